@@ -19,8 +19,9 @@ void PrintTopic(const std::string &topic, basis::core::transport::CoordinatorCon
     return;
   }
 
-  std::string schema_id = it->second.publishers()[0].schema_id();
-  std::optional<basis::core::transport::proto::MessageSchema> maybe_schema = FetchSchema(schema_id, connector, 5);
+  const auto &publisher = it->second.publishers()[0];
+  std::optional<basis::core::transport::proto::MessageSchema> maybe_schema =
+      FetchSchema(publisher.schema_id(), connector, 5, publisher.schema_hash_id());
   if (!maybe_schema) {
     return;
   }
@@ -33,7 +34,7 @@ void PrintTopic(const std::string &topic, basis::core::transport::CoordinatorCon
   }
   core::serialization::SerializationPlugin *plugin = plugin_it->second.get();
 
-  plugin->LoadSchema(maybe_schema->name(), maybe_schema->schema());
+  GetSchemaCache().LoadInto(plugin, *maybe_schema);
   basis::core::transport::TransportManager transport_manager(
       std::make_unique<basis::core::transport::InprocTransport>());
   transport_manager.RegisterTransport("net_tcp", std::make_unique<basis::plugins::transport::TcpTransport>());
@@ -58,7 +59,7 @@ void PrintTopic(const std::string &topic, basis::core::transport::CoordinatorCon
 
   while (!max_num_messages || max_num_messages > num_messages) {
     // todo: move this out into "unit"
-    connector->SendTransportManagerInfo(transport_manager.GetTransportManagerInfo());
+    connector->SendPublishersIfChanged(transport_manager.GetTransportManagerInfo());
     connector->Update();
 
     if (connector->GetLastNetworkInfo()) {
@@ -79,8 +80,9 @@ bool RateTopic(const std::string &topic, basis::core::transport::CoordinatorConn
     return false;
   }
 
-  std::string schema_id = it->second.publishers()[0].schema_id();
-  std::optional<basis::core::transport::proto::MessageSchema> maybe_schema = FetchSchema(schema_id, connector, 5);
+  const auto &publisher = it->second.publishers()[0];
+  std::optional<basis::core::transport::proto::MessageSchema> maybe_schema =
+      FetchSchema(publisher.schema_id(), connector, 5, publisher.schema_hash_id());
   if (!maybe_schema) {
     return false;
   }
@@ -93,7 +95,7 @@ bool RateTopic(const std::string &topic, basis::core::transport::CoordinatorConn
   }
   core::serialization::SerializationPlugin *plugin = plugin_it->second.get();
 
-  plugin->LoadSchema(maybe_schema->name(), maybe_schema->schema());
+  GetSchemaCache().LoadInto(plugin, *maybe_schema);
   basis::core::transport::TransportManager transport_manager(
       std::make_unique<basis::core::transport::InprocTransport>());
   transport_manager.RegisterTransport("net_tcp", std::make_unique<basis::plugins::transport::TcpTransport>());
@@ -106,7 +108,7 @@ bool RateTopic(const std::string &topic, basis::core::transport::CoordinatorConn
 
   while (true) {
     // todo: move this out into "unit"
-    connector->SendTransportManagerInfo(transport_manager.GetTransportManagerInfo());
+    connector->SendPublishersIfChanged(transport_manager.GetTransportManagerInfo());
     connector->Update();
 
     if (connector->GetLastNetworkInfo()) {
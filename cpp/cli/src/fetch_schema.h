@@ -1,10 +1,27 @@
 #pragma once
 #include <basis/core/coordinator_connector.h>
+#include <basis/core/schema_cache.h>
 #include <basis/core/transport/transport_manager.h>
 #include <iostream>
 
+/**
+ * Schemas seen by this process, backed by the on disk cache.
+ */
+inline basis::core::transport::SchemaCache &GetSchemaCache() {
+  static basis::core::transport::SchemaCache cache;
+  return cache;
+}
+
+/**
+ * Fetches a schema, from the schema cache if `hash_id` is known, otherwise from the coordinator.
+ */
 std::optional<basis::core::transport::proto::MessageSchema>
-FetchSchema(const std::string &schema_id, basis::core::transport::CoordinatorConnector *connector, int timeout_s) {
+FetchSchema(const std::string &schema_id, basis::core::transport::CoordinatorConnector *connector, int timeout_s,
+            const std::string &hash_id = "") {
+  if (auto cached = GetSchemaCache().Get(schema_id, hash_id)) {
+    return cached;
+  }
+
   connector->RequestSchemas({&schema_id, 1});
 
   auto end = std::chrono::steady_clock::now() + std::chrono::seconds(timeout_s);
@@ -13,6 +30,7 @@ FetchSchema(const std::string &schema_id, basis::core::transport::CoordinatorCon
     connector->Update();
     auto schema_ptr = connector->TryGetSchema(schema_id);
     if (schema_ptr) {
+      GetSchemaCache().Add(*schema_ptr);
       return *schema_ptr;
     }
 
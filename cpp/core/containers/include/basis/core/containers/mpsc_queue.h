@@ -0,0 +1,212 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <basis/core/time.h>
+
+namespace basis::core::containers {
+
+/**
+ * Inherit from this to be queued on an IntrusiveMPSCQueue.
+ */
+struct MPSCQueueNode {
+  std::atomic<MPSCQueueNode *> mpsc_next = nullptr;
+};
+
+/**
+ * Lock free, unbounded, multi producer single consumer queue of caller owned nodes (Vyukov's intrusive MPSC queue).
+ *
+ * Pushing is a single exchange, no matter how many producers. Popping never blocks on a producer, with one caveat: a
+ * producer preempted between its exchange and linking its node hides anything pushed after it until it resumes.
+ *
+ * The consumer can wait for work - producers only pay for a wake syscall if it's actually asleep.
+ */
+template <typename T_NODE> class IntrusiveMPSCQueue {
+public:
+  IntrusiveMPSCQueue() = default;
+
+  IntrusiveMPSCQueue(const IntrusiveMPSCQueue &) = delete;
+  IntrusiveMPSCQueue &operator=(const IntrusiveMPSCQueue &) = delete;
+
+  /**
+   * Any thread.
+   */
+  void Push(T_NODE *node) {
+    Link(node);
+    // Paired with Pop() - either the consumer sees the new count, or we see it waiting
+    pushed.fetch_add(1);
+    if (consumer_waiting.load()) {
+      syscall(SYS_futex, FutexWord(), FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+    }
+  }
+
+  /**
+   * Consumer only. Returns the oldest node, waiting up to `sleep` for one if empty, or nullptr on timeout.
+   */
+  T_NODE *Pop(const Duration &sleep = Duration::FromSecondsNanoseconds(0, 0)) {
+    if (T_NODE *node = TryPop()) {
+      return node;
+    }
+    if (sleep.nsecs <= 0) {
+      return nullptr;
+    }
+
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::nanoseconds(sleep.nsecs);
+    while (true) {
+      const uint32_t last_pushed = pushed.load();
+      if (T_NODE *node = TryPop()) {
+        return node;
+      }
+
+      const auto remaining = deadline - std::chrono::steady_clock::now();
+      if (remaining <= std::chrono::nanoseconds::zero()) {
+        return nullptr;
+      }
+
+      consumer_waiting.store(true);
+      if (pushed.load() == last_pushed) {
+        const auto seconds = std::chrono::duration_cast<std::chrono::seconds>(remaining);
+        timespec timeout{.tv_sec = seconds.count(),
+                         .tv_nsec = std::chrono::duration_cast<std::chrono::nanoseconds>(remaining - seconds).count()};
+        syscall(SYS_futex, FutexWord(), FUTEX_WAIT_PRIVATE, last_pushed, &timeout, nullptr, 0);
+      }
+      consumer_waiting.store(false);
+    }
+  }
+
+  /**
+   * Approximate when called from a producer.
+   */
+  size_t Size() const { return uint32_t(pushed.load(std::memory_order_relaxed) - popped.load(std::memory_order_relaxed)); }
+
+private:
+  void Link(MPSCQueueNode *node) {
+    node->mpsc_next.store(nullptr, std::memory_order_relaxed);
+    MPSCQueueNode *prev = head.exchange(node, std::memory_order_acq_rel);
+    prev->mpsc_next.store(node, std::memory_order_release);
+  }
+
+  T_NODE *TryPop() {
+    MPSCQueueNode *node = tail;
+    MPSCQueueNode *next = node->mpsc_next.load(std::memory_order_acquire);
+    if (node == &stub) {
+      if (next == nullptr) {
+        return nullptr;
+      }
+      tail = next;
+      node = next;
+      next = next->mpsc_next.load(std::memory_order_acquire);
+    }
+
+    if (next == nullptr) {
+      if (node != head.load(std::memory_order_acquire)) {
+        // A producer is midway through pushing
+        return nullptr;
+      }
+      // `node` is the last one - put the stub back behind it so it can be handed out
+      Link(&stub);
+      next = node->mpsc_next.load(std::memory_order_acquire);
+      if (next == nullptr) {
+        return nullptr;
+      }
+    }
+
+    tail = next;
+    popped.store(popped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    return static_cast<T_NODE *>(node);
+  }
+
+  uint32_t *FutexWord() { return reinterpret_cast<uint32_t *>(&pushed); }
+
+  MPSCQueueNode stub;
+  /// Producers only
+  alignas(64) std::atomic<MPSCQueueNode *> head = &stub;
+  /// Bumped after every push, doubles as the futex word the consumer sleeps on
+  std::atomic<uint32_t> pushed = 0;
+  std::atomic<bool> consumer_waiting = false;
+  /// Consumer only
+  alignas(64) MPSCQueueNode *tail = &stub;
+  std::atomic<uint32_t> popped = 0;
+};
+
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t));
+
+/**
+ * Lock free multi producer single consumer queue of values, optionally bounded.
+ */
+template <typename T> class MPSCQueue {
+public:
+  /**
+   * @param max_size 0 for unbounded. Enforced approximately - concurrent producers may overshoot by one each.
+   */
+  explicit MPSCQueue(size_t max_size = 0) : max_size(max_size) {}
+
+  ~MPSCQueue() {
+    while (Node *node = queue.Pop()) {
+      delete node;
+    }
+  }
+
+  /**
+   * Adds item to the queue. Any thread.
+   *
+   * @return false if the queue is full
+   */
+  bool Emplace(T &&item) {
+    if (max_size != 0 && queue.Size() >= max_size) {
+      return false;
+    }
+    queue.Push(new Node(std::move(item)));
+    return true;
+  }
+
+  size_t Size() const { return queue.Size(); }
+
+  /**
+   * Removes an item out of the queue - or nothing if there's a timeout. Consumer only.
+   */
+  std::optional<T> Pop(const Duration &sleep = basis::core::Duration::FromSecondsNanoseconds(0, 0)) {
+    Node *node = queue.Pop(sleep);
+    if (node == nullptr) {
+      return std::nullopt;
+    }
+    std::optional<T> ret(std::move(node->value));
+    delete node;
+    return ret;
+  }
+
+  /**
+   * Appends everything currently in the queue to `out`, waiting up to `sleep` for the first item. Consumer only.
+   *
+   * @return the number of items appended
+   */
+  size_t PopAll(std::vector<T> &out, const Duration &sleep = basis::core::Duration::FromSecondsNanoseconds(0, 0)) {
+    const size_t start_size = out.size();
+    for (Node *node = queue.Pop(sleep); node != nullptr; node = queue.Pop()) {
+      out.push_back(std::move(node->value));
+      delete node;
+    }
+    return out.size() - start_size;
+  }
+
+private:
+  struct Node : public MPSCQueueNode {
+    explicit Node(T &&value) : value(std::move(value)) {}
+    T value;
+  };
+
+  const size_t max_size;
+  IntrusiveMPSCQueue<Node> queue;
+};
+
+} // namespace basis::core::containers
@@ -1,101 +1,320 @@
-
 #pragma once
 
-#include <chrono>
-#include <condition_variable>
+#include <atomic>
+#include <cstdint>
 #include <deque>
 #include <functional>
+#include <limits>
 #include <memory>
 #include <mutex>
 #include <optional>
 #include <queue>
+#include <vector>
 
 #include <basis/core/time.h>
 
+#include "mpsc_queue.h"
+
 namespace basis::core::containers {
 
+class SubscriberQueue;
+
+/**
+ * Dispatch stats for everything queued with the same CallbackSchedule, ie one handler.
+ */
+struct CallbackStats {
+  /// Callbacks handed out by Pop()
+  std::atomic<uint64_t> dispatched = 0;
+  /// Callbacks handed out after their deadline
+  std::atomic<uint64_t> deadline_misses = 0;
+  /// Time spent queued, summed and worst case
+  std::atomic<int64_t> total_latency_nsecs = 0;
+  std::atomic<int64_t> max_latency_nsecs = 0;
+};
+
+/**
+ * Where a callback goes in the overall queue - highest priority first, then earliest deadline first, then in the
+ * order queued. Callbacks with no deadline go after those with one, at the same priority, and stay in the order queued
+ * relative to each other - so nothing is reordered at a given priority until someone opts in by setting a deadline.
+ */
+struct CallbackSchedule {
+  int32_t priority = 0;
+  /// Relative to when the callback is queued
+  std::optional<Duration> deadline;
+  /// Optional
+  std::shared_ptr<CallbackStats> stats;
+};
+
+/**
+ * A single queued callback. Shared between the SubscriberOverallQueue (which runs it) and the SubscriberQueue it came
+ * from (which may drop it to enforce its limit) - whoever claims it first wins.
+ */
+struct SubscriberCallbackNode : public MPSCQueueNode {
+  explicit SubscriberCallbackNode(std::function<void()> &&callback, std::shared_ptr<const std::atomic<bool>> alive,
+                                  uint32_t refs)
+      : callback(std::move(callback)), subscriber_alive(std::move(alive)), refs(refs) {}
+
+  bool Claim() { return !claimed.exchange(true, std::memory_order_acq_rel); }
+
+  void Release() {
+    if (refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      delete this;
+    }
+  }
+
+  void SetSchedule(const CallbackSchedule &schedule) {
+    priority = schedule.priority;
+    stats = schedule.stats;
+    if (stats || schedule.deadline) {
+      // Wall clock - this is about how long the queue took, not about the data
+      queued_nsecs = MonotonicTime::Now(true).nsecs;
+      if (schedule.deadline) {
+        deadline_nsecs = queued_nsecs + schedule.deadline->nsecs;
+      }
+    }
+  }
+
+  std::function<void()> callback;
+  /// Cleared when the SubscriberQueue is destroyed, so that nothing it queued runs afterwards
+  std::shared_ptr<const std::atomic<bool>> subscriber_alive;
+  std::atomic<bool> claimed = false;
+  std::atomic<uint32_t> refs;
+
+  int32_t priority = 0;
+  int64_t deadline_nsecs = std::numeric_limits<int64_t>::max();
+  int64_t queued_nsecs = 0;
+  std::shared_ptr<CallbackStats> stats;
+  /// Queue order, set by the consumer
+  uint64_t sequence = 0;
+};
+
+/**
+ * Callbacks from every subscriber of a unit, ordered by their CallbackSchedule - in the order they were queued, if
+ * nothing sets one. Any thread may add, only one thread may Pop().
+ *
+ * Producers only ever touch the lock free queue. The consumer moves everything queued so far into a heap on each
+ * Pop(), so ordering costs nothing on the publishing side.
+ */
 class SubscriberOverallQueue {
 public:
+  SubscriberOverallQueue() = default;
+
+  /**
+   * @param on_push called after every push, on the pushing thread - ie to hand the queue to a worker rather than
+   * polling it
+   */
+  explicit SubscriberOverallQueue(std::function<void()> on_push) : on_push(std::move(on_push)) {}
+
+  ~SubscriberOverallQueue() {
+    while (SubscriberCallbackNode *node = queue.Pop()) {
+      node->Release();
+    }
+    while (!ready.empty()) {
+      ready.top()->Release();
+      ready.pop();
+    }
+  }
 
   std::optional<std::function<void()>> Pop(const Duration &sleep = basis::core::Duration::FromSecondsNanoseconds(0, 0)) {
-    std::unique_lock lock(mutex);
-    if (queue.empty()) {
-      cv.wait_for(lock, std::chrono::duration<double>(sleep.ToSeconds()), [this] { return !queue.empty(); });
+    // Only wait if there's nothing at all - anything after the first may have been dropped by its subscriber
+    if (ready.empty()) {
+      SubscriberCallbackNode *node = queue.Pop(sleep);
+      if (!node) {
+        return std::nullopt;
+      }
+      MakeReady(node);
+    }
+    while (SubscriberCallbackNode *node = queue.Pop()) {
+      MakeReady(node);
     }
 
-    while (!queue.empty()) {
-      auto front = queue.front();
-      if (auto front_ptr = front.lock()) {
-        queue.pop();
-        return std::move(*front_ptr);
+    while (!ready.empty()) {
+      SubscriberCallbackNode *node = ready.top();
+      ready.pop();
+      ready_count.store(ready.size(), std::memory_order_relaxed);
+
+      std::optional<std::function<void()>> ret;
+      if (node->Claim() && (!node->subscriber_alive || node->subscriber_alive->load(std::memory_order_acquire))) {
+        ret = std::move(node->callback);
+        RecordDispatch(*node);
       }
-      else {
-        queue.pop();
+      node->Release();
+      if (ret) {
+        return ret;
       }
     }
-
     return std::nullopt;
   }
 
-  size_t Size() const {
-    std::lock_guard lock(mutex);
-    return queue.size();
+  /**
+   * Includes callbacks since dropped by their subscriber.
+   */
+  size_t Size() const { return queue.Size() + ready_count.load(std::memory_order_relaxed); }
+
+  /**
+   * Queue a callback that isn't associated with any SubscriberQueue - it will always run.
+   */
+  void AddCallback(std::function<void()> callback, const CallbackSchedule &schedule = {}) {
+    auto *node = new SubscriberCallbackNode(std::move(callback), nullptr, 1);
+    node->SetSchedule(schedule);
+    PushNode(node);
   }
 
-  void AddCallback(const std::shared_ptr<std::function<void()>> &cb_ptr) {
-    {
-      std::lock_guard<std::mutex> lock(mutex);
-      queue.emplace(cb_ptr);
+  /**
+   * Queue a callback owned by the caller - it only runs if the caller still holds on to it by then.
+   */
+  void AddCallback(const std::shared_ptr<std::function<void()>> &callback_ptr, const CallbackSchedule &schedule = {}) {
+    AddCallback(
+        [weak_callback = std::weak_ptr<std::function<void()>>(callback_ptr)]() {
+          if (auto callback = weak_callback.lock()) {
+            (*callback)();
+          }
+        },
+        schedule);
+  }
+
+protected:
+  friend class SubscriberQueue;
+
+  void PushNode(SubscriberCallbackNode *node) {
+    queue.Push(node);
+    if (on_push) {
+      on_push();
     }
-    cv.notify_one();
   }
 
+  IntrusiveMPSCQueue<SubscriberCallbackNode> queue;
+  const std::function<void()> on_push;
+
 private:
-  std::queue<std::weak_ptr<std::function<void()>>> queue; // Stores weak_ptrs to callbacks
-  mutable std::mutex mutex;                                      // Mutex to protect the queue
-  std::condition_variable cv;                            // Condition variable to signal when new callbacks are added
+  struct RunsAfter {
+    bool operator()(const SubscriberCallbackNode *a, const SubscriberCallbackNode *b) const {
+      if (a->priority != b->priority) {
+        return a->priority < b->priority;
+      }
+      if (a->deadline_nsecs != b->deadline_nsecs) {
+        return a->deadline_nsecs > b->deadline_nsecs;
+      }
+      return a->sequence > b->sequence;
+    }
+  };
+
+  void MakeReady(SubscriberCallbackNode *node) {
+    node->sequence = next_sequence++;
+    ready.push(node);
+    ready_count.store(ready.size(), std::memory_order_relaxed);
+  }
+
+  static void RecordDispatch(const SubscriberCallbackNode &node) {
+    if (!node.stats) {
+      return;
+    }
+    CallbackStats &stats = *node.stats;
+    const int64_t now = MonotonicTime::Now(true).nsecs;
+    const int64_t latency = now - node.queued_nsecs;
+    stats.dispatched.fetch_add(1, std::memory_order_relaxed);
+    if (now > node.deadline_nsecs) {
+      stats.deadline_misses.fetch_add(1, std::memory_order_relaxed);
+    }
+    stats.total_latency_nsecs.fetch_add(latency, std::memory_order_relaxed);
+    int64_t max_latency = stats.max_latency_nsecs.load(std::memory_order_relaxed);
+    while (latency > max_latency &&
+           !stats.max_latency_nsecs.compare_exchange_weak(max_latency, latency, std::memory_order_relaxed)) {
+    }
+  }
+
+  // Consumer only
+  std::priority_queue<SubscriberCallbackNode *, std::vector<SubscriberCallbackNode *>, RunsAfter> ready;
+  uint64_t next_sequence = 0;
+  /// ready.size(), for Size() from other threads
+  std::atomic<size_t> ready_count = 0;
 };
 
+/**
+ * A single subscriber's view into a SubscriberOverallQueue, dropping its oldest callbacks past `limit`.
+ *
+ * The callbacks themselves live in the overall queue - this only tracks the most recent `limit` of them, so that the
+ * oldest can be dropped (and whatever they hold on to freed) as soon as they are superseded.
+ */
 class SubscriberQueue {
 public:
-  SubscriberQueue(std::shared_ptr<SubscriberOverallQueue> overall_queue, size_t limit)
-      : overall_queue(std::move(overall_queue)), limit(limit) {}
+  SubscriberQueue(std::shared_ptr<SubscriberOverallQueue> overall_queue, size_t limit,
+                  CallbackSchedule schedule = {})
+      : overall_queue(std::move(overall_queue)), limit(limit), schedule(std::move(schedule)) {}
+
+  ~SubscriberQueue() {
+    alive->store(false, std::memory_order_release);
+    std::lock_guard lock(mutex);
+    for (SubscriberCallbackNode *node : recent) {
+      Drop(node);
+    }
+  }
+
+  SubscriberQueue(const SubscriberQueue &) = delete;
+  SubscriberQueue &operator=(const SubscriberQueue &) = delete;
 
   // Set a new limit for this subscriber
   void SetLimit(size_t limit) {
     std::lock_guard<std::mutex> lock(mutex);
+    if (limit == 0) {
+      // Nothing to track anymore
+      for (SubscriberCallbackNode *node : recent) {
+        node->Release();
+      }
+      recent.clear();
+    }
     this->limit = limit;
     EnforceLimit();
   }
 
   // Add a callback to the subscriber's queue
   void AddCallback(std::function<void()> callback) {
-    auto cb_ptr = std::make_shared<std::function<void()>>(std::move(callback));
+    // Unlimited queues don't need to keep track of anything, skip the lock
+    if (limit.load(std::memory_order_relaxed) == 0) {
+      auto *node = new SubscriberCallbackNode(std::move(callback), alive, 1);
+      node->SetSchedule(schedule);
+      overall_queue->PushNode(node);
+      return;
+    }
 
+    auto *node = new SubscriberCallbackNode(std::move(callback), alive, 2);
+    node->SetSchedule(schedule);
     {
       std::lock_guard<std::mutex> lock(mutex);
-      callbacks.emplace_back(cb_ptr);
+      recent.push_back(node);
       EnforceLimit();
     }
-
-    overall_queue->AddCallback(cb_ptr);
+    overall_queue->PushNode(node);
   }
 
 private:
   void EnforceLimit() {
+    const size_t limit = this->limit.load(std::memory_order_relaxed);
     if (limit == 0) {
       return;
     }
 
-    while (callbacks.size() > limit) {
-      callbacks.pop_front();
+    while (recent.size() > limit) {
+      Drop(recent.front());
+      recent.pop_front();
+    }
+  }
+
+  static void Drop(SubscriberCallbackNode *node) {
+    if (node->Claim()) {
+      // Free whatever the callback holds on to now, rather than when the overall queue gets to it
+      node->callback = nullptr;
     }
+    node->Release();
   }
 
-  std::shared_ptr<SubscriberOverallQueue> overall_queue;        // Shared pointer to the overall queue
-  size_t limit;                                                 // Maximum number of callbacks allowed
-  std::deque<std::shared_ptr<std::function<void()>>> callbacks; // Holds shared_ptrs to callbacks
-  std::mutex mutex;                                             // Mutex to protect subscriber-specific data
+  std::shared_ptr<SubscriberOverallQueue> overall_queue;
+  std::atomic<size_t> limit;
+  const CallbackSchedule schedule;
+  std::shared_ptr<std::atomic<bool>> alive = std::make_shared<std::atomic<bool>>(true);
+  /// The most recent `limit` callbacks, some of which may have already run
+  std::deque<SubscriberCallbackNode *> recent;
+  std::mutex mutex;
 };
 
 using SubscriberQueueSharedPtr = std::shared_ptr<SubscriberQueue>;
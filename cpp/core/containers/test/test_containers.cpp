@@ -1,3 +1,4 @@
+#include <basis/core/containers/mpsc_queue.h>
 #include <basis/core/containers/subscriber_callback_queue.h>
 
 #include <gtest/gtest.h>
@@ -7,6 +8,7 @@
 #include <mutex>
 #include <optional>
 #include <thread>
+#include <unordered_map>
 #include <vector>
 
 namespace containers = basis::core::containers;
@@ -214,3 +216,207 @@ TEST_F(SubscriberQueueTest, ZeroLimit) {
   auto called_ids = callback_mock->GetCalledIds();
   ASSERT_EQ(called_ids.size(), 2);
 }
+
+TEST_F(SubscriberQueueTest, DestroyedSubscriberDropsPending) {
+  {
+    containers::SubscriberQueue limited(overall_queue, 2);
+    containers::SubscriberQueue unlimited(overall_queue, 0);
+    limited.AddCallback([this]() { callback_mock->Callback(1); });
+    unlimited.AddCallback([this]() { callback_mock->Callback(2); });
+  }
+  overall_queue->AddCallback([this]() { callback_mock->Callback(3); });
+
+  ProcessAllCallbacks(overall_queue);
+
+  auto called_ids = callback_mock->GetCalledIds();
+  ASSERT_EQ(called_ids.size(), 1);
+  EXPECT_EQ(called_ids[0], 3);
+}
+
+TEST_F(SubscriberQueueTest, DroppedCallbacksAreFreed) {
+  containers::SubscriberQueue subscriber(overall_queue, 1);
+  auto payload = std::make_shared<int>(0);
+  subscriber.AddCallback([payload]() {});
+  ASSERT_EQ(payload.use_count(), 2);
+  // Superseded - released immediately, not when the overall queue gets to it
+  subscriber.AddCallback([]() {});
+  ASSERT_EQ(payload.use_count(), 1);
+}
+
+TEST_F(SubscriberQueueTest, OwnedCallback) {
+  auto kept = std::make_shared<std::function<void()>>([this]() { callback_mock->Callback(1); });
+  auto released = std::make_shared<std::function<void()>>([this]() { callback_mock->Callback(2); });
+  overall_queue->AddCallback(kept);
+  overall_queue->AddCallback(released);
+  released = nullptr;
+
+  ProcessAllCallbacks(overall_queue);
+
+  auto called_ids = callback_mock->GetCalledIds();
+  ASSERT_EQ(called_ids.size(), 1);
+  EXPECT_EQ(called_ids[0], 1);
+}
+
+TEST_F(SubscriberQueueTest, OnPush) {
+  size_t pushes = 0;
+  auto notifying_queue = std::make_shared<containers::SubscriberOverallQueue>([&pushes]() { pushes++; });
+  containers::SubscriberQueue subscriber(notifying_queue, 1);
+  subscriber.AddCallback([this]() { callback_mock->Callback(1); });
+  subscriber.AddCallback([this]() { callback_mock->Callback(2); });
+  notifying_queue->AddCallback([this]() { callback_mock->Callback(3); });
+  ASSERT_EQ(pushes, 3);
+
+  ProcessAllCallbacks(notifying_queue);
+  auto called_ids = callback_mock->GetCalledIds();
+  ASSERT_EQ(called_ids.size(), 2);
+  EXPECT_EQ(called_ids[0], 2);
+  EXPECT_EQ(called_ids[1], 3);
+}
+
+TEST_F(SubscriberQueueTest, Priority) {
+  containers::SubscriberQueue low(overall_queue, 0, {.priority = -1});
+  containers::SubscriberQueue normal(overall_queue, 0);
+  containers::SubscriberQueue high(overall_queue, 0, {.priority = 10});
+  low.AddCallback([this]() { callback_mock->Callback(1); });
+  normal.AddCallback([this]() { callback_mock->Callback(2); });
+  high.AddCallback([this]() { callback_mock->Callback(3); });
+  normal.AddCallback([this]() { callback_mock->Callback(4); });
+  overall_queue->AddCallback([this]() { callback_mock->Callback(5); }, {.priority = 10});
+
+  ProcessAllCallbacks(overall_queue);
+
+  EXPECT_EQ(callback_mock->GetCalledIds(), std::vector<int>({3, 5, 2, 4, 1}));
+}
+
+TEST_F(SubscriberQueueTest, EarliestDeadlineFirst) {
+  using basis::core::Duration;
+  containers::SubscriberQueue slow(overall_queue, 0, {.deadline = Duration::FromSeconds(10)});
+  containers::SubscriberQueue fast(overall_queue, 0, {.deadline = Duration::FromSeconds(0.001)});
+  containers::SubscriberQueue whenever(overall_queue, 0);
+  whenever.AddCallback([this]() { callback_mock->Callback(1); });
+  slow.AddCallback([this]() { callback_mock->Callback(2); });
+  fast.AddCallback([this]() { callback_mock->Callback(3); });
+
+  ProcessAllCallbacks(overall_queue);
+
+  EXPECT_EQ(callback_mock->GetCalledIds(), std::vector<int>({3, 2, 1}));
+}
+
+TEST_F(SubscriberQueueTest, NoDeadlineKeepsQueueOrder) {
+  using basis::core::Duration;
+  // Stats alone don't give a callback a deadline, so it shouldn't jump the line
+  containers::SubscriberQueue rate(overall_queue, 0, {.stats = std::make_shared<containers::CallbackStats>()});
+  containers::SubscriberQueue other(overall_queue, 0);
+  other.AddCallback([this]() { callback_mock->Callback(1); });
+  rate.AddCallback([this]() { callback_mock->Callback(2); });
+  other.AddCallback([this]() { callback_mock->Callback(3); });
+  overall_queue->AddCallback([this]() { callback_mock->Callback(4); });
+  rate.AddCallback([this]() { callback_mock->Callback(5); });
+
+  ProcessAllCallbacks(overall_queue);
+  EXPECT_EQ(callback_mock->GetCalledIds(), std::vector<int>({1, 2, 3, 4, 5}));
+
+  // Opting in with a deadline moves ahead of everything else at the same priority
+  containers::SubscriberQueue opted_in(overall_queue, 0, {.deadline = Duration::FromSeconds(10)});
+  other.AddCallback([this]() { callback_mock->Callback(6); });
+  opted_in.AddCallback([this]() { callback_mock->Callback(7); });
+
+  ProcessAllCallbacks(overall_queue);
+  EXPECT_EQ(callback_mock->GetCalledIds(), std::vector<int>({1, 2, 3, 4, 5, 7, 6}));
+}
+
+TEST_F(SubscriberQueueTest, DispatchStats) {
+  auto stats = std::make_shared<containers::CallbackStats>();
+  containers::SubscriberQueue subscriber(overall_queue, 0,
+                                         {.deadline = basis::core::Duration::FromSeconds(0.005), .stats = stats});
+  subscriber.AddCallback([]() {});
+  ProcessAllCallbacks(overall_queue);
+  ASSERT_EQ(stats->dispatched, 1);
+  ASSERT_EQ(stats->deadline_misses, 0);
+
+  subscriber.AddCallback([]() {});
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  ASSERT_EQ(overall_queue->Size(), 1);
+  ProcessAllCallbacks(overall_queue);
+  ASSERT_EQ(stats->dispatched, 2);
+  ASSERT_EQ(stats->deadline_misses, 1);
+  ASSERT_GE(stats->max_latency_nsecs, 20'000'000);
+  ASSERT_GE(stats->total_latency_nsecs, stats->max_latency_nsecs);
+}
+
+TEST(MPSCQueue, Basic) {
+  containers::MPSCQueue<int> queue;
+  ASSERT_EQ(queue.Pop(), std::nullopt);
+  ASSERT_EQ(queue.Size(), 0);
+
+  for (int i = 0; i < 5; i++) {
+    ASSERT_TRUE(queue.Emplace(int(i)));
+  }
+  ASSERT_EQ(queue.Size(), 5);
+  ASSERT_EQ(queue.Pop(), 0);
+
+  std::vector<int> out;
+  ASSERT_EQ(queue.PopAll(out), 4);
+  ASSERT_EQ(out, (std::vector<int>{1, 2, 3, 4}));
+  ASSERT_EQ(queue.Size(), 0);
+  ASSERT_EQ(queue.PopAll(out), 0);
+}
+
+TEST(MPSCQueue, Bounded) {
+  containers::MPSCQueue<int> queue(2);
+  ASSERT_TRUE(queue.Emplace(1));
+  ASSERT_TRUE(queue.Emplace(2));
+  ASSERT_FALSE(queue.Emplace(3));
+  ASSERT_EQ(queue.Pop(), 1);
+  ASSERT_TRUE(queue.Emplace(4));
+}
+
+TEST(MPSCQueue, Wait) {
+  containers::MPSCQueue<int> queue;
+
+  // Times out
+  const auto start = std::chrono::steady_clock::now();
+  ASSERT_EQ(queue.Pop(basis::core::Duration::FromSecondsNanoseconds(0, 20'000'000)), std::nullopt);
+  ASSERT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(20));
+
+  // Woken by a producer, well before the timeout
+  std::thread producer([&queue]() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    queue.Emplace(5);
+  });
+  ASSERT_EQ(queue.Pop(basis::core::Duration::FromSecondsNanoseconds(10, 0)), 5);
+  producer.join();
+}
+
+TEST(MPSCQueue, ConcurrentProducers) {
+  constexpr int PRODUCER_COUNT = 4;
+  constexpr int ITEMS_PER_PRODUCER = 50000;
+  containers::MPSCQueue<std::pair<int, int>> queue;
+
+  std::vector<std::thread> producers;
+  for (int p = 0; p < PRODUCER_COUNT; p++) {
+    producers.emplace_back([&queue, p]() {
+      for (int i = 0; i < ITEMS_PER_PRODUCER; i++) {
+        queue.Emplace({p, i});
+      }
+    });
+  }
+
+  // Every item arrives exactly once, in order per producer
+  std::unordered_map<int, int> next_expected;
+  std::vector<std::pair<int, int>> batch;
+  int received = 0;
+  while (received < PRODUCER_COUNT * ITEMS_PER_PRODUCER) {
+    queue.PopAll(batch, basis::core::Duration::FromSecondsNanoseconds(1, 0));
+    for (auto [p, i] : batch) {
+      ASSERT_EQ(next_expected[p]++, i);
+    }
+    received += batch.size();
+    batch.clear();
+  }
+
+  for (auto &producer : producers) {
+    producer.join();
+  }
+  ASSERT_EQ(queue.Pop(), std::nullopt);
+}
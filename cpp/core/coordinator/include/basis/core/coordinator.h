@@ -8,10 +8,12 @@
 #include <transport.pb.h>
 #pragma clang diagnostic pop
 
+#include <basis/core/time.h>
 #include <basis/plugins/serialization/protobuf.h>
 #include <basis/plugins/transport/tcp.h>
 
 #include "coordinator_default_port.h"
+#include "publishers_delta.h"
 
 /**
  * This is a bit annoying. We have to create a custom transport for publisher info as both the coordinator socket needs
@@ -46,23 +48,31 @@ namespace basis::core::transport {
 /**
  * A utility class for communicating the topic network state between TransportManagers (typically one per process)
  *
- * Implemented single threaded for safety - latency isn't a huge concern here.
+ * Implemented single threaded for safety - a single epoll instance covers the listen socket and every client, so one
+ * thread handles any number of clients and sleeps while there's nothing to do.
  *
- * @todo track publishers and add a delta message
- * @todo on connection, send the last message again (can we just implement latching?)
+ * The network's publishers are versioned. New clients get the full NetworkInfo once, after which they are only sent a
+ * PublishersDelta when something changes. Clients report their own publishers the same way.
  */
 class Coordinator {
   /**
    * An internal connection to a TransportManager
    */
   struct Connection : public basis::plugins::transport::TcpSender {
-    Connection(core::networking::TcpSocket &&socket) : TcpSender(std::move(socket)) { socket.SetNonblocking(); }
+    Connection(core::networking::TcpSocket &&socket) : TcpSender(std::move(socket)) {}
 
-    IncompleteMessagePacket in_progress_packet;
+    int GetFd() const { return socket.GetFd(); }
 
-    std::unique_ptr<proto::TransportManagerInfo> info;
+    basis::plugins::transport::TcpReceiveBuffer receive_buffer;
 
-    // todo: add rate limiting here to sending the publishers
+    /// This client's publishers, as of `publishers_version`
+    PublisherSet publishers;
+    uint64_t publishers_version = 0;
+    /// Set while waiting for the client to answer a RequestResync - deltas until then are stale
+    bool publishers_resync_requested = false;
+
+    /// Set until the client has been sent the full NetworkInfo - deltas are useless to it until then
+    bool needs_network_info = true;
   };
 
 public:
@@ -74,21 +84,35 @@ public:
    */
   static std::optional<Coordinator> Create(uint16_t port = BASIS_PUBLISH_INFO_PORT);
 
-  Coordinator(networking::TcpListenSocket &&listen_socket) : listen_socket(std::move(listen_socket)) {}
+  Coordinator(networking::TcpListenSocket &&listen_socket);
+
+  Coordinator(Coordinator &&other);
+  Coordinator &operator=(Coordinator &&other) = delete;
+
+  ~Coordinator();
 
   /**
-   * Gathers the publisher information from each client and packages it up into one message.
+   * Gathers the publisher information from each client and packages it up into one message, at the current version.
    */
   proto::NetworkInfo GenerateNetworkInfo();
 
   /**
-   * Update the coordinator. Should be called on a regular basis, from the main thread.
+   * Update the coordinator. Should be called in a loop, from the main thread.
    *
-   * Accept new clients
-   * Compiles data about the subscription networks
-   * Sends the data to each client
+   * Waits up to `max_sleep` for activity, then
+   *   Accepts new clients
+   *   Handles messages from any client that sent something, applying publisher changes
+   *   Sends the full network to new clients, and what changed (if anything) to everyone else
+   *
+   * @param max_sleep how long to wait for activity - returns as soon as there is some. Zero to only handle what's
+   * already arrived.
+   */
+  void Update(const Duration &max_sleep = Duration::FromSecondsNanoseconds(0, 0));
+
+  /**
+   * Bumped each time a delta goes out.
    */
-  void Update();
+  uint64_t GetNetworkInfoVersion() const { return network_info_version; }
 
   const std::unordered_map<std::string, proto::MessageSchema> &GetKnownSchemas() const { return known_schemas; }
 
@@ -104,7 +128,27 @@ protected:
     return shared_message;
   }
 
-  void HandleTransportManagerInfoRequest(proto::TransportManagerInfo *transport_manager_info, Connection &client);
+  void AcceptClients();
+
+  /**
+   * Handles everything the client has sent.
+   *
+   * @return false if the client disconnected
+   */
+  bool ReceiveFromClient(Connection &client);
+
+  void RemoveClient(Connection *client);
+
+  void HandleClientMessage(const proto::ClientToCoordinatorMessage &message, Connection &client);
+
+  /**
+   * Sends the pending delta to clients that are up to date, and the full network to any that aren't.
+   */
+  void SendNetworkUpdates();
+
+  void HandleTransportManagerInfoRequest(const proto::TransportManagerInfo &transport_manager_info,
+                                         Connection &client);
+  void HandlePublishersDeltaRequest(const proto::PublishersDelta &publishers_delta, Connection &client);
   void HandleSchemasRequest(const proto::MessageSchemas &schemas);
   void HandleRequestSchemasRequest(const proto::RequestSchemas &request_schemas, Connection &client);
 
@@ -114,10 +158,23 @@ protected:
   core::networking::TcpListenSocket listen_socket;
 
   /**
-   * The clients we should send information to. On disconnection, will be removed by Update()
+   * Watches the listen socket (with a null data pointer) and each client (pointing at its Connection).
+   */
+  int epoll_fd = -1;
+
+  /**
+   * The clients we should send information to. On disconnection, will be removed by Update(). A list, as epoll holds
+   * on to pointers to each Connection.
    */
   std::list<Connection> clients;
 
+  /**
+   * Changes to the network since the last delta was sent.
+   */
+  PublishersDeltaBuilder pending_network_delta;
+
+  uint64_t network_info_version;
+
   /**
    * All known schemas, indexed by "encoder_name:schema_name"
    */
@@ -12,6 +12,7 @@
 #include <basis/plugins/transport/tcp.h>
 
 #include "coordinator_default_port.h"
+#include "publishers_delta.h"
 
 #include <iostream>
 
@@ -43,10 +44,44 @@ public:
     SendMessage(shared_message);
   }
 
+  /**
+   * Sends the full set of our publishers to the coordinator. Prefer SendPublishersIfChanged().
+   */
   void SendTransportManagerInfo(const proto::TransportManagerInfo &info) {
     proto::ClientToCoordinatorMessage message;
     *message.mutable_transport_manager_info() = info;
+    message.mutable_transport_manager_info()->set_version(++publishers_version);
+    SendToCoordinator(message);
+
+    sent_publishers = ToPublisherSet(info);
+    publishers_resync_requested = false;
+  }
+
+  /**
+   * Sends whatever changed in our publishers since the last send, if anything. The first call (and any after the
+   * coordinator loses track of us) sends everything.
+   */
+  void SendPublishersIfChanged(const proto::TransportManagerInfo &info) {
+    if (publishers_version == 0 || publishers_resync_requested) {
+      SendTransportManagerInfo(info);
+      return;
+    }
+
+    PublisherSet publishers = ToPublisherSet(info);
+    PublishersDeltaBuilder builder;
+    builder.AddDiff(sent_publishers, publishers);
+    if (builder.Empty()) {
+      return;
+    }
+
+    proto::ClientToCoordinatorMessage message;
+    auto *delta = message.mutable_publishers_delta();
+    delta->set_base_version(publishers_version);
+    delta->set_version(++publishers_version);
+    builder.Build(delta);
     SendToCoordinator(message);
+
+    sent_publishers = std::move(publishers);
   }
 
   void SendSchemas(const std::vector<basis::core::serialization::MessageSchema> &schemas) {
@@ -94,6 +129,15 @@ public:
         }
         case proto::CoordinatorMessage::PossibleMessagesCase::kNetworkInfo: {
           last_network_info = std::unique_ptr<proto::NetworkInfo>(message->release_network_info());
+          network_resync_requested = false;
+          break;
+        }
+        case proto::CoordinatorMessage::PossibleMessagesCase::kNetworkInfoDelta: {
+          HandleNetworkInfoDelta(message->network_info_delta());
+          break;
+        }
+        case proto::CoordinatorMessage::PossibleMessagesCase::kRequestResync: {
+          publishers_resync_requested = true;
           break;
         }
         case proto::CoordinatorMessage::PossibleMessagesCase::kSchemas: {
@@ -125,6 +169,9 @@ public:
     } while (!finished);
   }
 
+  /**
+   * The network as of the last Update(). Its version only changes when the network does.
+   */
   proto::NetworkInfo *GetLastNetworkInfo() { return last_network_info.get(); }
 
   /**
@@ -142,7 +189,30 @@ public:
   std::vector<std::string> errors_from_coordinator;
 
 protected:
+  void HandleNetworkInfoDelta(const proto::PublishersDelta &delta) {
+    if (!last_network_info || delta.base_version() != last_network_info->version()) {
+      // Missed something - wait for the full network, ignoring any deltas already in flight
+      if (!network_resync_requested) {
+        BASIS_LOG_WARN("Got network delta from version {}, can't apply it - requesting resync", delta.base_version());
+        proto::ClientToCoordinatorMessage message;
+        message.mutable_request_resync();
+        SendToCoordinator(message);
+        network_resync_requested = true;
+      }
+      return;
+    }
+
+    ApplyPublishersDelta(delta, last_network_info.get());
+    last_network_info->set_version(delta.version());
+  }
+
   std::unique_ptr<proto::NetworkInfo> last_network_info;
+  bool network_resync_requested = false;
+
+  /// Our publishers, as last sent to the coordinator
+  PublisherSet sent_publishers;
+  uint64_t publishers_version = 0;
+  bool publishers_resync_requested = false;
 
   std::unordered_map<std::string, proto::MessageSchema> network_schemas;
 
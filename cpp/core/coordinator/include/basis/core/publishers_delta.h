@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wdeprecated-declarations"
+#include <transport.pb.h>
+#pragma clang diagnostic pop
+
+namespace basis::core::transport {
+
+/**
+ * The 128 bit publisher id, as sent over the wire.
+ */
+struct PublisherKey {
+  uint64_t high = 0;
+  uint64_t low = 0;
+
+  static PublisherKey FromProto(const proto::PublisherInfo &info) {
+    return {info.publisher_id_high(), info.publisher_id_low()};
+  }
+
+  bool operator==(const PublisherKey &) const = default;
+};
+
+struct PublisherKeyHash {
+  size_t operator()(const PublisherKey &key) const {
+    // Ids are random, either half is already a good hash
+    return std::hash<uint64_t>()(key.high ^ key.low);
+  }
+};
+
+/**
+ * A set of publishers, keyed by id.
+ */
+using PublisherSet = std::unordered_map<PublisherKey, proto::PublisherInfo, PublisherKeyHash>;
+
+PublisherSet ToPublisherSet(const proto::TransportManagerInfo &info);
+
+/**
+ * Accumulates adds and removes until they're sent off as a proto::PublishersDelta. Removing a publisher that was added
+ * since the last Build() cancels out the add.
+ */
+class PublishersDeltaBuilder {
+public:
+  void Add(const proto::PublisherInfo &info) { added[PublisherKey::FromProto(info)] = info; }
+
+  void Remove(const proto::PublisherInfo &info);
+
+  /**
+   * Adds whatever it takes to go from `from` to `to`.
+   */
+  void AddDiff(const PublisherSet &from, const PublisherSet &to);
+
+  bool Empty() const { return added.empty() && removed.empty(); }
+
+  /**
+   * Fills in the added and removed publishers of `delta` and resets the builder. Versions are left to the caller.
+   */
+  void Build(proto::PublishersDelta *delta);
+
+private:
+  PublisherSet added;
+  PublisherSet removed;
+};
+
+/**
+ * Applies the removes and then the adds from `delta` to `publishers`, without checking versions.
+ *
+ * @param changes optional, records each publisher actually removed or added
+ */
+void ApplyPublishersDelta(const proto::PublishersDelta &delta, PublisherSet *publishers,
+                          PublishersDeltaBuilder *changes = nullptr);
+
+/**
+ * Applies the removes and then the adds from `delta` to `network_info`, without checking versions. Topics left without
+ * publishers are erased.
+ */
+void ApplyPublishersDelta(const proto::PublishersDelta &delta, proto::NetworkInfo *network_info);
+
+} // namespace basis::core::transport
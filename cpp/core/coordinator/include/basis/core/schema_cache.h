@@ -0,0 +1,83 @@
+#pragma once
+
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+
+#include <basis/core/serialization.h>
+
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wdeprecated-declarations"
+#include <transport.pb.h>
+#pragma clang diagnostic pop
+
+namespace basis::core::transport {
+
+/**
+ * Content addressed store of schemas, keyed by MessageSchema::hash_id. The hash only covers the schema's content, and
+ * messages defined together may share it (eg protobuf messages from the same file), so the schema id is part of the key
+ * as well.
+ *
+ * Schemas are kept in memory and, if there's a cache directory, on disk - so that introspecting the same types again
+ * (even from another process) doesn't need a round trip to the coordinator. LoadInto() additionally remembers which
+ * schemas have already been compiled by a SerializationPlugin, so that each is only compiled once per process.
+ *
+ * Thread safe.
+ */
+class SchemaCache {
+public:
+  /**
+   * @param cache_dir where to persist schemas - empty to only cache in memory
+   */
+  explicit SchemaCache(std::filesystem::path cache_dir = DefaultCacheDir()) : cache_dir(std::move(cache_dir)) {}
+
+  /**
+   * $BASIS_SCHEMA_CACHE_DIR, falling back to $XDG_CACHE_HOME/basis/schemas, then ~/.cache/basis/schemas.
+   * Empty if none of those are set.
+   */
+  static std::filesystem::path DefaultCacheDir();
+
+  /**
+   * @return the schema, or nullopt if it isn't in memory or on disk
+   */
+  std::optional<proto::MessageSchema> Get(std::string_view schema_id, std::string_view hash_id);
+
+  /**
+   * Stores the schema, if it has a hash_id.
+   *
+   * @return false if the schema couldn't be cached
+   */
+  bool Add(const proto::MessageSchema &schema);
+
+  /**
+   * Loads the schema into the plugin, unless this cache already did so.
+   */
+  bool LoadInto(serialization::SerializationPlugin *plugin, const proto::MessageSchema &schema);
+
+  const std::filesystem::path &GetCacheDir() const { return cache_dir; }
+
+private:
+  static std::string Key(std::string_view schema_id, std::string_view hash_id) {
+    return std::string(schema_id) + "@" + std::string(hash_id);
+  }
+
+  /**
+   * Schema ids and hashes come from the network - don't let them pick arbitrary paths.
+   *
+   * @return nullopt if there's no cache directory, or the hash isn't usable as a filename
+   */
+  std::optional<std::filesystem::path> PathFor(std::string_view schema_id, std::string_view hash_id) const;
+
+  const std::filesystem::path cache_dir;
+
+  std::mutex mutex;
+  std::unordered_map<std::string, proto::MessageSchema> schemas;
+  /// Key() of each schema already handed to a plugin - loading is per process, so this isn't persisted
+  std::unordered_set<std::string> loaded;
+};
+
+} // namespace basis::core::transport
@@ -1,4 +1,10 @@
+#include <cassert>
+#include <chrono>
 #include <numeric>
+#include <utility>
+
+#include <sys/epoll.h>
+#include <unistd.h>
 
 #include <basis/core/coordinator.h>
 
@@ -16,97 +22,212 @@ std::optional<Coordinator> Coordinator::Create(uint16_t port) {
 
   return Coordinator(std::move(maybe_listen_socket.value()));
 }
+Coordinator::Coordinator(networking::TcpListenSocket &&listen_socket)
+    : listen_socket(std::move(listen_socket)), epoll_fd(epoll_create1(EPOLL_CLOEXEC)),
+      // Start from the wall clock rather than zero so that a restarted coordinator can't be confused with the old one
+      network_info_version(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                               std::chrono::system_clock::now().time_since_epoch())
+                               .count()) {
+  assert(epoll_fd != -1);
+
+  epoll_event event = {};
+  event.events = EPOLLIN;
+  event.data.ptr = nullptr;
+  epoll_ctl(epoll_fd, EPOLL_CTL_ADD, this->listen_socket.GetFd(), &event);
+}
+
+Coordinator::Coordinator(Coordinator &&other)
+    : listen_socket(std::move(other.listen_socket)), epoll_fd(std::exchange(other.epoll_fd, -1)),
+      // Moving a list keeps its nodes, so the Connection pointers registered with epoll stay valid
+      clients(std::move(other.clients)), pending_network_delta(std::move(other.pending_network_delta)),
+      network_info_version(other.network_info_version), known_schemas(std::move(other.known_schemas)) {}
+
+Coordinator::~Coordinator() {
+  if (epoll_fd != -1) {
+    close(epoll_fd);
+  }
+}
+
 proto::NetworkInfo Coordinator::GenerateNetworkInfo() {
   proto::NetworkInfo out;
 
   for (const auto &client : clients) {
-    if (client.info) {
-      for (auto &publisher : client.info->publishers()) {
-        *(*out.mutable_publishers_by_topic())[publisher.topic()].add_publishers() = publisher;
-      }
+    for (const auto &[key, publisher] : client.publishers) {
+      *(*out.mutable_publishers_by_topic())[publisher.topic()].add_publishers() = publisher;
     }
   }
+  out.set_version(network_info_version);
 
   return out;
 }
 
-void Coordinator::Update() {
-  // TODO: refactor this to select on all sockets - allows passing in a sleep time to Update()
+void Coordinator::Update(const Duration &max_sleep) {
+  constexpr int MAX_EVENTS = 128;
+  epoll_event ready_events[MAX_EVENTS];
 
-  // Look for new clients
-  while (auto maybe_socket = listen_socket.Accept(0)) {
-    clients.emplace_back(std::move(maybe_socket.value()));
-  }
-
-  // Receive messages from each client
-  for (auto it = clients.begin(); it != clients.end();) {
-    auto &client = *it;
-    switch (client.ReceiveMessage(client.in_progress_packet)) {
-    case plugins::transport::TcpConnection::ReceiveStatus::DONE: {
-      auto complete = client.in_progress_packet.GetCompletedMessage();
-      auto msg = basis::DeserializeFromSpan<proto::ClientToCoordinatorMessage>(complete->GetPayload());
-      if (!msg) {
-        BASIS_LOG_ERROR_NS(coordinator, "Coordinator: failed to deserialize a message");
-      } else {
-        // todo: break these out into handlers for better unit testing
-        switch (msg->PossibleMessages_case()) {
-        case proto::ClientToCoordinatorMessage::kTransportManagerInfo:
-          HandleTransportManagerInfoRequest(msg->release_transport_manager_info(), client);
-          break;
-
-        case proto::ClientToCoordinatorMessage::kSchemas:
-          HandleSchemasRequest(msg->schemas());
-          break;
-
-        case proto::ClientToCoordinatorMessage::kRequestSchemas:
-          HandleRequestSchemasRequest(msg->request_schemas(), client);
-          break;
-
-        case proto::ClientToCoordinatorMessage::POSSIBLEMESSAGES_NOT_SET:
-          BASIS_LOG_ERROR_NS(coordinator, "Unknown message from client!");
-          break;
-        }
-      }
-      // BASIS_LOG_DEBUG_NS(coordinator, "Got completed message {}", client.info->DebugString());
-      [[fallthrough]];
-    }
-    case plugins::transport::TcpConnection::ReceiveStatus::DOWNLOADING: {
-      // No work to be done
-      ++it;
-      break;
+  // epoll_wait() only has millisecond resolution - round up rather than spinning on sub millisecond sleeps
+  const int timeout_ms = max_sleep.nsecs <= 0 ? 0 : int((max_sleep.nsecs + 999'999) / 1'000'000);
+  const int nfds = epoll_wait(epoll_fd, ready_events, MAX_EVENTS, timeout_ms);
+  if (nfds < 0 && errno != EINTR) {
+    BASIS_LOG_ERROR_NS(coordinator, "epoll_wait failed: {} {}", errno, strerror(errno));
+  }
+
+  for (int n = 0; n < nfds; n++) {
+    auto *client = static_cast<Connection *>(ready_events[n].data.ptr);
+    if (client == nullptr) {
+      AcceptClients();
+    } else if (!ReceiveFromClient(*client)) {
+      RemoveClient(client);
     }
-    case plugins::transport::TcpConnection::ReceiveStatus::ERROR: {
-      BASIS_LOG_ERROR_NS(coordinator, "Client connection error after bytes {} - got error {} {}",
-                    client.in_progress_packet.GetCurrentProgress(), errno, strerror(errno));
-      // TODO: we can do a fast delete here instead, swapping with .last()
-      it = clients.erase(it);
-      break;
+  }
+
+  SendNetworkUpdates();
+}
+
+void Coordinator::AcceptClients() {
+  while (auto maybe_socket = listen_socket.Accept(0)) {
+    Connection &client = clients.emplace_back(std::move(maybe_socket.value()));
+
+    epoll_event event = {};
+    // Level triggered - a client that sent more than one read's worth is simply handled again next Update()
+    event.events = EPOLLIN | EPOLLRDHUP;
+    event.data.ptr = &client;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, client.GetFd(), &event)) {
+      BASIS_LOG_ERROR_NS(coordinator, "Failed to add client to epoll: {} {}", errno, strerror(errno));
+      clients.pop_back();
+      continue;
     }
-    case plugins::transport::TcpConnection::ReceiveStatus::DISCONNECTED: {
-      BASIS_LOG_ERROR_NS(coordinator, "Client connection disconnect after {} bytes", client.in_progress_packet.GetCurrentProgress());
-      // TODO: we can do a fast delete here instead, swapping with .last()
-      it = clients.erase(it);
-      break;
+
+    // The client may well have sent something already - that won't be part of this round of events
+    if (!ReceiveFromClient(client)) {
+      RemoveClient(&client);
     }
+  }
+}
+
+bool Coordinator::ReceiveFromClient(Connection &client) {
+  std::vector<std::unique_ptr<MessagePacket>> packets;
+  const auto status = client.ReceiveMessages(client.receive_buffer, packets);
+
+  // Handle whatever made it through, even if the client is gone now - it may have been its last words
+  for (auto &packet : packets) {
+    auto msg = basis::DeserializeFromSpan<proto::ClientToCoordinatorMessage>(packet->GetPayload());
+    if (!msg) {
+      BASIS_LOG_ERROR_NS(coordinator, "Coordinator: failed to deserialize a message");
+      continue;
     }
+    HandleClientMessage(*msg, client);
   }
 
-  proto::CoordinatorMessage message;
-  // Compile the information
-  *message.mutable_network_info() = GenerateNetworkInfo();
+  switch (status) {
+  case plugins::transport::TcpConnection::ReceiveStatus::DONE:
+  case plugins::transport::TcpConnection::ReceiveStatus::DOWNLOADING:
+    return true;
+  case plugins::transport::TcpConnection::ReceiveStatus::ERROR:
+    BASIS_LOG_ERROR_NS(coordinator, "Client connection error with {} bytes pending - got error {} {}",
+                       client.receive_buffer.GetPendingBytes(), client.receive_buffer.GetError(),
+                       strerror(client.receive_buffer.GetError()));
+    return false;
+  case plugins::transport::TcpConnection::ReceiveStatus::DISCONNECTED:
+    BASIS_LOG_ERROR_NS(coordinator, "Client connection disconnect with {} bytes pending",
+                       client.receive_buffer.GetPendingBytes());
+    return false;
+  }
+  return false;
+}
+
+void Coordinator::RemoveClient(Connection *client) {
+  epoll_ctl(epoll_fd, EPOLL_CTL_DEL, client->GetFd(), nullptr);
+  for (const auto &[key, publisher] : client->publishers) {
+    pending_network_delta.Remove(publisher);
+  }
+  clients.remove_if([client](const Connection &connection) { return &connection == client; });
+}
+
+void Coordinator::HandleClientMessage(const proto::ClientToCoordinatorMessage &message, Connection &client) {
+  switch (message.PossibleMessages_case()) {
+  case proto::ClientToCoordinatorMessage::kTransportManagerInfo:
+    HandleTransportManagerInfoRequest(message.transport_manager_info(), client);
+    break;
+
+  case proto::ClientToCoordinatorMessage::kPublishersDelta:
+    HandlePublishersDeltaRequest(message.publishers_delta(), client);
+    break;
+
+  case proto::ClientToCoordinatorMessage::kRequestResync:
+    client.needs_network_info = true;
+    break;
+
+  case proto::ClientToCoordinatorMessage::kSchemas:
+    HandleSchemasRequest(message.schemas());
+    break;
+
+  case proto::ClientToCoordinatorMessage::kRequestSchemas:
+    HandleRequestSchemasRequest(message.request_schemas(), client);
+    break;
+
+  case proto::ClientToCoordinatorMessage::POSSIBLEMESSAGES_NOT_SET:
+    BASIS_LOG_ERROR_NS(coordinator, "Unknown message from client!");
+    break;
+  }
+}
 
-  // Serialize it
-  auto shared_message = SerializeMessagePacket(message);
+void Coordinator::SendNetworkUpdates() {
+  // Clients that are up to date only hear about what changed - and nothing at all if nothing did
+  if (!pending_network_delta.Empty()) {
+    proto::CoordinatorMessage message;
+    auto *delta = message.mutable_network_info_delta();
+    delta->set_base_version(network_info_version);
+    delta->set_version(++network_info_version);
+    pending_network_delta.Build(delta);
 
-  // Send to all contacts
+    auto shared_message = SerializeMessagePacket(message);
+    for (auto &client : clients) {
+      if (!client.needs_network_info) {
+        client.SendMessage(shared_message);
+      }
+    }
+  }
+
+  // New and resyncing clients get everything, at the version the next delta will apply on top of
+  std::shared_ptr<basis::core::transport::MessagePacket> network_info_message;
   for (auto &client : clients) {
-    client.SendMessage(shared_message);
+    if (client.needs_network_info) {
+      if (!network_info_message) {
+        proto::CoordinatorMessage message;
+        *message.mutable_network_info() = GenerateNetworkInfo();
+        network_info_message = SerializeMessagePacket(message);
+      }
+      client.SendMessage(network_info_message);
+      client.needs_network_info = false;
+    }
   }
 }
 
-void Coordinator::HandleTransportManagerInfoRequest(proto::TransportManagerInfo *transport_manager_info,
+void Coordinator::HandleTransportManagerInfoRequest(const proto::TransportManagerInfo &transport_manager_info,
                                                     Connection &client) {
-  client.info = std::unique_ptr<proto::TransportManagerInfo>(transport_manager_info);
+  PublisherSet publishers = ToPublisherSet(transport_manager_info);
+  pending_network_delta.AddDiff(client.publishers, publishers);
+  client.publishers = std::move(publishers);
+  client.publishers_version = transport_manager_info.version();
+  client.publishers_resync_requested = false;
+}
+
+void Coordinator::HandlePublishersDeltaRequest(const proto::PublishersDelta &publishers_delta, Connection &client) {
+  if (publishers_delta.base_version() != client.publishers_version) {
+    if (!client.publishers_resync_requested) {
+      BASIS_LOG_WARN_NS(coordinator, "Got publishers delta from version {}, expected {} - requesting resync",
+                        publishers_delta.base_version(), client.publishers_version);
+      proto::CoordinatorMessage message;
+      message.mutable_request_resync();
+      client.SendMessage(SerializeMessagePacket(message));
+      client.publishers_resync_requested = true;
+    }
+    return;
+  }
+
+  ApplyPublishersDelta(publishers_delta, &client.publishers, &pending_network_delta);
+  client.publishers_version = publishers_delta.version();
 }
 
 void Coordinator::HandleSchemasRequest(const proto::MessageSchemas &schemas) {
@@ -14,12 +14,10 @@ int main() {
     BASIS_LOG_ERROR_NS(coordinator, "Unable to create coordinator.");
     return 1;
   }
-  auto next_sleep = std::chrono::steady_clock::now();
   while (true) {
     BASIS_LOG_TRACE_NS(coordinator, "Coordinator::Update()");
-    next_sleep += std::chrono::milliseconds(50);
-    coordinator->Update();
-    std::this_thread::sleep_until(next_sleep);
+    // Returns as soon as a client needs handling - the timeout only bounds how long an idle coordinator sleeps for
+    coordinator->Update(basis::core::Duration::FromSecondsNanoseconds(1, 0));
   }
   return 0;
 }
\ No newline at end of file
@@ -0,0 +1,147 @@
+#include <basis/core/publishers_delta.h>
+
+namespace basis::core::transport {
+
+namespace {
+bool SamePublisherInfo(const proto::PublisherInfo &a, const proto::PublisherInfo &b) {
+  if (a.topic() != b.topic() || a.schema_id() != b.schema_id() || a.schema_hash_id() != b.schema_hash_id() ||
+      a.transport_info_size() != b.transport_info_size()) {
+    return false;
+  }
+  for (const auto &[transport, info] : a.transport_info()) {
+    auto it = b.transport_info().find(transport);
+    if (it == b.transport_info().end() || it->second != info) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void BuildByTopic(PublisherSet &publishers,
+                  google::protobuf::Map<std::string, proto::RepeatedPublisherInfo> *publishers_by_topic) {
+  for (auto &[key, info] : publishers) {
+    auto *topic_publishers = (*publishers_by_topic)[info.topic()].add_publishers();
+    *topic_publishers = std::move(info);
+  }
+  publishers.clear();
+}
+} // namespace
+
+PublisherSet ToPublisherSet(const proto::TransportManagerInfo &info) {
+  PublisherSet out;
+  out.reserve(info.publishers_size());
+  for (const auto &publisher : info.publishers()) {
+    out.emplace(PublisherKey::FromProto(publisher), publisher);
+  }
+  return out;
+}
+
+void PublishersDeltaBuilder::Remove(const proto::PublisherInfo &info) {
+  const PublisherKey key = PublisherKey::FromProto(info);
+  if (added.erase(key) && !removed.contains(key)) {
+    // Added and removed before anyone heard about it
+    return;
+  }
+
+  proto::PublisherInfo &stripped = removed[key];
+  stripped.set_publisher_id_high(key.high);
+  stripped.set_publisher_id_low(key.low);
+  stripped.set_topic(info.topic());
+}
+
+void PublishersDeltaBuilder::AddDiff(const PublisherSet &from, const PublisherSet &to) {
+  for (const auto &[key, info] : from) {
+    auto it = to.find(key);
+    if (it == to.end() || !SamePublisherInfo(info, it->second)) {
+      Remove(info);
+    }
+  }
+  for (const auto &[key, info] : to) {
+    auto it = from.find(key);
+    if (it == from.end() || !SamePublisherInfo(info, it->second)) {
+      Add(info);
+    }
+  }
+}
+
+void PublishersDeltaBuilder::Build(proto::PublishersDelta *delta) {
+  BuildByTopic(removed, delta->mutable_removed_publishers());
+  BuildByTopic(added, delta->mutable_added_publishers());
+}
+
+void ApplyPublishersDelta(const proto::PublishersDelta &delta, PublisherSet *publishers,
+                          PublishersDeltaBuilder *changes) {
+  for (const auto &[topic, removed] : delta.removed_publishers()) {
+    for (const auto &info : removed.publishers()) {
+      auto it = publishers->find(PublisherKey::FromProto(info));
+      if (it != publishers->end()) {
+        if (changes) {
+          changes->Remove(it->second);
+        }
+        publishers->erase(it);
+      }
+    }
+  }
+
+  for (const auto &[topic, added] : delta.added_publishers()) {
+    for (const auto &info : added.publishers()) {
+      auto [it, inserted] = publishers->try_emplace(PublisherKey::FromProto(info), info);
+      if (!inserted) {
+        if (SamePublisherInfo(it->second, info)) {
+          continue;
+        }
+        if (changes) {
+          changes->Remove(it->second);
+        }
+        it->second = info;
+      }
+      if (changes) {
+        changes->Add(info);
+      }
+    }
+  }
+}
+
+void ApplyPublishersDelta(const proto::PublishersDelta &delta, proto::NetworkInfo *network_info) {
+  auto *publishers_by_topic = network_info->mutable_publishers_by_topic();
+
+  auto find_publisher = [](proto::RepeatedPublisherInfo &topic_publishers, const proto::PublisherInfo &info) {
+    const PublisherKey key = PublisherKey::FromProto(info);
+    for (int i = 0; i < topic_publishers.publishers_size(); i++) {
+      if (PublisherKey::FromProto(topic_publishers.publishers(i)) == key) {
+        return i;
+      }
+    }
+    return -1;
+  };
+
+  for (const auto &[topic, removed] : delta.removed_publishers()) {
+    auto topic_it = publishers_by_topic->find(topic);
+    if (topic_it == publishers_by_topic->end()) {
+      continue;
+    }
+    for (const auto &info : removed.publishers()) {
+      const int index = find_publisher(topic_it->second, info);
+      if (index >= 0) {
+        topic_it->second.mutable_publishers()->DeleteSubrange(index, 1);
+      }
+    }
+    if (topic_it->second.publishers_size() == 0) {
+      publishers_by_topic->erase(topic_it);
+    }
+  }
+
+  for (const auto &[topic, added] : delta.added_publishers()) {
+    proto::RepeatedPublisherInfo &topic_publishers = (*publishers_by_topic)[topic];
+    for (const auto &info : added.publishers()) {
+      const int index = find_publisher(topic_publishers, info);
+      if (index >= 0) {
+        *topic_publishers.mutable_publishers(index) = info;
+      } else {
+        *topic_publishers.add_publishers() = info;
+      }
+    }
+  }
+}
+
+} // namespace basis::core::transport
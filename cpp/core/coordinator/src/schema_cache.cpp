@@ -0,0 +1,144 @@
+#include <basis/core/schema_cache.h>
+#include <basis/core/transport/logger.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
+
+#include <unistd.h>
+
+namespace basis::core::transport {
+
+std::filesystem::path SchemaCache::DefaultCacheDir() {
+  if (const char *dir = std::getenv("BASIS_SCHEMA_CACHE_DIR")) {
+    return dir;
+  }
+  if (const char *dir = std::getenv("XDG_CACHE_HOME"); dir && *dir) {
+    return std::filesystem::path(dir) / "basis" / "schemas";
+  }
+  if (const char *dir = std::getenv("HOME"); dir && *dir) {
+    return std::filesystem::path(dir) / ".cache" / "basis" / "schemas";
+  }
+  return {};
+}
+
+std::optional<std::filesystem::path> SchemaCache::PathFor(std::string_view schema_id,
+                                                          std::string_view hash_id) const {
+  if (cache_dir.empty() || hash_id.empty()) {
+    return std::nullopt;
+  }
+  auto is_safe = [](char c) { return std::isalnum(uint8_t(c)) || c == '_' || c == '-'; };
+  if (!std::all_of(hash_id.begin(), hash_id.end(), is_safe)) {
+    return std::nullopt;
+  }
+
+  // The schema id is only there to make the cache browsable - Get() checks the schema it finds really matches
+  std::string filename;
+  filename.reserve(schema_id.size() + 1 + hash_id.size());
+  for (const char c : schema_id) {
+    filename += is_safe(c) || c == '.' ? c : '_';
+  }
+  filename += '@';
+  filename += hash_id;
+  return cache_dir / filename;
+}
+
+std::optional<proto::MessageSchema> SchemaCache::Get(std::string_view schema_id, std::string_view hash_id) {
+  if (hash_id.empty()) {
+    return std::nullopt;
+  }
+
+  const std::string key = Key(schema_id, hash_id);
+  std::lock_guard lock(mutex);
+  if (auto it = schemas.find(key); it != schemas.end()) {
+    return it->second;
+  }
+
+  auto path = PathFor(schema_id, hash_id);
+  if (!path) {
+    return std::nullopt;
+  }
+  std::ifstream file(*path, std::ios::binary);
+  if (!file) {
+    return std::nullopt;
+  }
+  proto::MessageSchema schema;
+  if (!schema.ParseFromIstream(&file) || schema.hash_id() != hash_id ||
+      schema.serializer() + ":" + schema.name() != schema_id) {
+    BASIS_LOG_WARN("Ignoring bad cached schema {}", path->string());
+    return std::nullopt;
+  }
+  schemas.emplace(key, schema);
+  return schema;
+}
+
+bool SchemaCache::Add(const proto::MessageSchema &schema) {
+  if (schema.hash_id().empty()) {
+    return false;
+  }
+
+  const std::string schema_id = schema.serializer() + ":" + schema.name();
+  std::lock_guard lock(mutex);
+  if (!schemas.emplace(Key(schema_id, schema.hash_id()), schema).second) {
+    return true;
+  }
+
+  auto path = PathFor(schema_id, schema.hash_id());
+  if (!path) {
+    // Memory only is only a failure if we were meant to persist it
+    return cache_dir.empty();
+  }
+  if (std::filesystem::exists(*path)) {
+    return true;
+  }
+
+  std::error_code error;
+  std::filesystem::create_directories(cache_dir, error);
+  if (error) {
+    BASIS_LOG_WARN("Unable to create schema cache {}: {}", cache_dir.string(), error.message());
+    return false;
+  }
+
+  // Write then rename, so that other processes never see a partial schema
+  std::filesystem::path tmp_path = *path;
+  tmp_path += "." + std::to_string(getpid()) + ".tmp";
+  {
+    std::ofstream file(tmp_path, std::ios::binary | std::ios::trunc);
+    if (!file || !schema.SerializeToOstream(&file)) {
+      BASIS_LOG_WARN("Unable to write cached schema {}", tmp_path.string());
+      std::filesystem::remove(tmp_path, error);
+      return false;
+    }
+  }
+  std::filesystem::rename(tmp_path, *path, error);
+  if (error) {
+    BASIS_LOG_WARN("Unable to write cached schema {}: {}", path->string(), error.message());
+    std::filesystem::remove(tmp_path, error);
+    return false;
+  }
+  return true;
+}
+
+bool SchemaCache::LoadInto(serialization::SerializationPlugin *plugin, const proto::MessageSchema &schema) {
+  if (schema.hash_id().empty()) {
+    // Nothing to tell two versions apart with, always load
+    return plugin->LoadSchema(schema.name(), schema.schema());
+  }
+
+  const std::string key = Key(schema.serializer() + ":" + schema.name(), schema.hash_id());
+  {
+    std::lock_guard lock(mutex);
+    if (loaded.contains(key)) {
+      return true;
+    }
+  }
+  if (!plugin->LoadSchema(schema.name(), schema.schema())) {
+    return false;
+  }
+  std::lock_guard lock(mutex);
+  loaded.insert(key);
+  return true;
+}
+
+} // namespace basis::core::transport
@@ -1,5 +1,6 @@
 #include <basis/core/coordinator.h>
 #include <basis/core/coordinator_connector.h>
+#include <basis/core/schema_cache.h>
 #include <basis/core/transport/transport_manager.h>
 #include <spdlog/cfg/env.h>
 
@@ -78,6 +79,239 @@ TEST(TestCoordinator, BasicTest) {
   ASSERT_NE(connector->TryGetSchema(request), nullptr);
 }
 
+TEST(TestCoordinator, PublishersDeltaBuilder) {
+  using namespace basis::core::transport;
+
+  PublisherInfo pub_info;
+  pub_info.publisher_id = CreatePublisherId();
+  pub_info.topic = "short_lived";
+  const proto::PublisherInfo info = pub_info.ToProto();
+
+  // Added and removed before being sent - nobody needs to hear about it
+  PublishersDeltaBuilder builder;
+  builder.Add(info);
+  builder.Remove(info);
+  ASSERT_TRUE(builder.Empty());
+
+  proto::NetworkInfo network_info;
+  builder.Add(info);
+  proto::PublishersDelta delta;
+  builder.Build(&delta);
+  ASSERT_TRUE(builder.Empty());
+  ApplyPublishersDelta(delta, &network_info);
+  ASSERT_EQ(network_info.publishers_by_topic().at("short_lived").publishers_size(), 1);
+
+  // Changed info is sent as a remove and an add
+  PublisherSet before = {{PublisherKey::FromProto(info), info}};
+  PublisherSet after = before;
+  (*after.begin()->second.mutable_transport_info())["net_tcp"] = "5678";
+  builder.AddDiff(before, after);
+  delta.Clear();
+  builder.Build(&delta);
+  ASSERT_EQ(delta.removed_publishers().at("short_lived").publishers(0).transport_info_size(), 0);
+  ApplyPublishersDelta(delta, &network_info);
+  ASSERT_EQ(network_info.publishers_by_topic().at("short_lived").publishers_size(), 1);
+  ASSERT_EQ(network_info.publishers_by_topic().at("short_lived").publishers(0).transport_info().at("net_tcp"), "5678");
+
+  // Topics without publishers are dropped
+  builder.AddDiff(after, {});
+  delta.Clear();
+  builder.Build(&delta);
+  ApplyPublishersDelta(delta, &network_info);
+  ASSERT_EQ(network_info.publishers_by_topic_size(), 0);
+}
+
+TEST(TestCoordinator, PublishersDelta) {
+  using namespace basis::core::transport;
+
+  Coordinator coordinator = *Coordinator::Create();
+
+  auto make_publisher = [](const std::string &topic) {
+    PublisherInfo pub_info;
+    pub_info.publisher_id = CreatePublisherId();
+    pub_info.topic = topic;
+    pub_info.transport_info["net_tcp"] = "1234";
+    return pub_info.ToProto();
+  };
+
+  auto publisher_connector = CoordinatorConnector::Create();
+  auto listener_connector = CoordinatorConnector::Create();
+
+  auto update = [&]() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    coordinator.Update();
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    if (publisher_connector) {
+      publisher_connector->Update();
+    }
+    listener_connector->Update();
+  };
+
+  auto topic_count = [&](const std::string &topic) {
+    auto &publishers_by_topic = listener_connector->GetLastNetworkInfo()->publishers_by_topic();
+    auto it = publishers_by_topic.find(topic);
+    return it == publishers_by_topic.end() ? 0 : it->second.publishers_size();
+  };
+
+  proto::TransportManagerInfo info;
+  *info.add_publishers() = make_publisher("a");
+  publisher_connector->SendPublishersIfChanged(info);
+  listener_connector->SendPublishersIfChanged({});
+  update();
+
+  ASSERT_NE(listener_connector->GetLastNetworkInfo(), nullptr);
+  ASSERT_EQ(topic_count("a"), 1);
+  ASSERT_EQ(listener_connector->GetLastNetworkInfo()->version(), coordinator.GetNetworkInfoVersion());
+
+  // Nothing changed, nothing sent
+  const uint64_t version = coordinator.GetNetworkInfoVersion();
+  publisher_connector->SendPublishersIfChanged(info);
+  listener_connector->SendPublishersIfChanged({});
+  update();
+  ASSERT_EQ(coordinator.GetNetworkInfoVersion(), version);
+
+  // Add one, remove one
+  const proto::PublisherInfo b = make_publisher("b");
+  *info.add_publishers() = b;
+  publisher_connector->SendPublishersIfChanged(info);
+  update();
+  ASSERT_EQ(coordinator.GetNetworkInfoVersion(), version + 1);
+  ASSERT_EQ(topic_count("a"), 1);
+  ASSERT_EQ(topic_count("b"), 1);
+
+  info.clear_publishers();
+  *info.add_publishers() = b;
+  publisher_connector->SendPublishersIfChanged(info);
+  update();
+  ASSERT_EQ(topic_count("a"), 0);
+  ASSERT_EQ(topic_count("b"), 1);
+  ASSERT_EQ(listener_connector->GetLastNetworkInfo()->version(), coordinator.GetNetworkInfoVersion());
+
+  // Late joiners get the full network
+  auto late_connector = CoordinatorConnector::Create();
+  update();
+  late_connector->Update();
+  ASSERT_NE(late_connector->GetLastNetworkInfo(), nullptr);
+  ASSERT_EQ(late_connector->GetLastNetworkInfo()->publishers_by_topic().at("b").publishers_size(), 1);
+  ASSERT_EQ(late_connector->GetLastNetworkInfo()->version(), coordinator.GetNetworkInfoVersion());
+
+  // Disconnecting removes everything that client published
+  publisher_connector.reset();
+  update();
+  ASSERT_EQ(topic_count("b"), 0);
+}
+
+struct CountingSerializationPlugin : public basis::core::serialization::SerializationPlugin {
+  std::string_view GetPluginName() override { return "test"; }
+  bool LoadSchema(std::string_view, std::string_view) override {
+    loads++;
+    return true;
+  }
+  std::optional<std::string> DumpMessageString(std::span<const std::byte>, std::string_view) override { return {}; }
+  std::optional<std::string> DumpMessageJSONString(std::span<const std::byte>, std::string_view) override {
+    return {};
+  }
+
+  int loads = 0;
+};
+
+TEST(TestCoordinator, SchemaCache) {
+  using namespace basis::core::transport;
+
+  const std::filesystem::path cache_dir =
+      std::filesystem::temp_directory_path() / ("basis_test_schema_cache_" + std::to_string(getpid()));
+  std::filesystem::remove_all(cache_dir);
+
+  proto::MessageSchema schema;
+  schema.set_serializer("test");
+  schema.set_name("Foo");
+  schema.set_schema("foo");
+  schema.set_hash_id(basis::core::serialization::HashSchemaContent(schema.schema()));
+
+  {
+    SchemaCache cache(cache_dir);
+    ASSERT_FALSE(cache.Get("test:Foo", schema.hash_id()));
+    ASSERT_TRUE(cache.Add(schema));
+    ASSERT_TRUE(cache.Get("test:Foo", schema.hash_id()));
+    // Same content under another name is a different schema
+    ASSERT_FALSE(cache.Get("test:Bar", schema.hash_id()));
+    ASSERT_FALSE(cache.Get("test:Foo", "0123"));
+
+    // Hashes from the network don't get to pick the path
+    proto::MessageSchema unsafe = schema;
+    unsafe.set_hash_id("../../oops");
+    ASSERT_FALSE(cache.Add(unsafe));
+  }
+
+  {
+    // A fresh cache (ie another process) picks it up from disk
+    SchemaCache cache(cache_dir);
+    auto cached = cache.Get("test:Foo", schema.hash_id());
+    ASSERT_TRUE(cached);
+    ASSERT_EQ(cached->schema(), "foo");
+
+    CountingSerializationPlugin plugin;
+    ASSERT_TRUE(cache.LoadInto(&plugin, *cached));
+    ASSERT_TRUE(cache.LoadInto(&plugin, *cached));
+    ASSERT_EQ(plugin.loads, 1);
+
+    proto::MessageSchema changed = schema;
+    changed.set_schema("foo2");
+    changed.set_hash_id(basis::core::serialization::HashSchemaContent(changed.schema()));
+    ASSERT_NE(changed.hash_id(), schema.hash_id());
+    ASSERT_TRUE(cache.LoadInto(&plugin, changed));
+    ASSERT_EQ(plugin.loads, 2);
+  }
+
+  {
+    SchemaCache memory_only("");
+    ASSERT_TRUE(memory_only.Add(schema));
+    ASSERT_TRUE(memory_only.Get("test:Foo", schema.hash_id()));
+  }
+
+  std::filesystem::remove_all(cache_dir);
+}
+
+TEST(TestCoordinator, ManyClients) {
+  using namespace basis::core::transport;
+
+  Coordinator coordinator = *Coordinator::Create();
+
+  // Nothing to do - sleeps for the whole timeout rather than spinning
+  const auto idle_start = std::chrono::steady_clock::now();
+  coordinator.Update(basis::core::Duration::FromSeconds(0.05));
+  ASSERT_GE(std::chrono::steady_clock::now() - idle_start, std::chrono::milliseconds(50));
+
+  constexpr int CLIENT_COUNT = 200;
+  std::vector<std::unique_ptr<CoordinatorConnector>> connectors;
+  for (int i = 0; i < CLIENT_COUNT; i++) {
+    auto connector = CoordinatorConnector::Create();
+    ASSERT_NE(connector, nullptr);
+
+    PublisherInfo pub_info;
+    pub_info.publisher_id = CreatePublisherId();
+    pub_info.topic = "topic_" + std::to_string(i);
+    proto::TransportManagerInfo info;
+    *info.add_publishers() = pub_info.ToProto();
+    connector->SendPublishersIfChanged(info);
+
+    connectors.push_back(std::move(connector));
+  }
+
+  // Each Update() returns as soon as there's something to handle
+  auto &listener = connectors.back();
+  for (int i = 0; i < 1000; i++) {
+    coordinator.Update(basis::core::Duration::FromSeconds(0.01));
+    listener->Update();
+    if (listener->GetLastNetworkInfo() &&
+        listener->GetLastNetworkInfo()->publishers_by_topic_size() == CLIENT_COUNT) {
+      break;
+    }
+  }
+  ASSERT_NE(listener->GetLastNetworkInfo(), nullptr);
+  ASSERT_EQ(listener->GetLastNetworkInfo()->publishers_by_topic_size(), CLIENT_COUNT);
+}
+
 // todo: explicitly check that connector and coordinator can consume multiple messages at once
 
 struct TestRawStruct {
@@ -4,8 +4,11 @@
 #include <tuple>
 
 #include <optional>
+#include <span>
 #include <string>
 
+#include <sys/uio.h>
+
 namespace basis {
 namespace core {
 namespace networking {
@@ -79,6 +82,13 @@ public:
    */
   int Send(const std::byte *data, size_t len);
 
+  /**
+   * Sends a list of buffers with a single sendmsg() call - returns the number of bytes sent, or -1 on error.
+   *
+   * @param flags additional flags for sendmsg(), ie MSG_ZEROCOPY
+   */
+  int SendV(std::span<const iovec> buffers, int flags = 0);
+
   enum class SelectType { READ, WRITE };
   /**
    * select()
@@ -127,7 +137,8 @@ public:
   nonstd::expected<TcpSocket, Socket::Error> Accept(int timeout_s = -1);
 
 private:
-  static constexpr int max_backlog_connections = 20;
+  /// Enough for a whole launch file of units to connect to the coordinator at once
+  static constexpr int max_backlog_connections = 256;
 };
 
 } // namespace networking
@@ -29,6 +29,16 @@ int Socket::Send(const std::byte *data, size_t len) {
   return send(fd, data, len, MSG_NOSIGNAL);
 }
 
+int Socket::SendV(std::span<const iovec> buffers, int flags) {
+  if (fd == -1) {
+    BASIS_LOG_CRITICAL("Trying to sendmsg() on an invalid socket");
+  }
+  msghdr message = {};
+  message.msg_iov = const_cast<iovec *>(buffers.data());
+  message.msg_iovlen = buffers.size();
+  return sendmsg(fd, &message, MSG_NOSIGNAL | flags);
+}
+
 int Socket::RecvInto(char *buffer, size_t buffer_len, bool peek) {
   // todo: error handling + close
   return recv(fd, buffer, buffer_len, peek ? MSG_PEEK : 0);
@@ -1,6 +1,9 @@
 #pragma once
 
+#include <cstdint>
+#include <cstdio>
 #include <string>
+#include <string_view>
 
 namespace basis::core::serialization {
 
@@ -25,6 +28,21 @@ struct MessageSchema {
   std::string hash_id;
 };
 
+/**
+ * Stable content hash for serializers without one of their own, to use as MessageSchema::hash_id.
+ * FNV-1a, 64 bits, as hex - this is for telling schemas apart, not for security.
+ */
+inline std::string HashSchemaContent(std::string_view content) {
+  uint64_t hash = 0xcbf29ce484222325ull;
+  for (const char c : content) {
+    hash ^= uint8_t(c);
+    hash *= 0x100000001b3ull;
+  }
+  char out[17];
+  snprintf(out, sizeof(out), "%016llx", (unsigned long long)hash);
+  return out;
+}
+
 constexpr char MCAP_CHANNEL_METADATA_SERIALIZER[] = "basis_serializer";
 constexpr char MCAP_CHANNEL_METADATA_READABLE_SCHEMA[] = "basis_human_readable_schema";
 constexpr char MCAP_CHANNEL_METADATA_HASH_ID[] = "basis_hash_id";
@@ -1,91 +1,264 @@
 #pragma once
-// Forked from https://github.com/progschj/ThreadPool under zlib license
 
+#include <atomic>
 #include <condition_variable>
+#include <deque>
 #include <functional>
 #include <future>
 #include <memory>
 #include <mutex>
-#include <queue>
 #include <stdexcept>
+#include <string>
 #include <thread>
+#include <type_traits>
 #include <vector>
 
+#include <pthread.h>
+#include <sched.h>
+
+#include "work_stealing_deque.h"
+
 namespace basis::core::threading {
 
+class ThreadPool;
+
+namespace internal {
+/**
+ * Type erased, move only unit of work. Unlike std::function, allows move only callables (ie ones holding a lock).
+ */
+class Task {
+public:
+  virtual ~Task() = default;
+  virtual void Run() = 0;
+};
+
+template <typename F> class CallableTask final : public Task {
+public:
+  explicit CallableTask(F &&f) : f(std::move(f)) {}
+  explicit CallableTask(const F &f) : f(f) {}
+
+  virtual void Run() override { f(); }
+
+private:
+  F f;
+};
+
+/**
+ * Set on worker threads, so that work posted from a worker stays on the worker.
+ */
+struct CurrentWorker {
+  ThreadPool *pool = nullptr;
+  size_t index = 0;
+};
+inline thread_local CurrentWorker current_worker;
+} // namespace internal
+
+struct ThreadPoolSettings {
+  /// Used to name the worker threads ("<name>/<index>", truncated to 15 characters)
+  std::string name;
+  /// CPUs to pin workers to, worker i is pinned to cpu_affinity[i % cpu_affinity.size()]. Empty for no pinning.
+  std::vector<int> cpu_affinity;
+};
+
+/**
+ * Work stealing thread pool.
+ *
+ * Each worker owns a WorkStealingDeque. Work posted from a worker goes onto its own deque, work posted from any other
+ * thread (ie an epoll thread) goes onto a shared injection queue. Idle workers take from their own deque first, then
+ * the injection queue, then steal from the other workers.
+ *
+ * Work from other threads is picked up in the order posted, but work posted from a worker runs newest first on that
+ * worker (thieves take the oldest). The pool this replaced was FIFO throughout - anything that needs its tasks to run
+ * in order has to chain them itself, or keep its own queue (see MultiThreadedUnit's handler queues).
+ */
 class ThreadPool {
 public:
-  explicit ThreadPool(size_t);
-  template <class F, class... Args>
-  auto enqueue(F &&f, Args &&...args) -> std::future<typename std::result_of<F(Args...)>::type>;
+  explicit ThreadPool(size_t thread_count, ThreadPoolSettings settings = {});
+
+  /**
+   * Runs everything already posted, then joins the workers.
+   */
   ~ThreadPool();
 
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  /**
+   * Fire and forget - run `f` on the pool. `f` must not throw.
+   *
+   * Posting from one of this pool's workers is LIFO - `f` runs before anything that worker posted earlier, unless
+   * another worker steals those first.
+   */
+  template <class F> void post(F &&f) {
+    Push(new internal::CallableTask<std::decay_t<F>>(std::forward<F>(f)));
+  }
+
+  /**
+   * Run `f(args...)` on the pool, returning a future to its result. Prefer post() if the result isn't needed.
+   */
+  template <class F, class... Args>
+  auto enqueue(F &&f, Args &&...args) -> std::future<std::invoke_result_t<F, Args...>>;
+
+  size_t GetThreadCount() const { return workers.size(); }
+
+  const std::string &GetName() const { return settings.name; }
+
 private:
-  // need to keep track of threads so we can join them
-  std::vector<std::thread> workers;
-  // the task queue
-  std::queue<std::function<void()>> tasks;
-
-  // synchronization
-  std::mutex queue_mutex;
-  std::condition_variable condition;
-  bool stop;
-};
+  struct Worker {
+    WorkStealingDeque<internal::Task *> deque;
+    std::thread thread;
+  };
 
-// the constructor just launches some amount of workers
-inline ThreadPool::ThreadPool(size_t threads) : stop(false) {
-  for (size_t i = 0; i < threads; ++i)
-    workers.emplace_back([this] {
-      for (;;) {
-        std::function<void()> task;
-
-        {
-          std::unique_lock<std::mutex> lock(this->queue_mutex);
-          this->condition.wait(lock, [this] { return this->stop || !this->tasks.empty(); });
-          if (this->stop && this->tasks.empty())
-            return;
-          task = std::move(this->tasks.front());
-          this->tasks.pop();
-        }
-
-        task();
-      }
-    });
-}
+  /// Onto the calling worker's deque (LIFO for that worker) if called from this pool, otherwise the injection queue
+  void Push(internal::Task *task);
 
-// add new work item to the pool
-template <class F, class... Args>
-auto ThreadPool::enqueue(F &&f, Args &&...args) -> std::future<typename std::result_of<F(Args...)>::type> {
-  // using return_type = typename std::result_of<F(Args...)>::type;
-  using return_type = typename std::invoke_result<F, Args...>::type;
+  internal::Task *FindTask(size_t worker_index);
 
-  auto task =
-      std::make_shared<std::packaged_task<return_type()>>(std::bind(std::forward<F>(f), std::forward<Args>(args)...));
+  void WorkerLoop(size_t worker_index);
 
-  std::future<return_type> res = task->get_future();
-  {
-    std::unique_lock<std::mutex> lock(queue_mutex);
+  /// Number of times a worker looks for work before going to sleep
+  static constexpr int IDLE_SPIN_COUNT = 16;
+
+  const ThreadPoolSettings settings;
+  std::vector<std::unique_ptr<Worker>> workers;
+
+  std::mutex injection_mutex;
+  std::deque<internal::Task *> injection_queue;
+  std::atomic<size_t> injection_size = 0;
+
+  /// Tasks posted but not yet picked up by a worker
+  std::atomic<int64_t> pending = 0;
+
+  std::mutex sleep_mutex;
+  std::condition_variable sleep_condition;
+  std::atomic<int> sleeping = 0;
+  std::atomic<bool> stop = false;
+};
+
+inline ThreadPool::ThreadPool(size_t thread_count, ThreadPoolSettings settings) : settings(std::move(settings)) {
+  for (size_t i = 0; i < thread_count; i++) {
+    workers.push_back(std::make_unique<Worker>());
+  }
+  // Start threads only once every deque exists, as they steal from each other
+  for (size_t i = 0; i < thread_count; i++) {
+    workers[i]->thread = std::thread(&ThreadPool::WorkerLoop, this, i);
 
-    // don't allow enqueueing after stopping the pool
-    if (stop) {
-      // TODO: change to returning an invalid future, add checks
-      throw std::runtime_error("enqueue on stopped ThreadPool");
+    pthread_t handle = workers[i]->thread.native_handle();
+    if (!this->settings.name.empty()) {
+      const std::string thread_name = (this->settings.name + "/" + std::to_string(i)).substr(0, 15);
+      pthread_setname_np(handle, thread_name.c_str());
+    }
+    if (!this->settings.cpu_affinity.empty()) {
+      cpu_set_t cpu_set;
+      CPU_ZERO(&cpu_set);
+      CPU_SET(this->settings.cpu_affinity[i % this->settings.cpu_affinity.size()], &cpu_set);
+      pthread_setaffinity_np(handle, sizeof(cpu_set), &cpu_set);
     }
-    tasks.emplace([task]() { (*task)(); });
   }
-  condition.notify_one();
-  return res;
 }
 
-// the destructor joins all threads
 inline ThreadPool::~ThreadPool() {
   {
-    std::unique_lock<std::mutex> lock(queue_mutex);
+    std::lock_guard lock(sleep_mutex);
     stop = true;
   }
-  condition.notify_all();
-  for (std::thread &worker : workers)
-    worker.join();
+  sleep_condition.notify_all();
+  for (auto &worker : workers) {
+    worker->thread.join();
+  }
+}
+
+template <class F, class... Args>
+auto ThreadPool::enqueue(F &&f, Args &&...args) -> std::future<std::invoke_result_t<F, Args...>> {
+  using return_type = std::invoke_result_t<F, Args...>;
+
+  std::packaged_task<return_type()> task(std::bind(std::forward<F>(f), std::forward<Args>(args)...));
+  std::future<return_type> res = task.get_future();
+  post([task = std::move(task)]() mutable { task(); });
+  return res;
+}
+
+inline void ThreadPool::Push(internal::Task *task) {
+  // Posting from a task while shutting down is fine - the posting worker will pick it up before exiting
+  if (stop && internal::current_worker.pool != this) {
+    delete task;
+    // TODO: change to returning an error, add checks
+    throw std::runtime_error("post on stopped ThreadPool");
+  }
+
+  // Counted before it's visible, so a worker that sees pending == 0 can safely sleep
+  pending.fetch_add(1);
+  if (internal::current_worker.pool == this) {
+    workers[internal::current_worker.index]->deque.Push(task);
+  } else {
+    std::lock_guard lock(injection_mutex);
+    injection_queue.push_back(task);
+    injection_size.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  // Paired with the check in WorkerLoop() - either the worker sees `pending`, or we see it sleeping
+  if (sleeping.load() != 0) {
+    // Taking the lock guarantees the worker is actually waiting, rather than about to
+    { std::lock_guard lock(sleep_mutex); }
+    sleep_condition.notify_one();
+  }
+}
+
+inline internal::Task *ThreadPool::FindTask(size_t worker_index) {
+  if (internal::Task *task = workers[worker_index]->deque.Pop()) {
+    return task;
+  }
+
+  if (injection_size.load(std::memory_order_relaxed) != 0) {
+    std::lock_guard lock(injection_mutex);
+    if (!injection_queue.empty()) {
+      internal::Task *task = injection_queue.front();
+      injection_queue.pop_front();
+      injection_size.fetch_sub(1, std::memory_order_relaxed);
+      return task;
+    }
+  }
+
+  for (size_t i = 1; i < workers.size(); i++) {
+    if (internal::Task *task = workers[(worker_index + i) % workers.size()]->deque.Steal()) {
+      return task;
+    }
+  }
+  return nullptr;
+}
+
+inline void ThreadPool::WorkerLoop(size_t worker_index) {
+  internal::current_worker = {this, worker_index};
+
+  int idle_count = 0;
+  while (true) {
+    if (internal::Task *task = FindTask(worker_index)) {
+      pending.fetch_sub(1);
+      task->Run();
+      delete task;
+      idle_count = 0;
+      continue;
+    }
+
+    if (++idle_count < IDLE_SPIN_COUNT) {
+      std::this_thread::yield();
+      continue;
+    }
+    idle_count = 0;
+
+    std::unique_lock lock(sleep_mutex);
+    sleeping.fetch_add(1);
+    if (pending.load() == 0) {
+      if (stop) {
+        sleeping.fetch_sub(1);
+        break;
+      }
+      sleep_condition.wait(lock);
+    }
+    sleeping.fetch_sub(1);
+  }
+
+  internal::current_worker = {};
 }
 
-} // namespace basis::core::threading
\ No newline at end of file
+} // namespace basis::core::threading
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+namespace basis::core::threading {
+
+/**
+ * Chase-Lev work stealing deque, following "Correct and Efficient Work-Stealing for Weak Memory Models" (Lê et al.)
+ *
+ * The owning thread pushes and pops at the bottom (LIFO), any other thread may steal from the top (FIFO). Grows as
+ * needed - old buffers are kept around until destruction, as a thief may still be reading from them.
+ *
+ * Only holds pointers, nullptr is used to signal empty.
+ */
+template <typename T> class WorkStealingDeque {
+  static_assert(std::is_pointer_v<T>);
+
+public:
+  explicit WorkStealingDeque(size_t initial_capacity = 1024)
+      : array(new Array(std::bit_ceil(std::max<size_t>(initial_capacity, 2)))) {}
+
+  ~WorkStealingDeque() { delete array.load(std::memory_order_relaxed); }
+
+  WorkStealingDeque(const WorkStealingDeque &) = delete;
+  WorkStealingDeque &operator=(const WorkStealingDeque &) = delete;
+
+  /**
+   * Owner only.
+   */
+  void Push(T item) {
+    const int64_t b = bottom.load(std::memory_order_relaxed);
+    const int64_t t = top.load(std::memory_order_acquire);
+    Array *a = array.load(std::memory_order_relaxed);
+    if (b - t > int64_t(a->capacity) - 1) {
+      a = Grow(a, t, b);
+    }
+    a->Put(b, item);
+    bottom.store(b + 1, std::memory_order_seq_cst);
+  }
+
+  /**
+   * Owner only. Returns the most recently pushed item, or nullptr if empty.
+   */
+  T Pop() {
+    const int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+    Array *a = array.load(std::memory_order_relaxed);
+    bottom.store(b, std::memory_order_seq_cst);
+    int64_t t = top.load(std::memory_order_seq_cst);
+
+    if (t > b) {
+      bottom.store(b + 1, std::memory_order_relaxed);
+      return nullptr;
+    }
+
+    T item = a->Get(b);
+    if (t == b) {
+      // Last item - race any thieves for it
+      if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+        item = nullptr;
+      }
+      bottom.store(b + 1, std::memory_order_relaxed);
+    }
+    return item;
+  }
+
+  /**
+   * Any thread. Returns the least recently pushed item, or nullptr if empty or another thread got there first.
+   */
+  T Steal() {
+    int64_t t = top.load(std::memory_order_seq_cst);
+    const int64_t b = bottom.load(std::memory_order_seq_cst);
+    if (t >= b) {
+      return nullptr;
+    }
+
+    T item = array.load(std::memory_order_acquire)->Get(t);
+    if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+      return nullptr;
+    }
+    return item;
+  }
+
+  /**
+   * Approximate when called from anything other than the owner.
+   */
+  bool Empty() const { return bottom.load(std::memory_order_relaxed) <= top.load(std::memory_order_relaxed); }
+
+private:
+  struct Array {
+    explicit Array(size_t capacity)
+        : capacity(capacity), mask(capacity - 1), items(new std::atomic<T>[capacity]) {}
+
+    T Get(int64_t index) const { return items[index & mask].load(std::memory_order_relaxed); }
+
+    void Put(int64_t index, T item) { items[index & mask].store(item, std::memory_order_relaxed); }
+
+    const size_t capacity;
+    const size_t mask;
+    std::unique_ptr<std::atomic<T>[]> items;
+  };
+
+  Array *Grow(Array *old_array, int64_t t, int64_t b) {
+    Array *new_array = new Array(old_array->capacity * 2);
+    for (int64_t i = t; i < b; i++) {
+      new_array->Put(i, old_array->Get(i));
+    }
+    retired.emplace_back(old_array);
+    array.store(new_array, std::memory_order_release);
+    return new_array;
+  }
+
+  // Keep the indices on their own cache lines - top is hammered by thieves, bottom by the owner
+  alignas(64) std::atomic<int64_t> top = 0;
+  alignas(64) std::atomic<int64_t> bottom = 0;
+  alignas(64) std::atomic<Array *> array;
+  /// Owner only
+  std::vector<std::unique_ptr<Array>> retired;
+};
+
+} // namespace basis::core::threading
@@ -0,0 +1,294 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <queue>
+#include <thread>
+
+#include <sched.h>
+
+#include <spdlog/spdlog.h>
+
+#include <basis/core/threading/thread_pool.h>
+#include <basis/core/threading/work_stealing_deque.h>
+
+using namespace basis::core::threading;
+
+TEST(WorkStealingDeque, SingleThreaded) {
+  int items[4096];
+  WorkStealingDeque<int *> deque(2);
+  ASSERT_TRUE(deque.Empty());
+  ASSERT_EQ(deque.Pop(), nullptr);
+  ASSERT_EQ(deque.Steal(), nullptr);
+
+  // Forces a few rounds of growth
+  for (int &item : items) {
+    deque.Push(&item);
+  }
+  // Owner is LIFO, thieves are FIFO
+  ASSERT_EQ(deque.Pop(), &items[4095]);
+  ASSERT_EQ(deque.Steal(), &items[0]);
+  for (int i = 4094; i >= 1; i--) {
+    ASSERT_EQ(deque.Pop(), &items[i]);
+  }
+  ASSERT_TRUE(deque.Empty());
+  ASSERT_EQ(deque.Pop(), nullptr);
+}
+
+TEST(WorkStealingDeque, ConcurrentSteal) {
+  constexpr int ITEM_COUNT = 200000;
+  std::vector<int> items(ITEM_COUNT);
+  std::vector<std::atomic<int>> taken(ITEM_COUNT);
+  WorkStealingDeque<int *> deque(16);
+
+  auto take = [&](int *item) { taken[item - items.data()]++; };
+
+  std::atomic<bool> done = false;
+  std::vector<std::thread> thieves;
+  for (int i = 0; i < 3; i++) {
+    thieves.emplace_back([&]() {
+      while (!done || !deque.Empty()) {
+        if (int *item = deque.Steal()) {
+          take(item);
+        }
+      }
+    });
+  }
+
+  // Mix pushes and pops so that the owner races thieves for the last item
+  for (int i = 0; i < ITEM_COUNT; i++) {
+    deque.Push(&items[i]);
+    if (i % 3 == 0) {
+      if (int *item = deque.Pop()) {
+        take(item);
+      }
+    }
+  }
+  while (int *item = deque.Pop()) {
+    take(item);
+  }
+  done = true;
+  for (auto &thief : thieves) {
+    thief.join();
+  }
+
+  for (int i = 0; i < ITEM_COUNT; i++) {
+    ASSERT_EQ(taken[i], 1) << i;
+  }
+}
+
+TEST(ThreadPool, Enqueue) {
+  ThreadPool thread_pool(4);
+  std::vector<std::future<int>> results;
+  for (int i = 0; i < 100; i++) {
+    results.push_back(thread_pool.enqueue([](int x) { return x * 2; }, i));
+  }
+  for (int i = 0; i < 100; i++) {
+    ASSERT_EQ(results[i].get(), i * 2);
+  }
+
+  // Move only callables are fine
+  auto value = std::make_unique<int>(5);
+  ASSERT_EQ(thread_pool.enqueue([value = std::move(value)] { return *value; }).get(), 5);
+}
+
+TEST(ThreadPool, PostFromWorker) {
+  std::atomic<int> leaves = 0;
+  {
+    ThreadPool thread_pool(4);
+    // Fan out from inside the pool - exercises the worker local deques and stealing
+    std::function<void(int)> fan_out = [&](int depth) {
+      if (depth == 0) {
+        leaves++;
+        return;
+      }
+      for (int i = 0; i < 4; i++) {
+        thread_pool.post([&fan_out, depth] { fan_out(depth - 1); });
+      }
+    };
+    thread_pool.post([&fan_out] { fan_out(6); });
+
+    for (int i = 0; i < 1000 && leaves < 4096; i++) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+  ASSERT_EQ(leaves, 4096);
+}
+
+TEST(ThreadPool, PostOrder) {
+  std::mutex order_mutex;
+  std::vector<int> order;
+  auto record = [&](int i) {
+    std::lock_guard lock(order_mutex);
+    order.push_back(i);
+  };
+  {
+    // A single worker, so nothing gets stolen
+    ThreadPool thread_pool(1);
+    thread_pool
+        .enqueue([&] {
+          // From the worker - newest first
+          for (int i = 0; i < 3; i++) {
+            thread_pool.post([&record, i] { record(i); });
+          }
+        })
+        .get();
+  }
+  ASSERT_EQ(order, std::vector<int>({2, 1, 0}));
+
+  order.clear();
+  {
+    ThreadPool thread_pool(1);
+    // From outside the pool - in the order posted
+    for (int i = 0; i < 3; i++) {
+      thread_pool.post([&record, i] { record(i); });
+    }
+  }
+  ASSERT_EQ(order, std::vector<int>({0, 1, 2}));
+}
+
+TEST(ThreadPool, RunsEverythingBeforeDestruction) {
+  std::atomic<int> ran = 0;
+  {
+    ThreadPool thread_pool(2);
+    for (int i = 0; i < 1000; i++) {
+      thread_pool.post([&ran] {
+        std::this_thread::sleep_for(std::chrono::microseconds(10));
+        ran++;
+      });
+    }
+  }
+  ASSERT_EQ(ran, 1000);
+}
+
+TEST(ThreadPool, Settings) {
+  // Pin to a CPU we're actually allowed to run on - CPU 0 may be excluded by a container or taskset
+  cpu_set_t allowed;
+  ASSERT_EQ(sched_getaffinity(0, sizeof(allowed), &allowed), 0);
+  int pinned_cpu = -1;
+  for (int i = 0; i < CPU_SETSIZE && pinned_cpu == -1; i++) {
+    if (CPU_ISSET(i, &allowed)) {
+      pinned_cpu = i;
+    }
+  }
+  if (pinned_cpu == -1) {
+    GTEST_SKIP() << "No CPUs in the affinity mask";
+  }
+
+  ThreadPool thread_pool(2, {.name = "test_pool", .cpu_affinity = {pinned_cpu}});
+  ASSERT_EQ(thread_pool.GetThreadCount(), 2);
+
+  auto [cpu, name] = thread_pool
+                         .enqueue([] {
+                           char name[16] = {};
+                           pthread_getname_np(pthread_self(), name, sizeof(name));
+                           return std::make_pair(sched_getcpu(), std::string(name));
+                         })
+                         .get();
+  ASSERT_EQ(cpu, pinned_cpu);
+  ASSERT_TRUE(name.starts_with("test_pool/"));
+}
+
+/**
+ * The single mutex + condition variable pool this replaced, kept here to benchmark against.
+ * Forked from https://github.com/progschj/ThreadPool under zlib license
+ */
+class SingleQueueThreadPool {
+public:
+  explicit SingleQueueThreadPool(size_t threads) {
+    for (size_t i = 0; i < threads; ++i)
+      workers.emplace_back([this] {
+        for (;;) {
+          std::function<void()> task;
+          {
+            std::unique_lock<std::mutex> lock(this->queue_mutex);
+            this->condition.wait(lock, [this] { return this->stop || !this->tasks.empty(); });
+            if (this->stop && this->tasks.empty())
+              return;
+            task = std::move(this->tasks.front());
+            this->tasks.pop();
+          }
+          task();
+        }
+      });
+  }
+
+  template <class F> auto enqueue(F &&f) -> std::future<std::invoke_result_t<F>> {
+    using return_type = std::invoke_result_t<F>;
+    auto task = std::make_shared<std::packaged_task<return_type()>>(std::bind(std::forward<F>(f)));
+    std::future<return_type> res = task->get_future();
+    {
+      std::unique_lock<std::mutex> lock(queue_mutex);
+      tasks.emplace([task]() { (*task)(); });
+    }
+    condition.notify_one();
+    return res;
+  }
+
+  ~SingleQueueThreadPool() {
+    {
+      std::unique_lock<std::mutex> lock(queue_mutex);
+      stop = true;
+    }
+    condition.notify_all();
+    for (std::thread &worker : workers)
+      worker.join();
+  }
+
+private:
+  std::vector<std::thread> workers;
+  std::queue<std::function<void()>> tasks;
+  std::mutex queue_mutex;
+  std::condition_variable condition;
+  bool stop = false;
+};
+
+/**
+ * Mimics the TCP receive path - a single epoll thread handing small units of work to a pool of four workers.
+ */
+TEST(ThreadPool, Benchmark) {
+  constexpr int TASK_COUNT = 200000;
+
+  std::atomic<uint64_t> checksum = 0;
+  auto work = [&checksum](int i) {
+    uint64_t x = i;
+    for (int j = 0; j < 64; j++) {
+      x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+    }
+    checksum.fetch_add(x & 1, std::memory_order_relaxed);
+  };
+
+  auto run = [&](const char *name, auto &&post_one) {
+    std::atomic<int> completed = 0;
+    const auto start = std::chrono::steady_clock::now();
+    std::thread epoll_thread([&]() {
+      for (int i = 0; i < TASK_COUNT; i++) {
+        post_one([&work, &completed, i] {
+          work(i);
+          completed.fetch_add(1, std::memory_order_relaxed);
+        });
+      }
+    });
+    epoll_thread.join();
+    while (completed < TASK_COUNT) {
+      std::this_thread::yield();
+    }
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    spdlog::info("{}: {} tasks in {:.3f}s - {:.0f} tasks/s", name, TASK_COUNT, elapsed.count(),
+                 TASK_COUNT / elapsed.count());
+  };
+
+  {
+    SingleQueueThreadPool thread_pool(4);
+    run("single queue enqueue", [&](auto &&f) { thread_pool.enqueue(std::move(f)); });
+  }
+  {
+    ThreadPool thread_pool(4);
+    run("work stealing enqueue", [&](auto &&f) { thread_pool.enqueue(std::move(f)); });
+  }
+  {
+    ThreadPool thread_pool(4);
+    run("work stealing post", [&](auto &&f) { thread_pool.post(std::move(f)); });
+  }
+}
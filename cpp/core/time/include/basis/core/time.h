@@ -130,6 +130,12 @@ struct MonotonicTime : public TimePoint {
 
   static void SetSimulatedTime(int64_t nanoseconds, uint64_t run_token);
 
+  /**
+   * Simulated time for the calling thread only, taking precedence over SetSimulatedTime() - for running callbacks from
+   * different points in time at once, ie parallel deterministic replay. INVALID_NSECS clears it.
+   */
+  static void SetThreadSimulatedTime(int64_t nanoseconds);
+
   static bool UsingSimulatedTime();
 
   static uint64_t GetRunToken();
@@ -10,6 +10,7 @@ namespace basis::core {
 namespace {
 static std::atomic<int64_t> simulated_time_ns = time::INVALID_NSECS;
 static std::atomic<uint64_t> current_run_token = 0;
+thread_local int64_t thread_simulated_time_ns = time::INVALID_NSECS;
 } // namespace
 MonotonicTime MonotonicTime::FromNanoseconds(int64_t ns) {
   return {ns};
@@ -20,6 +21,9 @@ MonotonicTime MonotonicTime::FromSecondsNanoseconds(int64_t seconds, int64_t nan
     return {TimeBase::SecondsToNanoseconds(seconds) + nanoseconds};
   }
 MonotonicTime MonotonicTime::Now(bool ignore_simulated_time) {
+  if (!ignore_simulated_time && thread_simulated_time_ns != time::INVALID_NSECS) {
+    return {thread_simulated_time_ns};
+  }
   if (!ignore_simulated_time && UsingSimulatedTime()) {
     return {simulated_time_ns};
   }
@@ -53,8 +57,10 @@ void MonotonicTime::SetSimulatedTime(int64_t nanoseconds, uint64_t run_token) {
   current_run_token = run_token;
 }
 
+void MonotonicTime::SetThreadSimulatedTime(int64_t nanoseconds) { thread_simulated_time_ns = nanoseconds; }
+
 bool MonotonicTime::UsingSimulatedTime() {
-  return simulated_time_ns != time::INVALID_NSECS;
+  return thread_simulated_time_ns != time::INVALID_NSECS || simulated_time_ns != time::INVALID_NSECS;
 }
 
 uint64_t MonotonicTime::GetRunToken() {
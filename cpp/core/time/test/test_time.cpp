@@ -1,5 +1,7 @@
 #include <gtest/gtest.h>
 
+#include <thread>
+
 #include <basis/core/time.h>
 
 namespace basis::core {
@@ -62,4 +64,22 @@ TEST(TestTime, TestConversions) {
   }
 }
 
+TEST(TestTime, ThreadSimulatedTime) {
+  MonotonicTime::SetSimulatedTime(1000, 1);
+  ASSERT_EQ(MonotonicTime::Now().nsecs, 1000);
+
+  std::thread([]() {
+    MonotonicTime::SetThreadSimulatedTime(2000);
+    ASSERT_EQ(MonotonicTime::Now().nsecs, 2000);
+    ASSERT_TRUE(MonotonicTime::UsingSimulatedTime());
+    MonotonicTime::SetThreadSimulatedTime(time::INVALID_NSECS);
+    ASSERT_EQ(MonotonicTime::Now().nsecs, 1000);
+  }).join();
+
+  // Other threads are unaffected
+  ASSERT_EQ(MonotonicTime::Now().nsecs, 1000);
+  MonotonicTime::SetSimulatedTime(time::INVALID_NSECS, 0);
+  ASSERT_FALSE(MonotonicTime::UsingSimulatedTime());
+}
+
 } // namespace basis::core
\ No newline at end of file
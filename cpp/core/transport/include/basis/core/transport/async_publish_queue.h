@@ -0,0 +1,77 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+
+#include <basis/core/threading/thread_pool.h>
+
+namespace basis::core::transport {
+
+struct AsyncPublishSettings {
+  /// What to do with a message published while `max_pending` messages are already waiting
+  enum class DropPolicy {
+    /// Drop the oldest waiting message to make room
+    DROP_OLDEST,
+    /// Drop the message being published
+    DROP_NEWEST,
+    /// Block the publisher until there's room (back-pressure)
+    BLOCK,
+  };
+
+  size_t max_pending = 10;
+  DropPolicy drop_policy = DropPolicy::DROP_OLDEST;
+};
+
+/**
+ * Runs a publisher's serialize and send work on a shared thread pool, in order, with a bounded number of messages
+ * waiting.
+ *
+ * At most one task per queue is on the pool at a time - it drains everything pending before returning, so messages
+ * from a single publisher are never reordered or serialized concurrently.
+ */
+class AsyncPublishQueue {
+public:
+  AsyncPublishQueue(threading::ThreadPool *thread_pool, AsyncPublishSettings settings)
+      : thread_pool(thread_pool), settings(settings) {}
+
+  /**
+   * Drops anything still waiting, and waits for the message currently being sent (if any).
+   */
+  ~AsyncPublishQueue();
+
+  AsyncPublishQueue(const AsyncPublishQueue &) = delete;
+  AsyncPublishQueue &operator=(const AsyncPublishQueue &) = delete;
+
+  /**
+   * Queue work to run on the pool, applying the drop policy if full.
+   *
+   * @return false if the work was dropped
+   */
+  bool Push(std::function<void()> work);
+
+  /**
+   * Number of messages dropped due to the queue being full.
+   */
+  uint64_t GetDroppedCount() const { return dropped.load(std::memory_order_relaxed); }
+
+private:
+  void Drain();
+
+  threading::ThreadPool *thread_pool;
+  const AsyncPublishSettings settings;
+
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::deque<std::function<void()>> pending;
+  /// True while a Drain() task is queued or running on the pool
+  bool draining = false;
+  bool stopping = false;
+
+  std::atomic<uint64_t> dropped = 0;
+};
+
+} // namespace basis::core::transport
@@ -1,13 +1,15 @@
 #pragma once
 
 #include <basis/core/transport/message_event.h>
+#include <atomic>
 #include <condition_variable>
 #include <functional>
-#include <list>
 #include <memory>
+#include <mutex>
 #include <string_view>
 #include <typeinfo>
 #include <unordered_map>
+#include <vector>
 
 namespace basis::core::transport {
 
@@ -43,23 +45,126 @@ template <typename T_MSG> struct InprocConnectorInterface : public InprocConnect
   virtual bool HasSubscribersFast(const std::string &topic) = 0;
 };
 
+template <typename T_MSG> class InprocSubscriber;
+
+/**
+ * The subscribers to a single topic on an InprocConnector.
+ *
+ * Publish() reads an immutable snapshot of the subscriber list, without taking any locks or allocating. Subscribing
+ * (and pruning expired subscribers) builds a new snapshot and swaps it in. Snapshots that may still be in use by a
+ * publish are retired rather than freed, and are freed by the first later change that finds no publish in progress.
+ */
+template <typename T_MSG> class InprocTopic {
+public:
+  InprocTopic() = default;
+  InprocTopic(const InprocTopic &) = delete;
+  InprocTopic &operator=(const InprocTopic &) = delete;
+
+  ~InprocTopic() {
+    delete snapshot.load();
+    for (const Snapshot *retired_snapshot : retired) {
+      delete retired_snapshot;
+    }
+  }
+
+  void Publish(std::shared_ptr<const T_MSG> msg, InprocConnectorBase *ignore_if_primary_connector) {
+    bool saw_expired = false;
+
+    // Must be counted before loading the snapshot, see Swap()
+    active_publishes.fetch_add(1);
+    for (const auto &weak_subscriber : snapshot.load()->subscribers) {
+      if (auto subscriber = weak_subscriber.lock()) {
+        // If this subscriber has another connector associated with it, and it's the same alternate connector as this
+        // publisher has, skip this subscriber
+        if (!ignore_if_primary_connector || subscriber->primary_inproc_connector != ignore_if_primary_connector) {
+          subscriber->OnMessage(msg);
+        }
+      } else {
+        saw_expired = true;
+      }
+    }
+    active_publishes.fetch_sub(1);
+
+    if (saw_expired) {
+      // Don't hold up the publisher if someone else is changing the list, they'll prune it
+      std::unique_lock lock(mutex, std::try_to_lock);
+      if (lock) {
+        Swap({});
+      }
+    }
+  }
+
+  void Subscribe(std::weak_ptr<InprocSubscriber<T_MSG>> subscriber) {
+    std::lock_guard lock(mutex);
+    Swap(std::move(subscriber));
+  }
+
+  /**
+   * If subscribers are removed they will continue to show until the next Publish() call.
+   */
+  bool HasSubscribers() const { return subscriber_count.load(std::memory_order_relaxed) != 0; }
+
+private:
+  struct Snapshot {
+    std::vector<std::weak_ptr<InprocSubscriber<T_MSG>>> subscribers;
+  };
+
+  /**
+   * Replace the snapshot with one without expired subscribers, plus `added` (if set). Must hold `mutex`.
+   */
+  void Swap(std::weak_ptr<InprocSubscriber<T_MSG>> added) {
+    const Snapshot *current = snapshot.load();
+    auto *next = new Snapshot;
+    next->subscribers.reserve(current->subscribers.size() + 1);
+    for (const auto &subscriber : current->subscribers) {
+      if (!subscriber.expired()) {
+        next->subscribers.push_back(subscriber);
+      }
+    }
+    if (!added.expired()) {
+      next->subscribers.push_back(std::move(added));
+    }
+    subscriber_count = next->subscribers.size();
+
+    retired.push_back(snapshot.exchange(next));
+    // Any publish that starts after this point is guaranteed to load `next` - if none are running now, nothing can
+    // be looking at a retired snapshot
+    if (active_publishes.load() == 0) {
+      for (const Snapshot *retired_snapshot : retired) {
+        delete retired_snapshot;
+      }
+      retired.clear();
+    }
+  }
+
+  /// Serializes changes to the subscriber list
+  std::mutex mutex;
+  std::atomic<const Snapshot *> snapshot = new Snapshot;
+  /// Number of Publish() calls currently reading a snapshot
+  std::atomic<uint32_t> active_publishes = 0;
+  std::atomic<size_t> subscriber_count = 0;
+  /// Old snapshots that a publish may still be reading, protected by `mutex`
+  std::vector<const Snapshot *> retired;
+};
+
 // TODO: this can manage its own subscribers, right?
 template <typename T_MSG> class InprocPublisher {
 public:
-  InprocPublisher(std::string_view topic, InprocConnectorInterface<T_MSG> *connector,
+  /**
+   * @param topic resolved once by the connector, so that publishing doesn't need to look it up again
+   */
+  InprocPublisher(InprocTopic<T_MSG> *topic, InprocConnectorInterface<T_MSG> *connector,
                   InprocConnectorBase *ignore_if_primary_connector)
       : topic(topic), connector(connector), ignore_if_primary_connector(ignore_if_primary_connector) {}
 
-  void Publish(std::shared_ptr<const T_MSG> msg) {
-    connector->Publish(this->topic, std::move(msg), ignore_if_primary_connector);
-  }
+  void Publish(std::shared_ptr<const T_MSG> msg) { topic->Publish(std::move(msg), ignore_if_primary_connector); }
 
-  bool HasSubscribersFast() { return connector->HasSubscribersFast(topic); }
+  bool HasSubscribersFast() { return topic->HasSubscribers(); }
 
   InprocConnectorBase *GetConnector() { return connector; }
 
 private:
-  std::string topic;
+  InprocTopic<T_MSG> *topic;
   InprocConnectorInterface<T_MSG> *connector;
   InprocConnectorBase *ignore_if_primary_connector;
 };
@@ -86,6 +191,7 @@ public:
 
 protected:
   friend class InprocConnector<T_MSG>;
+  friend class InprocTopic<T_MSG>;
   const std::function<void(MessageEvent<T_MSG> message)> callback;
   const std::string topic_name;
   // The connector we are associated with
@@ -95,18 +201,6 @@ protected:
 };
 
 template <typename T_MSG> class InprocConnector : public InprocConnectorInterface<T_MSG> {
-  struct SubscribersForTopic {
-    bool IsEmpty() {
-      std::unique_lock lock(mutex);
-      return subscribers.empty();
-    }
-
-    // Lock access to the subscriber list
-    std::mutex mutex;
-    // This isn't the best data structure for the list, but will do for now
-    std::list<std::weak_ptr<InprocSubscriber<T_MSG>>> subscribers;
-  };
-
 public:
   // TODO: ensure if we have one publisher we don't have another of a different type but the same name <- this is no
   // longer an error, with separate inproc types
@@ -114,26 +208,14 @@ public:
 
   std::shared_ptr<InprocPublisher<T_MSG>> Advertise(std::string_view topic,
                                                     InprocConnectorBase *ignore_if_primary_connector) {
-    return std::make_shared<InprocPublisher<T_MSG>>(topic, this, ignore_if_primary_connector);
+    return std::make_shared<InprocPublisher<T_MSG>>(GetOrCreateTopic(topic), this, ignore_if_primary_connector);
   }
 
   std::shared_ptr<InprocSubscriber<T_MSG>> Subscribe(std::string_view topic,
                                                      std::function<void(MessageEvent<T_MSG> message)> callback,
                                                      InprocConnectorBase *primary_inproc_connector) {
     auto subscriber = std::make_shared<InprocSubscriber<T_MSG>>(topic, callback, this, primary_inproc_connector);
-    SubscribersForTopic *subscribers = nullptr;
-    {
-
-      std::unique_lock lock(subscribers_by_topic_mutex);
-      auto it = subscribers_by_topic.find(topic);
-      if (it == subscribers_by_topic.end()) {
-        auto p = subscribers_by_topic.emplace(std::piecewise_construct, std::forward_as_tuple(topic),
-                                              std::forward_as_tuple());
-        it = p.first;
-      }
-      subscribers = &it->second;
-    }
-    subscribers->subscribers.emplace_back(subscriber);
+    GetOrCreateTopic(topic)->Subscribe(subscriber);
 
     return subscriber;
   }
@@ -141,53 +223,40 @@ public:
   // Returns true if any subscribers exist. If subscribers are removed they will continue to show until the next
   // Publish() call.
   virtual bool HasSubscribersFast(const std::string &topic) override {
-    std::unique_lock lock(subscribers_by_topic_mutex);
-    auto it = subscribers_by_topic.find(topic);
-    return it != subscribers_by_topic.end() && !it->second.IsEmpty();
+    InprocTopic<T_MSG> *subscribers = FindTopic(topic);
+    return subscribers && subscribers->HasSubscribers();
   }
 
 private:
-  virtual void Publish([[maybe_unused]] const std::string_view topic, std::shared_ptr<const T_MSG> msg,
+  /**
+   * Slow path - InprocPublisher goes straight to its InprocTopic.
+   */
+  virtual void Publish(const std::string_view topic, std::shared_ptr<const T_MSG> msg,
                        InprocConnectorBase *ignore_if_primary_connector) override {
-    // Lookup the subscribers for this topic
-    SubscribersForTopic *subscribers = nullptr;
-    {
-      std::unique_lock lock(subscribers_by_topic_mutex);
-      auto it = subscribers_by_topic.find(topic);
-      if (it == subscribers_by_topic.end()) {
-        // There are no subscribers for this topic
-        return;
-      }
-      subscribers = &it->second;
+    if (InprocTopic<T_MSG> *subscribers = FindTopic(topic)) {
+      subscribers->Publish(std::move(msg), ignore_if_primary_connector);
     }
+  }
 
-    std::vector<std::shared_ptr<InprocSubscriber<T_MSG>>> valid_subscribers;
-    {
-      std::unique_lock lock(subscribers->mutex);
-      valid_subscribers.reserve(subscribers->subscribers.size());
-      auto it = subscribers->subscribers.begin();
-      while (it != subscribers->subscribers.end()) {
-        if (auto subscriber = it->lock()) {
-          // If this subscriber has another connector associated with it, and it's the same alternate connector as this
-          // publisher has, skip this subscriber
-          if (!ignore_if_primary_connector || subscriber->primary_inproc_connector != ignore_if_primary_connector) {
-            valid_subscribers.push_back(subscriber);
-          }
-          ++it;
-        } else {
-          it = subscribers->subscribers.erase(it);
-        }
-      }
-    }
-    // Run callbacks outside the lock
-    for (auto &subscriber : valid_subscribers) {
-      subscriber->OnMessage(msg);
+  InprocTopic<T_MSG> *FindTopic(std::string_view topic) {
+    std::lock_guard lock(topics_mutex);
+    auto it = topics.find(topic);
+    return it == topics.end() ? nullptr : &it->second;
+  }
+
+  InprocTopic<T_MSG> *GetOrCreateTopic(std::string_view topic) {
+    std::lock_guard lock(topics_mutex);
+    auto it = topics.find(topic);
+    if (it == topics.end()) {
+      it = topics.emplace(std::piecewise_construct, std::forward_as_tuple(topic), std::forward_as_tuple()).first;
     }
+    // Elements of an unordered_map are never moved, this stays valid for the life of the connector
+    return &it->second;
   }
 
-  std::mutex subscribers_by_topic_mutex;
+  std::mutex topics_mutex;
 
-  std::unordered_map<std::string, SubscribersForTopic, internal::string_hash, std::equal_to<>> subscribers_by_topic;
+  std::unordered_map<std::string, InprocTopic<T_MSG>, internal::string_hash, std::equal_to<>> topics;
 
   // This might be wrong if compiled with different compilers.
   // std::unordered_map<std::string, std::type_info> topic_types;
@@ -1,7 +1,12 @@
 #pragma once
+#include <array>
+#include <cassert>
 #include <cstdint>
+#include <memory>
 #include <span>
 
+#include "packet_pool.h"
+
 namespace basis::core::transport {
 
 struct MessageHeader {
@@ -41,9 +46,11 @@ class MessagePacket {
 public:
   /**
    * Construct given a packet type and size. Typically used when preparing to send data.
+   *
+   * Storage comes from the PacketPool and is returned to it when the packet is destroyed.
    */
   MessagePacket(MessageHeader::DataType data_type, uint32_t data_size)
-      : storage(std::make_unique<std::byte[]>(data_size + sizeof(MessageHeader))) {
+      : storage(PacketPool::Global().Allocate(data_size + sizeof(MessageHeader))), data(storage.get()) {
     InitializeHeader(data_type, data_size);
   }
 
@@ -51,46 +58,109 @@ public:
    * Construct given a header. Typically used when receiving data.
    */
   MessagePacket(MessageHeader header)
-      : storage(std::make_unique<std::byte[]>(header.data_size + sizeof(MessageHeader))) {
-    *(MessageHeader *)storage.get() = header;
+      : storage(PacketPool::Global().Allocate(header.data_size + sizeof(MessageHeader))), data(storage.get()) {
+    *(MessageHeader *)data = header;
+  }
+
+  /**
+   * Construct a non owning view of an already complete packet (header + payload) living in memory owned by someone
+   * else, typically a transport (ie shared memory). `owner` is kept alive for as long as the packet is.
+   *
+   * @warning the caller is responsible for `packet` being at least as large as the header it contains claims.
+   */
+  MessagePacket(std::span<std::byte> packet, std::shared_ptr<const void> owner)
+      : data(packet.data()), owner(std::move(owner)) {}
+
+  /**
+   * Construct a new packet of the given type and size inside memory owned by someone else (a loan, see
+   * TransportPublisher::LoanPacket). `owner` is kept alive for as long as the packet is.
+   *
+   * @warning `storage` must be at least `data_size + sizeof(MessageHeader)` bytes.
+   */
+  MessagePacket(MessageHeader::DataType data_type, uint32_t data_size, std::span<std::byte> storage,
+                std::shared_ptr<const void> owner)
+      : data(storage.data()), owner(std::move(owner)) {
+    assert(storage.size() >= data_size + sizeof(MessageHeader));
+    InitializeHeader(data_type, data_size);
+  }
+
+  /**
+   * Construct a packet around a payload living in memory owned by someone else (ie a memory mapped recording), without
+   * copying it. The header is held separately, so the packet isn't contiguous - see GetPacketParts().
+   * `owner` is kept alive for as long as the packet is.
+   */
+  MessagePacket(MessageHeader::DataType data_type, std::span<const std::byte> payload, std::shared_ptr<const void> owner)
+      : data(reinterpret_cast<std::byte *>(&borrowed_header)), borrowed_payload(payload.data()),
+        owner(std::move(owner)) {
+    InitializeHeader(data_type, uint32_t(payload.size()));
   }
-#if 0
-    // More dangerous, assumes the constructor knows what they are doing
-    // This will be needed for in place serialization
-    // Actually, let's avoid this for now. We can ask protobuf the size up front, and then fill in
-    MessagePacket(std::unique_ptr<std::byte[]> storage, uint32_t total_size, uint32_t data_size) : storage(storage) {
-        assert(data_size + sizeof(MessageHeader) >= total_size);
-        InitializeHeader(data_size);
-    }
 
-    //...it may be useful to be able to ask a shared memory transport for allocation, and then pass in a non owning handle to it (but dangerous!)
-#endif
+  // `data` may point into the packet itself
+  MessagePacket(const MessagePacket &) = delete;
+  MessagePacket &operator=(const MessagePacket &) = delete;
 
-  const MessageHeader *GetMessageHeader() const { return reinterpret_cast<const MessageHeader *>(storage.get()); }
+  const MessageHeader *GetMessageHeader() const { return reinterpret_cast<const MessageHeader *>(data); }
 
+  /**
+   * @return false if the payload is borrowed, and doesn't follow the header in memory
+   */
+  bool IsContiguous() const { return borrowed_payload == nullptr; }
+
+  /**
+   * The header and payload as a single span.
+   *
+   * @warning only for contiguous packets, see IsContiguous() - use GetPacketParts() otherwise.
+   */
   std::span<const std::byte> GetPacket() const {
-    return std::span<const std::byte>(storage.get(), GetMessageHeader()->data_size + sizeof(MessageHeader));
+    assert(IsContiguous());
+    return std::span<const std::byte>(data, GetPacketSize());
   }
 
+  /**
+   * The packet as it goes out on the wire - the whole packet then an empty span when contiguous, otherwise the header
+   * then the payload.
+   */
+  std::array<std::span<const std::byte>, 2> GetPacketParts() const {
+    if (IsContiguous()) {
+      return {GetPacket(), std::span<const std::byte>()};
+    }
+    return {std::span<const std::byte>(data, sizeof(MessageHeader)), GetPayload()};
+  }
+
+  size_t GetPacketSize() const { return GetMessageHeader()->data_size + sizeof(MessageHeader); }
+
   std::span<const std::byte> GetPayload() const {
-    return std::span<const std::byte>(storage.get() + sizeof(MessageHeader), GetMessageHeader()->data_size);
+    return std::span<const std::byte>(IsContiguous() ? data + sizeof(MessageHeader) : borrowed_payload,
+                                      GetMessageHeader()->data_size);
   }
 
+  /**
+   * @warning not for packets with a borrowed payload - it may well be read only
+   */
   std::span<std::byte> GetMutablePayload() {
-    return std::span<std::byte>(storage.get() + sizeof(MessageHeader), GetMessageHeader()->data_size);
+    assert(IsContiguous());
+    return std::span<std::byte>(data + sizeof(MessageHeader), GetMessageHeader()->data_size);
   }
 
 private:
-  MessageHeader *GetMutableMessageHeader() { return reinterpret_cast<MessageHeader *>(storage.get()); }
+  MessageHeader *GetMutableMessageHeader() { return reinterpret_cast<MessageHeader *>(data); }
 
   void InitializeHeader(MessageHeader::DataType data_type, const uint32_t data_size) {
-    MessageHeader *header = new (storage.get()) MessageHeader;
+    MessageHeader *header = new (data) MessageHeader;
 
     header->data_type = data_type;
     header->data_size = data_size;
   }
 
-  std::unique_ptr<std::byte[]> storage;
+  /// Set when this packet owns its memory
+  PacketBuffer storage;
+  /// Start of the packet, header first. Always valid.
+  std::byte *data = nullptr;
+  /// Set when the payload is borrowed, `data` then points at `borrowed_header`
+  const std::byte *borrowed_payload = nullptr;
+  MessageHeader borrowed_header;
+  /// Set when this packet is a view into memory owned by someone else
+  std::shared_ptr<const void> owner;
 };
 
 } // namespace basis::core::transport
\ No newline at end of file
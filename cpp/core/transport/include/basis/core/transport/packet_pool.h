@@ -0,0 +1,175 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace basis::core::transport {
+
+class PacketPool;
+
+/**
+ * Returns a buffer to the PacketPool it came from (or the heap, if it was too large to pool).
+ */
+struct PacketBufferDeleter {
+  void operator()(std::byte *buffer) const;
+
+  /// Index of the size class, or PacketPool::UNPOOLED
+  uint8_t size_class = 0;
+};
+
+using PacketBuffer = std::unique_ptr<std::byte[], PacketBufferDeleter>;
+
+/**
+ * Process wide pool of packet buffers, bucketed into power of two size classes.
+ *
+ * Each thread keeps a small cache that it allocates from and releases into without locking, spilling
+ * to (and refilling from) a shared, mutex protected free list. Buffers are typically allocated on one thread (ie a
+ * TCP receive worker) and released on another (the unit's thread), so the shared list is what keeps memory from piling
+ * up in a single thread's cache.
+ *
+ * Buffers larger than the largest size class go straight to the heap.
+ *
+ * The shared lists are capped (BASIS_PACKET_POOL_MAX_BYTES in the environment, or SetSharedBytesLimit()). Update(),
+ * called regularly by TransportManager::Update(), gives memory back once the shared lists go unused for a while, down to
+ * a low water mark (BASIS_PACKET_POOL_LOW_WATER_BYTES, or SetSharedLowWaterBytes()).
+ */
+class PacketPool {
+public:
+  static constexpr uint8_t MIN_SIZE_CLASS_BITS = 8;
+  static constexpr uint8_t MAX_SIZE_CLASS_BITS = 24;
+  static constexpr size_t NUM_SIZE_CLASSES = MAX_SIZE_CLASS_BITS - MIN_SIZE_CLASS_BITS + 1;
+  static constexpr uint8_t UNPOOLED = 0xFF;
+
+  /// Upper bound on the bytes a single thread will cache, across all size classes, before spilling to the shared
+  /// list. Buffers larger than this always go to the shared list.
+  static constexpr size_t THREAD_CACHE_BYTES = 1024 * 1024;
+  /// Default upper bound on the bytes held by the shared free lists. Anything released past this is freed.
+  static constexpr size_t DEFAULT_SHARED_BYTES_LIMIT = 64 * 1024 * 1024;
+  /// Default for what the shared free lists are trimmed down to once idle
+  static constexpr size_t DEFAULT_SHARED_LOW_WATER_BYTES = 4 * 1024 * 1024;
+  /// How long the shared free lists must go without an allocation before Update() trims them
+  static constexpr std::chrono::seconds IDLE_TRIM_INTERVAL{5};
+  /// How often Update() logs the stats
+  static constexpr std::chrono::seconds STATS_LOG_INTERVAL{60};
+
+  struct Stats {
+    /// Allocations served from a free list
+    uint64_t hits = 0;
+    /// Allocations that had to go to the heap
+    uint64_t misses = 0;
+    /// Allocations too large to be pooled (also counted as misses)
+    uint64_t unpooled = 0;
+    /// Bytes currently sitting in free lists, across all threads
+    uint64_t bytes_held = 0;
+    /// Bytes given back to the heap by Update() and SetSharedBytesLimit()
+    uint64_t trimmed_bytes = 0;
+  };
+
+  static PacketPool &Global();
+
+  /**
+   * Get a buffer of at least `size` bytes. The contents are uninitialized.
+   */
+  PacketBuffer Allocate(size_t size);
+
+  Stats GetStats() const {
+    return {.hits = hits.load(std::memory_order_relaxed),
+            .misses = misses.load(std::memory_order_relaxed),
+            .unpooled = unpooled.load(std::memory_order_relaxed),
+            .bytes_held = bytes_held.load(std::memory_order_relaxed),
+            .trimmed_bytes = trimmed_bytes.load(std::memory_order_relaxed)};
+  }
+
+  /**
+   * Free everything in the shared free lists and the calling thread's cache.
+   */
+  void Trim();
+
+  /**
+   * Cap the bytes held by the shared free lists, freeing whatever they hold past the new limit.
+   */
+  void SetSharedBytesLimit(size_t bytes);
+
+  size_t GetSharedBytesLimit() const { return shared_bytes_limit.load(std::memory_order_relaxed); }
+
+  /**
+   * Set what the shared free lists are trimmed down to once idle.
+   */
+  void SetSharedLowWaterBytes(size_t bytes) { shared_low_water_bytes.store(bytes, std::memory_order_relaxed); }
+
+  size_t GetSharedLowWaterBytes() const { return shared_low_water_bytes.load(std::memory_order_relaxed); }
+
+  /**
+   * Periodic upkeep, cheap enough to call from any update loop. Once the shared free lists have gone
+   * IDLE_TRIM_INTERVAL without an allocation, frees what they hold above the low water mark. Logs the stats every
+   * STATS_LOG_INTERVAL.
+   *
+   * @return the number of bytes freed
+   */
+  size_t Update(std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now());
+
+  static constexpr size_t GetSizeClassBytes(uint8_t size_class) {
+    return size_t(1) << (size_class + MIN_SIZE_CLASS_BITS);
+  }
+
+  static uint8_t GetSizeClass(size_t size);
+
+protected:
+  friend struct PacketBufferDeleter;
+  struct ThreadCache;
+
+  /**
+   * Limits come from the environment, if set.
+   */
+  PacketPool();
+
+  void Release(std::byte *buffer, uint8_t size_class);
+
+  void ReleaseShared(std::byte *buffer, uint8_t size_class);
+
+  /**
+   * Free shared buffers, largest first, until the shared free lists hold at most `target_bytes`.
+   *
+   * @return the number of bytes freed
+   */
+  size_t TrimShared(size_t target_bytes);
+
+  /**
+   * Returns nullptr if called while the calling thread is exiting.
+   */
+  ThreadCache *GetThreadCache();
+
+  struct SharedFreeList {
+    std::mutex mutex;
+    std::vector<std::byte *> buffers;
+  };
+
+  std::array<SharedFreeList, NUM_SIZE_CLASSES> shared;
+
+  std::atomic<uint64_t> hits = 0;
+  std::atomic<uint64_t> misses = 0;
+  std::atomic<uint64_t> unpooled = 0;
+  std::atomic<uint64_t> bytes_held = 0;
+  std::atomic<uint64_t> trimmed_bytes = 0;
+  /// Bytes held by the shared lists only, used to enforce `shared_bytes_limit`
+  std::atomic<uint64_t> shared_bytes_held = 0;
+  /// Bumped on every allocation that reaches the shared lists, lets Update() tell when they're idle
+  std::atomic<uint64_t> shared_allocations = 0;
+
+  std::atomic<size_t> shared_bytes_limit;
+  std::atomic<size_t> shared_low_water_bytes;
+
+  /// Guards the state Update() keeps between calls
+  std::mutex update_mutex;
+  uint64_t last_shared_allocations = 0;
+  std::chrono::steady_clock::time_point last_shared_activity = std::chrono::steady_clock::now();
+  std::chrono::steady_clock::time_point last_stats_log = std::chrono::steady_clock::now();
+};
+
+} // namespace basis::core::transport
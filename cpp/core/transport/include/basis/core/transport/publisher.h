@@ -1,4 +1,5 @@
 #pragma once
+#include <algorithm>
 #include <atomic>
 #include <cassert>
 #include <cstdint>
@@ -8,6 +9,7 @@
 #include <spdlog/spdlog.h>
 
 #include "basis/core/time.h"
+#include "async_publish_queue.h"
 #include "inproc.h"
 #include "logger.h"
 #include "message_packet.h"
@@ -35,12 +37,27 @@ public:
 
   virtual void SendMessage(std::shared_ptr<MessagePacket> message) = 0;
 
+  /**
+   * Get a packet of `data_size` to serialize into, backed by memory the transport can send without any further copy
+   * (ie a shared memory slot). The packet is expected to be passed back into SendMessage(), though it's valid to send
+   * it over other transports as well, or to drop it.
+   *
+   * Returns nullptr if the transport has nothing better to offer than the heap.
+   */
+  virtual std::shared_ptr<MessagePacket> LoanPacket([[maybe_unused]] uint32_t data_size) { return nullptr; }
+
   virtual std::string GetTransportName() = 0;
 
   virtual std::string GetConnectionInformation() = 0;
 
   virtual size_t GetSubscriberCount() = 0;
 
+  /**
+   * Messages accepted by SendMessage() that the slowest subscriber hasn't been handed yet. Transports that can't tell
+   * (or never queue) report 0.
+   */
+  virtual size_t GetPendingMessageCount() { return 0; }
+
   virtual void SetMaxQueueSize(size_t max_queue_size) = 0;
 };
 
@@ -65,7 +82,44 @@ public:
     }
   }
 
+  /**
+   * The most messages any one subscriber is behind by, across all transports.
+   */
+  size_t GetPendingMessageCount() {
+    size_t pending = 0;
+    for (auto &pub : transport_publishers) {
+      pending = std::max(pending, pub->GetPendingMessageCount());
+    }
+    return pending;
+  }
+
 protected:
+  /**
+   * Get a packet to serialize into, borrowing the memory from a transport if it is the only consumer of the message.
+   * Falls back to a pooled heap packet, which transports that can loan will copy in on send.
+   *
+   * A loaned packet is only released once every holder drops it - handing one to other transports or the recorder
+   * would keep the lender's slots pinned and starve it.
+   */
+  std::shared_ptr<MessagePacket> LoanPacket(uint32_t data_size) {
+    if (!recorder) {
+      TransportPublisher *sole_consumer = nullptr;
+      size_t consumer_count = 0;
+      for (auto &pub : transport_publishers) {
+        if (pub->GetSubscriberCount() != 0) {
+          sole_consumer = pub.get();
+          consumer_count++;
+        }
+      }
+      if (consumer_count == 1) {
+        if (auto packet = sole_consumer->LoanPacket(data_size)) {
+          return packet;
+        }
+      }
+    }
+    return std::make_shared<MessagePacket>(MessageHeader::DataType::MESSAGE, data_size);
+  }
+
   void PublishRaw(std::shared_ptr<MessagePacket> packet, basis::core::MonotonicTime now) {
     // Send the data
     for (auto &pub : transport_publishers) {
@@ -90,6 +144,7 @@ public:
                std::vector<std::shared_ptr<TransportPublisher>> transport_publishers, RecorderInterface *recorder)
       : PublisherBase(topic, type_info, false, std::move(transport_publishers), recorder) {}
 
+  using PublisherBase::LoanPacket;
   using PublisherBase::PublishRaw;
 };
 
@@ -112,13 +167,32 @@ public:
     return n;
   }
 
+  /**
+   * Opt in to serializing and sending (and recording) on `thread_pool`, rather than inside Publish(). Inproc subscribers
+   * are still called from Publish(). Must be called before the first Publish().
+   */
+  void EnableAsyncPublish(threading::ThreadPool *thread_pool, AsyncPublishSettings settings = {}) {
+    async_queue = std::make_unique<AsyncPublishQueue>(thread_pool, settings);
+  }
+
+  /**
+   * Number of messages dropped by the async publish queue, see EnableAsyncPublish().
+   */
+  uint64_t GetAsyncDroppedCount() const { return async_queue ? async_queue->GetDroppedCount() : 0; }
+
   virtual void Publish(std::shared_ptr<const T_CONVERTABLE_INPROC> msg) {
     if constexpr (!std::is_same_v<T_CONVERTABLE_INPROC, NoAdditionalInproc>) {
       assert(convertable_inproc);
       convertable_inproc->Publish(msg);
 
-      if (GetTransportSubscriberCount() > 0 || inproc->HasSubscribersFast()) {
-        // This can someday be made async
+      if (async_queue && !inproc->HasSubscribersFast()) {
+        // Nothing needs the converted message synchronously - convert on the pool as well
+        if (GetTransportSubscriberCount() > 0) {
+          async_queue->Push([this, msg = std::move(msg), now = basis::core::MonotonicTime::Now()] {
+            SerializeAndSend(*ConvertToMessage<T_MSG>(msg), now);
+          });
+        }
+      } else if (GetTransportSubscriberCount() > 0 || inproc->HasSubscribersFast()) {
         Publish(ConvertToMessage<T_MSG>(msg));
       }
     }
@@ -133,19 +207,24 @@ public:
       return;
     }
 
-    // TODO: if the cost of serialization is high, it may be good to move the work onto a different thread
-
-    // Serialize
     basis::core::MonotonicTime now = basis::core::MonotonicTime::Now();
+    if (async_queue) {
+      async_queue->Push([this, msg = std::move(msg), now] { SerializeAndSend(*msg, now); });
+      return;
+    }
+    SerializeAndSend(*msg, now);
+  }
 
+private:
+  void SerializeAndSend(const T_MSG &msg, basis::core::MonotonicTime now) {
     // Request size of payload from serializer
-    const size_t payload_size = get_message_size_cb(*msg);
-    // Create a packet of the proper size
+    const size_t payload_size = get_message_size_cb(msg);
+    // Create a packet of the proper size, ideally in memory owned by the transport
     // TODO: embed time inside packet?
-    auto packet = std::make_shared<MessagePacket>(MessageHeader::DataType::MESSAGE, payload_size);
+    std::shared_ptr<MessagePacket> packet = LoanPacket(payload_size);
     // Serialize directly to the packet
     std::span<std::byte> payload = packet->GetMutablePayload();
-    if (!write_message_to_span_cb(*msg, payload)) {
+    if (!write_message_to_span_cb(msg, payload)) {
       BASIS_LOG_ERROR("Unable to serialize message on topic {}", topic);
       return;
     }
@@ -153,11 +232,12 @@ public:
     PublishRaw(std::move(packet), now);
   }
 
-private:
   std::shared_ptr<InprocPublisher<T_MSG>> inproc;
   std::shared_ptr<InprocPublisher<T_CONVERTABLE_INPROC>> convertable_inproc;
   SerializeGetSizeCallback<T_MSG> get_message_size_cb;
   SerializeWriteSpanCallback<T_MSG> write_message_to_span_cb;
+  /// Declared last, so that any in progress send finishes before the rest of the publisher is destroyed
+  std::unique_ptr<AsyncPublishQueue> async_queue;
 };
 
 } // namespace basis::core::transport
\ No newline at end of file
@@ -32,6 +32,10 @@ struct PublisherInfo {
    * ie "protobuf:Pose"
    */
   std::string schema_id;
+  /**
+   * MessageSchema::hash_id of schema_id - empty if the serializer doesn't provide one
+   */
+  std::string schema_hash_id;
   /**
    * Possible transports
    */
@@ -46,6 +50,7 @@ struct PublisherInfo {
     out.set_publisher_id_low(publisher_id_64s[1]);
     out.set_topic(topic);
     out.set_schema_id(schema_id);
+    out.set_schema_hash_id(schema_hash_id);
 
     for (auto &p : transport_info) {
       out.mutable_transport_info()->insert({p.first, p.second});
@@ -62,6 +67,7 @@ struct PublisherInfo {
     out.publisher_id_64s[1] = proto.publisher_id_low();
     out.topic = proto.topic();
     out.schema_id = proto.schema_id();
+    out.schema_hash_id = proto.schema_hash_id();
     for (auto &[topic, endpoint] : proto.transport_info()) {
       out.transport_info[topic] = endpoint;
     }
@@ -13,6 +13,7 @@
 #include <thread>
 #include <unordered_map>
 
+class TestShmTransport;
 class TestTcpTransport;
 
 namespace basis {
@@ -33,6 +34,18 @@ public:
 
   virtual size_t GetPublisherCount() = 0;
 
+  /**
+   * False once a publisher previously connected to is known to be lost, so that it can be connected again on the next
+   * publisher update or retry. Transports that can't tell assume they are still connected.
+   */
+  virtual bool IsConnectedToPublisher([[maybe_unused]] __uint128_t publisher_id) { return true; }
+
+  /**
+   * When a publisher is reachable over more than one transport, the transport with the highest preference that can
+   * connect is used.
+   */
+  virtual int GetPreference() const { return 0; }
+
   virtual ~TransportSubscriber() = default;
   const std::string transport_name;
 };
@@ -60,12 +73,15 @@ public:
    * Notify this subscriber of one or more publishers.
    *
    * The subscriber will pass the relevant information down into the correct transports.
+   *
+   * @return false if some publisher reachable over one of our transports couldn't be connected to - call again to retry
    */
-  void HandlePublisherInfo(const std::vector<PublisherInfo> &info);
+  bool HandlePublisherInfo(const std::vector<PublisherInfo> &info);
 
   size_t GetPublisherCount();
 
 protected:
+  friend class ::TestShmTransport;
   friend class ::TestTcpTransport;
   const std::string topic;
   const serialization::MessageTypeInfo type_info;
@@ -0,0 +1,209 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "inproc.h"
+#include "publisher_info.h"
+#include "subscriber.h"
+
+namespace basis::core::transport {
+
+/**
+ * Per topic index of the local subscribers and the publishers known from the network.
+ *
+ * Each topic name is stored once, as the key here - lookups by string_view don't allocate. Incoming NetworkInfo is
+ * diffed topic by topic, so that only subscribers of topics whose publishers changed are notified, and only those
+ * topics have their PublisherInfo rebuilt. Topics where a subscriber failed to connect to one of the publishers are
+ * remembered, to be retried with RetryUnconnected() - an unchanged publisher set would otherwise never ask again.
+ */
+class TopicRegistry {
+public:
+  struct Topic {
+    /// Publishers from the last NetworkInfo, in the order they were received
+    std::vector<PublisherInfo> network_publishers;
+    std::vector<std::weak_ptr<SubscriberBase>> subscribers;
+    /// The last HandleNetworkInfo() call this topic was part of
+    uint64_t network_generation = 0;
+  };
+
+  /**
+   * @return the topic, or nullptr if nothing has been seen on it
+   */
+  const Topic *Find(std::string_view topic) const {
+    auto it = topics.find(topic);
+    return it == topics.end() ? nullptr : &it->second;
+  }
+
+  void AddSubscriber(std::string_view topic, std::weak_ptr<SubscriberBase> subscriber) {
+    GetOrCreate(topic).subscribers.push_back(std::move(subscriber));
+  }
+
+  /**
+   * Publishers known from the network for `topic` - empty if none.
+   */
+  const std::vector<PublisherInfo> &GetNetworkPublishers(std::string_view topic) const {
+    static const std::vector<PublisherInfo> empty;
+    const Topic *entry = Find(topic);
+    return entry ? entry->network_publishers : empty;
+  }
+
+  /**
+   * Replaces the network publishers of every topic with those in `network_info`, notifying subscribers of each topic
+   * that changed.
+   *
+   * @return the number of topics that changed
+   */
+  size_t HandleNetworkInfo(const proto::NetworkInfo &network_info) {
+    generation++;
+    const size_t published_before = published_topic_count;
+    size_t still_published = 0;
+
+    size_t changed = 0;
+    for (const auto &[topic_name, publishers_msg] : network_info.publishers_by_topic()) {
+      Topic &topic = GetOrCreate(topic_name);
+      topic.network_generation = generation;
+
+      const bool was_published = !topic.network_publishers.empty();
+      still_published += was_published;
+      if (SamePublishers(topic.network_publishers, publishers_msg)) {
+        continue;
+      }
+
+      topic.network_publishers.clear();
+      topic.network_publishers.reserve(publishers_msg.publishers_size());
+      for (const auto &publisher_info : publishers_msg.publishers()) {
+        topic.network_publishers.emplace_back(PublisherInfo::FromProto(publisher_info));
+      }
+      published_topic_count += !topic.network_publishers.empty();
+      published_topic_count -= was_published;
+
+      SetConnected(topic, Notify(topic));
+      changed++;
+    }
+
+    // Only walk every topic if some topic went missing
+    if (still_published != published_before) {
+      changed += RemoveUnpublished();
+    }
+    return changed;
+  }
+
+  /**
+   * Marks `topic` as having a publisher that some subscriber couldn't connect to, ie after handing a new subscriber the
+   * network publishers directly.
+   */
+  void RetryLater(std::string_view topic) { unconnected.insert(&GetOrCreate(topic)); }
+
+  /**
+   * Hands the publishers again to the subscribers of each topic that wasn't connected to all of them. A transport may
+   * refuse a connection for a while (a TCP listener not accepting yet, a full shared memory segment) - this is what
+   * gets those connections made.
+   *
+   * @return the number of topics still not connected to every publisher
+   */
+  size_t RetryUnconnected() {
+    std::erase_if(unconnected, [](Topic *topic) { return Notify(*topic); });
+    return unconnected.size();
+  }
+
+  size_t GetUnconnectedCount() const { return unconnected.size(); }
+
+  size_t Size() const { return topics.size(); }
+
+private:
+  Topic &GetOrCreate(std::string_view topic) {
+    auto it = topics.find(topic);
+    if (it == topics.end()) {
+      it = topics.emplace(std::string(topic), Topic{}).first;
+    }
+    return it->second;
+  }
+
+  static bool SamePublishers(const std::vector<PublisherInfo> &known, const proto::RepeatedPublisherInfo &incoming) {
+    if (known.size() != size_t(incoming.publishers_size())) {
+      return false;
+    }
+    for (size_t i = 0; i < known.size(); i++) {
+      const PublisherInfo &a = known[i];
+      const proto::PublisherInfo &b = incoming.publishers(int(i));
+      if (a.publisher_id_64s[0] != b.publisher_id_high() || a.publisher_id_64s[1] != b.publisher_id_low() ||
+          a.schema_id != b.schema_id() || a.schema_hash_id != b.schema_hash_id() ||
+          a.transport_info.size() != size_t(b.transport_info_size())) {
+        return false;
+      }
+      for (const auto &[transport, endpoint] : b.transport_info()) {
+        auto it = a.transport_info.find(transport);
+        if (it == a.transport_info.end() || it->second != endpoint) {
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+
+  void SetConnected(Topic &topic, bool connected) {
+    if (connected) {
+      unconnected.erase(&topic);
+    } else {
+      unconnected.insert(&topic);
+    }
+  }
+
+  /**
+   * Hands the topic's publishers to each of its subscribers, forgetting any that have gone away.
+   *
+   * @return true if every subscriber is connected to every publisher it can reach
+   */
+  static bool Notify(Topic &topic) {
+    bool connected = true;
+    std::erase_if(topic.subscribers, [&](const std::weak_ptr<SubscriberBase> &weak_subscriber) {
+      auto subscriber = weak_subscriber.lock();
+      if (!subscriber) {
+        return true;
+      }
+      connected &= subscriber->HandlePublisherInfo(topic.network_publishers);
+      return false;
+    });
+    return connected;
+  }
+
+  /**
+   * Clears the publishers of topics missing from the last NetworkInfo, dropping topics that no longer have anything.
+   *
+   * @return the number of topics cleared
+   */
+  size_t RemoveUnpublished() {
+    size_t removed = 0;
+    for (auto it = topics.begin(); it != topics.end();) {
+      Topic &topic = it->second;
+      if (topic.network_generation != generation && !topic.network_publishers.empty()) {
+        topic.network_publishers.clear();
+        unconnected.erase(&topic);
+        published_topic_count--;
+        removed++;
+      }
+      std::erase_if(topic.subscribers, [](const auto &subscriber) { return subscriber.expired(); });
+      if (topic.network_publishers.empty() && topic.subscribers.empty()) {
+        unconnected.erase(&topic);
+        it = topics.erase(it);
+      } else {
+        ++it;
+      }
+    }
+    return removed;
+  }
+
+  std::unordered_map<std::string, Topic, internal::string_hash, std::equal_to<>> topics;
+  /// Topics with at least one network publisher
+  size_t published_topic_count = 0;
+  /// Topics with a publisher some subscriber isn't connected to - pointers into `topics`, which never move
+  std::unordered_set<Topic *> unconnected;
+  uint64_t generation = 0;
+};
+
+} // namespace basis::core::transport
@@ -10,7 +10,7 @@
 #include "publisher_info.h"
 #include "subscriber.h"
 
-#include <basis/core/containers/simple_mpsc.h>
+#include <basis/core/containers/mpsc_queue.h>
 
 #include <basis/core/serialization.h>
 #include <basis/core/threading/thread_pool.h>
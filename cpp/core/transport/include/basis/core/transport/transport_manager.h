@@ -1,12 +1,15 @@
 #pragma once
 
+#include <chrono>
 #include <memory>
 
 #include "basis/core/transport/convertable_inproc.h"
 #include "inproc.h"
+#include "packet_pool.h"
 #include "publisher.h"
 #include "publisher_info.h"
 #include "subscriber.h"
+#include "topic_registry.h"
 
 #include <basis/core/containers/subscriber_callback_queue.h>
 #include <basis/core/serialization.h>
@@ -73,7 +76,10 @@ protected:
   AdvertiseOnTransports(std::string_view topic, const serialization::MessageTypeInfo &message_type) {
     std::vector<std::shared_ptr<TransportPublisher>> tps;
     for (auto &[transport_name, transport] : transports) {
-      tps.push_back(transport->Advertise(topic, message_type));
+      // A transport may decline to advertise (ie shared memory being unavailable)
+      if (auto tp = transport->Advertise(topic, message_type)) {
+        tps.push_back(std::move(tp));
+      }
     }
     return tps;
   }
@@ -216,19 +222,23 @@ public:
   }
 
   /**
-   * Updates all transports and cleans up old publishers.
+   * Updates all transports, cleans up old publishers and gives idle packet buffers back to the heap.
    */
   void Update() {
     for (auto &[_, transport] : transports) {
       transport->Update();
     }
+    PacketPool::Global().Update();
 
     // Generate updated topic info and clean up old publishers
     std::vector<PublisherInfo> new_publisher_info;
 
     for (auto it = publishers.cbegin(); it != publishers.cend();) {
       if (auto publisher = it->second.lock()) {
-        new_publisher_info.emplace_back(publisher->GetPublisherInfo());
+        PublisherInfo &info = new_publisher_info.emplace_back(publisher->GetPublisherInfo());
+        if (const serialization::MessageSchema *schema = schema_manager.TryGetSchema(info.schema_id)) {
+          info.schema_hash_id = schema->hash_id;
+        }
         ++it;
       } else {
         it = publishers.erase(it);
@@ -249,22 +259,31 @@ public:
     return sent_info;
   }
 
-  void HandleNetworkInfo(const proto::NetworkInfo &network_info) {
-    last_network_publish_info.clear();
+  /// How often publishers that couldn't be connected to are tried again
+  static constexpr std::chrono::milliseconds CONNECT_RETRY_INTERVAL{100};
 
-    for (auto &[topic, publisher_infos_msg] : network_info.publishers_by_topic()) {
-      std::vector<PublisherInfo> &info = last_network_publish_info[topic];
-      info.reserve(publisher_infos_msg.publishers_size());
-      for (auto &publisher_info : publisher_infos_msg.publishers()) {
-        info.emplace_back(PublisherInfo::FromProto(publisher_info));
-      }
-      for (auto [it, end] = subscribers.equal_range(topic); it != end; it++) {
-        auto subscriber = it->second.lock();
-        if (subscriber) {
-          subscriber->HandlePublisherInfo(info);
-        }
-      }
+  /**
+   * Hands the publishers for each topic to its subscribers - only for topics whose publishers changed. Versioned
+   * NetworkInfo (from the coordinator) is skipped entirely if it's the version already handled.
+   *
+   * Publishers a subscriber failed to connect to are retried every CONNECT_RETRY_INTERVAL, whether or not anything
+   * changed - call this every update, even with the same NetworkInfo.
+   *
+   * @return the number of topics that changed
+   */
+  size_t HandleNetworkInfo(const proto::NetworkInfo &network_info,
+                           std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now()) {
+    if (topic_registry.GetUnconnectedCount() && now >= next_connect_retry) {
+      topic_registry.RetryUnconnected();
+      next_connect_retry = now + CONNECT_RETRY_INTERVAL;
     }
+
+    if (network_info.version() != 0 && network_info.version() == last_network_info_version) {
+      return 0;
+    }
+    last_network_info_version = network_info.version();
+
+    return topic_registry.HandleNetworkInfo(network_info);
   }
 
   SchemaManager &GetSchemaManager() { return schema_manager; }
@@ -316,12 +335,14 @@ protected:
       subscriber = std::make_shared<T_SUBSCRIBER>(topic, message_type, std::move(tps), inproc_subscriber,
                                                   additional_inproc_subscriber);
     }
-    subscribers.emplace(std::string(topic), subscriber);
+    topic_registry.AddSubscriber(topic, subscriber);
 
     if (use_local_publishers_for_subscribers) {
       subscriber->HandlePublisherInfo(GetLastPublisherInfo());
     }
-    subscriber->HandlePublisherInfo(last_network_publish_info[std::string(topic)]);
+    if (!subscriber->HandlePublisherInfo(topic_registry.GetNetworkPublishers(topic))) {
+      topic_registry.RetryLater(topic);
+    }
 
     return subscriber;
   }
@@ -350,9 +371,11 @@ protected:
   std::vector<PublisherInfo> last_owned_publish_info;
 
   /**
-   * Latest summary of publishers from other processes.
+   * Latest summary of publishers from other processes, and the subscribers to hand them to.
    */
-  std::unordered_map<std::string, std::vector<PublisherInfo>> last_network_publish_info;
+  TopicRegistry topic_registry;
+  uint64_t last_network_info_version = 0;
+  std::chrono::steady_clock::time_point next_connect_retry;
 
   /**
    * The inproc transport. Optional as for testing sending shared pointers directly may not be desired.
@@ -371,13 +394,6 @@ protected:
    */
   std::unordered_multimap<std::string, std::weak_ptr<PublisherBase>> publishers;
 
-  /**
-   * The subscribers we've created.
-   *
-   * @todo: it may be wise to make this a unnordered_map<string, vector<subscriber>> instead
-   */
-  std::unordered_multimap<std::string, std::weak_ptr<SubscriberBase>> subscribers;
-
   SchemaManager schema_manager;
 
   /**
@@ -0,0 +1,74 @@
+#include <basis/core/transport/async_publish_queue.h>
+#include <basis/core/transport/logger.h>
+
+namespace basis::core::transport {
+
+AsyncPublishQueue::~AsyncPublishQueue() {
+  std::unique_lock lock(mutex);
+  stopping = true;
+  pending.clear();
+  // Wake any publisher blocked on back-pressure, then wait out the drain task
+  cv.notify_all();
+  cv.wait(lock, [this] { return !draining; });
+}
+
+bool AsyncPublishQueue::Push(std::function<void()> work) {
+  std::unique_lock lock(mutex);
+  if (stopping) {
+    return false;
+  }
+
+  if (settings.max_pending > 0 && pending.size() >= settings.max_pending) {
+    switch (settings.drop_policy) {
+    case AsyncPublishSettings::DropPolicy::DROP_OLDEST:
+      pending.pop_front();
+      dropped.fetch_add(1, std::memory_order_relaxed);
+      break;
+    case AsyncPublishSettings::DropPolicy::DROP_NEWEST:
+      dropped.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    case AsyncPublishSettings::DropPolicy::BLOCK:
+      cv.wait(lock, [this] { return stopping || pending.size() < settings.max_pending; });
+      if (stopping) {
+        return false;
+      }
+      break;
+    }
+  }
+
+  pending.push_back(std::move(work));
+  if (!draining) {
+    try {
+      thread_pool->post([this] { Drain(); });
+    } catch (const std::runtime_error &e) {
+      // The pool is shutting down - send from this thread rather than leave the work stranded
+      BASIS_LOG_WARN("Unable to schedule async publish ({}), publishing inline", e.what());
+      draining = true;
+      lock.unlock();
+      Drain();
+      return true;
+    }
+    // Only marked once posted - the drain task can't observe it before the lock is released anyway
+    draining = true;
+  }
+  return true;
+}
+
+void AsyncPublishQueue::Drain() {
+  std::unique_lock lock(mutex);
+  while (!pending.empty()) {
+    std::function<void()> work = std::move(pending.front());
+    pending.pop_front();
+    // Make room for a blocked publisher
+    cv.notify_all();
+
+    lock.unlock();
+    work();
+    lock.lock();
+  }
+  draining = false;
+  // Notify with the lock held - once it's released, the destructor is free to run
+  cv.notify_all();
+}
+
+} // namespace basis::core::transport
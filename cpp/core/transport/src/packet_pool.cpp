@@ -0,0 +1,234 @@
+#include <basis/core/transport/logger.h>
+#include <basis/core/transport/packet_pool.h>
+
+#include <bit>
+#include <charconv>
+#include <cstdlib>
+#include <string_view>
+
+namespace basis::core::transport {
+
+namespace {
+/// Thread caches can't be touched once destroyed - buffers released after that go to the shared list
+thread_local bool thread_cache_destroyed = false;
+
+size_t GetBytesFromEnvironment(const char *name, size_t default_bytes) {
+  const char *value = std::getenv(name);
+  if (!value || !*value) {
+    return default_bytes;
+  }
+  const std::string_view text(value);
+  size_t bytes = 0;
+  auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), bytes);
+  if (ec != std::errc() || end != text.data() + text.size()) {
+    BASIS_LOG_ERROR("Ignoring {}={}, expected a number of bytes", name, text);
+    return default_bytes;
+  }
+  return bytes;
+}
+} // namespace
+
+struct PacketPool::ThreadCache {
+  ~ThreadCache() {
+    thread_cache_destroyed = true;
+    for (uint8_t size_class = 0; size_class < NUM_SIZE_CLASSES; size_class++) {
+      for (std::byte *buffer : buffers[size_class]) {
+        pool->bytes_held -= GetSizeClassBytes(size_class);
+        pool->ReleaseShared(buffer, size_class);
+      }
+    }
+  }
+
+  PacketPool *pool;
+  std::array<std::vector<std::byte *>, NUM_SIZE_CLASSES> buffers;
+  /// Total across all size classes, kept under THREAD_CACHE_BYTES
+  size_t bytes = 0;
+};
+
+void PacketBufferDeleter::operator()(std::byte *buffer) const {
+  if (size_class == PacketPool::UNPOOLED) {
+    delete[] buffer;
+  } else {
+    PacketPool::Global().Release(buffer, size_class);
+  }
+}
+
+PacketPool::PacketPool()
+    : shared_bytes_limit(GetBytesFromEnvironment("BASIS_PACKET_POOL_MAX_BYTES", DEFAULT_SHARED_BYTES_LIMIT)),
+      shared_low_water_bytes(
+          GetBytesFromEnvironment("BASIS_PACKET_POOL_LOW_WATER_BYTES", DEFAULT_SHARED_LOW_WATER_BYTES)) {}
+
+PacketPool &PacketPool::Global() {
+  // Intentionally leaked - buffers may be released by threads outliving static destruction
+  static PacketPool *pool = new PacketPool();
+  return *pool;
+}
+
+uint8_t PacketPool::GetSizeClass(size_t size) {
+  if (size <= GetSizeClassBytes(0)) {
+    return 0;
+  }
+  const int bits = std::bit_width(size - 1);
+  if (bits > MAX_SIZE_CLASS_BITS) {
+    return UNPOOLED;
+  }
+  return bits - MIN_SIZE_CLASS_BITS;
+}
+
+PacketPool::ThreadCache *PacketPool::GetThreadCache() {
+  if (thread_cache_destroyed) {
+    return nullptr;
+  }
+  thread_local ThreadCache cache{.pool = this, .buffers = {}};
+  return &cache;
+}
+
+PacketBuffer PacketPool::Allocate(size_t size) {
+  const uint8_t size_class = GetSizeClass(size);
+  if (size_class == UNPOOLED) {
+    misses.fetch_add(1, std::memory_order_relaxed);
+    unpooled.fetch_add(1, std::memory_order_relaxed);
+    return PacketBuffer(new std::byte[size], {.size_class = UNPOOLED});
+  }
+
+  const size_t class_bytes = GetSizeClassBytes(size_class);
+
+  // Fast path - this thread's cache
+  if (ThreadCache *cache = GetThreadCache(); cache && !cache->buffers[size_class].empty()) {
+    std::byte *buffer = cache->buffers[size_class].back();
+    cache->buffers[size_class].pop_back();
+    cache->bytes -= class_bytes;
+    bytes_held.fetch_sub(class_bytes, std::memory_order_relaxed);
+    hits.fetch_add(1, std::memory_order_relaxed);
+    return PacketBuffer(buffer, {.size_class = size_class});
+  }
+
+  // Slower path - the shared list
+  shared_allocations.fetch_add(1, std::memory_order_relaxed);
+  {
+    SharedFreeList &free_list = shared[size_class];
+    std::lock_guard lock(free_list.mutex);
+    if (!free_list.buffers.empty()) {
+      std::byte *buffer = free_list.buffers.back();
+      free_list.buffers.pop_back();
+      shared_bytes_held.fetch_sub(class_bytes, std::memory_order_relaxed);
+      bytes_held.fetch_sub(class_bytes, std::memory_order_relaxed);
+      hits.fetch_add(1, std::memory_order_relaxed);
+      return PacketBuffer(buffer, {.size_class = size_class});
+    }
+  }
+
+  misses.fetch_add(1, std::memory_order_relaxed);
+  return PacketBuffer(new std::byte[class_bytes], {.size_class = size_class});
+}
+
+void PacketPool::Release(std::byte *buffer, uint8_t size_class) {
+  const size_t class_bytes = GetSizeClassBytes(size_class);
+
+  if (ThreadCache *cache = GetThreadCache()) {
+    if (cache->bytes + class_bytes <= THREAD_CACHE_BYTES) {
+      cache->buffers[size_class].push_back(buffer);
+      cache->bytes += class_bytes;
+      bytes_held.fetch_add(class_bytes, std::memory_order_relaxed);
+      return;
+    }
+  }
+
+  ReleaseShared(buffer, size_class);
+}
+
+void PacketPool::ReleaseShared(std::byte *buffer, uint8_t size_class) {
+  const size_t class_bytes = GetSizeClassBytes(size_class);
+
+  if (shared_bytes_held.fetch_add(class_bytes, std::memory_order_relaxed) + class_bytes >
+      shared_bytes_limit.load(std::memory_order_relaxed)) {
+    shared_bytes_held.fetch_sub(class_bytes, std::memory_order_relaxed);
+    delete[] buffer;
+    return;
+  }
+
+  SharedFreeList &free_list = shared[size_class];
+  std::lock_guard lock(free_list.mutex);
+  free_list.buffers.push_back(buffer);
+  bytes_held.fetch_add(class_bytes, std::memory_order_relaxed);
+}
+
+void PacketPool::Trim() {
+  for (uint8_t size_class = 0; size_class < NUM_SIZE_CLASSES; size_class++) {
+    const size_t class_bytes = GetSizeClassBytes(size_class);
+
+    if (ThreadCache *cache = GetThreadCache()) {
+      for (std::byte *buffer : cache->buffers[size_class]) {
+        delete[] buffer;
+        bytes_held.fetch_sub(class_bytes, std::memory_order_relaxed);
+      }
+      cache->bytes -= cache->buffers[size_class].size() * class_bytes;
+      cache->buffers[size_class].clear();
+    }
+
+    SharedFreeList &free_list = shared[size_class];
+    std::lock_guard lock(free_list.mutex);
+    for (std::byte *buffer : free_list.buffers) {
+      delete[] buffer;
+      shared_bytes_held.fetch_sub(class_bytes, std::memory_order_relaxed);
+      bytes_held.fetch_sub(class_bytes, std::memory_order_relaxed);
+    }
+    free_list.buffers.clear();
+  }
+}
+
+void PacketPool::SetSharedBytesLimit(size_t bytes) {
+  shared_bytes_limit.store(bytes, std::memory_order_relaxed);
+  TrimShared(bytes);
+}
+
+size_t PacketPool::TrimShared(size_t target_bytes) {
+  size_t freed = 0;
+  // Largest first - fewest frees for the most memory, and large buffers are the least likely to be needed again soon
+  for (int size_class = NUM_SIZE_CLASSES - 1; size_class >= 0; size_class--) {
+    const size_t class_bytes = GetSizeClassBytes(size_class);
+    SharedFreeList &free_list = shared[size_class];
+    std::lock_guard lock(free_list.mutex);
+    while (!free_list.buffers.empty() && shared_bytes_held.load(std::memory_order_relaxed) > target_bytes) {
+      delete[] free_list.buffers.back();
+      free_list.buffers.pop_back();
+      shared_bytes_held.fetch_sub(class_bytes, std::memory_order_relaxed);
+      bytes_held.fetch_sub(class_bytes, std::memory_order_relaxed);
+      freed += class_bytes;
+    }
+  }
+  trimmed_bytes.fetch_add(freed, std::memory_order_relaxed);
+  return freed;
+}
+
+size_t PacketPool::Update(std::chrono::steady_clock::time_point now) {
+  // Someone else is already on it
+  std::unique_lock lock(update_mutex, std::try_to_lock);
+  if (!lock) {
+    return 0;
+  }
+
+  size_t freed = 0;
+  const uint64_t allocations = shared_allocations.load(std::memory_order_relaxed);
+  if (allocations != last_shared_allocations) {
+    last_shared_allocations = allocations;
+    last_shared_activity = now;
+  } else if (now - last_shared_activity >= IDLE_TRIM_INTERVAL) {
+    freed = TrimShared(shared_low_water_bytes.load(std::memory_order_relaxed));
+    if (freed) {
+      const Stats stats = GetStats();
+      BASIS_LOG_INFO("Packet pool idle, freed {} bytes ({} still held, {} hits, {} misses)", freed, stats.bytes_held,
+                     stats.hits, stats.misses);
+    }
+  }
+
+  if (now - last_stats_log >= STATS_LOG_INTERVAL) {
+    last_stats_log = now;
+    const Stats stats = GetStats();
+    BASIS_LOG_DEBUG("Packet pool: {} hits, {} misses ({} unpooled), {} bytes held, {} bytes trimmed", stats.hits,
+                    stats.misses, stats.unpooled, stats.bytes_held, stats.trimmed_bytes);
+  }
+  return freed;
+}
+
+} // namespace basis::core::transport
@@ -3,10 +3,13 @@
 
 #include <spdlog/spdlog.h>
 
+#include <algorithm>
+
 #include <unistd.h>
 
 namespace basis::core::transport {
-void SubscriberBase::HandlePublisherInfo(const std::vector<PublisherInfo> &info) {
+bool SubscriberBase::HandlePublisherInfo(const std::vector<PublisherInfo> &info) {
+  bool connected = true;
   for (const PublisherInfo &publisher_info : info) {
     if (publisher_info.topic != topic) {
       BASIS_LOG_ERROR("Skipping publisher info because no topic");
@@ -21,14 +24,11 @@ void SubscriberBase::HandlePublisherInfo(const std::vector<PublisherInfo> &info)
         continue;
       }
 
-/// @todo BASIS-11: need to be able to handle disconnects
-#if 0
-        if(it->second->IsConnectedToPublisher(publisher_id)) {
-          continue;
-        }
-#else
-      continue;
-#endif
+      if (it->second->IsConnectedToPublisher(publisher_id)) {
+        continue;
+      }
+      // Lost it - fall through and connect again
+      publisher_id_to_transport_sub.erase(it);
     }
 
     // todo check if inproc pid is ours
@@ -41,17 +41,30 @@ void SubscriberBase::HandlePublisherInfo(const std::vector<PublisherInfo> &info)
       }
     }
 
-    /// @todo BASIS-12: this will arbitrarily pick a transport once we add another type
+    // Try each transport the publisher is reachable over, most preferred first, stopping at the first that connects.
+    // A transport may refuse (ie shared memory to a publisher on another host), in which case we fall through.
+    std::vector<std::pair<TransportSubscriber *, std::string_view>> candidates;
     for (auto &transport_subscriber : transport_subscribers) {
-      for (const auto &[pub_transport_name, pub_transport_endpoint] : publisher_info.transport_info) {
-        if (pub_transport_name == transport_subscriber->GetTransportName()) {
-          if (transport_subscriber->Connect("127.0.0.1", pub_transport_endpoint, publisher_id)) {
-            publisher_id_to_transport_sub.emplace(publisher_id, transport_subscriber.get());
-          }
-        }
+      auto it = publisher_info.transport_info.find(std::string(transport_subscriber->GetTransportName()));
+      if (it != publisher_info.transport_info.end()) {
+        candidates.emplace_back(transport_subscriber.get(), it->second);
+      }
+    }
+    std::stable_sort(candidates.begin(), candidates.end(), [](const auto &a, const auto &b) {
+      return a.first->GetPreference() > b.first->GetPreference();
+    });
+
+    bool publisher_connected = candidates.empty();
+    for (auto &[transport_subscriber, endpoint] : candidates) {
+      if (transport_subscriber->Connect("127.0.0.1", endpoint, publisher_id)) {
+        publisher_id_to_transport_sub.emplace(publisher_id, transport_subscriber);
+        publisher_connected = true;
+        break;
       }
     }
+    connected &= publisher_connected;
   }
+  return connected;
 }
 
 size_t SubscriberBase::GetPublisherCount() {
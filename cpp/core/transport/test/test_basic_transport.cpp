@@ -1,8 +1,10 @@
 #include <basis/core/threading/thread_pool.h>
+#include <basis/core/transport/async_publish_queue.h>
 #include <basis/core/transport/inproc.h>
 #include <basis/core/transport/transport_manager.h>
 
 #include <gtest/gtest.h>
+#include <spdlog/spdlog.h>
 #include <thread>
 using namespace basis::core::transport;
 
@@ -47,6 +49,43 @@ TEST(Inproc, PubSubWait) {
   GTEST_ASSERT_EQ(num_recv, 10);
 }
 
+TEST(Inproc, SubscribeWhilePublishing) {
+  InprocConnector<int> coordinator;
+  auto publisher = coordinator.Advertise("topic", nullptr);
+  ASSERT_FALSE(publisher->HasSubscribersFast());
+
+  std::atomic<bool> stop = false;
+  std::thread pub_thread([&]() {
+    while (!stop) {
+      publisher->Publish(std::make_shared<int>(0));
+    }
+  });
+
+  // Churn the subscriber list underneath the publisher
+  std::atomic<int> num_recv = 0;
+  for (int i = 0; i < 100; i++) {
+    auto subscriber =
+        coordinator.Subscribe("topic", [&num_recv](const MessageEvent<int> &) { num_recv++; }, nullptr);
+    std::this_thread::sleep_for(std::chrono::microseconds(100));
+  }
+
+  std::atomic<int> num_recv_kept = 0;
+  auto kept_subscriber =
+      coordinator.Subscribe("topic", [&num_recv_kept](const MessageEvent<int> &) { num_recv_kept++; }, nullptr);
+  ASSERT_TRUE(publisher->HasSubscribersFast());
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+  stop = true;
+  pub_thread.join();
+
+  ASSERT_GT(num_recv_kept, 0);
+
+  // Expired subscribers are never called again
+  const int final_num_recv = num_recv;
+  publisher->Publish(std::make_shared<int>(0));
+  ASSERT_EQ(num_recv, final_num_recv);
+}
+
 struct TestStruct {
   uint32_t foo = 3;
   float bar = 8.5;
@@ -68,4 +107,510 @@ TEST(TransportManager, Basic) {
 
   publisher->Publish(std::make_shared<TestStruct>());
   ASSERT_EQ(num_recv, 1);
-}
\ No newline at end of file
+}
+
+/**
+ * Counts messages sent to it, optionally sleeping to simulate a slow send.
+ */
+class CountingTransportPublisher : public TransportPublisher {
+public:
+  virtual void SendMessage(std::shared_ptr<MessagePacket>) override {
+    std::this_thread::sleep_for(send_delay);
+    num_sent++;
+  }
+  virtual std::string GetTransportName() override { return "counting"; }
+  virtual std::string GetConnectionInformation() override { return ""; }
+  virtual size_t GetSubscriberCount() override { return 1; }
+  virtual void SetMaxQueueSize(size_t) override {}
+
+  std::chrono::milliseconds send_delay{0};
+  std::atomic<int> num_sent = 0;
+};
+
+TEST(AsyncPublishQueue, DropPolicies) {
+  basis::core::threading::ThreadPool thread_pool(2);
+
+  for (auto policy : {AsyncPublishSettings::DropPolicy::DROP_OLDEST, AsyncPublishSettings::DropPolicy::DROP_NEWEST}) {
+    std::promise<void> gate;
+    std::shared_future<void> gate_future = gate.get_future().share();
+    std::vector<int> ran;
+    std::mutex ran_mutex;
+    {
+      AsyncPublishQueue queue(&thread_pool, {.max_pending = 2, .drop_policy = policy});
+      // Hold up the drain task so everything after the first push queues up
+      ASSERT_TRUE(queue.Push([gate_future] { gate_future.wait(); }));
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      for (int i = 0; i < 5; i++) {
+        queue.Push([i, &ran, &ran_mutex] {
+          std::lock_guard lock(ran_mutex);
+          ran.push_back(i);
+        });
+      }
+      ASSERT_EQ(queue.GetDroppedCount(), 3);
+      gate.set_value();
+
+      // The destructor drops anything still pending - give the pool a chance to drain first
+      for (int i = 0; i < 100; i++) {
+        {
+          std::lock_guard lock(ran_mutex);
+          if (ran.size() == 2) {
+            break;
+          }
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+    }
+    std::lock_guard lock(ran_mutex);
+    if (policy == AsyncPublishSettings::DropPolicy::DROP_OLDEST) {
+      ASSERT_EQ(ran, (std::vector<int>{3, 4}));
+    } else {
+      ASSERT_EQ(ran, (std::vector<int>{0, 1}));
+    }
+  }
+}
+
+TEST(AsyncPublishQueue, Block) {
+  basis::core::threading::ThreadPool thread_pool(2);
+  std::atomic<int> num_ran = 0;
+  {
+    AsyncPublishQueue queue(&thread_pool, {.max_pending = 1, .drop_policy = AsyncPublishSettings::DropPolicy::BLOCK});
+    for (int i = 0; i < 20; i++) {
+      ASSERT_TRUE(queue.Push([&num_ran] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        num_ran++;
+      }));
+    }
+    ASSERT_EQ(queue.GetDroppedCount(), 0);
+    // The publisher was held back - at most the running task and one pending are left
+    ASSERT_GE(num_ran, 18);
+  }
+}
+
+TEST(Publisher, AsyncPublish) {
+  basis::core::threading::ThreadPool thread_pool(2);
+  auto transport_publisher = std::make_shared<CountingTransportPublisher>();
+  transport_publisher->send_delay = std::chrono::milliseconds(20);
+
+  InprocConnector<TestStruct> inproc_connector;
+  std::atomic<int> num_inproc_recv = 0;
+  auto inproc_subscriber = inproc_connector.Subscribe(
+      "topic", [&num_inproc_recv](const MessageEvent<TestStruct> &) { num_inproc_recv++; }, nullptr);
+
+  Publisher<TestStruct> publisher(
+      "topic", basis::core::serialization::RawSerializer::DeduceMessageTypeInfo<TestStruct>(), {transport_publisher},
+      inproc_connector.Advertise("topic", nullptr),
+      basis::core::serialization::RawSerializer::GetSerializedSize<TestStruct>,
+      basis::core::serialization::RawSerializer::SerializeToSpan<TestStruct>);
+  publisher.EnableAsyncPublish(&thread_pool, {.max_pending = 100});
+
+  const auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < 5; i++) {
+    publisher.Publish(std::make_shared<TestStruct>());
+  }
+  // Publishing doesn't wait on the slow transport, but inproc is still delivered synchronously
+  ASSERT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(50));
+  ASSERT_EQ(num_inproc_recv, 5);
+
+  for (int i = 0; i < 100 && transport_publisher->num_sent < 5; i++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  ASSERT_EQ(transport_publisher->num_sent, 5);
+  ASSERT_EQ(publisher.GetAsyncDroppedCount(), 0);
+}
+
+/**
+ * Offers loaned packets, counting how many were handed out.
+ */
+class LoaningTransportPublisher : public CountingTransportPublisher {
+public:
+  virtual std::shared_ptr<MessagePacket> LoanPacket(uint32_t data_size) override {
+    num_loaned++;
+    return std::make_shared<MessagePacket>(MessageHeader::DataType::MESSAGE, data_size);
+  }
+  virtual size_t GetSubscriberCount() override { return subscriber_count; }
+
+  size_t subscriber_count = 1;
+  int num_loaned = 0;
+};
+
+class NullRecorder : public basis::RecorderInterface {
+public:
+  virtual bool Start(std::string_view) override { return true; }
+  virtual void Stop() override {}
+  virtual bool RegisterTopic(const std::string &, const basis::core::serialization::MessageTypeInfo &,
+                             const basis::core::serialization::MessageSchema &) override {
+    return true;
+  }
+  virtual bool WriteMessage(const std::string &, basis::OwningSpan, const basis::core::MonotonicTime &) override {
+    return true;
+  }
+};
+
+TEST(Publisher, LoanOnlyToSoleConsumer) {
+  auto lender = std::make_shared<LoaningTransportPublisher>();
+  auto other = std::make_shared<LoaningTransportPublisher>();
+  other->subscriber_count = 0;
+  const auto type_info = basis::core::serialization::RawSerializer::DeduceMessageTypeInfo<TestStruct>();
+
+  // Only the lender has subscribers - loan
+  PublisherRaw publisher("topic", type_info, {other, lender}, nullptr);
+  publisher.LoanPacket(16);
+  ASSERT_EQ(lender->num_loaned, 1);
+  ASSERT_EQ(other->num_loaned, 0);
+
+  // Another transport would hold onto the packet - don't loan
+  other->subscriber_count = 1;
+  publisher.LoanPacket(16);
+  ASSERT_EQ(lender->num_loaned + other->num_loaned, 1);
+
+  // Neither would the recorder
+  other->subscriber_count = 0;
+  NullRecorder recorder;
+  PublisherRaw recorded_publisher("topic", type_info, {other, lender}, &recorder);
+  recorded_publisher.LoanPacket(16);
+  ASSERT_EQ(lender->num_loaned, 1);
+}
+
+TEST(PacketPool, SizeClasses) {
+  ASSERT_EQ(PacketPool::GetSizeClass(0), 0);
+  ASSERT_EQ(PacketPool::GetSizeClass(1), 0);
+  ASSERT_EQ(PacketPool::GetSizeClass(256), 0);
+  ASSERT_EQ(PacketPool::GetSizeClass(257), 1);
+  ASSERT_EQ(PacketPool::GetSizeClass(512), 1);
+  ASSERT_EQ(PacketPool::GetSizeClassBytes(PacketPool::GetSizeClass(1000)), 1024);
+  ASSERT_EQ(PacketPool::GetSizeClass(PacketPool::GetSizeClassBytes(PacketPool::NUM_SIZE_CLASSES - 1) + 1),
+            PacketPool::UNPOOLED);
+}
+
+TEST(MessagePacket, BorrowedPayload) {
+  auto storage = std::make_shared<std::vector<std::byte>>(100);
+  std::weak_ptr<std::vector<std::byte>> weak_storage = storage;
+  auto packet = std::make_shared<MessagePacket>(MessageHeader::DataType::MESSAGE,
+                                                std::span<const std::byte>(*storage), std::move(storage));
+  ASSERT_FALSE(packet->IsContiguous());
+  ASSERT_EQ(packet->GetMessageHeader()->data_size, 100);
+  ASSERT_EQ(packet->GetPacketSize(), 100 + sizeof(MessageHeader));
+
+  // No copy made
+  ASSERT_EQ(packet->GetPayload().data(), weak_storage.lock()->data());
+  auto parts = packet->GetPacketParts();
+  ASSERT_EQ(parts[0].size(), sizeof(MessageHeader));
+  ASSERT_EQ(parts[1].data(), packet->GetPayload().data());
+
+  // Keeps its owner alive
+  ASSERT_FALSE(weak_storage.expired());
+  packet.reset();
+  ASSERT_TRUE(weak_storage.expired());
+
+  MessagePacket contiguous(MessageHeader::DataType::MESSAGE, 100);
+  ASSERT_TRUE(contiguous.IsContiguous());
+  ASSERT_EQ(contiguous.GetPacketParts()[0].data(), contiguous.GetPacket().data());
+  ASSERT_TRUE(contiguous.GetPacketParts()[1].empty());
+}
+
+TEST(PacketPool, Reuse) {
+  PacketPool &pool = PacketPool::Global();
+  pool.Trim();
+  const PacketPool::Stats start = pool.GetStats();
+  ASSERT_EQ(start.bytes_held, 0);
+
+  const std::byte *first_data = nullptr;
+  {
+    MessagePacket packet(MessageHeader::DataType::MESSAGE, 1000);
+    first_data = packet.GetPacket().data();
+  }
+  ASSERT_EQ(pool.GetStats().misses, start.misses + 1);
+  ASSERT_EQ(pool.GetStats().bytes_held, 1024);
+
+  // Same size class, same thread - should get the same buffer back
+  {
+    MessagePacket packet(MessageHeader::DataType::MESSAGE, 900);
+    ASSERT_EQ(packet.GetPacket().data(), first_data);
+    ASSERT_EQ(packet.GetPayload().size(), 900);
+  }
+  ASSERT_EQ(pool.GetStats().hits, start.hits + 1);
+  ASSERT_EQ(pool.GetStats().misses, start.misses + 1);
+
+  // Released on another thread, once that thread exits its cache spills into the shared list
+  auto packet = std::make_shared<MessagePacket>(MessageHeader::DataType::MESSAGE, 5000);
+  std::thread([packet = std::move(packet)]() mutable { packet.reset(); }).join();
+  ASSERT_EQ(pool.GetStats().bytes_held, 1024 + 8192);
+  {
+    MessagePacket from_shared(MessageHeader::DataType::MESSAGE, 5000);
+  }
+  ASSERT_EQ(pool.GetStats().hits, start.hits + 2);
+
+  // Larger than a thread's cache budget - released straight to the shared list, where another thread can reuse it
+  { MessagePacket large(MessageHeader::DataType::MESSAGE, PacketPool::THREAD_CACHE_BYTES * 2); }
+  std::thread([] { MessagePacket large(MessageHeader::DataType::MESSAGE, PacketPool::THREAD_CACHE_BYTES * 2); }).join();
+  ASSERT_EQ(pool.GetStats().hits, start.hits + 3);
+
+  // Too large to pool
+  { MessagePacket huge(MessageHeader::DataType::MESSAGE, 64 * 1024 * 1024); }
+  ASSERT_EQ(pool.GetStats().unpooled, start.unpooled + 1);
+
+  pool.Trim();
+  ASSERT_EQ(pool.GetStats().bytes_held, 0);
+}
+
+TEST(PacketPool, Limits) {
+  PacketPool &pool = PacketPool::Global();
+  pool.Trim();
+  const size_t default_limit = pool.GetSharedBytesLimit();
+  const size_t default_low_water = pool.GetSharedLowWaterBytes();
+  const PacketPool::Stats start = pool.GetStats();
+
+  // Four 8KB buffers spill into the shared lists when the thread exits, only two fit
+  pool.SetSharedBytesLimit(2 * 8192);
+  pool.SetSharedLowWaterBytes(8192);
+  std::thread([] {
+    std::vector<std::unique_ptr<MessagePacket>> packets;
+    for (int i = 0; i < 4; i++) {
+      packets.push_back(std::make_unique<MessagePacket>(MessageHeader::DataType::MESSAGE, 5000));
+    }
+  }).join();
+  ASSERT_EQ(pool.GetStats().bytes_held, 2 * 8192);
+
+  // Allocating from the shared lists holds off trimming
+  std::thread([] { MessagePacket packet(MessageHeader::DataType::MESSAGE, 5000); }).join();
+  const auto now = std::chrono::steady_clock::now();
+  ASSERT_EQ(pool.Update(now), 0);
+  ASSERT_EQ(pool.Update(now + PacketPool::IDLE_TRIM_INTERVAL / 2), 0);
+  ASSERT_EQ(pool.GetStats().bytes_held, 2 * 8192);
+
+  // Idle for long enough - trimmed down to the low water mark
+  ASSERT_EQ(pool.Update(now + PacketPool::IDLE_TRIM_INTERVAL), 8192);
+  ASSERT_EQ(pool.GetStats().bytes_held, 8192);
+  ASSERT_EQ(pool.GetStats().trimmed_bytes, start.trimmed_bytes + 8192);
+
+  // Lowering the limit frees immediately
+  pool.SetSharedBytesLimit(0);
+  ASSERT_EQ(pool.GetStats().bytes_held, 0);
+
+  pool.SetSharedBytesLimit(default_limit);
+  pool.SetSharedLowWaterBytes(default_low_water);
+}
+
+/**
+ * Counts connection attempts - ie how many publishers a subscriber was told about. Never connects, so that every
+ * notification is counted.
+ */
+class CountingTransportSubscriber : public TransportSubscriber {
+public:
+  CountingTransportSubscriber() : TransportSubscriber("counting") {}
+  virtual bool Connect(std::string_view, std::string_view, __uint128_t) override {
+    num_connects++;
+    return false;
+  }
+  virtual size_t GetPublisherCount() override { return 0; }
+
+  int num_connects = 0;
+};
+
+struct TopicRegistryFixture {
+  TopicRegistryFixture(int topic_count, int publishers_per_topic) {
+    for (int t = 0; t < topic_count; t++) {
+      const std::string topic = "/topic_" + std::to_string(t);
+      auto transport_subscriber = std::make_shared<CountingTransportSubscriber>();
+      transport_subscribers.push_back(transport_subscriber);
+      subscribers.push_back(std::make_shared<SubscriberBase>(
+          topic, basis::core::serialization::MessageTypeInfo{},
+          std::vector<std::shared_ptr<TransportSubscriber>>{transport_subscriber}, false));
+      subscribers_by_topic.emplace(topic, subscribers.back());
+
+      auto &publishers = (*network_info.mutable_publishers_by_topic())[topic];
+      for (int p = 0; p < publishers_per_topic; p++) {
+        PublisherInfo info;
+        info.publisher_id = CreatePublisherId();
+        info.topic = topic;
+        info.schema_id = "raw:TestStruct";
+        info.transport_info["counting"] = std::to_string(p);
+        *publishers.add_publishers() = info.ToProto();
+      }
+    }
+  }
+
+  int TotalConnects() const {
+    int total = 0;
+    for (auto &transport_subscriber : transport_subscribers) {
+      total += transport_subscriber->num_connects;
+    }
+    return total;
+  }
+
+  proto::NetworkInfo network_info;
+  std::vector<std::shared_ptr<CountingTransportSubscriber>> transport_subscribers;
+  std::vector<std::shared_ptr<SubscriberBase>> subscribers;
+  std::unordered_multimap<std::string, std::weak_ptr<SubscriberBase>> subscribers_by_topic;
+
+  void Register(TopicRegistry &registry) {
+    for (auto &[topic, subscriber] : subscribers_by_topic) {
+      registry.AddSubscriber(topic, subscriber);
+    }
+  }
+};
+
+TEST(TopicRegistry, OnlyChangedTopics) {
+  TopicRegistryFixture fixture(3, 2);
+  TopicRegistry registry;
+  fixture.Register(registry);
+
+  ASSERT_EQ(registry.HandleNetworkInfo(fixture.network_info), 3);
+  ASSERT_EQ(fixture.TotalConnects(), 6);
+
+  // Nothing changed
+  ASSERT_EQ(registry.HandleNetworkInfo(fixture.network_info), 0);
+  ASSERT_EQ(fixture.TotalConnects(), 6);
+
+  // A changed endpoint only notifies that topic's subscriber
+  auto &topic_1 = (*fixture.network_info.mutable_publishers_by_topic())["/topic_1"];
+  (*topic_1.mutable_publishers(0)->mutable_transport_info())["counting"] = "changed";
+  ASSERT_EQ(registry.HandleNetworkInfo(fixture.network_info), 1);
+  ASSERT_EQ(fixture.transport_subscribers[0]->num_connects, 2);
+  ASSERT_EQ(fixture.transport_subscribers[1]->num_connects, 4);
+  ASSERT_EQ(registry.GetNetworkPublishers("/topic_1")[0].transport_info.at("counting"), "changed");
+
+  // A topic that disappears is forgotten
+  fixture.network_info.mutable_publishers_by_topic()->erase("/topic_2");
+  ASSERT_EQ(registry.HandleNetworkInfo(fixture.network_info), 1);
+  ASSERT_TRUE(registry.GetNetworkPublishers("/topic_2").empty());
+
+  // ...along with its subscriber, once gone
+  fixture.subscribers[2].reset();
+  fixture.network_info.mutable_publishers_by_topic()->erase("/topic_1");
+  registry.HandleNetworkInfo(fixture.network_info);
+  ASSERT_EQ(registry.Find("/topic_2"), nullptr);
+  ASSERT_NE(registry.Find("/topic_1"), nullptr);
+}
+
+/**
+ * Refuses the first `failures` connection attempts, as a TCP publisher that isn't accepting yet would.
+ */
+class FlakyTransportSubscriber : public TransportSubscriber {
+public:
+  FlakyTransportSubscriber(int failures) : TransportSubscriber("flaky"), failures(failures) {}
+  virtual bool Connect(std::string_view, std::string_view, __uint128_t) override {
+    num_connects++;
+    connected = num_connects > failures;
+    return connected;
+  }
+  virtual size_t GetPublisherCount() override { return connected; }
+
+  const int failures;
+  int num_connects = 0;
+  bool connected = false;
+};
+
+class FlakyTransport : public Transport {
+public:
+  FlakyTransport(std::shared_ptr<FlakyTransportSubscriber> transport_subscriber)
+      : transport_subscriber(std::move(transport_subscriber)) {}
+
+  virtual std::shared_ptr<TransportPublisher> Advertise(std::string_view,
+                                                        basis::core::serialization::MessageTypeInfo) override {
+    return nullptr;
+  }
+  virtual std::shared_ptr<TransportSubscriber> Subscribe(std::string_view, TypeErasedSubscriberCallback,
+                                                         basis::core::threading::ThreadPool *,
+                                                         basis::core::serialization::MessageTypeInfo) override {
+    return transport_subscriber;
+  }
+
+  std::shared_ptr<FlakyTransportSubscriber> transport_subscriber;
+};
+
+TEST(TopicRegistry, RetryUnconnected) {
+  auto transport_subscriber = std::make_shared<FlakyTransportSubscriber>(2);
+  TransportManager transport_manager(nullptr);
+  transport_manager.RegisterTransport("flaky", std::make_unique<FlakyTransport>(transport_subscriber));
+
+  basis::core::threading::ThreadPool work_thread_pool(1);
+  auto subscriber = transport_manager.Subscribe<TestStruct, basis::core::serialization::RawSerializer>(
+      "/flaky", [](std::shared_ptr<const TestStruct>) {}, &work_thread_pool);
+
+  PublisherInfo info;
+  info.publisher_id = CreatePublisherId();
+  info.topic = "/flaky";
+  info.schema_id = "raw:TestStruct";
+  info.transport_info["flaky"] = "endpoint";
+  proto::NetworkInfo network_info;
+  network_info.set_version(1);
+  *(*network_info.mutable_publishers_by_topic())["/flaky"].add_publishers() = info.ToProto();
+
+  const auto now = std::chrono::steady_clock::now();
+  ASSERT_EQ(transport_manager.HandleNetworkInfo(network_info, now), 1);
+  ASSERT_EQ(transport_subscriber->num_connects, 1);
+
+  // The same NetworkInfo again - nothing changed, but the failed connection is retried
+  ASSERT_EQ(transport_manager.HandleNetworkInfo(network_info, now), 0);
+  ASSERT_EQ(transport_subscriber->num_connects, 2);
+
+  // ...no more often than the retry interval
+  transport_manager.HandleNetworkInfo(network_info, now);
+  ASSERT_EQ(transport_subscriber->num_connects, 2);
+
+  transport_manager.HandleNetworkInfo(network_info, now + TransportManager::CONNECT_RETRY_INTERVAL);
+  ASSERT_EQ(transport_subscriber->num_connects, 3);
+  ASSERT_EQ(subscriber->GetPublisherCount(), 1);
+
+  // Connected - nothing left to retry
+  transport_manager.HandleNetworkInfo(network_info, now + 2 * TransportManager::CONNECT_RETRY_INTERVAL);
+  ASSERT_EQ(transport_subscriber->num_connects, 3);
+}
+
+/**
+ * 10k publishers over 1k topics, with one publisher changing per update.
+ */
+TEST(TopicRegistry, Benchmark) {
+  constexpr int TOPIC_COUNT = 1000;
+  constexpr int PUBLISHERS_PER_TOPIC = 10;
+  constexpr int UPDATE_COUNT = 100;
+
+  auto run = [&](const char *name, auto &&handle_network_info) {
+    TopicRegistryFixture fixture(TOPIC_COUNT, PUBLISHERS_PER_TOPIC);
+    handle_network_info(fixture, fixture.network_info);
+    const int initial_connects = fixture.TotalConnects();
+
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < UPDATE_COUNT; i++) {
+      auto &topic = (*fixture.network_info.mutable_publishers_by_topic())["/topic_" + std::to_string(i)];
+      (*topic.mutable_publishers(0)->mutable_transport_info())["counting"] = "changed";
+      handle_network_info(fixture, fixture.network_info);
+    }
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    spdlog::info("{}: {} updates of {} publishers in {:.3f}s - {:.1f}us per update, {} publishers handed to subscribers",
+                 name, UPDATE_COUNT, TOPIC_COUNT * PUBLISHERS_PER_TOPIC, elapsed.count(),
+                 elapsed.count() * 1e6 / UPDATE_COUNT, fixture.TotalConnects() - initial_connects);
+    return fixture.TotalConnects() - initial_connects;
+  };
+
+  // What HandleNetworkInfo used to do - rebuild every topic, notify every subscriber
+  const int rebuild_connects = run("rebuild all", [](TopicRegistryFixture &fixture, const proto::NetworkInfo &info) {
+    std::unordered_map<std::string, std::vector<PublisherInfo>> last_network_publish_info;
+    for (auto &[topic, publisher_infos_msg] : info.publishers_by_topic()) {
+      std::vector<PublisherInfo> &publishers = last_network_publish_info[topic];
+      for (auto &publisher_info : publisher_infos_msg.publishers()) {
+        publishers.emplace_back(PublisherInfo::FromProto(publisher_info));
+      }
+      for (auto [it, end] = fixture.subscribers_by_topic.equal_range(topic); it != end; it++) {
+        if (auto subscriber = it->second.lock()) {
+          subscriber->HandlePublisherInfo(publishers);
+        }
+      }
+    }
+  });
+
+  TopicRegistry registry;
+  bool registered = false;
+  const int registry_connects =
+      run("topic registry", [&](TopicRegistryFixture &fixture, const proto::NetworkInfo &info) {
+        if (!registered) {
+          fixture.Register(registry);
+          registered = true;
+        }
+        registry.HandleNetworkInfo(info);
+      });
+
+  ASSERT_EQ(registry_connects, UPDATE_COUNT * PUBLISHERS_PER_TOPIC);
+  ASSERT_EQ(rebuild_connects, UPDATE_COUNT * TOPIC_COUNT * PUBLISHERS_PER_TOPIC);
+}
@@ -14,6 +14,7 @@
 #include <basis/arguments/command_line.h>
 
 #include <basis/recorder/glob.h>
+#include <basis/recorder/options.h>
 
 namespace basis::launch {
 
@@ -36,6 +37,11 @@ struct RecordingSettings {
   // <regex_str, regex>
   std::vector<std::pair<std::string, std::regex>> patterns;
   std::filesystem::path directory;
+  recorder::RecorderOptions options;
+  /// Only used when async
+  recorder::AsyncRecorderOptions async_options;
+  /// Set to only write out snapshots around triggers, see SnapshotRecorder
+  std::optional<recorder::SnapshotRecorderOptions> snapshot_options;
   bool operator==(const RecordingSettings &other) const {
 
     if (patterns.size() != other.patterns.size()) {
@@ -46,7 +52,8 @@ struct RecordingSettings {
         return false;
       }
     }
-    return other.async == async && other.name == name && other.directory == directory;
+    return other.async == async && other.name == name && other.directory == directory && other.options == options &&
+           other.async_options == async_options && other.snapshot_options == snapshot_options;
   }
 };
 
@@ -69,7 +76,10 @@ struct LaunchDefinitionDebugFormatter {
 std::string LaunchDefinitionToDebugString(const LaunchDefinition &launch, LaunchDefinitionDebugFormatter& formatter);
 std::string ProcessDefinitionToDebugString(std::string_view process_name, const ProcessDefinition &process, LaunchDefinitionDebugFormatter& formatter);
 
-RecordingSettings ParseRecordingSettingsYAML(const YAML::Node &yaml);
+/**
+ * @return nullopt if the settings ask for something unknown (ie a compression that doesn't exist)
+ */
+std::optional<RecordingSettings> ParseRecordingSettingsYAML(const YAML::Node &yaml);
 
 struct LaunchContext {
   bool sim = false;
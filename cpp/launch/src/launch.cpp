@@ -9,6 +9,7 @@
 #include <basis/recorder.h>
 #include <basis/recorder/glob.h>
 #include <basis/recorder/protobuf_log.h>
+#include <basis/recorder/snapshot_recorder.h>
 #include <basis/unit.h>
 
 #include <google/protobuf/wrappers.pb.h>
@@ -265,11 +266,24 @@ void LaunchProcessDefinition(const ProcessDefinition &process_definition,
     std::unique_ptr<basis::RecorderInterface> recorder;
     if (recording_settings && recording_settings->patterns.size()) {
       std::string recorder_type;
-      if (recording_settings->async) {
+      const bool compressed = recording_settings->options.compression != basis::recorder::Compression::None;
+      if (!recording_settings->async && compressed) {
+        // Compressing synchronously would stall whichever publisher happened to fill the chunk
+        BASIS_LOG_WARN("Recording with compression - ignoring async: false");
+      }
+      if (recording_settings->snapshot_options) {
+        recorder_type = " (snapshots)";
+        recorder = std::make_unique<basis::SnapshotRecorder>(recording_settings->directory, recording_settings->patterns,
+                                                             *recording_settings->snapshot_options,
+                                                             recording_settings->options);
+      } else if (recording_settings->async || compressed) {
         recorder_type = " (async)";
-        recorder = std::make_unique<basis::AsyncRecorder>(recording_settings->directory, recording_settings->patterns);
+        recorder = std::make_unique<basis::AsyncRecorder>(recording_settings->directory, recording_settings->patterns,
+                                                          recording_settings->async_options,
+                                                          recording_settings->options);
       } else {
-        recorder = std::make_unique<basis::Recorder>(recording_settings->directory, recording_settings->patterns);
+        recorder = std::make_unique<basis::Recorder>(recording_settings->directory, recording_settings->patterns,
+                                                     recording_settings->options);
       }
 
       std::string record_name =
@@ -58,7 +58,7 @@ std::string ProcessDefinitionToDebugString(std::string_view process_name, const
 }
 constexpr int MAX_LAUNCH_INCLUDE_DEPTH = 32;
 
-[[nodiscard]] RecordingSettings ParseRecordingSettingsYAML(const YAML::Node &yaml) {
+[[nodiscard]] std::optional<RecordingSettings> ParseRecordingSettingsYAML(const YAML::Node &yaml) {
   RecordingSettings settings;
 
   if (yaml["directory"]) {
@@ -77,6 +77,85 @@ constexpr int MAX_LAUNCH_INCLUDE_DEPTH = 32;
     settings.name = yaml["name"].as<std::string>();
   }
 
+  if (yaml["chunk_size"]) {
+    settings.options.chunk_size = yaml["chunk_size"].as<uint64_t>();
+  }
+
+  if (yaml["compression"]) {
+    const std::string compression = yaml["compression"].as<std::string>();
+    if (auto parsed = recorder::CompressionFromString(compression)) {
+      settings.options.compression = *parsed;
+    } else {
+      BASIS_LOG_FATAL("Unknown recording compression '{}' (expected none, lz4, or zstd)", compression);
+      return {};
+    }
+  }
+
+  if (yaml["compression_level"]) {
+    const std::string level = yaml["compression_level"].as<std::string>();
+    if (auto parsed = recorder::CompressionLevelFromString(level)) {
+      settings.options.compression_level = *parsed;
+    } else {
+      BASIS_LOG_FATAL("Unknown recording compression_level '{}' (expected fastest, fast, default, slow, or slowest)",
+                      level);
+      return {};
+    }
+  }
+
+  if (yaml["chunk_indexing"]) {
+    settings.options.chunk_indexing = yaml["chunk_indexing"].as<bool>();
+  }
+
+  if (yaml["segment_max_bytes"]) {
+    settings.options.segment_max_bytes = yaml["segment_max_bytes"].as<uint64_t>();
+  }
+  if (yaml["segment_max_duration"]) {
+    settings.options.segment_max_duration = core::Duration::FromSeconds(yaml["segment_max_duration"].as<double>());
+  }
+  if (yaml["max_segments"]) {
+    settings.options.max_segments = yaml["max_segments"].as<size_t>();
+  }
+
+  if (const YAML::Node &queue = yaml["queue"]) {
+    if (queue["max_bytes"]) {
+      settings.async_options.max_queue_bytes = queue["max_bytes"].as<uint64_t>();
+    }
+    if (queue["max_messages"]) {
+      settings.async_options.max_queue_messages = queue["max_messages"].as<uint64_t>();
+    }
+    if (queue["overflow"]) {
+      const std::string overflow = queue["overflow"].as<std::string>();
+      if (auto parsed = recorder::OverflowPolicyFromString(overflow)) {
+        settings.async_options.overflow_policy = *parsed;
+      } else {
+        BASIS_LOG_FATAL("Unknown recording queue overflow '{}' (expected block, drop_oldest, drop_newest, or priority)",
+                        overflow);
+        return {};
+      }
+    }
+    for (const auto &priority_yaml : queue["priorities"]) {
+      auto [pattern, regex] = glob::GlobToRegex(priority_yaml.first.as<std::string>());
+      settings.async_options.topic_priorities.push_back(
+          {.pattern = std::move(pattern), .regex = std::move(regex), .priority = priority_yaml.second.as<int>()});
+    }
+  }
+
+  if (const YAML::Node &snapshot = yaml["snapshot"]) {
+    recorder::SnapshotRecorderOptions &snapshot_options = settings.snapshot_options.emplace();
+    if (snapshot["pre_trigger"]) {
+      snapshot_options.pre_trigger_duration = core::Duration::FromSeconds(snapshot["pre_trigger"].as<double>());
+    }
+    if (snapshot["post_trigger"]) {
+      snapshot_options.post_trigger_duration = core::Duration::FromSeconds(snapshot["post_trigger"].as<double>());
+    }
+    if (snapshot["max_bytes"]) {
+      snapshot_options.max_buffer_bytes = snapshot["max_bytes"].as<uint64_t>();
+    }
+    if (snapshot["trigger_topic"]) {
+      snapshot_options.trigger_topic = snapshot["trigger_topic"].as<std::string>();
+    }
+  }
+
   return settings;
 }
 
@@ -456,6 +535,9 @@ ParseLaunchDefinitionYAML(const YAML::Node &yaml, const CurrentLaunchParseState
 
   if (yaml["recording"]) {
     launch.recording_settings = ParseRecordingSettingsYAML(yaml["recording"]);
+    if (!launch.recording_settings) {
+      return {};
+    }
   }
   return launch;
 }
@@ -171,5 +171,84 @@ TEST(TestLaunchDefinition, TestIncludes) {
   }
 }
 
+TEST(TestLaunchDefinition, RecordingOptions) {
+  auto defaults = ParseRecordingSettingsYAML(YAML::Load(R"(
+topics:
+  - /log
+)"));
+  ASSERT_TRUE(defaults);
+  ASSERT_EQ(defaults->options, basis::recorder::RecorderOptions{});
+
+  auto settings = ParseRecordingSettingsYAML(YAML::Load(R"(
+topics:
+  - /camera/*
+chunk_size: 4194304
+compression: zstd
+compression_level: fast
+chunk_indexing: false
+segment_max_bytes: 536870912
+segment_max_duration: 60
+max_segments: 10
+queue:
+  max_bytes: 1048576
+  overflow: priority
+  priorities:
+    /camera/*: -1
+    /log: 10
+)"));
+  ASSERT_TRUE(settings);
+  ASSERT_EQ(settings->options.chunk_size, 4194304u);
+  ASSERT_EQ(settings->options.compression, basis::recorder::Compression::Zstd);
+  ASSERT_EQ(settings->options.compression_level, basis::recorder::CompressionLevel::Fast);
+  ASSERT_FALSE(settings->options.chunk_indexing);
+  ASSERT_EQ(settings->options.segment_max_bytes, 536870912u);
+  ASSERT_EQ(settings->options.segment_max_duration, basis::core::Duration::FromSeconds(60));
+  ASSERT_EQ(settings->options.max_segments, 10u);
+  ASSERT_TRUE(settings->options.IsSegmented());
+  ASSERT_EQ(settings->async_options.max_queue_bytes, 1048576u);
+  ASSERT_EQ(settings->async_options.overflow_policy, basis::recorder::OverflowPolicy::DropLowestPriority);
+  ASSERT_EQ(settings->async_options.topic_priorities.size(), 2u);
+  ASSERT_TRUE(std::regex_match("/camera/rgb", settings->async_options.topic_priorities[0].regex));
+  ASSERT_EQ(settings->async_options.topic_priorities[0].priority, -1);
+  ASSERT_EQ(settings->async_options.topic_priorities[1].priority, 10);
+
+  ASSERT_FALSE(settings->snapshot_options);
+
+  auto snapshot = ParseRecordingSettingsYAML(YAML::Load(R"(
+topics:
+  - /camera/*
+snapshot:
+  pre_trigger: 20
+  post_trigger: 5.5
+  trigger_topic: /incident
+)"));
+  ASSERT_TRUE(snapshot);
+  ASSERT_TRUE(snapshot->snapshot_options);
+  ASSERT_EQ(snapshot->snapshot_options->pre_trigger_duration, basis::core::Duration::FromSeconds(20));
+  ASSERT_EQ(snapshot->snapshot_options->post_trigger_duration, basis::core::Duration::FromSeconds(5.5));
+  ASSERT_EQ(snapshot->snapshot_options->max_buffer_bytes, basis::recorder::SnapshotRecorderOptions{}.max_buffer_bytes);
+  ASSERT_EQ(snapshot->snapshot_options->trigger_topic, "/incident");
+
+  // Unknown values fail the launch, rather than quietly recording something else
+  ASSERT_FALSE(ParseRecordingSettingsYAML(YAML::Load(R"(
+compression: brotli
+)")));
+  ASSERT_FALSE(ParseRecordingSettingsYAML(YAML::Load(R"(
+compression: zstd
+compression_level: fastish
+)")));
+  ASSERT_FALSE(ParseRecordingSettingsYAML(YAML::Load(R"(
+queue:
+  overflow: drop_everything
+)")));
+  ASSERT_FALSE(ParseTemplatedLaunchDefinitionYAMLContents(R"(
+recording:
+  topics:
+    - /log
+  compression: brotli
+)",
+                                                          {}, default_parse_state));
+}
+
 // TODO: there are a number of edge cases we should test here (that were hand tested instead), work more at filling them
 // out
\ No newline at end of file
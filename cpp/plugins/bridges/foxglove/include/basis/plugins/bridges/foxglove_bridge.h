@@ -2,6 +2,7 @@
 
 #include <nonstd/expected.hpp>
 
+#include <basis/core/schema_cache.h>
 #include <basis/unit.h>
 
 #include <foxglove/websocket/websocket_server.hpp>
@@ -31,6 +32,7 @@ private:
     std::string topic;
     std::string schema_serializer;
     std::string schema;
+    std::string schema_hash_id;
   };
 
   void init(const std::string &address = "0.0.0.0", int port = 8765);
@@ -61,6 +63,9 @@ private:
   PublicationsByClient clientAdvertisedTopics;
 
   std::vector<std::regex> topicWhitelistPatterns = {std::regex(".*")};
+
+  /// Lets topics with a known schema be advertised without waiting on the coordinator
+  core::transport::SchemaCache schemaCache;
 };
 
 } // namespace basis::plugins::bridges::foxglove
\ No newline at end of file
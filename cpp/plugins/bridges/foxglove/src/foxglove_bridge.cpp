@@ -326,7 +326,8 @@ void FoxgloveBridge::updateAdvertisedTopics() {
       if (::foxglove::isWhitelisted(topic_name, topicWhitelistPatterns)) {
         std::string schema = publishers.publishers(0).schema_id();
         auto [serializer, schema_name] = split_serializer_and_schema(schema);
-        const TopicAndDatatype topicAndDatatype = {topic_name, serializer, schema_name};
+        const TopicAndDatatype topicAndDatatype = {topic_name, serializer, schema_name,
+                                                   publishers.publishers(0).schema_hash_id()};
         latestTopics.push_back(topicAndDatatype);
       }
     }
@@ -387,7 +388,14 @@ void FoxgloveBridge::updateAdvertisedTopics() {
     }
 
     const std::string schemaId = topicAndDatatype.schema_serializer + ":" + topicAndDatatype.schema;
-    const auto msgDescription = coordinator_connector->TryGetSchema(schemaId);
+    std::optional<core::transport::proto::MessageSchema> msgDescription =
+        schemaCache.Get(schemaId, topicAndDatatype.schema_hash_id);
+    if (!msgDescription) {
+      if (const auto *fetched = coordinator_connector->TryGetSchema(schemaId)) {
+        msgDescription = *fetched;
+        schemaCache.Add(*fetched);
+      }
+    }
 
     if (!msgDescription) {
       BASIS_LOG_INFO("Could not find definition for type {}, requesting from Coordinator...", topicAndDatatype.schema);
@@ -111,6 +111,7 @@ public:
     // schema.schema = msg.SerializeAsString();
     schema.schema_efficient = msg.SerializeAsString();
     google::protobuf::TextFormat::PrintToString(msg, &schema.schema);
+    schema.hash_id = basis::core::serialization::HashSchemaContent(schema.schema_efficient);
     // schema.human_readable = msg.DebugString();
     return schema;
   }
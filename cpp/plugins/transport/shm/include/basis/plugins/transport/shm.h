@@ -0,0 +1,215 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+#include <basis/core/transport/publisher.h>
+#include <basis/core/transport/subscriber.h>
+#include <basis/core/transport/transport.h>
+
+#include "shm_segment.h"
+#include "shm_transport_name.h"
+
+class TestShmTransport;
+
+namespace basis::plugins::transport {
+
+constexpr uint32_t SHM_DEFAULT_SLOT_COUNT = 16;
+constexpr size_t SHM_DEFAULT_SLOT_SIZE = 64 * 1024;
+/// How often an idle subscriber checks that the publisher is still alive, and the publisher its subscribers
+constexpr std::chrono::milliseconds SHM_LIVENESS_CHECK_INTERVAL{1000};
+/// Slots at least double in size with every generation, so no publisher gets further than this past any generation
+constexpr uint32_t SHM_MAX_GENERATIONS = 64;
+/// Longest a subscriber waits between attempts to attach to its publisher's next generation
+constexpr std::chrono::milliseconds SHM_ATTACH_RETRY_MAX_DELAY{100};
+
+/**
+ * Publishes serialized messages into a shared memory ring, for subscribers on the same host.
+ *
+ * The connection information is "<hostname>/<segment name>". Slots have a fixed size - if a message doesn't fit,
+ * the publisher creates the next "generation" of the segment with larger slots and marks the old one as superseded.
+ * Subscribers follow along on their own.
+ *
+ * Every SHM_LIVENESS_CHECK_INTERVAL, the publisher releases whatever subscribers that have crashed left pinned. The
+ * first publisher in a process also unlinks segments left behind by publishers that crashed.
+ */
+class ShmPublisher : public core::transport::TransportPublisher {
+public:
+  /**
+   * Returns nullptr if shared memory is unavailable.
+   */
+  static std::shared_ptr<ShmPublisher> Create(uint32_t slot_count = SHM_DEFAULT_SLOT_COUNT,
+                                              size_t slot_size = SHM_DEFAULT_SLOT_SIZE);
+
+  virtual std::string GetTransportName() override { return SHM_TRANSPORT_NAME; }
+
+  virtual std::string GetConnectionInformation() override;
+
+  /**
+   * The depth of the ring is fixed at creation, there's no per subscriber queue to limit.
+   */
+  virtual void SetMaxQueueSize([[maybe_unused]] size_t max_queue_size) override {}
+
+  virtual void SendMessage(std::shared_ptr<core::transport::MessagePacket> message) override;
+
+  /**
+   * Hands out a slot in the segment directly, growing it first if needed. Sending the packet back through
+   * SendMessage() publishes it without a copy.
+   */
+  virtual std::shared_ptr<core::transport::MessagePacket> LoanPacket(uint32_t data_size) override;
+
+  virtual size_t GetSubscriberCount() override;
+
+  static std::string GetSegmentName(std::string_view base_name, uint32_t generation);
+
+protected:
+  friend class ::TestShmTransport;
+
+  ShmPublisher(std::string base_name, uint32_t slot_count, std::shared_ptr<ShmSegment> segment)
+      : base_name(std::move(base_name)), slot_count(slot_count), segment(std::move(segment)) {}
+
+  /**
+   * Replace the current segment with one that can hold `packet_size`.
+   */
+  bool Grow(size_t packet_size);
+
+  /**
+   * Forget the oldest previous generations, once nobody is left on them.
+   */
+  void DropUnusedGenerations();
+
+  /**
+   * Reclaim crashed subscribers from every generation, if SHM_LIVENESS_CHECK_INTERVAL has passed since the last check.
+   */
+  void CheckSubscribers();
+
+  const std::string base_name;
+  const uint32_t slot_count;
+
+  std::mutex segment_mutex;
+  uint32_t generation = 0;
+  std::shared_ptr<ShmSegment> segment;
+  /**
+   * Older generations, oldest first. Each is kept alive (and linked) while a subscriber is still on it or on an older
+   * one, so that slow subscribers can always find the generation after theirs.
+   */
+  std::deque<std::shared_ptr<ShmSegment>> previous_segments;
+  std::chrono::steady_clock::time_point last_liveness_check = std::chrono::steady_clock::now();
+};
+
+/**
+ * Receives messages from one or more ShmPublishers. Each connected publisher gets a thread that sleeps on the segment's
+ * futex and hands out MessagePackets that point directly into shared memory. The thread follows its publisher from
+ * generation to generation on its own, retrying with backoff while the next one can't be attached to, and exits once
+ * the publisher closes the segment or dies.
+ */
+class ShmSubscriber : public core::transport::TransportSubscriber {
+public:
+  static std::shared_ptr<ShmSubscriber> Create(std::string_view topic_name,
+                                               core::transport::TypeErasedSubscriberCallback callback) {
+    return std::shared_ptr<ShmSubscriber>(new ShmSubscriber(topic_name, std::move(callback)));
+  }
+
+  ~ShmSubscriber() override;
+
+  /**
+   * Connect to a publisher. Fails if the publisher is on another host or no longer alive.
+   */
+  virtual bool Connect(std::string_view host, std::string_view endpoint, __uint128_t publisher_id) override;
+
+  virtual size_t GetPublisherCount() override {
+    std::lock_guard lock(receivers_mutex);
+    size_t count = 0;
+    for (auto &[_, receiver] : receivers) {
+      count += !receiver->finished;
+    }
+    return count;
+  }
+
+  /**
+   * False if the receiver for `publisher_id` has lost its publisher (or never existed), so that it's connected again
+   * on the next publisher update or retry.
+   */
+  virtual bool IsConnectedToPublisher(__uint128_t publisher_id) override {
+    std::lock_guard lock(receivers_mutex);
+    for (auto &[_, receiver] : receivers) {
+      if (receiver->publisher_id == publisher_id) {
+        return !receiver->finished;
+      }
+    }
+    return false;
+  }
+
+  /**
+   * Zero copy, prefer over any network transport.
+   */
+  virtual int GetPreference() const override { return 100; }
+
+protected:
+  friend class ::TestShmTransport;
+
+  ShmSubscriber(std::string_view topic_name, core::transport::TypeErasedSubscriberCallback callback)
+      : core::transport::TransportSubscriber(SHM_TRANSPORT_NAME), topic_name(topic_name),
+        callback(std::move(callback)) {}
+
+  struct Receiver {
+    std::string base_name;
+    __uint128_t publisher_id = 0;
+    std::atomic<bool> stop = false;
+    /// Set by the thread once it exits on its own (publisher gone), the receiver is replaced on the next Connect()
+    std::atomic<bool> finished = false;
+    std::thread thread;
+  };
+
+  /**
+   * Open `generation` of a publisher's segment or, if the publisher has already dropped it, the oldest generation after
+   * it still around. `generation` is updated to the one opened.
+   *
+   * @return nullptr if the publisher is gone
+   */
+  static std::shared_ptr<ShmSegment> OpenGeneration(std::string_view base_name, uint32_t &generation);
+
+  /**
+   * Delivers everything after `last_sequence`, which is read in Connect() so that messages sent right after
+   * connecting aren't missed.
+   */
+  void ReceiveThread(Receiver *receiver, std::shared_ptr<ShmReader> reader, uint32_t generation,
+                     uint64_t last_sequence);
+
+  std::string topic_name;
+  core::transport::TypeErasedSubscriberCallback callback;
+
+  std::mutex receivers_mutex;
+  std::unordered_map<std::string, std::unique_ptr<Receiver>> receivers;
+};
+
+class ShmTransport : public core::transport::Transport {
+public:
+  ShmTransport() {}
+
+  /**
+   * Returns nullptr (and the topic won't be advertised over shared memory) if a segment can't be created.
+   */
+  virtual std::shared_ptr<basis::core::transport::TransportPublisher>
+  Advertise([[maybe_unused]] std::string_view topic,
+            [[maybe_unused]] core::serialization::MessageTypeInfo type_info) override {
+    return ShmPublisher::Create();
+  }
+
+  virtual std::shared_ptr<basis::core::transport::TransportSubscriber>
+  Subscribe(std::string_view topic, core::transport::TypeErasedSubscriberCallback callback,
+            [[maybe_unused]] basis::core::threading::ThreadPool *work_thread_pool,
+            [[maybe_unused]] core::serialization::MessageTypeInfo type_info) override {
+    // Callbacks are run directly on the receive thread to preserve ordering - the callback is typically either a
+    // deserialize or a push onto a unit's queue
+    return ShmSubscriber::Create(topic, std::move(callback));
+  }
+};
+
+} // namespace basis::plugins::transport
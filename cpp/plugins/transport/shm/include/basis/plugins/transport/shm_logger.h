@@ -0,0 +1,4 @@
+#pragma once
+#include <basis/core/logging/macros.h>
+
+DEFINE_AUTO_LOGGER_PLUGIN(transport, shm)
@@ -0,0 +1,254 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <basis/core/transport/message_packet.h>
+
+namespace basis::plugins::transport {
+
+/// Subscribers that can be attached to one segment at a time, each owns a bit of ShmSlotHeader::readers
+constexpr uint32_t SHM_MAX_SUBSCRIBERS = 63;
+/// Pin held by the publisher on a slot it has loaned out
+constexpr uint64_t SHM_WRITER_PIN = uint64_t(1) << SHM_MAX_SUBSCRIBERS;
+
+/**
+ * Control block living at the start of every shared memory segment.
+ *
+ * Everything in here is shared between processes - only lock free atomics and plain data are allowed.
+ *
+ * Liveness isn't tracked in here, but with open file description locks on the segment: the publisher holds byte 0 and
+ * the subscriber at index i byte i + 1 (see ShmSegment::IsPublisherAlive()). The kernel drops them when their holder
+ * dies, and unlike pids they mean the same thing to every process sharing /dev/shm, whatever pid namespace it is in.
+ */
+struct ShmSegmentHeader {
+  uint8_t magic_version[4] = {'B', 'S', 'H', 3};
+  uint32_t slot_count = 0;
+  uint64_t slot_size = 0;
+  /// Process that created the segment, for logging only - it may be in another pid namespace
+  int32_t publisher_pid = 0;
+  /// Sequence number of the most recently written slot. Sequences start at 1, 0 marks an empty slot.
+  std::atomic<uint64_t> last_sequence = 0;
+  /// Futex word, bumped on every write
+  std::atomic<uint32_t> notify = 0;
+  /// Number of subscribers currently sleeping on `notify`, lets the publisher skip the wake syscall
+  std::atomic<uint32_t> waiters = 0;
+  std::atomic<uint32_t> subscriber_count = 0;
+  /// Set once the publisher has moved on to a larger segment (see ShmPublisher)
+  std::atomic<uint32_t> superseded = 0;
+  /// Set once the publisher has destroyed the segment - nothing more will be written
+  std::atomic<uint32_t> closed = 0;
+  /// Process of the subscriber attached at each index, 0 if free. An index in use whose lock is no longer held belongs
+  /// to a subscriber that died without detaching, see ShmSegment::ReclaimDeadSubscribers().
+  std::atomic<int32_t> subscriber_pids[SHM_MAX_SUBSCRIBERS];
+};
+
+/**
+ * Header for a single slot in the ring. The packet (MessageHeader + payload) follows immediately after.
+ */
+struct ShmSlotHeader {
+  /// Sequence of the packet in this slot, or 0 if empty or being written
+  std::atomic<uint64_t> sequence = 0;
+  /// One bit per subscriber index holding MessagePacket views into this slot, plus SHM_WRITER_PIN for loans. The
+  /// publisher will not overwrite a pinned slot.
+  std::atomic<uint64_t> readers = 0;
+  uint32_t packet_size = 0;
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free);
+static_assert(std::atomic<uint32_t>::is_always_lock_free);
+static_assert(std::is_standard_layout_v<ShmSegmentHeader>);
+static_assert(std::is_standard_layout_v<ShmSlotHeader>);
+
+class ShmReader;
+
+/**
+ * A POSIX shared memory segment holding a fixed number of fixed size slots, written by a single publisher and read by
+ * any number of subscribers.
+ *
+ * Delivery is lossy in the same way a bounded send queue is - if a subscriber falls more than `slot_count` messages
+ * behind, it will miss messages.
+ *
+ * Subscribers read through a ShmReader (see Attach()), which takes a subscriber index in the header and holds its
+ * lock. If a subscriber crashes, the publisher releases its slots with ReclaimDeadSubscribers().
+ */
+class ShmSegment : public std::enable_shared_from_this<ShmSegment> {
+public:
+  /**
+   * Create (and own) a new segment. Returns nullptr on failure.
+   */
+  static std::shared_ptr<ShmSegment> Create(const std::string &name, uint32_t slot_count, size_t slot_size);
+
+  /**
+   * Map an existing segment created by another process. Returns nullptr on failure, quietly if it doesn't exist.
+   */
+  static std::shared_ptr<ShmSegment> Open(const std::string &name);
+
+  /**
+   * Unlink the segment `name` if it was left behind by a publisher that died without destroying it.
+   *
+   * @return true if it was unlinked
+   */
+  static bool UnlinkIfStale(const std::string &name);
+
+  /**
+   * Unlink every stale segment (see UnlinkIfStale()) whose name starts with `prefix`.
+   *
+   * @return the number of segments unlinked
+   */
+  static size_t UnlinkStale(std::string_view prefix);
+
+  ~ShmSegment();
+
+  ShmSegment(const ShmSegment &) = delete;
+  ShmSegment &operator=(const ShmSegment &) = delete;
+
+  ShmSegmentHeader *GetHeader() const { return reinterpret_cast<ShmSegmentHeader *>(mapping); }
+
+  uint32_t GetSlotCount() const { return GetHeader()->slot_count; }
+
+  size_t GetSlotSize() const { return GetHeader()->slot_size; }
+
+  const std::string &GetName() const { return name; }
+
+  /**
+   * Copy a packet into the next free slot and wake any subscribers.
+   *
+   * @return false if the packet is larger than a slot or every slot is currently pinned.
+   */
+  bool Write(std::span<const std::byte> packet);
+
+  /**
+   * As above, gathering a packet that may not be contiguous, see MessagePacket::GetPacketParts().
+   */
+  bool Write(const core::transport::MessagePacket &packet);
+
+  /**
+   * Reserve the next free slot so that a message can be serialized directly into it. The slot stays pinned until the
+   * returned packet is released.
+   *
+   * @return nullptr if the packet is larger than a slot or every slot is currently pinned.
+   */
+  std::shared_ptr<core::transport::MessagePacket> Loan(uint32_t data_size);
+
+  /**
+   * Publish a packet previously returned by Loan() and wake any subscribers. No copy is made.
+   *
+   * @return false if the packet doesn't live in this segment.
+   */
+  bool Commit(const core::transport::MessagePacket &packet);
+
+  /**
+   * Take a free subscriber index, counting towards `subscriber_count` until the reader and every packet read through
+   * it are released.
+   *
+   * @return nullptr if SHM_MAX_SUBSCRIBERS are already attached.
+   */
+  std::shared_ptr<ShmReader> Attach();
+
+  /**
+   * Release the pins and subscriber index of every attached subscriber whose process no longer exists. Called
+   * periodically by the publisher.
+   *
+   * @return the number of subscribers reclaimed
+   */
+  size_t ReclaimDeadSubscribers();
+
+  /**
+   * Sleep until `notify` moves past `last_notify` or the timeout expires.
+   */
+  void Wait(uint32_t last_notify, std::chrono::milliseconds timeout);
+
+  /**
+   * Wake all subscribers waiting on this segment.
+   */
+  void Notify();
+
+  /**
+   * False once the publisher has closed the segment, or no longer holds its lock (ie it died).
+   */
+  bool IsPublisherAlive() const;
+
+protected:
+  friend class ShmReader;
+
+  ShmSegment(std::string name, int fd, std::byte *mapping, size_t mapping_size, bool owner)
+      : name(std::move(name)), fd(fd), mapping(mapping), mapping_size(mapping_size), owner(owner) {}
+
+  /**
+   * Keeps a slot pinned and the segment mapped for as long as a MessagePacket points into it.
+   */
+  struct SlotPin {
+    ~SlotPin() { slot->readers.fetch_and(~pin, std::memory_order_release); }
+    /// The segment for loans, the ShmReader for reads
+    std::shared_ptr<const void> owner;
+    ShmSlotHeader *slot;
+    uint64_t pin;
+  };
+
+  static size_t GetSlotStride(size_t slot_size);
+
+  ShmSlotHeader *GetSlot(uint32_t index) const;
+
+  static std::byte *GetSlotData(ShmSlotHeader *slot);
+
+  /**
+   * Find the next slot not pinned by anyone and invalidate it. Returns nullptr if there are none.
+   */
+  ShmSlotHeader *AcquireSlot();
+
+  /**
+   * Assign the next sequence to a filled in slot and notify.
+   */
+  void PublishSlot(ShmSlotHeader *slot, uint32_t packet_size);
+
+  std::string name;
+  /// Kept open for the lifetime of the segment - the publisher's lock lives on it, and liveness is queried through it
+  int fd = -1;
+  std::byte *mapping = nullptr;
+  size_t mapping_size = 0;
+  /// The owner unlinks the segment on destruction
+  bool owner = false;
+  /// Only used by the writer
+  uint32_t next_slot = 0;
+};
+
+/**
+ * A subscriber attached to a ShmSegment, see ShmSegment::Attach().
+ */
+class ShmReader : public std::enable_shared_from_this<ShmReader> {
+public:
+  ~ShmReader();
+
+  ShmReader(const ShmReader &) = delete;
+  ShmReader &operator=(const ShmReader &) = delete;
+
+  const std::shared_ptr<ShmSegment> &GetSegment() const { return segment; }
+
+  /**
+   * Pin and return views of every packet newer than `last_sequence`, oldest first. `last_sequence` is updated.
+   *
+   * The returned packets point directly into shared memory and keep the slot, this reader and the mapping alive.
+   */
+  std::vector<std::shared_ptr<core::transport::MessagePacket>> ReadNewer(uint64_t &last_sequence);
+
+protected:
+  friend class ShmSegment;
+
+  ShmReader(std::shared_ptr<ShmSegment> segment, uint32_t index, int lock_fd)
+      : segment(std::move(segment)), index(index), lock_fd(lock_fd) {}
+
+  const std::shared_ptr<ShmSegment> segment;
+  const uint32_t index;
+  /// Holds the lock on our index. Opened separately from the segment's descriptor - a lock never conflicts with
+  /// queries through the descriptor holding it, which would hide us when attached through the publisher's own segment.
+  const int lock_fd;
+};
+
+} // namespace basis::plugins::transport
@@ -0,0 +1,6 @@
+#pragma once
+namespace basis::plugins::transport {
+
+constexpr char SHM_TRANSPORT_NAME[] = "shm";
+
+}
@@ -0,0 +1,284 @@
+#include <basis/plugins/transport/shm.h>
+
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <mutex>
+#include <random>
+
+#include <unistd.h>
+
+#include <basis/plugins/transport/shm_logger.h>
+
+namespace basis::plugins::transport {
+
+using namespace shm;
+
+namespace {
+std::atomic<uint32_t> segment_counter;
+std::once_flag unlink_stale_once;
+
+/// Part of every segment name - processes in different pid namespaces sharing /dev/shm may have the same pid
+uint32_t GetProcessNonce() {
+  static const uint32_t nonce = std::random_device()();
+  return nonce;
+}
+
+const std::string &GetHostname() {
+  static const std::string hostname = [] {
+    char buffer[256] = {};
+    gethostname(buffer, sizeof(buffer) - 1);
+    return std::string(buffer);
+  }();
+  return hostname;
+}
+} // namespace
+
+std::string ShmPublisher::GetSegmentName(std::string_view base_name, uint32_t generation) {
+  return "/" + std::string(base_name) + "." + std::to_string(generation);
+}
+
+std::shared_ptr<ShmPublisher> ShmPublisher::Create(uint32_t slot_count, size_t slot_size) {
+  std::call_once(unlink_stale_once, [] { ShmSegment::UnlinkStale("basis_"); });
+
+  std::string base_name = "basis_" + std::to_string(getpid()) + "_" + std::to_string(GetProcessNonce()) + "_" +
+                          std::to_string(segment_counter++);
+  auto segment = ShmSegment::Create(GetSegmentName(base_name, 0), slot_count, slot_size);
+  if (!segment) {
+    return nullptr;
+  }
+  return std::shared_ptr<ShmPublisher>(new ShmPublisher(std::move(base_name), slot_count, std::move(segment)));
+}
+
+std::string ShmPublisher::GetConnectionInformation() {
+  std::lock_guard lock(segment_mutex);
+  return GetHostname() + segment->GetName();
+}
+
+size_t ShmPublisher::GetSubscriberCount() {
+  std::lock_guard lock(segment_mutex);
+  CheckSubscribers();
+  DropUnusedGenerations();
+  // Subscribers migrate between generations on their own, count every generation until they have
+  size_t count = segment->GetHeader()->subscriber_count.load();
+  for (auto &previous_segment : previous_segments) {
+    count += previous_segment->GetHeader()->subscriber_count.load();
+  }
+  return count;
+}
+
+void ShmPublisher::DropUnusedGenerations() {
+  // Only ever from the front - a subscriber on an older generation still needs every later one to catch up
+  while (!previous_segments.empty() && previous_segments.front()->GetHeader()->subscriber_count.load() == 0) {
+    previous_segments.pop_front();
+  }
+}
+
+void ShmPublisher::CheckSubscribers() {
+  const auto now = std::chrono::steady_clock::now();
+  if (now - last_liveness_check < SHM_LIVENESS_CHECK_INTERVAL) {
+    return;
+  }
+  last_liveness_check = now;
+
+  segment->ReclaimDeadSubscribers();
+  for (auto &previous_segment : previous_segments) {
+    previous_segment->ReclaimDeadSubscribers();
+  }
+}
+
+void ShmPublisher::SendMessage(std::shared_ptr<core::transport::MessagePacket> message) {
+  const size_t packet_size = message->GetPacketSize();
+
+  std::lock_guard lock(segment_mutex);
+  CheckSubscribers();
+  // Loaned from us - already in place
+  if (segment->Commit(*message)) {
+    return;
+  }
+
+  if (packet_size > segment->GetSlotSize() && !Grow(packet_size)) {
+    BASIS_LOG_ERROR("Unable to grow {} to fit a {} byte message, dropping", segment->GetName(), packet_size);
+    return;
+  }
+  segment->Write(*message);
+}
+
+std::shared_ptr<core::transport::MessagePacket> ShmPublisher::LoanPacket(uint32_t data_size) {
+  const size_t packet_size = data_size + sizeof(core::transport::MessageHeader);
+
+  std::lock_guard lock(segment_mutex);
+  if (packet_size > segment->GetSlotSize() && !Grow(packet_size)) {
+    return nullptr;
+  }
+  return segment->Loan(data_size);
+}
+
+bool ShmPublisher::Grow(size_t packet_size) {
+  const size_t slot_size = std::bit_ceil(packet_size);
+  auto next_segment = ShmSegment::Create(GetSegmentName(base_name, generation + 1), slot_count, slot_size);
+  if (!next_segment) {
+    return false;
+  }
+  BASIS_LOG_DEBUG("Growing {} to {} byte slots", segment->GetName(), slot_size);
+
+  // Keep sequences monotonic across generations so subscribers don't have to reset
+  next_segment->GetHeader()->last_sequence.store(segment->GetHeader()->last_sequence.load());
+
+  segment->GetHeader()->superseded.store(1);
+  segment->Notify();
+
+  generation++;
+  previous_segments.push_back(std::move(segment));
+  segment = std::move(next_segment);
+  DropUnusedGenerations();
+  return true;
+}
+
+ShmSubscriber::~ShmSubscriber() {
+  std::lock_guard lock(receivers_mutex);
+  for (auto &[_, receiver] : receivers) {
+    receiver->stop = true;
+  }
+  for (auto &[_, receiver] : receivers) {
+    if (receiver->thread.joinable()) {
+      receiver->thread.join();
+    }
+  }
+}
+
+bool ShmSubscriber::Connect([[maybe_unused]] std::string_view host, std::string_view endpoint,
+                            __uint128_t publisher_id) {
+  // "<hostname>/<base name>.<generation>"
+  const size_t slash = endpoint.find('/');
+  const size_t dot = endpoint.rfind('.');
+  uint32_t generation = 0;
+  if (slash == std::string_view::npos || dot == std::string_view::npos || dot < slash ||
+      std::from_chars(endpoint.data() + dot + 1, endpoint.data() + endpoint.size(), generation).ec != std::errc()) {
+    BASIS_LOG_ERROR("ShmSubscriber::Connect: '{}' is not a valid endpoint", endpoint);
+    return false;
+  }
+
+  if (endpoint.substr(0, slash) != GetHostname()) {
+    BASIS_LOG_DEBUG("ShmSubscriber::Connect: {} is on another host", endpoint);
+    return false;
+  }
+
+  std::string base_name(endpoint.substr(slash + 1, dot - slash - 1));
+
+  std::lock_guard lock(receivers_mutex);
+  if (auto it = receivers.find(base_name); it != receivers.end()) {
+    if (!it->second->finished) {
+      BASIS_LOG_WARN("Already connected to {}", base_name);
+      return true;
+    }
+    // Lost the publisher before, start over
+    it->second->thread.join();
+    receivers.erase(it);
+  }
+
+  // The endpoint may be a generation or two behind by the time we get to it
+  auto segment = OpenGeneration(base_name, generation);
+  if (!segment) {
+    BASIS_LOG_WARN("ShmSubscriber::Connect: publisher of {} is gone", endpoint);
+    return false;
+  }
+  // Count ourselves immediately, so the publisher starts sending
+  std::shared_ptr<ShmReader> reader = segment->Attach();
+  if (!reader) {
+    return false;
+  }
+  // Like TCP, only messages sent after connecting are delivered
+  const uint64_t last_sequence = segment->GetHeader()->last_sequence.load();
+
+  auto receiver = std::make_unique<Receiver>();
+  receiver->base_name = base_name;
+  receiver->publisher_id = publisher_id;
+  receiver->thread = std::thread(&ShmSubscriber::ReceiveThread, this, receiver.get(), std::move(reader), generation,
+                                 last_sequence);
+  receivers.emplace(std::move(base_name), std::move(receiver));
+  return true;
+}
+
+std::shared_ptr<ShmSegment> ShmSubscriber::OpenGeneration(std::string_view base_name, uint32_t &generation) {
+  for (uint32_t next = generation; next - generation < SHM_MAX_GENERATIONS; next++) {
+    auto segment = ShmSegment::Open(ShmPublisher::GetSegmentName(base_name, next));
+    if (!segment) {
+      continue;
+    }
+    if (!segment->IsPublisherAlive()) {
+      return nullptr;
+    }
+    generation = next;
+    return segment;
+  }
+  return nullptr;
+}
+
+void ShmSubscriber::ReceiveThread(Receiver *receiver, std::shared_ptr<ShmReader> reader, uint32_t generation,
+                                  uint64_t last_sequence) {
+  std::shared_ptr<ShmSegment> segment = reader->GetSegment();
+  ShmSegmentHeader *header = segment->GetHeader();
+  auto last_liveness_check = std::chrono::steady_clock::now();
+  std::chrono::milliseconds attach_retry_delay{1};
+
+  while (!receiver->stop) {
+    const uint32_t notify = header->notify.load();
+    // Must be checked before draining - anything written before the publisher moved on is guaranteed to be visible
+    const bool superseded = header->superseded.load();
+    // A crashed publisher can't mark the segment closed - look for its process now and then
+    bool publisher_alive = !header->closed.load();
+    if (publisher_alive && std::chrono::steady_clock::now() - last_liveness_check >= SHM_LIVENESS_CHECK_INTERVAL) {
+      publisher_alive = segment->IsPublisherAlive();
+      last_liveness_check = std::chrono::steady_clock::now();
+    }
+
+    for (auto &packet : reader->ReadNewer(last_sequence)) {
+      callback(std::move(packet));
+    }
+
+    if (superseded) {
+      uint32_t next_generation = generation + 1;
+      auto next_segment = OpenGeneration(receiver->base_name, next_generation);
+      if (!next_segment) {
+        BASIS_LOG_INFO("Publisher {} on topic {} has gone away", receiver->base_name, topic_name);
+        break;
+      }
+      std::shared_ptr<ShmReader> next_reader = next_segment->Attach();
+      if (!next_reader) {
+        // Every subscriber entry is taken. Nothing else would reconnect us while the publisher itself is unchanged,
+        // keep trying - staying attached here keeps this generation around.
+        std::this_thread::sleep_for(attach_retry_delay);
+        attach_retry_delay = std::min(attach_retry_delay * 2, SHM_ATTACH_RETRY_MAX_DELAY);
+        continue;
+      }
+      attach_retry_delay = std::chrono::milliseconds(1);
+      if (next_generation != generation + 1) {
+        // Only if we connected to a generation the publisher was already dropping
+        BASIS_LOG_WARN("Publisher {} on topic {} moved past generation {} before we got to it", receiver->base_name,
+                       topic_name, generation + 1);
+      }
+      // The old reader stays attached until the packets read through it are released
+
+      generation = next_generation;
+      reader = std::move(next_reader);
+      segment = reader->GetSegment();
+      header = segment->GetHeader();
+      continue;
+    }
+
+    if (!publisher_alive) {
+      BASIS_LOG_INFO("Publisher {} on topic {} has gone away", receiver->base_name, topic_name);
+      break;
+    }
+
+    segment->Wait(notify, std::chrono::milliseconds(100));
+  }
+
+  // Detach before reporting, so that the publisher no longer counts us by then
+  segment.reset();
+  reader.reset();
+  receiver->finished = true;
+}
+
+} // namespace basis::plugins::transport
@@ -0,0 +1,470 @@
+#include <basis/plugins/transport/shm_segment.h>
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <string>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <basis/plugins/transport/shm_logger.h>
+
+DECLARE_AUTO_LOGGER_PLUGIN(transport, shm)
+
+namespace basis::plugins::transport {
+
+using namespace shm;
+
+namespace {
+constexpr size_t CACHE_LINE_SIZE = 64;
+
+constexpr size_t AlignToCacheLine(size_t size) { return (size + CACHE_LINE_SIZE - 1) & ~(CACHE_LINE_SIZE - 1); }
+
+uint32_t *FutexWord(std::atomic<uint32_t> &word) { return reinterpret_cast<uint32_t *>(&word); }
+
+/// Byte of the segment locked by the publisher, subscriber index i locks the byte after it, see ShmSegmentHeader
+constexpr off_t PUBLISHER_LOCK_OFFSET = 0;
+
+constexpr off_t GetSubscriberLockOffset(uint32_t index) { return PUBLISHER_LOCK_OFFSET + 1 + index; }
+
+struct flock MakeLock(short type, off_t offset) {
+  struct flock lock = {};
+  lock.l_type = type;
+  lock.l_whence = SEEK_SET;
+  lock.l_start = offset;
+  lock.l_len = 1;
+  return lock;
+}
+
+/**
+ * Take an exclusive lock on a single byte, without blocking. Open file description locks are only released once every
+ * descriptor sharing the description is closed - or the process dies.
+ */
+bool TryLock(int fd, off_t offset) {
+  struct flock lock = MakeLock(F_WRLCK, offset);
+  return fcntl(fd, F_OFD_SETLK, &lock) == 0;
+}
+
+void Unlock(int fd, off_t offset) {
+  struct flock lock = MakeLock(F_UNLCK, offset);
+  fcntl(fd, F_OFD_SETLK, &lock);
+}
+
+/**
+ * True if a lock on the byte is held through any open file description other than `fd`'s. Works with read only
+ * descriptors.
+ */
+bool IsLocked(int fd, off_t offset) {
+  struct flock lock = MakeLock(F_RDLCK, offset);
+  if (fcntl(fd, F_OFD_GETLK, &lock) == -1) {
+    // Can't tell - better to keep a dead process around than to take from a live one
+    return true;
+  }
+  return lock.l_type != F_UNLCK;
+}
+} // namespace
+
+size_t ShmSegment::GetSlotStride(size_t slot_size) {
+  return AlignToCacheLine(sizeof(ShmSlotHeader)) + AlignToCacheLine(slot_size);
+}
+
+ShmSlotHeader *ShmSegment::GetSlot(uint32_t index) const {
+  return reinterpret_cast<ShmSlotHeader *>(mapping + AlignToCacheLine(sizeof(ShmSegmentHeader)) +
+                                           index * GetSlotStride(GetSlotSize()));
+}
+
+std::byte *ShmSegment::GetSlotData(ShmSlotHeader *slot) {
+  return reinterpret_cast<std::byte *>(slot) + AlignToCacheLine(sizeof(ShmSlotHeader));
+}
+
+std::shared_ptr<ShmSegment> ShmSegment::Create(const std::string &name, uint32_t slot_count, size_t slot_size) {
+  const size_t mapping_size = AlignToCacheLine(sizeof(ShmSegmentHeader)) + slot_count * GetSlotStride(slot_size);
+
+  int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+  // A publisher that crashed may have left a segment of the same name behind
+  if (fd == -1 && errno == EEXIST && UnlinkIfStale(name)) {
+    fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+  }
+  if (fd == -1) {
+    BASIS_LOG_ERROR("Unable to create shared memory segment {}: {} {}", name, errno, strerror(errno));
+    return nullptr;
+  }
+  // Before sizing it - until then, UnlinkIfStale() leaves the segment alone
+  if (!TryLock(fd, PUBLISHER_LOCK_OFFSET)) {
+    BASIS_LOG_ERROR("Unable to lock shared memory segment {}: {} {}", name, errno, strerror(errno));
+    close(fd);
+    shm_unlink(name.c_str());
+    return nullptr;
+  }
+
+  // tmpfs only commits pages once they are touched, so this is cheap even for large slots
+  if (ftruncate(fd, mapping_size) == -1) {
+    BASIS_LOG_ERROR("Unable to size shared memory segment {} to {} bytes: {} {}", name, mapping_size, errno,
+                    strerror(errno));
+    close(fd);
+    shm_unlink(name.c_str());
+    return nullptr;
+  }
+
+  void *mapping = mmap(nullptr, mapping_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (mapping == MAP_FAILED) {
+    BASIS_LOG_ERROR("Unable to map shared memory segment {}: {} {}", name, errno, strerror(errno));
+    close(fd);
+    shm_unlink(name.c_str());
+    return nullptr;
+  }
+
+  ShmSegmentHeader *header = new (mapping) ShmSegmentHeader;
+  header->slot_count = slot_count;
+  header->slot_size = slot_size;
+  header->publisher_pid = getpid();
+
+  auto segment = std::shared_ptr<ShmSegment>(new ShmSegment(name, fd, (std::byte *)mapping, mapping_size, true));
+  for (uint32_t i = 0; i < slot_count; i++) {
+    new (segment->GetSlot(i)) ShmSlotHeader;
+  }
+  return segment;
+}
+
+std::shared_ptr<ShmSegment> ShmSegment::Open(const std::string &name) {
+  int fd = shm_open(name.c_str(), O_RDWR, 0);
+  if (fd == -1 && errno == ENOENT) {
+    // Expected when looking for the generations of a publisher, see ShmSubscriber
+    BASIS_LOG_DEBUG("Shared memory segment {} doesn't exist", name);
+    return nullptr;
+  }
+  if (fd == -1) {
+    BASIS_LOG_ERROR("Unable to open shared memory segment {}: {} {}", name, errno, strerror(errno));
+    return nullptr;
+  }
+
+  struct stat stat_buf;
+  if (fstat(fd, &stat_buf) == -1 || (size_t)stat_buf.st_size < sizeof(ShmSegmentHeader)) {
+    BASIS_LOG_ERROR("Shared memory segment {} is too small", name);
+    close(fd);
+    return nullptr;
+  }
+
+  const size_t mapping_size = stat_buf.st_size;
+  void *mapping = mmap(nullptr, mapping_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (mapping == MAP_FAILED) {
+    BASIS_LOG_ERROR("Unable to map shared memory segment {}: {} {}", name, errno, strerror(errno));
+    close(fd);
+    return nullptr;
+  }
+
+  auto segment = std::shared_ptr<ShmSegment>(new ShmSegment(name, fd, (std::byte *)mapping, mapping_size, false));
+  const ShmSegmentHeader *header = segment->GetHeader();
+  if (memcmp(header->magic_version, ShmSegmentHeader().magic_version, sizeof(header->magic_version)) != 0 ||
+      AlignToCacheLine(sizeof(ShmSegmentHeader)) + header->slot_count * GetSlotStride(header->slot_size) >
+          mapping_size) {
+    BASIS_LOG_ERROR("Shared memory segment {} has an invalid header", name);
+    return nullptr;
+  }
+  return segment;
+}
+
+bool ShmSegment::UnlinkIfStale(const std::string &name) {
+  int fd = shm_open(name.c_str(), O_RDONLY, 0);
+  if (fd == -1) {
+    return false;
+  }
+
+  struct stat stat_buf;
+  void *mapping = MAP_FAILED;
+  if (fstat(fd, &stat_buf) == 0 && (size_t)stat_buf.st_size >= sizeof(ShmSegmentHeader)) {
+    mapping = mmap(nullptr, sizeof(ShmSegmentHeader), PROT_READ, MAP_SHARED, fd, 0);
+  }
+  if (mapping == MAP_FAILED) {
+    // Too small - either being created right now, or not ours
+    close(fd);
+    return false;
+  }
+
+  const ShmSegmentHeader *header = reinterpret_cast<const ShmSegmentHeader *>(mapping);
+  // Segments of other versions may not lock the same way, leave them be
+  const bool stale =
+      memcmp(header->magic_version, ShmSegmentHeader().magic_version, sizeof(header->magic_version)) == 0 &&
+      !IsLocked(fd, PUBLISHER_LOCK_OFFSET);
+  const pid_t publisher_pid = header->publisher_pid;
+  munmap(mapping, sizeof(ShmSegmentHeader));
+  close(fd);
+  if (!stale) {
+    return false;
+  }
+
+  BASIS_LOG_INFO("Unlinking {}, left behind by publisher process {}", name, publisher_pid);
+  return shm_unlink(name.c_str()) == 0;
+}
+
+size_t ShmSegment::UnlinkStale(std::string_view prefix) {
+  // Linux keeps POSIX shared memory in /dev/shm
+  DIR *dir = opendir("/dev/shm");
+  if (!dir) {
+    return 0;
+  }
+  size_t unlinked = 0;
+  while (const dirent *entry = readdir(dir)) {
+    if (std::string_view(entry->d_name).starts_with(prefix)) {
+      unlinked += UnlinkIfStale("/" + std::string(entry->d_name));
+    }
+  }
+  closedir(dir);
+  return unlinked;
+}
+
+ShmSegment::~ShmSegment() {
+  if (owner) {
+    // Let subscribers know not to wait on us any longer
+    GetHeader()->closed.store(1);
+    Notify();
+  }
+  munmap(mapping, mapping_size);
+  if (owner) {
+    shm_unlink(name.c_str());
+  }
+  // Releases the publisher's lock - only after unlinking, so that the segment is never seen as stale
+  close(fd);
+}
+
+bool ShmSegment::IsPublisherAlive() const {
+  const ShmSegmentHeader *header = GetHeader();
+  if (header->closed.load()) {
+    return false;
+  }
+  // Our own lock doesn't show up through our own descriptor
+  return owner || IsLocked(fd, PUBLISHER_LOCK_OFFSET);
+}
+
+std::shared_ptr<ShmReader> ShmSegment::Attach() {
+  // A new open file description, works even once the segment has been unlinked
+  const int lock_fd = open(("/proc/self/fd/" + std::to_string(fd)).c_str(), O_RDWR | O_CLOEXEC);
+  if (lock_fd == -1) {
+    BASIS_LOG_ERROR("Unable to reopen shared memory segment {}: {} {}", name, errno, strerror(errno));
+    return nullptr;
+  }
+
+  ShmSegmentHeader *header = GetHeader();
+  for (uint32_t index = 0; index < SHM_MAX_SUBSCRIBERS; index++) {
+    // Lock before taking the index, so that the publisher never sees the index in use without its lock
+    if (!TryLock(lock_fd, GetSubscriberLockOffset(index))) {
+      continue;
+    }
+    int32_t expected = 0;
+    if (header->subscriber_pids[index].compare_exchange_strong(expected, getpid())) {
+      header->subscriber_count.fetch_add(1);
+      return std::shared_ptr<ShmReader>(new ShmReader(shared_from_this(), index, lock_fd));
+    }
+    // Left behind by a dead subscriber, not reclaimed yet
+    Unlock(lock_fd, GetSubscriberLockOffset(index));
+  }
+  close(lock_fd);
+  BASIS_LOG_WARN("All {} subscriber entries of {} are in use", SHM_MAX_SUBSCRIBERS, name);
+  return nullptr;
+}
+
+size_t ShmSegment::ReclaimDeadSubscribers() {
+  ShmSegmentHeader *header = GetHeader();
+  size_t reclaimed = 0;
+  for (uint32_t index = 0; index < SHM_MAX_SUBSCRIBERS; index++) {
+    int32_t pid = header->subscriber_pids[index].load();
+    if (pid == 0 || IsLocked(fd, GetSubscriberLockOffset(index))) {
+      continue;
+    }
+
+    // Release the pins before the index, so that they can't be mistaken for those of the next subscriber to take it
+    const uint64_t pin = uint64_t(1) << index;
+    for (uint32_t i = 0; i < GetSlotCount(); i++) {
+      GetSlot(i)->readers.fetch_and(~pin);
+    }
+    if (header->subscriber_pids[index].compare_exchange_strong(pid, 0)) {
+      header->subscriber_count.fetch_sub(1);
+      reclaimed++;
+      BASIS_LOG_WARN("Subscriber process {} of {} is gone, releasing its slots", pid, name);
+    }
+  }
+  return reclaimed;
+}
+
+ShmSlotHeader *ShmSegment::AcquireSlot() {
+  const uint32_t slot_count = GetSlotCount();
+  for (uint32_t attempt = 0; attempt < slot_count; attempt++) {
+    ShmSlotHeader *slot = GetSlot(next_slot);
+    next_slot = (next_slot + 1) % slot_count;
+
+    // Invalidate first, then check for readers - paired with the pin in ReadNewer(), at least one side is guaranteed
+    // to see the other
+    slot->sequence.store(0);
+    if (slot->readers.load() == 0) {
+      return slot;
+    }
+  }
+
+  BASIS_LOG_WARN("All {} slots in {} are held by subscribers, dropping message", slot_count, name);
+  return nullptr;
+}
+
+void ShmSegment::PublishSlot(ShmSlotHeader *slot, uint32_t packet_size) {
+  ShmSegmentHeader *header = GetHeader();
+  slot->packet_size = packet_size;
+
+  const uint64_t sequence = header->last_sequence.load(std::memory_order_relaxed) + 1;
+  slot->sequence.store(sequence, std::memory_order_release);
+  header->last_sequence.store(sequence, std::memory_order_release);
+
+  Notify();
+}
+
+bool ShmSegment::Write(std::span<const std::byte> packet) {
+  if (packet.size() > GetSlotSize()) {
+    return false;
+  }
+
+  ShmSlotHeader *slot = AcquireSlot();
+  if (!slot) {
+    return false;
+  }
+
+  memcpy(GetSlotData(slot), packet.data(), packet.size());
+  PublishSlot(slot, packet.size());
+  return true;
+}
+
+bool ShmSegment::Write(const core::transport::MessagePacket &packet) {
+  const size_t packet_size = packet.GetPacketSize();
+  if (packet_size > GetSlotSize()) {
+    return false;
+  }
+
+  ShmSlotHeader *slot = AcquireSlot();
+  if (!slot) {
+    return false;
+  }
+
+  std::byte *out = GetSlotData(slot);
+  for (std::span<const std::byte> part : packet.GetPacketParts()) {
+    if (!part.empty()) {
+      memcpy(out, part.data(), part.size());
+      out += part.size();
+    }
+  }
+  PublishSlot(slot, packet_size);
+  return true;
+}
+
+std::shared_ptr<core::transport::MessagePacket> ShmSegment::Loan(uint32_t data_size) {
+  if (data_size + sizeof(core::transport::MessageHeader) > GetSlotSize()) {
+    return nullptr;
+  }
+
+  ShmSlotHeader *slot = AcquireSlot();
+  if (!slot) {
+    return nullptr;
+  }
+  // Pin on behalf of the writer - we are the only writer, so no need to recheck anything
+  slot->readers.fetch_or(SHM_WRITER_PIN);
+
+  return std::make_shared<core::transport::MessagePacket>(
+      core::transport::MessageHeader::DataType::MESSAGE, data_size,
+      std::span<std::byte>(GetSlotData(slot), GetSlotSize()),
+      std::make_shared<SlotPin>(shared_from_this(), slot, SHM_WRITER_PIN));
+}
+
+bool ShmSegment::Commit(const core::transport::MessagePacket &packet) {
+  if (!packet.IsContiguous()) {
+    return false;
+  }
+  const std::byte *data = packet.GetPacket().data();
+  const std::byte *slots_start = mapping + AlignToCacheLine(sizeof(ShmSegmentHeader));
+  if (data < slots_start || data >= mapping + mapping_size) {
+    return false;
+  }
+
+  const size_t stride = GetSlotStride(GetSlotSize());
+  const size_t offset = data - slots_start;
+  if (offset % stride != AlignToCacheLine(sizeof(ShmSlotHeader))) {
+    return false;
+  }
+
+  PublishSlot(GetSlot(offset / stride), packet.GetPacket().size());
+  return true;
+}
+
+ShmReader::~ShmReader() {
+  ShmSegmentHeader *header = segment->GetHeader();
+  header->subscriber_pids[index].store(0);
+  header->subscriber_count.fetch_sub(1);
+  // Only once the index is free again - see ShmSegment::ReclaimDeadSubscribers()
+  close(lock_fd);
+}
+
+std::vector<std::shared_ptr<core::transport::MessagePacket>> ShmReader::ReadNewer(uint64_t &last_sequence) {
+  const ShmSegmentHeader *header = segment->GetHeader();
+  const uint64_t pin = uint64_t(1) << index;
+
+  std::vector<std::pair<uint64_t, ShmSlotHeader *>> newer;
+  for (uint32_t i = 0; i < header->slot_count; i++) {
+    ShmSlotHeader *slot = segment->GetSlot(i);
+    const uint64_t sequence = slot->sequence.load(std::memory_order_acquire);
+    if (sequence > last_sequence) {
+      newer.emplace_back(sequence, slot);
+    }
+  }
+  std::sort(newer.begin(), newer.end());
+
+  std::vector<std::shared_ptr<core::transport::MessagePacket>> out;
+  out.reserve(newer.size());
+  for (auto &[sequence, slot] : newer) {
+    last_sequence = sequence;
+
+    slot->readers.fetch_or(pin);
+    if (slot->sequence.load() != sequence) {
+      // Overwritten between the scan and the pin
+      slot->readers.fetch_and(~pin, std::memory_order_release);
+      continue;
+    }
+
+    const uint32_t packet_size = slot->packet_size;
+    std::span<std::byte> packet(ShmSegment::GetSlotData(slot), packet_size);
+    if (packet_size < sizeof(core::transport::MessageHeader) ||
+        reinterpret_cast<const core::transport::MessageHeader *>(packet.data())->data_size +
+                sizeof(core::transport::MessageHeader) !=
+            packet_size) {
+      BASIS_LOG_ERROR("Skipping malformed packet in {}", segment->GetName());
+      slot->readers.fetch_and(~pin, std::memory_order_release);
+      continue;
+    }
+
+    out.push_back(std::make_shared<core::transport::MessagePacket>(
+        packet, std::make_shared<ShmSegment::SlotPin>(shared_from_this(), slot, pin)));
+  }
+  return out;
+}
+
+void ShmSegment::Wait(uint32_t last_notify, std::chrono::milliseconds timeout) {
+  ShmSegmentHeader *header = GetHeader();
+  header->waiters.fetch_add(1);
+  if (header->notify.load() == last_notify) {
+    const auto seconds = std::chrono::duration_cast<std::chrono::seconds>(timeout);
+    timespec ts{.tv_sec = seconds.count(),
+                .tv_nsec = std::chrono::duration_cast<std::chrono::nanoseconds>(timeout - seconds).count()};
+    syscall(SYS_futex, FutexWord(header->notify), FUTEX_WAIT, last_notify, &ts, nullptr, 0);
+  }
+  header->waiters.fetch_sub(1);
+}
+
+void ShmSegment::Notify() {
+  ShmSegmentHeader *header = GetHeader();
+  header->notify.fetch_add(1);
+  if (header->waiters.load() != 0) {
+    syscall(SYS_futex, FutexWord(header->notify), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+  }
+}
+
+} // namespace basis::plugins::transport
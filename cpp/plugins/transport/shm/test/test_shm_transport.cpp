@@ -0,0 +1,649 @@
+#include <memory>
+#include <span>
+#include <thread>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <basis/core/transport/transport_manager.h>
+#include <basis/plugins/transport/shm.h>
+#include <basis/plugins/transport/tcp.h>
+#include <gtest/gtest.h>
+
+#include "spdlog/spdlog.h"
+
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wdeprecated-declarations"
+#include <test.pb.h>
+#pragma clang diagnostic pop
+
+#include <basis/plugins/serialization/protobuf.h>
+
+#include <google/protobuf/util/message_differencer.h>
+
+using namespace basis::core::transport;
+
+using namespace basis::plugins::transport;
+
+class TestShmTransport : public testing::Test {
+public:
+  TestShmTransport() { spdlog::set_level(spdlog::level::debug); }
+
+  std::shared_ptr<MessagePacket> CreatePacket(std::string_view contents) {
+    auto packet = std::make_shared<MessagePacket>(MessageHeader::DataType::MESSAGE, contents.size());
+    memcpy(packet->GetMutablePayload().data(), contents.data(), contents.size());
+    return packet;
+  }
+
+  std::shared_ptr<ShmSegment> GetSegment(ShmPublisher &publisher) { return publisher.segment; }
+
+  /**
+   * Fork a process that creates `segment_name` and dies without destroying it, as if it crashed.
+   */
+  void CreateInCrashedProcess(const std::string &segment_name) {
+    const pid_t pid = fork();
+    if (pid == 0) {
+      _exit(ShmSegment::Create(segment_name, 2, 1024) ? 0 : 1);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+    ASSERT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+  }
+
+  /**
+   * Fork a process running a ShmPublisher, which crashes once CrashPublisherProcess() is called.
+   *
+   * @return the publisher's connection information
+   */
+  std::string StartPublisherProcess() {
+    int to_child[2];
+    int from_child[2];
+    EXPECT_EQ(pipe(to_child), 0);
+    EXPECT_EQ(pipe(from_child), 0);
+    publisher_process = fork();
+    if (publisher_process == 0) {
+      close(to_child[1]);
+      close(from_child[0]);
+      auto publisher = ShmPublisher::Create(4, 64);
+      const std::string endpoint = publisher ? publisher->GetConnectionInformation() : "";
+      [[maybe_unused]] ssize_t written = write(from_child[1], endpoint.data(), endpoint.size());
+      close(from_child[1]);
+      // Until the other end is closed
+      char byte;
+      [[maybe_unused]] ssize_t got = read(to_child[0], &byte, 1);
+      _exit(0);
+    }
+    close(to_child[0]);
+    close(from_child[1]);
+    publisher_process_pipe = to_child[1];
+
+    std::string endpoint;
+    char buffer[256];
+    ssize_t got;
+    while ((got = read(from_child[0], buffer, sizeof(buffer))) > 0) {
+      endpoint.append(buffer, got);
+    }
+    close(from_child[0]);
+    return endpoint;
+  }
+
+  void CrashPublisherProcess() {
+    close(publisher_process_pipe);
+    waitpid(publisher_process, nullptr, 0);
+  }
+
+  pid_t publisher_process = 0;
+  int publisher_process_pipe = -1;
+
+  /**
+   * Take every free subscriber entry of `segment`.
+   */
+  std::vector<std::shared_ptr<ShmReader>> AttachAll(ShmSegment &segment) {
+    std::vector<std::shared_ptr<ShmReader>> readers;
+    while (auto reader = segment.Attach()) {
+      readers.push_back(std::move(reader));
+    }
+    return readers;
+  }
+
+  /**
+   * NetworkInfo as the coordinator would send it, with `publisher` the only publisher on `topic`.
+   */
+  proto::NetworkInfo CreateNetworkInfo(const std::string &topic, ShmPublisher &publisher) {
+    PublisherInfo info;
+    info.publisher_id = CreatePublisherId();
+    info.topic = topic;
+    info.transport_info[SHM_TRANSPORT_NAME] = publisher.GetConnectionInformation();
+    proto::NetworkInfo network_info;
+    network_info.set_version(1);
+    *(*network_info.mutable_publishers_by_topic())[topic].add_publishers() = info.ToProto();
+    return network_info;
+  }
+
+  size_t GetPreviousSegmentCount(ShmPublisher &publisher) {
+    std::lock_guard lock(publisher.segment_mutex);
+    return publisher.previous_segments.size();
+  }
+
+  ShmSubscriber *GetShmSubscriber(SubscriberBase *subscriber) {
+    for (auto &transport_subscriber : subscriber->transport_subscribers) {
+      if (auto shm_subscriber = dynamic_cast<ShmSubscriber *>(transport_subscriber.get())) {
+        return shm_subscriber;
+      }
+    }
+    return nullptr;
+  }
+
+  TcpSubscriber *GetTcpSubscriber(SubscriberBase *subscriber) {
+    for (auto &transport_subscriber : subscriber->transport_subscribers) {
+      if (auto tcp_subscriber = dynamic_cast<TcpSubscriber *>(transport_subscriber.get())) {
+        return tcp_subscriber;
+      }
+    }
+    return nullptr;
+  }
+};
+
+/**
+ * Test raw reads and writes through a single segment
+ */
+TEST_F(TestShmTransport, Segment) {
+  auto segment = ShmSegment::Create("/basis_test_shm_segment", 4, 1024);
+  ASSERT_NE(segment, nullptr);
+
+  auto opened = ShmSegment::Open("/basis_test_shm_segment");
+  ASSERT_NE(opened, nullptr);
+  ASSERT_EQ(opened->GetSlotCount(), 4);
+  auto reader = opened->Attach();
+  ASSERT_NE(reader, nullptr);
+  ASSERT_EQ(segment->GetHeader()->subscriber_count, 1);
+
+  uint64_t last_sequence = 0;
+  ASSERT_TRUE(reader->ReadNewer(last_sequence).empty());
+
+  const std::string hello = "Hello, World!";
+  ASSERT_TRUE(segment->Write(CreatePacket(hello)->GetPacket()));
+
+  auto packets = reader->ReadNewer(last_sequence);
+  ASSERT_EQ(packets.size(), 1);
+  ASSERT_EQ(last_sequence, 1);
+  const std::span<const std::byte> payload = packets[0]->GetPayload();
+  ASSERT_EQ(std::string_view((const char *)payload.data(), payload.size()), hello);
+
+  // Zero copy - the payload points into the mapping
+  ASSERT_GE(payload.data(), (const std::byte *)opened->GetHeader());
+  ASSERT_LT(payload.data(), (const std::byte *)opened->GetHeader() + 8 * 1024);
+
+  // Nothing new
+  ASSERT_TRUE(reader->ReadNewer(last_sequence).empty());
+
+  // Too large for a slot
+  ASSERT_FALSE(segment->Write(CreatePacket(std::string(2048, 'x'))->GetPacket()));
+
+  // Borrowed payloads are gathered into the slot
+  auto storage = std::make_shared<std::string>("borrowed");
+  MessagePacket borrowed(MessageHeader::DataType::MESSAGE,
+                         std::as_bytes(std::span<const char>(storage->data(), storage->size())), storage);
+  ASSERT_TRUE(segment->Write(borrowed));
+  packets = reader->ReadNewer(last_sequence);
+  ASSERT_EQ(packets.size(), 1);
+  ASSERT_EQ(std::string_view((const char *)packets[0]->GetPayload().data(), packets[0]->GetPayload().size()),
+            *storage);
+
+  // Detaching waits for the packets read through the reader
+  reader.reset();
+  ASSERT_EQ(segment->GetHeader()->subscriber_count, 1);
+  packets.clear();
+  ASSERT_EQ(segment->GetHeader()->subscriber_count, 0);
+}
+
+/**
+ * Test that a slot held by a subscriber is never overwritten
+ */
+TEST_F(TestShmTransport, PinnedSlots) {
+  auto segment = ShmSegment::Create("/basis_test_shm_pinned", 2, 1024);
+  ASSERT_NE(segment, nullptr);
+  auto reader = segment->Attach();
+  ASSERT_NE(reader, nullptr);
+
+  uint64_t last_sequence = 0;
+  ASSERT_TRUE(segment->Write(CreatePacket("first")->GetPacket()));
+  ASSERT_TRUE(segment->Write(CreatePacket("second")->GetPacket()));
+  auto held = reader->ReadNewer(last_sequence);
+  ASSERT_EQ(held.size(), 2);
+
+  // Every slot is pinned, there's nowhere to write
+  ASSERT_FALSE(segment->Write(CreatePacket("third")->GetPacket()));
+  ASSERT_EQ(std::string_view((const char *)held[0]->GetPayload().data(), held[0]->GetPayload().size()), "first");
+  ASSERT_EQ(std::string_view((const char *)held[1]->GetPayload().data(), held[1]->GetPayload().size()), "second");
+
+  // Releasing a view frees its slot
+  held.pop_back();
+  ASSERT_TRUE(segment->Write(CreatePacket("fourth")->GetPacket()));
+  ASSERT_EQ(std::string_view((const char *)held[0]->GetPayload().data(), held[0]->GetPayload().size()), "first");
+
+  auto packets = reader->ReadNewer(last_sequence);
+  ASSERT_EQ(packets.size(), 1);
+  ASSERT_EQ(std::string_view((const char *)packets[0]->GetPayload().data(), packets[0]->GetPayload().size()),
+            "fourth");
+}
+
+/**
+ * Test that the slots and subscriber entry of a subscriber that crashed are given back
+ */
+TEST_F(TestShmTransport, CrashedSubscriber) {
+  auto segment = ShmSegment::Create("/basis_test_shm_crashed", 2, 1024);
+  ASSERT_NE(segment, nullptr);
+  ShmSegmentHeader *header = segment->GetHeader();
+  ASSERT_TRUE(segment->Write(CreatePacket("first")->GetPacket()));
+  ASSERT_TRUE(segment->Write(CreatePacket("second")->GetPacket()));
+
+  // Pin every slot, then die without detaching
+  const pid_t subscriber_pid = fork();
+  if (subscriber_pid == 0) {
+    auto reader = ShmSegment::Open("/basis_test_shm_crashed")->Attach();
+    uint64_t last_sequence = 0;
+    auto held = reader->ReadNewer(last_sequence);
+    _exit(held.size() == 2 ? 0 : 1);
+  }
+  int status = 0;
+  waitpid(subscriber_pid, &status, 0);
+  ASSERT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+  ASSERT_EQ(header->subscriber_count, 1);
+  ASSERT_FALSE(segment->Write(CreatePacket("third")->GetPacket()));
+
+  // Live subscribers are left alone
+  auto reader = segment->Attach();
+  ASSERT_EQ(header->subscriber_count, 2);
+  ASSERT_EQ(segment->ReclaimDeadSubscribers(), 1);
+  ASSERT_EQ(segment->ReclaimDeadSubscribers(), 0);
+  ASSERT_EQ(header->subscriber_count, 1);
+  ASSERT_TRUE(segment->Write(CreatePacket("third")->GetPacket()));
+
+  uint64_t last_sequence = 2;
+  auto packets = reader->ReadNewer(last_sequence);
+  ASSERT_EQ(packets.size(), 1);
+  ASSERT_EQ(std::string_view((const char *)packets[0]->GetPayload().data(), packets[0]->GetPayload().size()),
+            "third");
+
+  // Publishers check on their own
+  auto publisher = ShmPublisher::Create(4, 64);
+  ASSERT_NE(publisher, nullptr);
+  const std::string segment_name = GetSegment(*publisher)->GetName();
+  const pid_t publisher_subscriber_pid = fork();
+  if (publisher_subscriber_pid == 0) {
+    auto reader = ShmSegment::Open(segment_name)->Attach();
+    _exit(reader ? 0 : 1);
+  }
+  waitpid(publisher_subscriber_pid, &status, 0);
+  ASSERT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+  ASSERT_EQ(publisher->GetSubscriberCount(), 1);
+  for (int i = 0; i < 300 && publisher->GetSubscriberCount() != 0; i++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  ASSERT_EQ(publisher->GetSubscriberCount(), 0);
+}
+
+/**
+ * Test that segments left behind by a crashed publisher are unlinked, and don't block reusing their name
+ */
+TEST_F(TestShmTransport, StaleSegments) {
+  auto live = ShmSegment::Create("/basis_test_shm_stale_live.0", 2, 1024);
+  ASSERT_NE(live, nullptr);
+  CreateInCrashedProcess("/basis_test_shm_stale_dead.0");
+
+  // Only the lock counts - a pid from another pid namespace may not exist here, or be someone else entirely
+  const pid_t dead_pid = fork();
+  if (dead_pid == 0) {
+    _exit(0);
+  }
+  waitpid(dead_pid, nullptr, 0);
+  live->GetHeader()->publisher_pid = dead_pid;
+
+  ASSERT_EQ(ShmSegment::UnlinkStale("basis_test_shm_stale_"), 1);
+  ASSERT_EQ(ShmSegment::Open("/basis_test_shm_stale_dead.0"), nullptr);
+  auto opened = ShmSegment::Open("/basis_test_shm_stale_live.0");
+  ASSERT_NE(opened, nullptr);
+  ASSERT_TRUE(opened->IsPublisherAlive());
+
+  // A publisher that reuses a crashed publisher's segment name can still create its segment
+  CreateInCrashedProcess("/basis_test_shm_stale_reused.0");
+  auto replacement = ShmSegment::Create("/basis_test_shm_stale_reused.0", 2, 1024);
+  ASSERT_NE(replacement, nullptr);
+  ASSERT_EQ(replacement->GetHeader()->publisher_pid, getpid());
+}
+
+/**
+ * Test serializing directly into a slot
+ */
+TEST_F(TestShmTransport, LoanPacket) {
+  auto publisher = ShmPublisher::Create(4, 64);
+  ASSERT_NE(publisher, nullptr);
+  auto opened = ShmSegment::Open(GetSegment(*publisher)->GetName());
+  ASSERT_NE(opened, nullptr);
+  auto reader = opened->Attach();
+  ASSERT_NE(reader, nullptr);
+
+  const std::string hello = "Hello, World!";
+  std::shared_ptr<MessagePacket> packet = publisher->LoanPacket(hello.size());
+  ASSERT_NE(packet, nullptr);
+  ASSERT_EQ(packet->GetPayload().size(), hello.size());
+  memcpy(packet->GetMutablePayload().data(), hello.data(), hello.size());
+
+  // Not visible until sent
+  uint64_t last_sequence = 0;
+  ASSERT_TRUE(reader->ReadNewer(last_sequence).empty());
+
+  publisher->SendMessage(packet);
+  auto packets = reader->ReadNewer(last_sequence);
+  ASSERT_EQ(packets.size(), 1);
+  ASSERT_EQ(std::string_view((const char *)packets[0]->GetPayload().data(), packets[0]->GetPayload().size()), hello);
+
+  // Too large for the current slots - the publisher grows and the loan comes from the new segment
+  std::shared_ptr<MessagePacket> large_packet = publisher->LoanPacket(1024);
+  ASSERT_NE(large_packet, nullptr);
+  ASSERT_TRUE(opened->GetHeader()->superseded);
+  ASSERT_GE(GetSegment(*publisher)->GetSlotSize(), 1024 + sizeof(MessageHeader));
+}
+
+/**
+ * Test publisher to subscriber, including growing past the initial slot size
+ */
+TEST_F(TestShmTransport, PublisherSubscriber) {
+  auto publisher = ShmPublisher::Create(4, 64);
+  ASSERT_NE(publisher, nullptr);
+  ASSERT_EQ(publisher->GetSubscriberCount(), 0);
+
+  std::mutex received_mutex;
+  std::vector<std::string> received;
+  auto subscriber = ShmSubscriber::Create("test", [&](std::shared_ptr<MessagePacket> packet) {
+    std::lock_guard lock(received_mutex);
+    received.emplace_back((const char *)packet->GetPayload().data(), packet->GetPayload().size());
+  });
+
+  ASSERT_FALSE(subscriber->Connect("127.0.0.1", "some_other_host" + GetSegment(*publisher)->GetName(), 0));
+  ASSERT_TRUE(subscriber->Connect("127.0.0.1", publisher->GetConnectionInformation(), 0));
+  ASSERT_EQ(subscriber->GetPublisherCount(), 1);
+  ASSERT_EQ(publisher->GetSubscriberCount(), 1);
+
+  const std::string small = "small";
+  const std::string large(4096, 'L');
+  publisher->SendMessage(CreatePacket(small));
+  publisher->SendMessage(CreatePacket(large));
+  publisher->SendMessage(CreatePacket(small));
+
+  for (int i = 0; i < 100; i++) {
+    {
+      std::lock_guard lock(received_mutex);
+      if (received.size() == 3) {
+        break;
+      }
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+
+  std::lock_guard lock(received_mutex);
+  ASSERT_EQ(received.size(), 3);
+  ASSERT_EQ(received[0], small);
+  ASSERT_EQ(received[1], large);
+  ASSERT_EQ(received[2], small);
+  ASSERT_GE(GetSegment(*publisher)->GetSlotSize(), large.size() + sizeof(MessageHeader));
+}
+
+/**
+ * Test that a subscriber stuck in a callback can still follow the publisher after it grew several times
+ */
+TEST_F(TestShmTransport, SlowSubscriberFollowsGrowth) {
+  auto publisher = ShmPublisher::Create(4, 64);
+  ASSERT_NE(publisher, nullptr);
+
+  std::mutex received_mutex;
+  std::vector<size_t> received;
+  std::atomic<bool> in_callback = false;
+  std::atomic<bool> release = false;
+  auto subscriber = ShmSubscriber::Create("test", [&](std::shared_ptr<MessagePacket> packet) {
+    in_callback = true;
+    while (!release) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    std::lock_guard lock(received_mutex);
+    received.push_back(packet->GetPayload().size());
+  });
+  const std::string endpoint = publisher->GetConnectionInformation();
+  ASSERT_TRUE(subscriber->Connect("127.0.0.1", endpoint, 0));
+
+  publisher->SendMessage(CreatePacket("small"));
+  for (int i = 0; i < 100 && !in_callback; i++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  ASSERT_TRUE(in_callback);
+
+  // Grow three times while the subscriber is still on the first generation
+  const std::vector<size_t> sizes = {200, 1000, 5000};
+  for (size_t size : sizes) {
+    publisher->SendMessage(CreatePacket(std::string(size, 'x')));
+  }
+  ASSERT_EQ(GetPreviousSegmentCount(*publisher), 3);
+  ASSERT_EQ(publisher->GetSubscriberCount(), 1);
+
+  release = true;
+  for (int i = 0; i < 100; i++) {
+    {
+      std::lock_guard lock(received_mutex);
+      if (received.size() == 4) {
+        break;
+      }
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  {
+    std::lock_guard lock(received_mutex);
+    ASSERT_EQ(received, (std::vector<size_t>{5, 200, 1000, 5000}));
+  }
+  ASSERT_EQ(subscriber->GetPublisherCount(), 1);
+  ASSERT_TRUE(subscriber->IsConnectedToPublisher(0));
+
+  // Once the subscriber has caught up, the old generations go away
+  for (int i = 0; i < 100 && GetPreviousSegmentCount(*publisher) != 0; i++) {
+    publisher->GetSubscriberCount();
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  ASSERT_EQ(GetPreviousSegmentCount(*publisher), 0);
+
+  // An endpoint from before the growth still leads to the current generation
+  auto late_subscriber = ShmSubscriber::Create("test", [](std::shared_ptr<MessagePacket>) {});
+  ASSERT_TRUE(late_subscriber->Connect("127.0.0.1", endpoint, 0));
+  ASSERT_EQ(publisher->GetSubscriberCount(), 2);
+}
+
+/**
+ * Test that a subscriber notices when its publisher crashes or goes away, and can connect again afterwards
+ */
+TEST_F(TestShmTransport, PublisherGone) {
+  std::atomic<int> num_received = 0;
+  auto subscriber = ShmSubscriber::Create("test", [&](std::shared_ptr<MessagePacket>) { num_received++; });
+
+  auto wait_for_publisher_count = [&](size_t count) {
+    for (int i = 0; i < 300 && subscriber->GetPublisherCount() != count; i++) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return subscriber->GetPublisherCount() == count;
+  };
+
+  const std::string crashed_endpoint = StartPublisherProcess();
+  ASSERT_FALSE(crashed_endpoint.empty());
+  ASSERT_TRUE(subscriber->Connect("127.0.0.1", crashed_endpoint, 0));
+  ASSERT_EQ(subscriber->GetPublisherCount(), 1);
+
+  CrashPublisherProcess();
+  ASSERT_TRUE(wait_for_publisher_count(0));
+  ASSERT_FALSE(subscriber->IsConnectedToPublisher(0));
+  ASSERT_FALSE(subscriber->Connect("127.0.0.1", crashed_endpoint, 0));
+  // Left for the next publisher to clean up
+  ASSERT_TRUE(ShmSegment::UnlinkIfStale(crashed_endpoint.substr(crashed_endpoint.find('/'))));
+
+  // The dead receiver doesn't get in the way of other publishers
+  auto publisher = ShmPublisher::Create(4, 64);
+  ASSERT_NE(publisher, nullptr);
+  ASSERT_TRUE(subscriber->Connect("127.0.0.1", publisher->GetConnectionInformation(), 0));
+  ASSERT_EQ(subscriber->GetPublisherCount(), 1);
+  publisher->SendMessage(CreatePacket("hello"));
+  for (int i = 0; i < 100 && num_received == 0; i++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  ASSERT_EQ(num_received, 1);
+
+  // A publisher that shuts down cleanly is noticed right away
+  const auto start = std::chrono::steady_clock::now();
+  publisher.reset();
+  ASSERT_TRUE(wait_for_publisher_count(0));
+  ASSERT_LT(std::chrono::steady_clock::now() - start, SHM_LIVENESS_CHECK_INTERVAL);
+}
+
+/**
+ * Test that a subscriber that couldn't connect at first is connected by a later update, with the publishers unchanged
+ */
+TEST_F(TestShmTransport, RetryConnect) {
+  auto publisher = ShmPublisher::Create(4, 64);
+  ASSERT_NE(publisher, nullptr);
+
+  // Take every subscriber entry, so that connecting fails
+  std::vector<std::shared_ptr<ShmReader>> readers = AttachAll(*GetSegment(*publisher));
+  ASSERT_EQ(readers.size(), SHM_MAX_SUBSCRIBERS);
+
+  basis::core::threading::ThreadPool work_thread_pool(1);
+  TransportManager transport_manager;
+  transport_manager.RegisterTransport(SHM_TRANSPORT_NAME, std::make_unique<ShmTransport>());
+  std::atomic<int> num_received = 0;
+  auto subscriber = transport_manager.SubscribeRaw(
+      "test", [&](std::shared_ptr<MessagePacket>) { num_received++; }, &work_thread_pool, nullptr, {});
+
+  const proto::NetworkInfo network_info = CreateNetworkInfo("test", *publisher);
+  const auto now = std::chrono::steady_clock::now();
+  ASSERT_EQ(transport_manager.HandleNetworkInfo(network_info, now), 1);
+  ASSERT_EQ(subscriber->GetPublisherCount(), 0);
+
+  // An entry frees up - the same NetworkInfo again is enough
+  readers.pop_back();
+  ASSERT_EQ(transport_manager.HandleNetworkInfo(network_info, now + TransportManager::CONNECT_RETRY_INTERVAL), 0);
+  ASSERT_EQ(subscriber->GetPublisherCount(), 1);
+
+  publisher->SendMessage(CreatePacket("hello"));
+  for (int i = 0; i < 100 && num_received == 0; i++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  ASSERT_EQ(num_received, 1);
+}
+
+/**
+ * Test that a subscriber that can't attach to its publisher's next generation right away keeps trying on its own - the
+ * publishers are unchanged, so no update would reconnect it
+ */
+TEST_F(TestShmTransport, FollowGrowthRetries) {
+  auto publisher = ShmPublisher::Create(4, 64);
+  ASSERT_NE(publisher, nullptr);
+
+  std::mutex received_mutex;
+  std::vector<size_t> received;
+  std::atomic<bool> in_callback = false;
+  std::atomic<bool> release = false;
+  auto received_sizes = [&] {
+    std::lock_guard lock(received_mutex);
+    return received;
+  };
+
+  basis::core::threading::ThreadPool work_thread_pool(1);
+  TransportManager transport_manager;
+  transport_manager.RegisterTransport(SHM_TRANSPORT_NAME, std::make_unique<ShmTransport>());
+  auto subscriber = transport_manager.SubscribeRaw(
+      "test",
+      [&](std::shared_ptr<MessagePacket> packet) {
+        in_callback = true;
+        while (!release) {
+          std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        std::lock_guard lock(received_mutex);
+        received.push_back(packet->GetPayload().size());
+      },
+      &work_thread_pool, nullptr, {});
+
+  const proto::NetworkInfo network_info = CreateNetworkInfo("test", *publisher);
+  const auto now = std::chrono::steady_clock::now();
+  transport_manager.HandleNetworkInfo(network_info, now);
+  ASSERT_EQ(subscriber->GetPublisherCount(), 1);
+
+  publisher->SendMessage(CreatePacket("small"));
+  for (int i = 0; i < 100 && !in_callback; i++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  ASSERT_TRUE(in_callback);
+
+  // Grow while the subscriber is busy, then take every entry of the new generation before it gets there
+  publisher->SendMessage(CreatePacket(std::string(200, 'x')));
+  std::vector<std::shared_ptr<ShmReader>> readers = AttachAll(*GetSegment(*publisher));
+  ASSERT_EQ(readers.size(), SHM_MAX_SUBSCRIBERS);
+  release = true;
+
+  // Stuck on the first generation, which is kept around for it
+  for (int i = 0; i < 100 && received_sizes().empty(); i++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  std::this_thread::sleep_for(SHM_ATTACH_RETRY_MAX_DELAY);
+  ASSERT_EQ(received_sizes(), std::vector<size_t>{5});
+  ASSERT_EQ(GetPreviousSegmentCount(*publisher), 1);
+  ASSERT_EQ(subscriber->GetPublisherCount(), 1);
+
+  transport_manager.HandleNetworkInfo(network_info, now + TransportManager::CONNECT_RETRY_INTERVAL);
+  readers.pop_back();
+  for (int i = 0; i < 100 && received_sizes().size() != 2; i++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  ASSERT_EQ(received_sizes(), (std::vector<size_t>{5, 200}));
+  ASSERT_EQ(subscriber->GetPublisherCount(), 1);
+}
+
+/**
+ * Test that the transport manager picks shared memory over TCP for a local publisher
+ */
+TEST_F(TestShmTransport, PreferredOverTcp) {
+  basis::core::threading::ThreadPool work_thread_pool(4);
+
+  TransportManager transport_manager;
+  transport_manager.RegisterTransport(TCP_TRANSPORT_NAME, std::make_unique<TcpTransport>());
+  transport_manager.RegisterTransport(SHM_TRANSPORT_NAME, std::make_unique<ShmTransport>());
+
+  auto send_msg = std::make_shared<TestProtoStruct>();
+  send_msg->set_foo(3);
+  send_msg->set_bar(8.5);
+  send_msg->set_baz("baz");
+
+  std::atomic<int> callback_times{0};
+  SubscriberCallback<TestProtoStruct> callback = [&](std::shared_ptr<const TestProtoStruct> t) {
+    ASSERT_TRUE(google::protobuf::util::MessageDifferencer::Equals(*send_msg, *t));
+    callback_times++;
+  };
+
+  auto test_publisher = transport_manager.Advertise<TestProtoStruct>("test_shm");
+  ASSERT_NE(test_publisher, nullptr);
+  transport_manager.Update();
+
+  auto pub_info = transport_manager.GetLastPublisherInfo();
+  ASSERT_EQ(pub_info.size(), 1);
+  ASSERT_EQ(pub_info[0].transport_info.count(SHM_TRANSPORT_NAME), 1);
+  ASSERT_EQ(pub_info[0].transport_info.count(TCP_TRANSPORT_NAME), 1);
+
+  auto subscriber = transport_manager.Subscribe<TestProtoStruct>("test_shm", callback, &work_thread_pool);
+  transport_manager.Update();
+
+  ASSERT_EQ(GetShmSubscriber(subscriber.get())->GetPublisherCount(), 1);
+  ASSERT_EQ(GetTcpSubscriber(subscriber.get())->GetPublisherCount(), 0);
+  ASSERT_EQ(test_publisher->GetTransportSubscriberCount(), 1);
+
+  test_publisher->Publish(send_msg);
+
+  for (int i = 0; i < 100 && callback_times == 0; i++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  ASSERT_EQ(callback_times, 1);
+}
@@ -6,8 +6,13 @@
 
 #include <cassert>
 #include <fcntl.h>
+#include <functional>
+#include <mutex>
 #include <spdlog/spdlog.h>
 #include <sys/epoll.h>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
 namespace basis::plugins::transport {
 
@@ -30,7 +35,12 @@ struct Epoll {
   // done when the thread loops, it locks and checks if there's work to be done, no need to wait for cv
 
   // todo: check for CAP_BLOCK_SUSPEND
-  Epoll();
+
+  /**
+   * @param events the events to wait for on every fd - EPOLLIN for receiving, EPOLLOUT for sending. Always oneshot.
+   * @param thread_count number of threads calling epoll_wait. Callbacks for a single fd are never run concurrently.
+   */
+  Epoll(uint32_t events = EPOLLIN, size_t thread_count = 1);
 
   /*
   Epoll(const Epoll&) = delete;
@@ -59,8 +69,11 @@ private:
   void MainThread();
   // todo https://idea.popcount.org/2017-03-20-epoll-is-fundamentally-broken-22/
   // https://lwn.net/Articles/520012/
-  std::thread epoll_main_thread;
+  std::vector<std::thread> epoll_threads;
   int epoll_fd = -1;
+  /// eventfd used to wake the epoll threads on shutdown
+  int wake_fd = -1;
+  const uint32_t events;
   std::atomic<bool> stop = false;
 
   struct CallbackContext {
@@ -1,7 +1,9 @@
 #pragma once
 
-#include <condition_variable>
-#include <thread>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
 #include <vector>
 
 #include "epoll.h"
@@ -17,38 +19,48 @@ class TestTcpTransport;
 
 namespace basis::plugins::transport {
 
+/**
+ * Number of threads shared by every TcpSender in the process for writing to sockets.
+ */
+constexpr size_t TCP_SEND_THREAD_COUNT = 2;
+
+/**
+ * Packets at least this large are sent with MSG_ZEROCOPY, when the socket supports it. Below this, the cost of pinning
+ * pages and handling the completion outweighs the copy.
+ */
+constexpr size_t TCP_ZEROCOPY_THRESHOLD = 64 * 1024;
+
 /**
  * Used to send serialized data over TCP.
  *
  * Basic building block for sending data over the network.
  *
- * Currently spawns thread per publisher. This should be performant but will waste memory in stack allocations.
+ * Senders don't own a thread - every sender in the process shares one small, epoll driven pool of send threads (see
+ * GetSharedSendEpoll()). SendMessage() queues the packet and arms EPOLLOUT on the socket; a send thread then writes as
+ * much of the queue as the socket will take, and re-arms if the socket's buffer fills up part way through.
  *
- * @todo Move to using a worker/thread pool - should be relatively easy.
+ * Queued packets are gathered into a single sendmsg() where possible. Packets of TCP_ZEROCOPY_THRESHOLD or more are
+ * sent on their own with MSG_ZEROCOPY and kept alive until the kernel reports it's done with them. Completions are
+ * only collected when the sender next wakes up, so the last large packet sent may be held until the next send.
  */
 class TcpSender : public TcpConnection {
 public:
   /**
    * Construct a sender, given an already created+valid socket.
    */
-  TcpSender(core::networking::TcpSocket socket, size_t max_queue_size = 0)
-      : TcpConnection(std::move(socket)), max_queue_size(max_queue_size) {
-    StartThread();
-  }
+  TcpSender(core::networking::TcpSocket socket, size_t max_queue_size = 0);
 
   /**
    * Destruct.
    */
   ~TcpSender() {
-    // Do _not_ manually call Close() here if running asynchronously.
-    // Doing so could lead to race conditions. (TODO: why?)
-    // socket.Close();
+    // Do _not_ manually call Close() here - the socket has to be removed from epoll first.
     Stop(true);
   }
 
   bool IsConnected() {
-    // TODO: this does not handle failure cases - needs to query socket internally for validity
-    return socket.IsValid();
+    // TODO: this only catches failures on send, not on an idle connection
+    return socket.IsValid() && !stop_sending;
   }
 
   void SetMaxQueueSize(size_t max_queue_size);
@@ -56,31 +68,95 @@ public:
   // TODO: do we want to be able to send high priority packets?
   void SendMessage(std::shared_ptr<core::transport::MessagePacket> message);
 
-  void Stop(bool wait = false) {
-    {
-      std::lock_guard lock(send_mutex);
-      stop_thread = true;
-    }
-    send_cv.notify_one();
-    if (wait) {
-      if (send_thread.joinable()) {
-        send_thread.join();
-      }
-    }
+  /**
+   * Stop sending, dropping anything queued.
+   *
+   * @param wait if true, also wait for any in progress write to finish
+   */
+  void Stop(bool wait = false);
+
+  /**
+   * The send epoll instance shared by all TcpSenders, created on first use and destroyed with the last sender.
+   */
+  static std::shared_ptr<Epoll> GetSharedSendEpoll();
+
+  struct SendStats {
+    /// Packets fully written to the socket
+    uint64_t messages = 0;
+    uint64_t bytes = 0;
+    /// sendmsg() calls, including ones that would have blocked
+    uint64_t send_calls = 0;
+    /// sendmsg() calls made with MSG_ZEROCOPY
+    uint64_t zerocopy_send_calls = 0;
+  };
+
+  /**
+   * Packets queued or partway through being written to the socket - how far behind this subscriber is.
+   */
+  size_t GetPendingMessageCount() const {
+    return stop_sending ? 0 : pending_messages.load(std::memory_order_relaxed);
+  }
+
+  SendStats GetSendStats() const {
+    return {.messages = messages_sent.load(std::memory_order_relaxed),
+            .bytes = bytes_sent.load(std::memory_order_relaxed),
+            .send_calls = send_calls.load(std::memory_order_relaxed),
+            .zerocopy_send_calls = zerocopy_send_calls.load(std::memory_order_relaxed)};
   }
 
 protected:
   friend class ::TestTcpTransport;
 
 private:
-  void StartThread();
+  /// Upper bound on the packets gathered into a single sendmsg()
+  static constexpr size_t MAX_IOVECS = 64;
+
+  /**
+   * Called from the send epoll when the socket is writable.
+   */
+  void OnWritable();
+
+  /**
+   * Send as much of in_flight as possible with one sendmsg(), advancing past whatever was sent.
+   *
+   * @return the number of bytes sent, 0 if the socket would block, or -1 on error.
+   */
+  int SendBatch();
+
+  /**
+   * Release any packets the kernel has finished zerocopy sending.
+   */
+  void ReapZerocopyCompletions();
+
+  std::shared_ptr<Epoll> send_epoll;
 
-  std::thread send_thread;
-  std::condition_variable send_cv;
   std::mutex send_mutex;
   std::vector<std::shared_ptr<const core::transport::MessagePacket>> send_buffer;
   size_t max_queue_size = 0;
-  std::atomic<bool> stop_thread = false;
+  /// True if the socket is armed in epoll or OnWritable() is running, so SendMessage() doesn't have to arm it again
+  bool send_scheduled = true;
+  std::atomic<bool> stop_sending = false;
+
+  /// Packets taken off send_buffer by OnWritable(), only touched from there
+  std::vector<std::shared_ptr<const core::transport::MessagePacket>> in_flight;
+  /// The packet in in_flight currently being sent
+  size_t in_flight_index = 0;
+  /// How much of that packet has been sent already
+  size_t in_flight_offset = 0;
+
+  /// Only touched from OnWritable()
+  bool zerocopy_enabled = false;
+  /// The id the kernel will assign to the next MSG_ZEROCOPY send
+  uint32_t zerocopy_next_id = 0;
+  /// Packets the kernel may still be reading from, by the id of the send they were part of
+  std::deque<std::pair<uint32_t, std::shared_ptr<const core::transport::MessagePacket>>> zerocopy_pending;
+
+  /// Queued by SendMessage(), minus those trimmed or fully sent
+  std::atomic<size_t> pending_messages = 0;
+  std::atomic<uint64_t> messages_sent = 0;
+  std::atomic<uint64_t> bytes_sent = 0;
+  std::atomic<uint64_t> send_calls = 0;
+  std::atomic<uint64_t> zerocopy_send_calls = 0;
 };
 
 class TcpPublisher : public core::transport::TransportPublisher {
@@ -88,7 +164,12 @@ public:
   // returns a managed pointer due to mutex member
   static nonstd::expected<std::shared_ptr<TcpPublisher>, core::networking::Socket::Error> Create(uint16_t port = 0);
 
-  // TODO: this should probably just be Update() and also check for dead subscriptions
+  /**
+   * Accept any new subscribers, and drop any whose connection has failed.
+   *
+   * @return the number of new subscribers
+   * @todo this should probably just be Update()
+   */
   size_t CheckForNewSubscriptions();
 
   uint16_t GetPort();
@@ -106,6 +187,8 @@ public:
     return senders.size();
   }
 
+  virtual size_t GetPendingMessageCount() override;
+
 protected:
   TcpPublisher(core::networking::TcpListenSocket listen_socket);
 
@@ -5,11 +5,64 @@
 #include <basis/core/transport/transport.h>
 
 #include <memory>
+#include <vector>
 
 #include <basis/plugins/transport/logger.h>
 
 namespace basis::plugins::transport {
 
+/**
+ * Per connection state for TcpConnection::ReceiveMessages().
+ *
+ * Small packets are received many at a time into one large buffer and copied out once complete. A packet larger than
+ * GetDirectReadThreshold() is instead read straight into its own MessagePacket, avoiding the extra copy.
+ */
+class TcpReceiveBuffer {
+public:
+  static constexpr size_t DEFAULT_SIZE = 64 * 1024;
+  static constexpr size_t DEFAULT_MAX_PACKET_SIZE = 512 * 1024 * 1024;
+
+  explicit TcpReceiveBuffer(size_t size = DEFAULT_SIZE, size_t max_packet_size = DEFAULT_MAX_PACKET_SIZE)
+      : size(size), max_packet_size(max_packet_size) {}
+
+  /**
+   * Packets (header included) larger than this bypass the buffer.
+   */
+  size_t GetDirectReadThreshold() const { return size / 4; }
+
+  /**
+   * Number of bytes received but not yet part of a completed packet.
+   */
+  size_t GetPendingBytes() const {
+    return (end - begin) + (direct_packet ? sizeof(core::transport::MessageHeader) + direct_progress : 0);
+  }
+
+  /**
+   * Why ReceiveMessages() last returned ERROR - an errno, EBADMSG or EMSGSIZE for a corrupt stream. Kept here as errno
+   * itself won't survive running the callbacks for whatever was received before the error.
+   */
+  int GetError() const { return error; }
+
+protected:
+  friend class TcpConnection;
+
+  const size_t size;
+  /// Payloads claiming to be larger than this are taken as a corrupt stream, rather than allocated
+  const size_t max_packet_size;
+  int error = 0;
+  /// Allocated on first receive
+  core::transport::PacketBuffer buffer;
+  /// Start of the data not yet parsed into packets
+  size_t begin = 0;
+  /// End of the data received into the buffer
+  size_t end = 0;
+
+  /// A large packet being received directly
+  std::unique_ptr<core::transport::MessagePacket> direct_packet;
+  /// Payload bytes of direct_packet received so far
+  size_t direct_progress = 0;
+};
+
 /**
  * Common class for unifying TcpSender and Receiver functionality.
  *
@@ -62,6 +115,18 @@ public:
    */
   ReceiveStatus ReceiveMessage(basis::core::transport::IncompleteMessagePacket &message);
 
+  /**
+   * Receives as much data as the underlying socket has, in large reads, parsing out every complete packet along the
+   * way. Typically one recv() covers many small packets.
+   *
+   * Completed packets are appended to `out`, even if an error or disconnect happens later on.
+   *
+   * @return DOWNLOADING once the socket has been drained (or a read budget used up - the caller should rearm and will
+   * be called again), ERROR or DISCONNECTED.
+   */
+  ReceiveStatus ReceiveMessages(TcpReceiveBuffer &receive_buffer,
+                                std::vector<std::unique_ptr<basis::core::transport::MessagePacket>> &out);
+
   /**
    * Receives data over the socket into the buffer pointed to by `buffer`
    * Will not return until buffer_len bytes have been received or a disconnect occurs.
@@ -71,7 +136,8 @@ public:
   bool Receive(std::byte *buffer, size_t buffer_len, int timeout_s = -1);
 
   /**
-   * Sends the data pointed at in the buffer over the socket.
+   * Sends the data pointed at in the buffer over the socket, blocking until all of it has been sent.
+   * TcpSender doesn't use this - it's a helper for raw writes and test code.
    *
    * @param data
    * @param len
@@ -79,7 +145,31 @@ public:
    */
   bool Send(const std::byte *data, size_t len);
 
+  /**
+   * Sends as much of the buffer as the socket will currently take, without blocking.
+   *
+   * @return the number of bytes sent (0 if the socket's send buffer is full), or -1 on error.
+   */
+  int TrySend(const std::byte *data, size_t len);
+
+  /**
+   * Sends as much of the buffers as the socket will currently take with a single sendmsg(), without blocking.
+   *
+   * @param flags additional flags for sendmsg(), ie MSG_ZEROCOPY
+   * @return the number of bytes sent (0 if the socket's send buffer is full), or -1 on error.
+   */
+  int TrySendV(std::span<const iovec> buffers, int flags = 0);
+
 protected:
+  /**
+   * Parse every complete packet out of the receive buffer. A large packet is started as the buffer's direct_packet,
+   * with whatever of it has already been received.
+   *
+   * @return false if the stream is corrupt
+   */
+  static bool ParsePackets(TcpReceiveBuffer &receive_buffer,
+                           std::vector<std::unique_ptr<basis::core::transport::MessagePacket>> &out);
+
   /**
    * The underlying socket for this connection.
    */
@@ -1,3 +1,4 @@
+#include <sys/eventfd.h>
 #include <unistd.h>
 
 #include <basis/plugins/transport/epoll.h>
@@ -6,40 +7,59 @@
 namespace basis::plugins::transport {
 using namespace tcp;
 
-Epoll::Epoll() {
+Epoll::Epoll(uint32_t events, size_t thread_count) : events(events) {
   epoll_fd = epoll_create1(EPOLL_CLOEXEC);
   assert(epoll_fd != -1);
 
-  epoll_main_thread = std::thread(&Epoll::MainThread, this);
+  // Level triggered and never disarmed - once written to, every thread will see it
+  wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  assert(wake_fd != -1);
+  epoll_event event;
+  event.events = EPOLLIN;
+  event.data.fd = wake_fd;
+  epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd, &event);
+
+  for (size_t i = 0; i < thread_count; i++) {
+    epoll_threads.emplace_back(&Epoll::MainThread, this);
+  }
 }
 
 Epoll::~Epoll() {
   BASIS_LOG_DEBUG("~Epoll");
   stop = true;
-  if (epoll_main_thread.joinable()) {
-    epoll_main_thread.join();
+  uint64_t one = 1;
+  [[maybe_unused]] ssize_t written = write(wake_fd, &one, sizeof(one));
+  for (auto &thread : epoll_threads) {
+    if (thread.joinable()) {
+      thread.join();
+    }
   }
+  close(wake_fd);
   close(epoll_fd);
 }
 
 void Epoll::MainThread() {
   // https://linux.die.net/man/4/epoll
   constexpr int MAX_EVENTS = 128;
-  epoll_event events[128];
+  epoll_event ready_events[MAX_EVENTS];
   while (!stop) {
-    // Wait for events, indefinitely, checking once per second for shutdown
-    // todo: we could send a signal or add an additional socket for epoll to listen to
-    // to get faster shutdown
-    BASIS_LOG_DEBUG("epoll_wait");
-    int nfds = epoll_wait(epoll_fd, events, MAX_EVENTS, 1000);
+    // Wait for events, indefinitely - shutdown is signaled through wake_fd
+    BASIS_LOG_TRACE("epoll_wait");
+    int nfds = epoll_wait(epoll_fd, ready_events, MAX_EVENTS, -1);
     if (nfds < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
       BASIS_LOG_DEBUG("epoll dieing");
       return;
     }
-    BASIS_LOG_DEBUG("epoll_wait nfds {}", nfds);
+    BASIS_LOG_TRACE("epoll_wait nfds {}", nfds);
     for (int n = 0; n < nfds; ++n) {
-      int fd = events[n].data.fd;
-      BASIS_LOG_DEBUG("Socket {} ready.", events[n].data.fd);
+      int fd = ready_events[n].data.fd;
+      if (fd == wake_fd) {
+        continue;
+      }
+      BASIS_LOG_TRACE("Socket {} ready.", fd);
 
       std::unique_lock map_guard(callbacks_mutex);
       auto it = callbacks.find(fd);
@@ -69,21 +89,27 @@ bool Epoll::AddFd(int fd, Epoll::CallbackType callback) {
   fcntl(fd, F_SETFL, flags | O_NONBLOCK);
 
   epoll_event event;
-  event.events = EPOLLIN | EPOLLET | EPOLLONESHOT; // EPOLLEXCLUSIVE shouldn't be needed for single threaded epoll
+  // EPOLLEXCLUSIVE isn't needed - oneshot already guarantees only one thread is woken per event
+  event.events = events | EPOLLET | EPOLLONESHOT;
   event.data.fd = fd;
 
   // todo: catch EPOLLRDHUP here?
 
+  // The callback has to be in place before the fd is added - if the fd is already ready, the (single) event may be
+  // delivered immediately
+  {
+    std::lock_guard guard(callbacks_mutex);
+
+    callbacks.emplace(fd, callback);
+  }
+
   // This is safe across threads
   // https://bugzilla.kernel.org/show_bug.cgi?id=43072
   if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event)) {
     BASIS_LOG_DEBUG("Failed to add file descriptor to epoll");
-    return false;
-  }
-  {
     std::lock_guard guard(callbacks_mutex);
-
-    callbacks.emplace(fd, callback);
+    callbacks.erase(fd);
+    return false;
   }
   return true;
 }
@@ -110,7 +136,7 @@ void Epoll::RemoveFd(int fd) {
 
 bool Epoll::ReactivateHandle(int fd) {
   epoll_event event;
-  event.events = EPOLLIN | EPOLLET | EPOLLONESHOT;
+  event.events = events | EPOLLET | EPOLLONESHOT;
   event.data.fd = fd;
 
   // This is safe across threads
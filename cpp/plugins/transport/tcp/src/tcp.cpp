@@ -1,4 +1,12 @@
+#include <algorithm>
+#include <array>
 #include <string.h>
+#include <time.h>
+
+// errqueue.h doesn't include the definition of timespec itself
+#include <linux/errqueue.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
 
 #include <basis/plugins/transport/tcp.h>
 
@@ -6,38 +14,194 @@
 
 namespace basis::plugins::transport {
 using namespace tcp;
-void TcpSender::StartThread() {
-  BASIS_LOG_TRACE("Starting TcpSender thread");
-
-  send_thread = std::thread([this]() {
-    while (!stop_thread) {
-      std::vector<std::shared_ptr<const core::transport::MessagePacket>> buffer;
-      {
-        std::unique_lock lock(send_mutex);
-        if (!stop_thread && buffer.empty()) {
-          send_cv.wait(lock, [this] { return stop_thread || !send_buffer.empty(); });
-        }
-        buffer = std::move(send_buffer);
+
+std::shared_ptr<Epoll> TcpSender::GetSharedSendEpoll() {
+  static std::mutex mutex;
+  static std::weak_ptr<Epoll> shared_epoll;
+
+  std::lock_guard lock(mutex);
+  std::shared_ptr<Epoll> epoll = shared_epoll.lock();
+  if (!epoll) {
+    BASIS_LOG_DEBUG("Starting {} TcpSender threads", TCP_SEND_THREAD_COUNT);
+    epoll = std::make_shared<Epoll>(EPOLLOUT, TCP_SEND_THREAD_COUNT);
+    shared_epoll = epoll;
+  }
+  return epoll;
+}
+
+TcpSender::TcpSender(core::networking::TcpSocket socket, size_t max_queue_size)
+    : TcpConnection(std::move(socket)), send_epoll(GetSharedSendEpoll()), max_queue_size(max_queue_size) {
+  int one = 1;
+  zerocopy_enabled = setsockopt(this->socket.GetFd(), SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) == 0;
+
+  // The socket is almost certainly writable already, so this will fire once immediately and find nothing to send -
+  // send_scheduled starts out true to account for that
+  if (!send_epoll->AddFd(this->socket.GetFd(), [this](int, std::unique_lock<std::mutex>) { OnWritable(); })) {
+    BASIS_LOG_ERROR("Failed to add TcpSender socket to epoll");
+    stop_sending = true;
+  }
+}
+
+void TcpSender::Stop(bool wait) {
+  stop_sending = true;
+  {
+    std::lock_guard lock(send_mutex);
+    send_buffer.clear();
+  }
+  if (wait) {
+    // Waits out any running OnWritable()
+    send_epoll->RemoveFd(socket.GetFd());
+  }
+}
+
+void TcpSender::OnWritable() {
+  ReapZerocopyCompletions();
+
+  bool took_batch = false;
+  while (!stop_sending) {
+    if (in_flight_index == in_flight.size()) {
+      in_flight.clear();
+      in_flight_index = 0;
+
+      std::lock_guard lock(send_mutex);
+      if (send_buffer.empty()) {
+        // Leave the socket disarmed until the next SendMessage()
+        send_scheduled = false;
+        return;
       }
-      if (stop_thread) {
+      if (took_batch) {
+        // Go to the back of the line rather than starving other senders sharing this thread
+        send_epoll->ReactivateHandle(socket.GetFd());
         return;
       }
+      in_flight.swap(send_buffer);
+      took_batch = true;
+    }
+
+    const int sent = SendBatch();
+    if (sent < 0) {
+      BASIS_LOG_TRACE("Stopping TcpSender due to {}: {}", errno, strerror(errno));
+      in_flight.clear();
+      in_flight_index = 0;
+      Stop();
+      return;
+    }
+    if (sent == 0) {
+      // The socket's send buffer is full, wait for it to drain
+      send_epoll->ReactivateHandle(socket.GetFd());
+      return;
+    }
+  }
+}
+
+int TcpSender::SendBatch() {
+  std::array<iovec, MAX_IOVECS> iovecs;
+  size_t iovec_count = 0;
+  bool zerocopy = false;
+  // Each packet takes up to two iovecs, see MessagePacket::GetPacketParts()
+  for (size_t i = in_flight_index; i < in_flight.size() && iovec_count + 2 <= iovecs.size(); i++) {
+    const bool large = zerocopy_enabled && in_flight[i]->GetPacketSize() >= TCP_ZEROCOPY_THRESHOLD;
+    if (iovec_count == 0) {
+      zerocopy = large;
+    } else if (large || zerocopy) {
+      // Large packets go out on their own, so that small ones never wait on a zerocopy completion
+      break;
+    }
+    size_t skip = i == in_flight_index ? in_flight_offset : 0;
+    for (std::span<const std::byte> part : in_flight[i]->GetPacketParts()) {
+      if (skip >= part.size()) {
+        skip -= part.size();
+        continue;
+      }
+      part = part.subspan(skip);
+      skip = 0;
+      iovecs[iovec_count++] = {.iov_base = const_cast<std::byte *>(part.data()), .iov_len = part.size()};
+    }
+  }
+
+  std::span<const iovec> buffers(iovecs.data(), iovec_count);
+  send_calls.fetch_add(1, std::memory_order_relaxed);
+  int sent = TrySendV(buffers, zerocopy ? MSG_ZEROCOPY : 0);
+  if (sent < 0 && zerocopy && errno == ENOBUFS) {
+    BASIS_LOG_DEBUG("Out of memory for a zerocopy send, copying instead");
+    zerocopy = false;
+    send_calls.fetch_add(1, std::memory_order_relaxed);
+    sent = TrySendV(buffers);
+  }
+  if (sent <= 0) {
+    return sent;
+  }
+
+  if (zerocopy) {
+    zerocopy_send_calls.fetch_add(1, std::memory_order_relaxed);
+  }
+  bytes_sent.fetch_add(sent, std::memory_order_relaxed);
+
+  // Advance past everything that was sent
+  size_t remaining = sent;
+  while (remaining) {
+    std::shared_ptr<const core::transport::MessagePacket> &packet = in_flight[in_flight_index];
+    if (zerocopy) {
+      // The kernel reads from the packet after sendmsg() returns - hold on to it until the completion comes in
+      zerocopy_pending.emplace_back(zerocopy_next_id, packet);
+    }
+
+    const size_t packet_remaining = packet->GetPacketSize() - in_flight_offset;
+    if (remaining < packet_remaining) {
+      in_flight_offset += remaining;
+      break;
+    }
+    remaining -= packet_remaining;
+
+    // Release the packet as soon as possible, rather than at the end of the batch
+    packet.reset();
+    in_flight_index++;
+    in_flight_offset = 0;
+    pending_messages.fetch_sub(1, std::memory_order_relaxed);
+    messages_sent.fetch_add(1, std::memory_order_relaxed);
+  }
+  if (zerocopy) {
+    zerocopy_next_id++;
+  }
+
+  return sent;
+}
+
+void TcpSender::ReapZerocopyCompletions() {
+  // https://www.kernel.org/doc/html/latest/networking/msg_zerocopy.html
+  while (!zerocopy_pending.empty()) {
+    char control[128];
+    msghdr message = {};
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+    if (recvmsg(socket.GetFd(), &message, MSG_ERRQUEUE) == -1) {
+      // Nothing (else) has completed yet
+      return;
+    }
+
+    for (cmsghdr *cmsg = CMSG_FIRSTHDR(&message); cmsg; cmsg = CMSG_NXTHDR(&message, cmsg)) {
+      if (!(cmsg->cmsg_level == SOL_IP && cmsg->cmsg_type == IP_RECVERR) &&
+          !(cmsg->cmsg_level == SOL_IPV6 && cmsg->cmsg_type == IPV6_RECVERR)) {
+        continue;
+      }
+      const sock_extended_err *error = reinterpret_cast<const sock_extended_err *>(CMSG_DATA(cmsg));
+      if (error->ee_origin != SO_EE_ORIGIN_ZEROCOPY) {
+        continue;
+      }
+
+      if (error->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) {
+        // The kernel had to copy anyways (ie over loopback) - zerocopy is only overhead on this socket
+        BASIS_LOG_DEBUG("Zerocopy sends fell back to a copy, disabling zerocopy for this connection");
+        zerocopy_enabled = false;
+      }
 
-      for (auto &message : buffer) {
-        BASIS_LOG_TRACE("Sending a message of size {}", message->GetPacket().size());
-        std::span<const std::byte> packet = message->GetPacket();
-        if (!Send(packet.data(), packet.size())) {
-          BASIS_LOG_TRACE("Stopping send thread due to {}: {}", errno, strerror(errno));
-          stop_thread = true;
-        }
-        BASIS_LOG_TRACE("Sent");
-        if (stop_thread) {
-          BASIS_LOG_TRACE("stop TcpSender");
-          return;
-        }
+      // Completions cover the inclusive range of send ids [ee_info, ee_data], and arrive in order
+      const uint32_t last_completed = error->ee_data;
+      while (!zerocopy_pending.empty() && int32_t(zerocopy_pending.front().first - last_completed) <= 0) {
+        zerocopy_pending.pop_front();
       }
     }
-  });
+  }
 }
 
 void TcpSender::SetMaxQueueSize(size_t max_queue_size) {
@@ -45,15 +209,21 @@ void TcpSender::SetMaxQueueSize(size_t max_queue_size) {
 
   if (max_queue_size > 0) {
     std::lock_guard lock(send_mutex);
-    while (send_buffer.size() >= max_queue_size)
+    while (send_buffer.size() >= max_queue_size) {
       send_buffer.erase(send_buffer.begin());
+      pending_messages.fetch_sub(1, std::memory_order_relaxed);
+    }
   }
 }
 
 void TcpSender::SendMessage(std::shared_ptr<core::transport::MessagePacket> message) {
-  BASIS_LOG_TRACE("Queueing a message of size {}", message->GetPacket().size());
+  BASIS_LOG_TRACE("Queueing a message of size {}", message->GetPacketSize());
+  bool needs_arming = false;
   {
     std::lock_guard lock(send_mutex);
+    if (stop_sending) {
+      return;
+    }
 
     if (max_queue_size > 0) {
       if (send_buffer.size() >= max_queue_size) {
@@ -62,12 +232,18 @@ void TcpSender::SendMessage(std::shared_ptr<core::transport::MessagePacket> mess
 
       while (send_buffer.size() >= max_queue_size) {
         send_buffer.erase(send_buffer.begin());
+        pending_messages.fetch_sub(1, std::memory_order_relaxed);
       }
     }
 
     send_buffer.emplace_back(std::move(message));
+    pending_messages.fetch_add(1, std::memory_order_relaxed);
+    needs_arming = !send_scheduled;
+    send_scheduled = true;
+  }
+  if (needs_arming) {
+    send_epoll->ReactivateHandle(socket.GetFd());
   }
-  send_cv.notify_one();
 }
 
 nonstd::expected<std::shared_ptr<TcpPublisher>, core::networking::Socket::Error> TcpPublisher::Create(uint16_t port) {
@@ -98,9 +274,23 @@ void TcpPublisher::SendMessage(std::shared_ptr<core::transport::MessagePacket> m
   }
 }
 
+size_t TcpPublisher::GetPendingMessageCount() {
+  std::lock_guard lock(senders_mutex);
+  size_t pending = 0;
+  for (auto &sender : senders) {
+    pending = std::max(pending, sender->GetPendingMessageCount());
+  }
+  return pending;
+}
+
 size_t TcpPublisher::CheckForNewSubscriptions() {
   int num = 0;
 
+  {
+    std::lock_guard lock(senders_mutex);
+    std::erase_if(senders, [](const std::unique_ptr<TcpSender> &sender) { return !sender->IsConnected(); });
+  }
+
   while (auto maybe_sender_socket = listen_socket.Accept(0)) {
     std::lock_guard lock(senders_mutex);
     auto sender = std::make_unique<TcpSender>(std::move(maybe_sender_socket.value()), max_queue_size);
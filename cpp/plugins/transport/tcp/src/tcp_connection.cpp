@@ -1,6 +1,10 @@
 #include <basis/plugins/transport/tcp_connection.h>
 
+#include <algorithm>
+#include <cerrno>
+
 #include <spdlog/spdlog.h>
+#include <sys/socket.h>
 
 #include <basis/plugins/transport/logger.h>
 
@@ -18,6 +22,12 @@ std::unique_ptr<const basis::core::transport::MessagePacket> TcpConnection::Rece
     return {};
   }
 
+  if (header.data_size > TcpReceiveBuffer::DEFAULT_MAX_PACKET_SIZE) {
+    BASIS_LOG_ERROR("ReceiveMessage got a packet of {} bytes, over the {} byte limit", uint32_t(header.data_size),
+                    TcpReceiveBuffer::DEFAULT_MAX_PACKET_SIZE);
+    return {};
+  }
+
   auto message = std::make_unique<core::transport::MessagePacket>(header);
   std::span<std::byte> payload(message->GetMutablePayload());
   if (!Receive(payload.data(), payload.size(), timeout_s)) {
@@ -62,6 +72,113 @@ TcpConnection::ReceiveStatus TcpConnection::ReceiveMessage(core::transport::Inco
   return ReceiveStatus::DONE;
 }
 
+bool TcpConnection::ParsePackets(TcpReceiveBuffer &receive_buffer,
+                                 std::vector<std::unique_ptr<core::transport::MessagePacket>> &out) {
+  using core::transport::MessageHeader;
+  std::byte *buffer = receive_buffer.buffer.get();
+  size_t &begin = receive_buffer.begin;
+
+  while (receive_buffer.end - begin >= sizeof(MessageHeader)) {
+    MessageHeader header;
+    memcpy(&header, buffer + begin, sizeof(header));
+    if (memcmp(header.magic_version, MessageHeader().magic_version, sizeof(header.magic_version)) != 0) {
+      BASIS_LOG_ERROR("ReceiveMessages got a packet with an invalid header");
+      receive_buffer.error = EBADMSG;
+      return false;
+    }
+    if (header.data_size > receive_buffer.max_packet_size) {
+      BASIS_LOG_ERROR("ReceiveMessages got a packet of {} bytes, over the {} byte limit", uint32_t(header.data_size),
+                      receive_buffer.max_packet_size);
+      receive_buffer.error = EMSGSIZE;
+      return false;
+    }
+
+    const size_t buffered_payload = receive_buffer.end - begin - sizeof(MessageHeader);
+    if (sizeof(MessageHeader) + header.data_size > receive_buffer.GetDirectReadThreshold()) {
+      // Too big to go through the buffer - take what we have and read the rest directly into the packet
+      receive_buffer.direct_packet = std::make_unique<core::transport::MessagePacket>(header);
+      receive_buffer.direct_progress = std::min<size_t>(buffered_payload, header.data_size);
+      memcpy(receive_buffer.direct_packet->GetMutablePayload().data(), buffer + begin + sizeof(MessageHeader),
+             receive_buffer.direct_progress);
+      begin += sizeof(MessageHeader) + receive_buffer.direct_progress;
+      if (receive_buffer.direct_progress == header.data_size) {
+        out.push_back(std::move(receive_buffer.direct_packet));
+        receive_buffer.direct_progress = 0;
+      }
+      continue;
+    }
+
+    if (buffered_payload < header.data_size) {
+      break;
+    }
+    auto packet = std::make_unique<core::transport::MessagePacket>(header);
+    memcpy(packet->GetMutablePayload().data(), buffer + begin + sizeof(MessageHeader), header.data_size);
+    out.push_back(std::move(packet));
+    begin += sizeof(MessageHeader) + header.data_size;
+  }
+  return true;
+}
+
+TcpConnection::ReceiveStatus
+TcpConnection::ReceiveMessages(TcpReceiveBuffer &receive_buffer,
+                               std::vector<std::unique_ptr<core::transport::MessagePacket>> &out) {
+  // Bounds the time spent on one connection if the sender is keeping up with us
+  constexpr int MAX_READS = 16;
+
+  if (!receive_buffer.buffer) {
+    receive_buffer.buffer = core::transport::PacketPool::Global().Allocate(receive_buffer.size);
+  }
+  std::byte *buffer = receive_buffer.buffer.get();
+
+  for (int reads = 0; reads < MAX_READS; reads++) {
+    std::span<std::byte> target;
+    if (receive_buffer.direct_packet) {
+      target = receive_buffer.direct_packet->GetMutablePayload().subspan(receive_buffer.direct_progress);
+    } else {
+      // Move the partial packet left at the end of the last read (at most GetDirectReadThreshold() bytes) to the front
+      if (receive_buffer.begin != 0) {
+        memmove(buffer, buffer + receive_buffer.begin, receive_buffer.end - receive_buffer.begin);
+        receive_buffer.end -= receive_buffer.begin;
+        receive_buffer.begin = 0;
+      }
+      target = std::span<std::byte>(buffer + receive_buffer.end, receive_buffer.size - receive_buffer.end);
+    }
+
+    const int count = socket.RecvInto((char *)target.data(), target.size());
+    if (count < 0) {
+      if (errno != EAGAIN && errno != EWOULDBLOCK) {
+        receive_buffer.error = errno;
+        BASIS_LOG_ERROR("ReceiveMessages failed due to {} {}", receive_buffer.error, strerror(receive_buffer.error));
+        return ReceiveStatus::ERROR;
+      }
+      return ReceiveStatus::DOWNLOADING;
+    }
+    if (count == 0) {
+      return ReceiveStatus::DISCONNECTED;
+    }
+    BASIS_LOG_TRACE("ReceiveMessages Got {} bytes", count);
+
+    if (receive_buffer.direct_packet) {
+      receive_buffer.direct_progress += count;
+      if (receive_buffer.direct_progress == receive_buffer.direct_packet->GetPayload().size()) {
+        out.push_back(std::move(receive_buffer.direct_packet));
+        receive_buffer.direct_progress = 0;
+      }
+    } else {
+      receive_buffer.end += count;
+      if (!ParsePackets(receive_buffer, out)) {
+        return ReceiveStatus::ERROR;
+      }
+    }
+
+    // A short read means the socket is empty - skip the recv() that would only tell us EAGAIN
+    if ((size_t)count < target.size()) {
+      return ReceiveStatus::DOWNLOADING;
+    }
+  }
+  return ReceiveStatus::DOWNLOADING;
+}
+
 bool TcpConnection::Receive(std::byte *buffer, size_t buffer_len, int timeout_s) {
   while (buffer_len) {
     if (timeout_s >= 0) {
@@ -90,18 +207,15 @@ bool TcpConnection::Receive(std::byte *buffer, size_t buffer_len, int timeout_s)
 bool TcpConnection::Send(const std::byte *data, size_t len) {
   // TODO: this loop should go on a helper on Socket(?)
   while (len) {
-    int sent_size = socket.Send(data, len);
-    BASIS_LOG_TRACE("TCP Sent {} bytes", sent_size);
+    int sent_size = TrySend(data, len);
     if (sent_size < 0) {
-      // Very large sends can cause EAGAIN if we fill the send buffer
-      if(errno == EAGAIN || errno == EWOULDBLOCK) {
-        socket.Select(core::networking::Socket::SelectType::WRITE, 0, 1e4);
-        continue;
-      }
-
-      BASIS_LOG_ERROR("TcpConnection::Send Error: {}", errno);      
       return false;
     }
+    if (sent_size == 0) {
+      // Very large sends can fill the send buffer - sleep until there's room again
+      socket.Select(core::networking::Socket::SelectType::WRITE, 1, 0);
+      continue;
+    }
     len -= sent_size;
     data += sent_size;
   }
@@ -109,4 +223,33 @@ bool TcpConnection::Send(const std::byte *data, size_t len) {
   return true;
 }
 
+int TcpConnection::TrySend(const std::byte *data, size_t len) {
+  int sent_size = socket.Send(data, len);
+  BASIS_LOG_TRACE("TCP Sent {} bytes", sent_size);
+  if (sent_size < 0) {
+    if (errno == EAGAIN || errno == EWOULDBLOCK) {
+      return 0;
+    }
+    BASIS_LOG_ERROR("TcpConnection::Send Error: {} {}", errno, strerror(errno));
+    return -1;
+  }
+  return sent_size;
+}
+
+int TcpConnection::TrySendV(std::span<const iovec> buffers, int flags) {
+  int sent_size = socket.SendV(buffers, flags);
+  BASIS_LOG_TRACE("TCP Sent {} bytes from {} buffers", sent_size, buffers.size());
+  if (sent_size < 0) {
+    if (errno == EAGAIN || errno == EWOULDBLOCK) {
+      return 0;
+    }
+    // Out of memory to pin pages for a zerocopy send - not fatal, the caller can retry with a copy
+    if (errno != ENOBUFS || !(flags & MSG_ZEROCOPY)) {
+      BASIS_LOG_ERROR("TcpConnection::SendV Error: {} {}", errno, strerror(errno));
+    }
+    return -1;
+  }
+  return sent_size;
+}
+
 } // namespace basis::plugins::transport
\ No newline at end of file
@@ -64,26 +64,32 @@ bool TcpSubscriber::ConnectToPort(std::string_view address, uint16_t port) {
     receivers.emplace(key, std::move(receiver));
   }
 
-  auto on_epoll_callback = [this, key](int fd, std::unique_lock<std::mutex> lock, TcpReceiver *receiver_ptr,
-                                  std::shared_ptr<core::transport::IncompleteMessagePacket> incomplete) {
+  auto on_epoll_callback = [this](int fd, std::unique_lock<std::mutex> lock, TcpReceiver *receiver_ptr,
+                                   std::shared_ptr<TcpReceiveBuffer> receive_buffer) {
     BASIS_LOG_DEBUG("Queuing work for socket {}", fd);
 
-    worker_pool->enqueue([this, fd, incomplete = std::move(incomplete), receiver_ptr, lock = std::move(lock), key] {
+    worker_pool->post([this, fd, receive_buffer = std::move(receive_buffer), receiver_ptr, lock = std::move(lock)] {
       // It's an error to actually call this with multiple threads.
       // TODO: add debug only checks for this
-      switch (receiver_ptr->ReceiveMessage(*incomplete)) {
+      std::vector<std::unique_ptr<core::transport::MessagePacket>> messages;
+      const TcpReceiver::ReceiveStatus status = receiver_ptr->ReceiveMessages(*receive_buffer, messages);
 
-      case TcpReceiver::ReceiveStatus::DONE: {
-        this->callback(incomplete->GetCompletedMessage());
+      // Everything completed by this read goes out in one batch, even if the connection failed afterwards
+      for (auto &message : messages) {
+        this->callback(std::move(message));
       }
+
+      switch (status) {
+      case TcpReceiver::ReceiveStatus::DONE:
       case TcpReceiver::ReceiveStatus::DOWNLOADING: {
-        // No work to be done
         break;
       }
       case TcpReceiver::ReceiveStatus::ERROR: {
         // TODO
-        BASIS_LOG_ERROR("{}, {}: bytes {} - got error {} {}", fd, (void *)incomplete.get(),
-                        incomplete->GetCurrentProgress(), errno, strerror(errno));
+        BASIS_LOG_ERROR("{}, {}: bytes {} - got error {} {}", fd, (void *)receive_buffer.get(),
+                        receive_buffer->GetPendingBytes(), receive_buffer->GetError(),
+                        strerror(receive_buffer->GetError()));
+        [[fallthrough]];
       }
       case TcpReceiver::ReceiveStatus::DISCONNECTED: {
         // TODO: this needs to be updated when we gracefully handle disconnection
@@ -98,7 +104,7 @@ bool TcpSubscriber::ConnectToPort(std::string_view address, uint16_t port) {
   TcpReceiver *receiver_ptr = &receivers.at(key);
   epoll->AddFd(receiver_ptr->GetSocket().GetFd(),
                std::bind(on_epoll_callback, std::placeholders::_1, std::placeholders::_2, receiver_ptr,
-                         std::make_shared<core::transport::IncompleteMessagePacket>()));
+                         std::make_shared<TcpReceiveBuffer>()));
 
   return true;
 }
@@ -1,3 +1,4 @@
+#include <fcntl.h>
 #include <memory>
 #include <span>
 #include <thread>
@@ -36,6 +37,12 @@ class TestTcpTransport : public testing::Test {
 public:
   TestTcpTransport() { spdlog::set_level(spdlog::level::debug); }
 
+  // Tests quiet the global logger down as they see fit (ie SendBenchmark) - put it back for whatever runs next, even if
+  // an assertion bailed out early
+  ~TestTcpTransport() { spdlog::set_level(previous_log_level); }
+
+  const spdlog::level::level_enum previous_log_level = spdlog::get_level();
+
   TcpListenSocket CreateListenSocket(uint16_t port = 0) {
     spdlog::debug("Create TcpListenSocket");
     auto maybe_listen_socket = TcpListenSocket::Create(port);
@@ -127,6 +134,247 @@ TEST_F(TestTcpTransport, NoCoordinator) {
   ASSERT_NE(receiver->ReceiveMessage(1.0), nullptr);
 }
 
+/**
+ * Send messages much larger than the socket buffers, to a receiver that isn't reading yet - the send threads have to
+ * park the partial write and pick it back up on EPOLLOUT
+ */
+TEST_F(TestTcpTransport, PartialWrites) {
+  TcpListenSocket listen_socket = CreateListenSocket();
+  std::unique_ptr<TcpReceiver> receiver = SubscribeToPort(listen_socket.GetPort());
+  std::unique_ptr<TcpSender> sender = AcceptOneKnownClient(listen_socket);
+
+  constexpr size_t MESSAGE_SIZE = 8 * 1024 * 1024;
+  constexpr int MESSAGE_COUNT = 3;
+  for (int i = 0; i < MESSAGE_COUNT; i++) {
+    auto message = std::make_shared<basis::core::transport::MessagePacket>(
+        basis::core::transport::MessageHeader::DataType::MESSAGE, MESSAGE_SIZE);
+    std::span<std::byte> payload = message->GetMutablePayload();
+    for (size_t j = 0; j < payload.size(); j++) {
+      payload[j] = std::byte((j + i) % 251);
+    }
+    sender->SendMessage(message);
+  }
+
+  // Let the socket buffers fill up
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  // More than the socket buffers can hold, so the receiver is visibly behind
+  ASSERT_GT(sender->GetPendingMessageCount(), 0u);
+  ASSERT_LE(sender->GetPendingMessageCount(), size_t(MESSAGE_COUNT));
+
+  for (int i = 0; i < MESSAGE_COUNT; i++) {
+    auto msg = receiver->ReceiveMessage(1);
+    ASSERT_NE(msg, nullptr);
+    std::span<const std::byte> payload = msg->GetPayload();
+    ASSERT_EQ(payload.size(), MESSAGE_SIZE);
+    for (size_t j = 0; j < payload.size(); j++) {
+      ASSERT_EQ(payload[j], std::byte((j + i) % 251)) << "message " << i << " byte " << j;
+    }
+  }
+  ASSERT_TRUE(sender->IsConnected());
+  ASSERT_EQ(sender->GetPendingMessageCount(), 0u);
+
+  // A closed receiver should be noticed on the next send
+  receiver.reset();
+  for (int i = 0; i < 10 && sender->IsConnected(); i++) {
+    sender->SendMessage(std::make_shared<basis::core::transport::MessagePacket>(
+        basis::core::transport::MessageHeader::DataType::MESSAGE, MESSAGE_SIZE));
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  ASSERT_FALSE(sender->IsConnected());
+}
+
+/**
+ * Packets whose payload isn't contiguous with their header (ie replayed straight out of a mapped recording) go out as
+ * two iovecs, and must survive being split across writes
+ */
+TEST_F(TestTcpTransport, BorrowedPayload) {
+  TcpListenSocket listen_socket = CreateListenSocket();
+  std::unique_ptr<TcpReceiver> receiver = SubscribeToPort(listen_socket.GetPort());
+  std::unique_ptr<TcpSender> sender = AcceptOneKnownClient(listen_socket);
+
+  constexpr int MESSAGE_COUNT = 6;
+  auto payload_size = [](int i) -> size_t { return i % 2 ? 4 * 1024 * 1024 + i : 100 + i; };
+  for (int i = 0; i < MESSAGE_COUNT; i++) {
+    auto storage = std::make_shared<std::vector<std::byte>>(payload_size(i));
+    for (size_t j = 0; j < storage->size(); j++) {
+      (*storage)[j] = std::byte((j + i) % 251);
+    }
+    auto message = std::make_shared<basis::core::transport::MessagePacket>(
+        basis::core::transport::MessageHeader::DataType::MESSAGE, std::span<const std::byte>(*storage), storage);
+    ASSERT_FALSE(message->IsContiguous());
+    sender->SendMessage(message);
+  }
+
+  for (int i = 0; i < MESSAGE_COUNT; i++) {
+    auto msg = receiver->ReceiveMessage(1);
+    ASSERT_NE(msg, nullptr);
+    std::span<const std::byte> payload = msg->GetPayload();
+    ASSERT_EQ(payload.size(), payload_size(i));
+    for (size_t j = 0; j < payload.size(); j++) {
+      ASSERT_EQ(payload[j], std::byte((j + i) % 251)) << "message " << i << " byte " << j;
+    }
+  }
+}
+
+/**
+ * Small packets should be parsed many at a time out of the receive buffer, large ones read directly into their packet
+ */
+TEST_F(TestTcpTransport, BatchedReceive) {
+  TcpListenSocket listen_socket = CreateListenSocket();
+  std::unique_ptr<TcpReceiver> receiver = SubscribeToPort(listen_socket.GetPort());
+  std::unique_ptr<TcpSender> sender = AcceptOneKnownClient(listen_socket);
+  int flags = fcntl(receiver->GetSocket().GetFd(), F_GETFL);
+  fcntl(receiver->GetSocket().GetFd(), F_SETFL, flags | O_NONBLOCK);
+
+  TcpReceiveBuffer receive_buffer;
+  // Small, then one large enough to bypass the buffer, then small again
+  std::vector<size_t> sizes;
+  for (size_t i = 0; i < 1000; i++) {
+    sizes.push_back(i % 100);
+  }
+  sizes.push_back(1024 * 1024);
+  for (size_t i = 0; i < 10; i++) {
+    sizes.push_back(i);
+  }
+
+  for (size_t i = 0; i < sizes.size(); i++) {
+    auto message = std::make_shared<basis::core::transport::MessagePacket>(
+        basis::core::transport::MessageHeader::DataType::MESSAGE, sizes[i]);
+    std::span<std::byte> payload = message->GetMutablePayload();
+    for (size_t j = 0; j < payload.size(); j++) {
+      payload[j] = std::byte(i + j);
+    }
+    sender->SendMessage(message);
+  }
+
+  std::vector<std::unique_ptr<MessagePacket>> received;
+  size_t calls = 0;
+  const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while (received.size() < sizes.size() && std::chrono::steady_clock::now() < deadline) {
+    ASSERT_EQ(receiver->ReceiveMessages(receive_buffer, received), TcpReceiver::ReceiveStatus::DOWNLOADING);
+    calls++;
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+
+  ASSERT_EQ(received.size(), sizes.size());
+  ASSERT_EQ(receive_buffer.GetPendingBytes(), 0);
+  spdlog::info("Received {} messages in {} calls", received.size(), calls);
+  for (size_t i = 0; i < sizes.size(); i++) {
+    std::span<const std::byte> payload = received[i]->GetPayload();
+    ASSERT_EQ(payload.size(), sizes[i]);
+    for (size_t j = 0; j < payload.size(); j++) {
+      ASSERT_EQ(payload[j], std::byte(i + j)) << "message " << i << " byte " << j;
+    }
+  }
+
+  // The sender going away is reported, after anything already received
+  sender.reset();
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  ASSERT_EQ(receiver->ReceiveMessages(receive_buffer, received), TcpReceiver::ReceiveStatus::DISCONNECTED);
+}
+
+/**
+ * Headers straight off the wire can't be trusted - a bad magic or an absurd size is an error, not an allocation
+ */
+TEST_F(TestTcpTransport, CorruptStream) {
+  TcpListenSocket listen_socket = CreateListenSocket();
+  auto receive_until_done = [](TcpReceiver &receiver, TcpReceiveBuffer &receive_buffer,
+                               std::vector<std::unique_ptr<MessagePacket>> &received) {
+    int flags = fcntl(receiver.GetSocket().GetFd(), F_GETFL);
+    fcntl(receiver.GetSocket().GetFd(), F_SETFL, flags | O_NONBLOCK);
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    TcpReceiver::ReceiveStatus status = TcpReceiver::ReceiveStatus::DOWNLOADING;
+    while (status == TcpReceiver::ReceiveStatus::DOWNLOADING && std::chrono::steady_clock::now() < deadline) {
+      status = receiver.ReceiveMessages(receive_buffer, received);
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return status;
+  };
+
+  {
+    std::unique_ptr<TcpReceiver> receiver = SubscribeToPort(listen_socket.GetPort());
+    std::unique_ptr<TcpSender> sender = AcceptOneKnownClient(listen_socket);
+    TcpReceiveBuffer receive_buffer(TcpReceiveBuffer::DEFAULT_SIZE, 1024);
+    sender->SendMessage(
+        std::make_shared<MessagePacket>(basis::core::transport::MessageHeader::DataType::MESSAGE, 1000));
+    sender->SendMessage(
+        std::make_shared<MessagePacket>(basis::core::transport::MessageHeader::DataType::MESSAGE, 2000));
+
+    std::vector<std::unique_ptr<MessagePacket>> received;
+    ASSERT_EQ(receive_until_done(*receiver, receive_buffer, received), TcpReceiver::ReceiveStatus::ERROR);
+    ASSERT_EQ(receive_buffer.GetError(), EMSGSIZE);
+    // Everything before the oversized packet still arrives
+    ASSERT_EQ(received.size(), 1u);
+    ASSERT_EQ(received[0]->GetPayload().size(), 1000u);
+  }
+
+  {
+    std::unique_ptr<TcpReceiver> receiver = SubscribeToPort(listen_socket.GetPort());
+    std::unique_ptr<TcpSender> sender = AcceptOneKnownClient(listen_socket);
+    TcpReceiveBuffer receive_buffer;
+    std::vector<std::byte> garbage(sizeof(MessageHeader), std::byte(0xff));
+    ASSERT_TRUE(Send(*sender, garbage.data(), garbage.size()));
+
+    std::vector<std::unique_ptr<MessagePacket>> received;
+    ASSERT_EQ(receive_until_done(*receiver, receive_buffer, received), TcpReceiver::ReceiveStatus::ERROR);
+    ASSERT_EQ(receive_buffer.GetError(), EBADMSG);
+    ASSERT_TRUE(received.empty());
+  }
+}
+
+/**
+ * Not so much a test as a benchmark - reports the send syscalls per message and the throughput for a storm of small
+ * messages versus large frames.
+ */
+TEST_F(TestTcpTransport, SendBenchmark) {
+  struct BenchmarkCase {
+    std::string name;
+    size_t message_size;
+    size_t message_count;
+  };
+
+  for (const BenchmarkCase &benchmark : {BenchmarkCase{"small messages", 64, 50000},
+                                         BenchmarkCase{"large frames", 4 * 1024 * 1024, 100}}) {
+    TcpListenSocket listen_socket = CreateListenSocket();
+    std::unique_ptr<TcpReceiver> receiver = SubscribeToPort(listen_socket.GetPort());
+    std::unique_ptr<TcpSender> sender = AcceptOneKnownClient(listen_socket);
+    spdlog::set_level(spdlog::level::info);
+
+    size_t received = 0;
+    std::thread receive_thread([&]() {
+      while (received < benchmark.message_count && receiver->ReceiveMessage(5)) {
+        received++;
+      }
+    });
+
+    auto message = std::make_shared<basis::core::transport::MessagePacket>(
+        basis::core::transport::MessageHeader::DataType::MESSAGE, benchmark.message_size);
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < benchmark.message_count; i++) {
+      sender->SendMessage(message);
+    }
+    receive_thread.join();
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    // Wait out the send thread, so the stats are final
+    sender->Stop(true);
+    const TcpSender::SendStats stats = sender->GetSendStats();
+
+    spdlog::info("{}: {} x {} bytes in {:.3f}s - {:.0f} messages/s, {:.1f} MB/s, {:.3f} sendmsg calls per message ({} "
+                 "zerocopy)",
+                 benchmark.name, benchmark.message_count, benchmark.message_size, elapsed.count(),
+                 benchmark.message_count / elapsed.count(), stats.bytes / elapsed.count() / 1e6,
+                 double(stats.send_calls) / stats.messages, stats.zerocopy_send_calls);
+
+    ASSERT_EQ(received, benchmark.message_count);
+    ASSERT_EQ(stats.messages, benchmark.message_count);
+    if (benchmark.message_size < TCP_ZEROCOPY_THRESHOLD) {
+      // Anything queued while a send is in progress goes out in one call
+      ASSERT_LT(stats.send_calls, stats.messages);
+    }
+  }
+}
+
 /**
  * Test creating a publisher.
  */
@@ -478,7 +726,7 @@ TEST_F(TestTcpTransport, MPSCQueue) {
   Epoll poller;
   ThreadPool thread_pool(4);
 
-  basis::core::containers::SimpleMPSCQueue<std::shared_ptr<MessagePacket>> output_queue;
+  basis::core::containers::MPSCQueue<std::shared_ptr<MessagePacket>> output_queue;
 
   /**
    * Create callback, storing in the bind
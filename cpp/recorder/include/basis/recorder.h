@@ -1,20 +1,30 @@
 #pragma once
-#define MCAP_COMPRESSION_NO_LZ4
-#define MCAP_COMPRESSION_NO_ZSTD
 
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
 #include <filesystem>
+#include <map>
+#include <mutex>
+#include <optional>
 #include <regex>
 #include <span>
 #include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
 #include <mcap/mcap.hpp>
 #include <spdlog/spdlog.h>
 
-#include <basis/core/containers/simple_mpsc.h>
+#include <basis/core/containers/mpsc_queue.h>
 #include <basis/core/logging/macros.h>
 #include <basis/core/serialization/message_type_info.h>
 #include <basis/core/time.h>
 
+#include "recorder/options.h"
+
 DEFINE_AUTO_LOGGER_NS(basis::recorder)
 
 namespace basis {
@@ -28,7 +38,7 @@ public:
   OwningSpan(std::shared_ptr<T> ptr, const std::span<const std::byte> &span)
       : owning_object(std::move(ptr)), span(span) {}
 
-  const std::span<const std::byte> &Span() { return span; }
+  const std::span<const std::byte> &Span() const { return span; }
 
 private:
   std::shared_ptr<const void> owning_object;
@@ -58,117 +68,334 @@ public:
   virtual bool WriteMessage(const std::string &topic, OwningSpan payload, const basis::core::MonotonicTime &now) = 0;
 };
 
+/**
+ * mcap sink that hands writes off to a thread of its own, so that whoever is filling (and compressing) chunks never
+ * waits on the disk. Writes stay in order. At most `max_pending_bytes` are held before handleWrite() blocks.
+ */
+class ThreadedFileWriter final : public mcap::IWritable {
+public:
+  explicit ThreadedFileWriter(size_t max_pending_bytes = 64 * 1024 * 1024) : max_pending_bytes(max_pending_bytes) {}
+  ~ThreadedFileWriter() override { end(); }
+
+  mcap::Status open(std::string_view filename);
+
+  /**
+   * Waits for all pending writes, then closes the file.
+   */
+  void end() override;
+
+  uint64_t size() const override { return bytes_written; }
+
+protected:
+  void handleWrite(const std::byte *data, uint64_t size) override;
+
+private:
+  void Flush();
+  void WriteThread();
+
+  static constexpr size_t BUFFER_SIZE = 1024 * 1024;
+
+  const size_t max_pending_bytes;
+  std::FILE *file = nullptr;
+  /// Total handed to handleWrite() - what mcap uses for offsets
+  uint64_t bytes_written = 0;
+  std::vector<std::byte> buffer;
+
+  std::mutex mutex;
+  std::condition_variable pending_changed;
+  std::deque<std::vector<std::byte>> pending;
+  size_t pending_bytes = 0;
+  bool ending = false;
+  std::thread write_thread;
+};
+
+/**
+ * Writes messages as they come in - any compression happens on the thread calling WriteMessage(), once a chunk fills.
+ * Use AsyncRecorder to keep that off of publishing threads.
+ *
+ * With RecorderOptions::IsSegmented(), the recording is split into `{name}_{index}.mcap` segments. The next segment is
+ * opened ahead of time with every schema and channel already added, so rolling over never waits on the disk. Closing
+ * the previous segment (writing its summary and index) and deleting segments past `max_segments` happens on a
+ * background thread.
+ */
 class Recorder : public RecorderInterface {
 public:
   static const std::vector<std::pair<std::string, std::regex>> RECORD_ALL_TOPICS;
 
+  /**
+   * @param threaded_file_writes write to disk from a separate thread, see ThreadedFileWriter
+   */
   Recorder(const std::filesystem::path &recording_dir = {},
-           const std::vector<std::pair<std::string, std::regex>> &topic_patterns = RECORD_ALL_TOPICS)
-      : recording_dir(recording_dir), topic_patterns(topic_patterns) {}
+           const std::vector<std::pair<std::string, std::regex>> &topic_patterns = RECORD_ALL_TOPICS,
+           const RecorderOptions &options = {}, bool threaded_file_writes = false)
+      : recording_dir(recording_dir), topic_patterns(topic_patterns), options(options),
+        threaded_file_writes(threaded_file_writes) {}
   ~Recorder() { Stop(); }
 
-  virtual bool Start(std::string_view output_name) override {
-    std::string output_filename(output_name);
-    output_filename += ".mcap";
+  virtual bool Start(std::string_view output_name) override;
 
-    auto status = writer.open((recording_dir / output_filename).string(), mcap::McapWriterOptions("basis"));
-    if (!status.ok()) {
-      BASIS_LOG_ERROR(status.message);
-    }
-    return status.ok();
-  }
-
-  virtual void Stop() override { writer.close(); }
+  /**
+   * Closes the current file, waiting for every segment to be finalized.
+   */
+  virtual void Stop() override;
 
+  /**
+   * Continues the recording in a new file (or series of segments) named `new_name`, without dropping any messages.
+   * The current file is finalized in the background.
+   */
   bool Split(std::string_view new_name);
 
   virtual bool RegisterTopic(const std::string &topic, const core::serialization::MessageTypeInfo &message_type_info,
                              const core::serialization::MessageSchema &basis_schema) override;
 
+  /**
+   * @return the channel a registered topic is written to, nullopt if the topic isn't recorded
+   */
+  std::optional<mcap::ChannelId> GetChannelId(const std::string &topic) const {
+    auto it = topic_to_channel.find(topic);
+    if (it == topic_to_channel.end()) {
+      return std::nullopt;
+    }
+    return it->second;
+  }
+
   virtual bool WriteMessage(const std::string &topic, OwningSpan payload,
                             const basis::core::MonotonicTime &now) override {
     return WriteMessage(topic, payload.Span(), now);
   }
 
   bool WriteMessage(const std::string &topic, const std::span<const std::byte> &payload,
+                    const basis::core::MonotonicTime &now) {
+    return WriteMessage(*topic_to_channel.at(topic), payload, now);
+  }
+
+  bool WriteMessage(mcap::ChannelId channel_id, const std::span<const std::byte> &payload,
                     const basis::core::MonotonicTime &now);
 
+  /**
+   * @return the path of the file currently being written, empty if not started
+   */
+  std::filesystem::path GetCurrentPath() const { return current ? current->path : std::filesystem::path(); }
+
+  static mcap::McapWriterOptions ToMcapWriterOptions(const RecorderOptions &options);
+
 private:
-  mcap::McapWriter writer;
+  /**
+   * A single output file.
+   */
+  struct Segment {
+    std::filesystem::path path;
+    /// Only with threaded_file_writes - must outlive `writer`
+    std::unique_ptr<ThreadedFileWriter> file_writer;
+    mcap::McapWriter writer;
+    /// Stamp of the first message written, for segment_max_duration
+    core::MonotonicTime first_message_time;
+  };
+
+  struct FinishedSegment {
+    std::unique_ptr<Segment> segment;
+    /// Never written to - remove it rather than keep an empty file around
+    bool discard = false;
+  };
+
+  /**
+   * Opens a file and adds every schema and channel registered so far. Requires `segment_mutex`.
+   */
+  std::unique_ptr<Segment> OpenSegment(const std::filesystem::path &path);
+
+  /**
+   * Opens a file and writes the mcap header, without any registrations. Safe to call without `segment_mutex`.
+   */
+  std::unique_ptr<Segment> OpenSegmentFile(const std::filesystem::path &path) const;
+
+  /**
+   * Adds every schema and channel registered so far. Requires `segment_mutex`.
+   */
+  void AddRegistrations(Segment &segment) const;
+
+  /**
+   * Requires `segment_mutex`.
+   */
+  std::filesystem::path NextSegmentPath();
+
+  bool NeedsRollover(const core::MonotonicTime &now) const;
+
+  /**
+   * Swaps in the next segment and hands the current one off to be finalized.
+   */
+  bool Rollover();
+
+  void FinalizeThread();
+
+  /**
+   * Deletes the oldest finished segments past `max_segments`. Requires `segment_mutex`.
+   */
+  void ApplyRetention();
+
+  /// Only touched by the writing thread
+  std::unique_ptr<Segment> current;
+
+  /// Guards everything below, shared with the finalize thread
+  std::mutex segment_mutex;
+  std::condition_variable segments_changed;
+  /// Opened ahead of time, ready for the next rollover
+  std::unique_ptr<Segment> next;
+  /// Set when `next` should be opened in the background
+  bool want_next = false;
+  /// Set while the finalize thread is opening `next` with the lock released
+  bool opening_next = false;
+  std::deque<FinishedSegment> to_finalize;
+  /// Finalized segments of this recording, oldest first
+  std::deque<std::filesystem::path> finished_segments;
+  std::string segment_base_name;
+  uint64_t segment_index = 0;
+  bool stopping = false;
+  std::thread finalize_thread;
+
+  /// Registrations in order, so that every segment assigns the same ids
+  std::vector<mcap::Schema> schemas;
+  std::vector<mcap::Channel> channels;
+  std::unordered_map<std::string, mcap::SchemaId> schema_id_to_mcap_schema_id;
+  std::unordered_map<std::string, std::optional<mcap::ChannelId>> topic_to_channel;
 
-  std::unordered_map<std::string, mcap::Schema> schema_id_to_mcap_schema;
-  std::unordered_map<std::string, std::optional<mcap::Channel>> topic_to_channel;
   std::filesystem::path recording_dir;
   std::vector<std::pair<std::string, std::regex>> topic_patterns;
+  RecorderOptions options;
+  bool threaded_file_writes;
 };
 
+/**
+ * Queues messages to be written on a background thread - WriteMessage() never touches the file.
+ *
+ * Recording is a pipeline: publishers queue messages, the recording thread packs them into (compressed) chunks, and a
+ * ThreadedFileWriter writes the chunks out in order. By default the queue is unbounded and nothing is dropped - see
+ * AsyncRecorderOptions for bounding it and for what happens when the disk can't keep up.
+ */
 class AsyncRecorder : public RecorderInterface {
 public:
-  // TODO: max record queue size
+  /**
+   * Counters for a single topic. Every message passed to WriteMessage() counts as queued, and is eventually either
+   * written or dropped.
+   */
+  struct TopicStats {
+    uint64_t queued_messages = 0;
+    uint64_t queued_bytes = 0;
+    uint64_t written_messages = 0;
+    uint64_t written_bytes = 0;
+    uint64_t dropped_messages = 0;
+    uint64_t dropped_bytes = 0;
+  };
+
   AsyncRecorder(const std::filesystem::path &recording_dir = {},
                 const std::vector<std::pair<std::string, std::regex>> &topic_patterns = Recorder::RECORD_ALL_TOPICS,
-                bool drain_queue_on_stop = true)
-      : drain_queue_on_stop(drain_queue_on_stop), recorder(recording_dir, topic_patterns) {}
+                const AsyncRecorderOptions &async_options = {}, const RecorderOptions &options = {})
+      : async_options(async_options), recorder(recording_dir, topic_patterns, options, true) {}
   ~AsyncRecorder() { Stop(); }
 
-  virtual bool Start(std::string_view output_name) {
-    bool success = recorder.Start(output_name);
-    if (success) {
-      recording_thread = std::thread([this]() { WorkThread(); });
-    }
-    return success;
-  }
+  virtual bool Start(std::string_view output_name) override;
 
   // TODO: it may be better to have a wait time and a force stop flag
-  virtual void Stop() {
-    stop = true;
-    if (recording_thread.joinable()) {
-      recording_thread.join();
-    }
-
-    recorder.Stop();
-  }
+  virtual void Stop() override;
 
   virtual bool RegisterTopic(const std::string &topic, const core::serialization::MessageTypeInfo &message_type_info,
-                             const core::serialization::MessageSchema &basis_schema) {
-    std::lock_guard lock(mutex);
-    return recorder.RegisterTopic(topic, message_type_info, basis_schema);
-  }
+                             const core::serialization::MessageSchema &basis_schema) override;
 
-  virtual bool WriteMessage(const std::string &topic, OwningSpan payload, const basis::core::MonotonicTime &now) {
-    work_queue.Emplace({topic, std::move(payload), now});
-    return true;
-  }
+  /**
+   * Queues the message, applying the overflow policy if the queue is full.
+   *
+   * @return false if the topic isn't recorded, or the message was dropped
+   */
+  virtual bool WriteMessage(const std::string &topic, OwningSpan payload,
+                            const basis::core::MonotonicTime &now) override;
 
-private:
-  void WorkThread() {
-    const basis::core::RealTimeDuration wait_time = basis::core::RealTimeDuration::FromSeconds(0.1);
-    while (!stop) {
-      auto event = work_queue.Pop(wait_time);
-      if (event) {
-        recorder.WriteMessage(event->topic, event->payload, event->stamp);
-      }
-    }
+  /**
+   * Counters for every registered topic.
+   */
+  std::vector<std::pair<std::string, TopicStats>> GetTopicStats() const;
 
-    if (drain_queue_on_stop) {
-      while (auto event = work_queue.Pop()) {
-        recorder.WriteMessage(event->topic, event->payload, event->stamp);
-      }
-    }
-  }
+private:
+  /**
+   * A recorded topic, interned - queued messages refer to it by index.
+   */
+  struct Channel {
+    Channel(std::string topic, mcap::ChannelId mcap_channel_id, int priority)
+        : topic(std::move(topic)), mcap_channel_id(mcap_channel_id), priority(priority) {}
+
+    const std::string topic;
+    const mcap::ChannelId mcap_channel_id;
+    const int priority;
+
+    std::atomic<uint64_t> queued_messages = 0;
+    std::atomic<uint64_t> queued_bytes = 0;
+    std::atomic<uint64_t> written_messages = 0;
+    std::atomic<uint64_t> written_bytes = 0;
+    std::atomic<uint64_t> dropped_messages = 0;
+    std::atomic<uint64_t> dropped_bytes = 0;
+  };
 
   struct RecordEvent {
-    std::string topic;
+    Channel *channel;
+    /// Keeps queue order across priorities
+    uint64_t sequence;
     OwningSpan payload;
     core::MonotonicTime stamp;
   };
 
-  core::containers::SimpleMPSCQueue<RecordEvent> work_queue;
+  void WorkThread();
+
+  /**
+   * Makes room for a message of `size` bytes at `priority`, per the overflow policy. Requires `queue_mutex`.
+   *
+   * @return false if the incoming message should be dropped instead
+   */
+  bool MakeRoom(std::unique_lock<std::mutex> &lock, size_t size, int priority);
+
+  bool Fits(size_t size) const {
+    const uint64_t messages = queued_messages + in_flight_messages;
+    if (messages == 0) {
+      // Always let a single message through, no matter how large
+      return true;
+    }
+    const uint64_t bytes = queued_bytes + in_flight_bytes;
+    return (async_options.max_queue_bytes == 0 || bytes + size <= async_options.max_queue_bytes) &&
+           (async_options.max_queue_messages == 0 || messages + 1 <= async_options.max_queue_messages);
+  }
+
+  /**
+   * Removes the oldest message queued at `priority`, counting it as dropped. Requires `queue_mutex`.
+   */
+  void DropOldest(std::map<int, std::deque<RecordEvent>>::iterator level);
+
+  /**
+   * Moves everything queued into `out`, in the order it was queued. It stays counted against the queue limits until
+   * it's written. Requires `queue_mutex`.
+   */
+  void TakeQueued(std::vector<RecordEvent> &out);
+
+  void Write(std::vector<RecordEvent> &events);
+
+  const AsyncRecorderOptions async_options;
+
+  mutable std::mutex queue_mutex;
+  /// Only ever appended to, so that queued messages can point at their channel
+  std::deque<Channel> channels;
+  std::unordered_map<std::string, Channel *> topic_to_channel;
+
+  std::condition_variable work_available;
+  std::condition_variable space_available;
+  /// Queued messages, by topic priority
+  std::map<int, std::deque<RecordEvent>> queue;
+  uint64_t next_sequence = 0;
+  uint64_t queued_bytes = 0;
+  uint64_t queued_messages = 0;
+  /// Taken off the queue by the recording thread, but not yet written
+  uint64_t in_flight_bytes = 0;
+  uint64_t in_flight_messages = 0;
+  bool stop = false;
 
-  bool drain_queue_on_stop;
-  std::atomic<bool> stop = false;
   std::thread recording_thread;
-  std::mutex mutex;
+  /// Guards `recorder` between RegisterTopic() and the recording thread
+  std::mutex recorder_mutex;
   Recorder recorder;
 };
 } // namespace recorder
@@ -176,5 +403,7 @@ private:
 using recorder::AsyncRecorder;
 using recorder::Recorder;
 using recorder::RecorderInterface;
+using recorder::AsyncRecorderOptions;
+using recorder::RecorderOptions;
 
 } // namespace basis
\ No newline at end of file
@@ -0,0 +1,161 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <regex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <basis/core/time.h>
+
+namespace basis::recorder {
+
+/**
+ * Mirrors mcap::Compression, without pulling mcap into everything that configures a recorder.
+ */
+enum class Compression { None, Lz4, Zstd };
+
+/**
+ * Mirrors mcap::CompressionLevel.
+ */
+enum class CompressionLevel { Fastest, Fast, Default, Slow, Slowest };
+
+inline std::optional<Compression> CompressionFromString(std::string_view name) {
+  if (name == "none") {
+    return Compression::None;
+  }
+  if (name == "lz4") {
+    return Compression::Lz4;
+  }
+  if (name == "zstd") {
+    return Compression::Zstd;
+  }
+  return std::nullopt;
+}
+
+inline std::optional<CompressionLevel> CompressionLevelFromString(std::string_view name) {
+  if (name == "fastest") {
+    return CompressionLevel::Fastest;
+  }
+  if (name == "fast") {
+    return CompressionLevel::Fast;
+  }
+  if (name == "default") {
+    return CompressionLevel::Default;
+  }
+  if (name == "slow") {
+    return CompressionLevel::Slow;
+  }
+  if (name == "slowest") {
+    return CompressionLevel::Slowest;
+  }
+  return std::nullopt;
+}
+
+/**
+ * How messages are laid out in a recording.
+ */
+struct RecorderOptions {
+  /**
+   * Messages are buffered until a chunk reaches this size, then the chunk is compressed and written out.
+   * 0 disables chunking, and with it compression.
+   */
+  uint64_t chunk_size = 1024 * 768;
+  Compression compression = Compression::None;
+  CompressionLevel compression_level = CompressionLevel::Default;
+  /**
+   * Write chunk and message indices, letting readers seek without scanning the whole file.
+   */
+  bool chunk_indexing = true;
+
+  /**
+   * Roll over to a new file once the current one reaches this many bytes, 0 to never split on size.
+   * Measured as written by mcap, so with chunking a file overshoots by up to one chunk.
+   */
+  uint64_t segment_max_bytes = 0;
+  /**
+   * Roll over to a new file once the current one spans this much time, 0 to never split on time.
+   */
+  core::Duration segment_max_duration = core::Duration::FromNanoseconds(0);
+  /**
+   * Delete the oldest segments once there are more than this many, 0 to keep all of them.
+   */
+  size_t max_segments = 0;
+
+  bool IsSegmented() const { return segment_max_bytes != 0 || segment_max_duration.nsecs > 0; }
+
+  bool operator==(const RecorderOptions &) const = default;
+};
+
+/**
+ * What AsyncRecorder does with a message that doesn't fit in its queue.
+ */
+enum class OverflowPolicy {
+  /// Wait for the writer to catch up - stalls the publisher
+  Block,
+  /// Drop the oldest queued messages to make room
+  DropOldest,
+  /// Drop the incoming message
+  DropNewest,
+  /// Drop the oldest queued message of the lowest priority topic - or the incoming message, if its topic is lower
+  DropLowestPriority,
+};
+
+inline std::optional<OverflowPolicy> OverflowPolicyFromString(std::string_view name) {
+  if (name == "block") {
+    return OverflowPolicy::Block;
+  }
+  if (name == "drop_oldest") {
+    return OverflowPolicy::DropOldest;
+  }
+  if (name == "drop_newest") {
+    return OverflowPolicy::DropNewest;
+  }
+  if (name == "priority") {
+    return OverflowPolicy::DropLowestPriority;
+  }
+  return std::nullopt;
+}
+
+struct TopicPriority {
+  std::string pattern;
+  std::regex regex;
+  /// Higher is kept longer. Topics matching no pattern have priority 0.
+  int priority = 0;
+
+  bool operator==(const TopicPriority &other) const {
+    return pattern == other.pattern && priority == other.priority;
+  }
+};
+
+struct AsyncRecorderOptions {
+  /// Payload bytes that may be waiting to be written, 0 for unlimited
+  uint64_t max_queue_bytes = 0;
+  /// Messages that may be waiting to be written, 0 for unlimited
+  uint64_t max_queue_messages = 0;
+  /// What to do once a limit is hit. Recording is lossless unless a dropping policy is asked for.
+  OverflowPolicy overflow_policy = OverflowPolicy::Block;
+  /// First match wins
+  std::vector<TopicPriority> topic_priorities;
+  /// Write out everything queued on Stop(), rather than dropping it
+  bool drain_queue_on_stop = true;
+
+  bool operator==(const AsyncRecorderOptions &) const = default;
+};
+
+struct SnapshotRecorderOptions {
+  /// History each snapshot starts with
+  core::Duration pre_trigger_duration = core::Duration::FromSeconds(30);
+  /// How long recording continues after the trigger - triggering again during this extends it
+  core::Duration post_trigger_duration = core::Duration::FromSeconds(10);
+  /// Payload bytes held for the pre-trigger window, 0 for unlimited. The oldest messages go first. Separately bounds
+  /// messages waiting to be buffered or written, which are dropped as they come in instead.
+  uint64_t max_buffer_bytes = 512 * 1024 * 1024;
+  /// Any message published on this topic triggers a snapshot - empty to only trigger from code
+  std::string trigger_topic;
+
+  bool operator==(const SnapshotRecorderOptions &) const = default;
+};
+
+} // namespace basis::recorder
@@ -0,0 +1,174 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+#include <basis/core/containers/mpsc_queue.h>
+#include <basis/recorder.h>
+
+namespace basis::recorder {
+
+/**
+ * "Black box" recorder - rather than writing everything, holds the last few seconds of messages in memory and only
+ * writes them out when triggered, along with whatever comes in for a while after.
+ *
+ * Buffered messages are the same refcounted payloads handed to every subscriber, so holding on to them costs no
+ * copies. Publishers only take a shared lock to look up the topic and push onto a lock free queue - the ring buffer,
+ * and writing snapshots out, is left to a background thread. Messages waiting for that thread are bounded by
+ * `max_buffer_bytes` as well - past that, publishers drop them rather than queue them.
+ *
+ * Each snapshot is written to `{output_name}_{index}.mcap`.
+ */
+class SnapshotRecorder : public RecorderInterface {
+public:
+  SnapshotRecorder(const std::filesystem::path &recording_dir = {},
+                   const std::vector<std::pair<std::string, std::regex>> &topic_patterns = Recorder::RECORD_ALL_TOPICS,
+                   const SnapshotRecorderOptions &snapshot_options = {}, const RecorderOptions &options = {})
+      : recording_dir(recording_dir), topic_patterns(topic_patterns), snapshot_options(snapshot_options),
+        options(options) {}
+  ~SnapshotRecorder() { Stop(); }
+
+  virtual bool Start(std::string_view output_name) override;
+
+  /**
+   * Finishes any snapshot in progress, cutting its post-trigger tail short. Anything still buffered is discarded.
+   */
+  virtual void Stop() override;
+
+  /**
+   * @return true for recorded topics and the trigger topic
+   */
+  virtual bool RegisterTopic(const std::string &topic, const core::serialization::MessageTypeInfo &message_type_info,
+                             const core::serialization::MessageSchema &basis_schema) override;
+
+  /**
+   * @return false if the topic isn't recorded, the recorder isn't started, or the message was dropped because too much
+   * is already waiting for the snapshot thread
+   */
+  virtual bool WriteMessage(const std::string &topic, OwningSpan payload,
+                            const basis::core::MonotonicTime &now) override;
+
+  /**
+   * Snapshots the window around `stamp` - messages from `pre_trigger_duration` before it, until
+   * `post_trigger_duration` after it. Ordered with respect to WriteMessage() calls from the same thread.
+   */
+  void Trigger(const core::MonotonicTime &stamp = core::MonotonicTime::Now());
+
+  /**
+   * Snapshots started so far.
+   */
+  uint64_t GetSnapshotCount() const { return snapshot_count.load(); }
+
+  /**
+   * Messages dropped so far because too much was waiting for the snapshot thread.
+   */
+  uint64_t GetDroppedMessageCount() const { return dropped_messages.load(); }
+
+  uint64_t GetDroppedByteCount() const { return dropped_bytes.load(); }
+
+private:
+  struct Channel {
+    std::string topic;
+    core::serialization::MessageTypeInfo message_type_info;
+    core::serialization::MessageSchema basis_schema;
+    /// Matches the topic patterns - otherwise only registered as the trigger topic
+    bool record = false;
+    bool trigger = false;
+  };
+
+  struct Event {
+    /// nullptr for Trigger()
+    const Channel *channel;
+    OwningSpan payload;
+    core::MonotonicTime stamp;
+  };
+
+  void SnapshotThread();
+
+  void HandleEvent(Event &event);
+
+  /**
+   * Warns about messages dropped since the last call.
+   */
+  void ReportDrops();
+
+  void StartSnapshot(const core::MonotonicTime &trigger_stamp);
+
+  /**
+   * Hands the snapshot in progress off to the finalize thread.
+   */
+  void FinishSnapshot();
+
+  /**
+   * Closes out finished snapshots (summary, index, joining the writer), so the snapshot thread keeps draining events.
+   */
+  void FinalizeThread();
+
+  /**
+   * Pushes back the clock deadline of the snapshot in progress, after handling an event at `stamp`.
+   */
+  void UpdateSnapshotDeadline(const core::MonotonicTime &stamp);
+
+  /**
+   * Writes to the snapshot in progress.
+   */
+  void Write(Event &event);
+
+  /**
+   * Drops buffered messages that are too old, or over the memory limit.
+   */
+  void Evict(const core::MonotonicTime &newest);
+
+  const std::filesystem::path recording_dir;
+  const std::vector<std::pair<std::string, std::regex>> topic_patterns;
+  const SnapshotRecorderOptions snapshot_options;
+  const RecorderOptions options;
+
+  /// Guards `channels` and `topic_to_channel` - shared by publishers, exclusive by RegisterTopic()
+  mutable std::shared_mutex channel_mutex;
+  /// Only ever appended to, so that events can point at their channel
+  std::deque<Channel> channels;
+  std::unordered_map<std::string, const Channel *> topic_to_channel;
+
+  core::containers::MPSCQueue<Event> events;
+  /// Payload bytes pushed onto `events` and not yet handled by the snapshot thread
+  std::atomic<uint64_t> queued_bytes = 0;
+  std::atomic<uint64_t> dropped_messages = 0;
+  std::atomic<uint64_t> dropped_bytes = 0;
+  std::atomic<bool> running = false;
+  std::atomic<uint64_t> snapshot_count = 0;
+  std::thread snapshot_thread;
+
+  // Everything below is only touched by the snapshot thread
+  std::string output_name;
+  /// dropped_messages as of the last warning
+  uint64_t reported_dropped_messages = 0;
+  /// The pre-trigger window, oldest first
+  std::deque<Event> ring;
+  uint64_t ring_bytes = 0;
+  std::unique_ptr<Recorder> snapshot;
+  core::MonotonicTime snapshot_end;
+  /// When snapshot_end is reached by the clock, assuming stamps keep pace with it from the newest event handled. Lets
+  /// a snapshot finish once traffic stops, even if stamps come from a clock of their own.
+  core::MonotonicTime snapshot_deadline;
+
+  std::mutex finalize_mutex;
+  std::condition_variable finalize_cv;
+  std::deque<std::unique_ptr<Recorder>> to_finalize;
+  bool finalize_stopping = false;
+  std::thread finalize_thread;
+};
+
+} // namespace basis::recorder
+
+namespace basis {
+using recorder::SnapshotRecorder;
+using recorder::SnapshotRecorderOptions;
+} // namespace basis
@@ -4,27 +4,373 @@
 
 #include <basis/recorder.h>
 
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <iterator>
+
 DECLARE_AUTO_LOGGER_NS(basis::recorder)
 
 namespace basis::recorder {
 const std::vector<std::pair<std::string, std::regex>> Recorder::RECORD_ALL_TOPICS = {{".*", std::regex(".*")}};
 
-bool Recorder::Split(std::string_view new_name) {
+mcap::Status ThreadedFileWriter::open(std::string_view filename) {
+  end();
+
+  file = std::fopen(std::string(filename).c_str(), "wb");
+  if (!file) {
+    return mcap::Status{mcap::StatusCode::OpenFailed, fmt::format("failed to open file \"{}\" for writing", filename)};
+  }
+  bytes_written = 0;
+  ending = false;
+  buffer.reserve(BUFFER_SIZE);
+  write_thread = std::thread([this]() { WriteThread(); });
+  return mcap::StatusCode::Success;
+}
+
+void ThreadedFileWriter::end() {
+  if (!file) {
+    return;
+  }
+  Flush();
+  {
+    std::lock_guard lock(mutex);
+    ending = true;
+  }
+  pending_changed.notify_all();
+  write_thread.join();
+  std::fclose(file);
+  file = nullptr;
+}
+
+void ThreadedFileWriter::handleWrite(const std::byte *data, uint64_t size) {
+  buffer.insert(buffer.end(), data, data + size);
+  bytes_written += size;
+  if (buffer.size() >= BUFFER_SIZE) {
+    Flush();
+  }
+}
+
+void ThreadedFileWriter::Flush() {
+  if (buffer.empty()) {
+    return;
+  }
+  const size_t size = buffer.size();
+  {
+    std::unique_lock lock(mutex);
+    pending_changed.wait(lock, [&]() { return pending.empty() || pending_bytes + size <= max_pending_bytes; });
+    pending.push_back(std::move(buffer));
+    pending_bytes += size;
+  }
+  pending_changed.notify_all();
+  buffer = {};
+  buffer.reserve(BUFFER_SIZE);
+}
+
+void ThreadedFileWriter::WriteThread() {
+  bool failed = false;
+  std::unique_lock lock(mutex);
+  while (true) {
+    pending_changed.wait(lock, [this]() { return !pending.empty() || ending; });
+    if (pending.empty()) {
+      return;
+    }
+    std::vector<std::byte> data = std::move(pending.front());
+    pending.pop_front();
+
+    lock.unlock();
+    if (std::fwrite(data.data(), 1, data.size(), file) != data.size() && !failed) {
+      BASIS_LOG_ERROR("Failed to write to recording: {}", strerror(errno));
+      failed = true;
+    }
+    lock.lock();
+
+    pending_bytes -= data.size();
+    pending_changed.notify_all();
+  }
+}
+
+namespace {
+void AddSchema(mcap::McapWriter &writer, const mcap::Schema &registered) {
+  mcap::Schema schema = registered;
+  writer.addSchema(schema);
+  if (schema.id != registered.id) {
+    BASIS_LOG_ERROR("Schema {} was given id {} rather than {}", schema.name, schema.id, registered.id);
+  }
+}
+
+void AddChannel(mcap::McapWriter &writer, const mcap::Channel &registered) {
+  mcap::Channel channel = registered;
+  writer.addChannel(channel);
+  if (channel.id != registered.id) {
+    BASIS_LOG_ERROR("Channel {} was given id {} rather than {}", channel.topic, channel.id, registered.id);
+  }
+}
+} // namespace
+
+bool Recorder::Start(std::string_view output_name) {
   Stop();
 
-  return Start(new_name);
+  {
+    std::lock_guard lock(segment_mutex);
+    stopping = false;
+    finished_segments.clear();
+    segment_base_name = output_name;
+    segment_index = 0;
+    current = OpenSegment(NextSegmentPath());
+    if (!current) {
+      return false;
+    }
+    want_next = options.IsSegmented();
+  }
+  finalize_thread = std::thread([this]() { FinalizeThread(); });
+  return true;
+}
+
+void Recorder::Stop() {
+  {
+    std::lock_guard lock(segment_mutex);
+    if (current) {
+      to_finalize.push_back({std::move(current)});
+    }
+    if (next) {
+      to_finalize.push_back({std::move(next), true});
+    }
+    want_next = false;
+    stopping = true;
+  }
+  segments_changed.notify_all();
+  if (finalize_thread.joinable()) {
+    finalize_thread.join();
+  }
+}
+
+std::unique_ptr<Recorder::Segment> Recorder::OpenSegment(const std::filesystem::path &path) {
+  auto segment = OpenSegmentFile(path);
+  if (segment) {
+    AddRegistrations(*segment);
+  }
+  return segment;
+}
+
+std::unique_ptr<Recorder::Segment> Recorder::OpenSegmentFile(const std::filesystem::path &path) const {
+  auto segment = std::make_unique<Segment>();
+  segment->path = path;
+  const mcap::McapWriterOptions writer_options = ToMcapWriterOptions(options);
+
+  if (threaded_file_writes) {
+    segment->file_writer = std::make_unique<ThreadedFileWriter>();
+    auto status = segment->file_writer->open(path.string());
+    if (!status.ok()) {
+      BASIS_LOG_ERROR(status.message);
+      return nullptr;
+    }
+    segment->writer.open(*segment->file_writer, writer_options);
+  } else {
+    auto status = segment->writer.open(path.string(), writer_options);
+    if (!status.ok()) {
+      BASIS_LOG_ERROR(status.message);
+      return nullptr;
+    }
+  }
+  return segment;
+}
+
+void Recorder::AddRegistrations(Segment &segment) const {
+  for (const mcap::Schema &schema : schemas) {
+    AddSchema(segment.writer, schema);
+  }
+  for (const mcap::Channel &channel : channels) {
+    AddChannel(segment.writer, channel);
+  }
+}
+
+std::filesystem::path Recorder::NextSegmentPath() {
+  if (!options.IsSegmented()) {
+    return recording_dir / (segment_base_name + ".mcap");
+  }
+  return recording_dir / fmt::format("{}_{:04}.mcap", segment_base_name, segment_index++);
+}
+
+bool Recorder::NeedsRollover(const core::MonotonicTime &now) const {
+  if (options.segment_max_bytes != 0 && current->writer.dataSink()->size() >= options.segment_max_bytes) {
+    return true;
+  }
+  return options.segment_max_duration.nsecs > 0 && current->first_message_time.IsValid() &&
+         now - current->first_message_time >= options.segment_max_duration;
+}
+
+bool Recorder::Rollover() {
+  {
+    std::unique_lock lock(segment_mutex);
+    // Rather than take the next path ourselves and leave a gap in the segment numbering
+    segments_changed.wait(lock, [this]() { return !opening_next; });
+    std::unique_ptr<Segment> previous = std::move(current);
+    if (next) {
+      current = std::move(next);
+    } else {
+      // The finalize thread hasn't caught up, or failed to open the file - try here
+      current = OpenSegment(NextSegmentPath());
+    }
+    if (!current) {
+      BASIS_LOG_ERROR("Unable to open a new segment, continuing to write to {}", previous->path.string());
+      current = std::move(previous);
+      return false;
+    }
+    to_finalize.push_back({std::move(previous)});
+    want_next = options.IsSegmented();
+  }
+  segments_changed.notify_all();
+  return true;
+}
+
+void Recorder::FinalizeThread() {
+  std::unique_lock lock(segment_mutex);
+  while (true) {
+    segments_changed.wait(lock, [this]() { return !to_finalize.empty() || (want_next && !next) || stopping; });
+
+    if (!to_finalize.empty()) {
+      FinishedSegment finished = std::move(to_finalize.front());
+      to_finalize.pop_front();
+      lock.unlock();
+
+      const std::filesystem::path path = finished.segment->path;
+      // Writes out the summary and index
+      finished.segment->writer.close();
+      finished.segment.reset();
+      if (finished.discard) {
+        std::error_code error;
+        std::filesystem::remove(path, error);
+      }
+
+      lock.lock();
+      if (!finished.discard) {
+        finished_segments.push_back(path);
+        ApplyRetention();
+      }
+      continue;
+    }
+
+    if (stopping) {
+      return;
+    }
+
+    // Opening touches the disk - do it without holding up RegisterTopic()
+    const std::filesystem::path path = NextSegmentPath();
+    const std::string base_name = segment_base_name;
+    opening_next = true;
+    lock.unlock();
+    std::unique_ptr<Segment> opened = OpenSegmentFile(path);
+    lock.lock();
+    opening_next = false;
+    segments_changed.notify_all();
+
+    if (!opened) {
+      // Leave it to Rollover()
+      want_next = false;
+      continue;
+    }
+    // Split() or Stop() came in while opening
+    if (stopping || segment_base_name != base_name) {
+      to_finalize.push_back({std::move(opened), true});
+      continue;
+    }
+    // Registrations made while the file was opening are picked up here
+    AddRegistrations(*opened);
+    next = std::move(opened);
+  }
+}
+
+void Recorder::ApplyRetention() {
+  if (options.max_segments == 0) {
+    return;
+  }
+  // The segment being written counts against the limit, until the recording is stopped
+  const size_t limit = stopping ? options.max_segments : options.max_segments - 1;
+  while (finished_segments.size() > limit) {
+    std::error_code error;
+    std::filesystem::remove(finished_segments.front(), error);
+    if (error) {
+      BASIS_LOG_WARN("Unable to remove old segment {}: {}", finished_segments.front().string(), error.message());
+    }
+    finished_segments.pop_front();
+  }
 }
 
-bool Recorder::WriteMessage(const std::string &topic, const std::span<const std::byte> &payload,
+mcap::McapWriterOptions Recorder::ToMcapWriterOptions(const RecorderOptions &options) {
+  mcap::McapWriterOptions out("basis");
+  out.noChunking = options.chunk_size == 0;
+  out.chunkSize = options.chunk_size;
+  switch (options.compression) {
+  case Compression::None:
+    out.compression = mcap::Compression::None;
+    break;
+  case Compression::Lz4:
+    out.compression = mcap::Compression::Lz4;
+    break;
+  case Compression::Zstd:
+    out.compression = mcap::Compression::Zstd;
+    break;
+  }
+  switch (options.compression_level) {
+  case CompressionLevel::Fastest:
+    out.compressionLevel = mcap::CompressionLevel::Fastest;
+    break;
+  case CompressionLevel::Fast:
+    out.compressionLevel = mcap::CompressionLevel::Fast;
+    break;
+  case CompressionLevel::Default:
+    out.compressionLevel = mcap::CompressionLevel::Default;
+    break;
+  case CompressionLevel::Slow:
+    out.compressionLevel = mcap::CompressionLevel::Slow;
+    break;
+  case CompressionLevel::Slowest:
+    out.compressionLevel = mcap::CompressionLevel::Slowest;
+    break;
+  }
+  out.noChunkIndex = !options.chunk_indexing;
+  out.noMessageIndex = !options.chunk_indexing;
+  return out;
+}
+
+bool Recorder::Split(std::string_view new_name) {
+  if (!current) {
+    return Start(new_name);
+  }
+
+  {
+    std::lock_guard lock(segment_mutex);
+    if (next) {
+      // Opened under the old name
+      to_finalize.push_back({std::move(next), true});
+    }
+    segment_base_name = new_name;
+    segment_index = 0;
+  }
+  return Rollover();
+}
+
+bool Recorder::WriteMessage(mcap::ChannelId channel_id, const std::span<const std::byte> &payload,
                             const basis::core::MonotonicTime &now) {
+  if (!current) {
+    return false;
+  }
+  if (options.IsSegmented() && NeedsRollover(now)) {
+    Rollover();
+  }
+  if (!current->first_message_time.IsValid()) {
+    current->first_message_time = now;
+  }
+
   mcap::Message msg;
-  msg.channelId = topic_to_channel.at(topic)->id;
+  msg.channelId = channel_id;
   // msg.sequence = 1; // Optional, though we should implement eventually
   msg.logTime = now.nsecs;       // Required nanosecond timestamp
   msg.publishTime = msg.logTime; // for now
   msg.data = payload.data();
   msg.dataSize = payload.size();
-  auto status = writer.write(msg);
+  auto status = current->writer.write(msg);
   if (!status.ok()) {
     BASIS_LOG_ERROR(status.message);
   }
@@ -50,24 +396,263 @@ bool Recorder::RegisterTopic(const std::string &topic, const core::serialization
     return false;
   }
 
-  auto schema_it = schema_id_to_mcap_schema.find(message_type_info.SchemaId());
-  if (schema_it == schema_id_to_mcap_schema.end()) {
-    mcap::Schema schema(message_type_info.name, message_type_info.mcap_schema_encoding,
-                        basis_schema.schema_efficient.empty() ? basis_schema.schema : basis_schema.schema_efficient);
-    writer.addSchema(schema);
-    schema_it = schema_id_to_mcap_schema.emplace(message_type_info.SchemaId(), std::move(schema)).first;
+  // Both the current and pre-opened segments need the new registrations
+  std::lock_guard lock(segment_mutex);
+  const std::array<Segment *, 2> open_segments = {current.get(), next.get()};
+
+  auto schema_it = schema_id_to_mcap_schema_id.find(message_type_info.SchemaId());
+  if (schema_it == schema_id_to_mcap_schema_id.end()) {
+    mcap::Schema &schema =
+        schemas.emplace_back(message_type_info.name, message_type_info.mcap_schema_encoding,
+                             basis_schema.schema_efficient.empty() ? basis_schema.schema : basis_schema.schema_efficient);
+    // The id mcap will assign - the same in every segment, as they're all added in the same order
+    schema.id = mcap::SchemaId(schemas.size());
+    for (Segment *segment : open_segments) {
+      if (segment) {
+        AddSchema(segment->writer, schema);
+      }
+    }
+    schema_it = schema_id_to_mcap_schema_id.emplace(message_type_info.SchemaId(), schema.id).first;
   }
 
-  mcap::Channel channel(topic, message_type_info.mcap_message_encoding, schema_it->second.id);
+  mcap::Channel &channel = channels.emplace_back(topic, message_type_info.mcap_message_encoding, schema_it->second);
+  channel.id = mcap::ChannelId(channels.size());
   // Write the serializer as mcap's well known serializers are slightly different than basis's serializer name
   channel.metadata[core::serialization::MCAP_CHANNEL_METADATA_SERIALIZER] = message_type_info.serializer;
   // Write the hash ID and schema so that we don't have to load a serialization plugin up on replay to dump them
   channel.metadata[core::serialization::MCAP_CHANNEL_METADATA_HASH_ID] = basis_schema.hash_id;
   channel.metadata[core::serialization::MCAP_CHANNEL_METADATA_READABLE_SCHEMA] = basis_schema.schema;
+  for (Segment *segment : open_segments) {
+    if (segment) {
+      AddChannel(segment->writer, channel);
+    }
+  }
 
-  writer.addChannel(channel);
-  topic_to_channel.emplace(std::move(topic), channel);
+  topic_to_channel.emplace(topic, channel.id);
+  return true;
+}
+
+bool AsyncRecorder::Start(std::string_view output_name) {
+  {
+    std::lock_guard lock(recorder_mutex);
+    if (!recorder.Start(output_name)) {
+      return false;
+    }
+  }
+  {
+    std::lock_guard lock(queue_mutex);
+    stop = false;
+  }
+  recording_thread = std::thread([this]() { WorkThread(); });
+  return true;
+}
+
+void AsyncRecorder::Stop() {
+  {
+    std::lock_guard lock(queue_mutex);
+    stop = true;
+  }
+  work_available.notify_all();
+  space_available.notify_all();
+
+  if (recording_thread.joinable()) {
+    recording_thread.join();
+
+    std::lock_guard lock(queue_mutex);
+    // Whatever wasn't drained
+    for (auto level = queue.begin(); level != queue.end(); ++level) {
+      while (!level->second.empty()) {
+        DropOldest(level);
+      }
+    }
+    for (const Channel &channel : channels) {
+      if (const uint64_t dropped = channel.dropped_messages.load()) {
+        BASIS_LOG_WARN("Dropped {} of {} messages ({} bytes) on {}", dropped, channel.queued_messages.load(),
+                       channel.dropped_bytes.load(), channel.topic);
+      }
+    }
+  }
+
+  std::lock_guard lock(recorder_mutex);
+  recorder.Stop();
+}
+
+bool AsyncRecorder::RegisterTopic(const std::string &topic,
+                                  const core::serialization::MessageTypeInfo &message_type_info,
+                                  const core::serialization::MessageSchema &basis_schema) {
+  std::optional<mcap::ChannelId> mcap_channel_id;
+  {
+    std::lock_guard lock(recorder_mutex);
+    if (!recorder.RegisterTopic(topic, message_type_info, basis_schema)) {
+      return false;
+    }
+    mcap_channel_id = recorder.GetChannelId(topic);
+  }
+
+  int priority = 0;
+  for (const TopicPriority &topic_priority : async_options.topic_priorities) {
+    if (std::regex_match(topic, topic_priority.regex)) {
+      priority = topic_priority.priority;
+      break;
+    }
+  }
+
+  std::lock_guard lock(queue_mutex);
+  if (!topic_to_channel.contains(topic)) {
+    Channel &channel = channels.emplace_back(topic, *mcap_channel_id, priority);
+    topic_to_channel.emplace(topic, &channel);
+  }
   return true;
 }
 
-} // namespace basis::recorder
\ No newline at end of file
+bool AsyncRecorder::WriteMessage(const std::string &topic, OwningSpan payload, const basis::core::MonotonicTime &now) {
+  const size_t size = payload.Span().size();
+
+  std::unique_lock lock(queue_mutex);
+  auto it = topic_to_channel.find(topic);
+  if (it == topic_to_channel.end()) {
+    return false;
+  }
+  Channel *channel = it->second;
+  channel->queued_messages.fetch_add(1, std::memory_order_relaxed);
+  channel->queued_bytes.fetch_add(size, std::memory_order_relaxed);
+
+  if (stop || !MakeRoom(lock, size, channel->priority)) {
+    channel->dropped_messages.fetch_add(1, std::memory_order_relaxed);
+    channel->dropped_bytes.fetch_add(size, std::memory_order_relaxed);
+    return false;
+  }
+
+  queue[channel->priority].push_back({channel, next_sequence++, std::move(payload), now});
+  queued_bytes += size;
+  queued_messages++;
+  lock.unlock();
+
+  work_available.notify_one();
+  return true;
+}
+
+std::vector<std::pair<std::string, AsyncRecorder::TopicStats>> AsyncRecorder::GetTopicStats() const {
+  std::vector<std::pair<std::string, TopicStats>> out;
+  std::lock_guard lock(queue_mutex);
+  out.reserve(channels.size());
+  for (const Channel &channel : channels) {
+    out.emplace_back(channel.topic, TopicStats{
+                                        .queued_messages = channel.queued_messages.load(),
+                                        .queued_bytes = channel.queued_bytes.load(),
+                                        .written_messages = channel.written_messages.load(),
+                                        .written_bytes = channel.written_bytes.load(),
+                                        .dropped_messages = channel.dropped_messages.load(),
+                                        .dropped_bytes = channel.dropped_bytes.load(),
+                                    });
+  }
+  return out;
+}
+
+bool AsyncRecorder::MakeRoom(std::unique_lock<std::mutex> &lock, size_t size, int priority) {
+  switch (async_options.overflow_policy) {
+  case OverflowPolicy::Block:
+    space_available.wait(lock, [&]() { return stop || Fits(size); });
+    return !stop;
+  case OverflowPolicy::DropNewest:
+    return Fits(size);
+  case OverflowPolicy::DropOldest:
+    while (!Fits(size)) {
+      auto oldest = queue.end();
+      for (auto level = queue.begin(); level != queue.end(); ++level) {
+        if (!level->second.empty() &&
+            (oldest == queue.end() || level->second.front().sequence < oldest->second.front().sequence)) {
+          oldest = level;
+        }
+      }
+      if (oldest == queue.end()) {
+        // Everything is already being written
+        return false;
+      }
+      DropOldest(oldest);
+    }
+    return true;
+  case OverflowPolicy::DropLowestPriority:
+    while (!Fits(size)) {
+      auto lowest =
+          std::find_if(queue.begin(), queue.end(), [](const auto &level) { return !level.second.empty(); });
+      if (lowest == queue.end() || lowest->first > priority) {
+        return false;
+      }
+      DropOldest(lowest);
+    }
+    return true;
+  }
+  return false;
+}
+
+void AsyncRecorder::DropOldest(std::map<int, std::deque<RecordEvent>>::iterator level) {
+  RecordEvent &event = level->second.front();
+  const size_t size = event.payload.Span().size();
+  event.channel->dropped_messages.fetch_add(1, std::memory_order_relaxed);
+  event.channel->dropped_bytes.fetch_add(size, std::memory_order_relaxed);
+  queued_bytes -= size;
+  queued_messages--;
+  level->second.pop_front();
+}
+
+void AsyncRecorder::TakeQueued(std::vector<RecordEvent> &out) {
+  const size_t start = out.size();
+  for (auto &[_, level] : queue) {
+    std::move(level.begin(), level.end(), std::back_inserter(out));
+    level.clear();
+  }
+  if (queue.size() > 1) {
+    std::sort(out.begin() + start, out.end(),
+              [](const RecordEvent &a, const RecordEvent &b) { return a.sequence < b.sequence; });
+  }
+  in_flight_bytes += queued_bytes;
+  in_flight_messages += queued_messages;
+  queued_bytes = 0;
+  queued_messages = 0;
+}
+
+void AsyncRecorder::Write(std::vector<RecordEvent> &events) {
+  uint64_t bytes = 0;
+  {
+    std::lock_guard lock(recorder_mutex);
+    for (RecordEvent &event : events) {
+      const std::span<const std::byte> payload = event.payload.Span();
+      bytes += payload.size();
+      if (recorder.WriteMessage(event.channel->mcap_channel_id, payload, event.stamp)) {
+        event.channel->written_messages.fetch_add(1, std::memory_order_relaxed);
+        event.channel->written_bytes.fetch_add(payload.size(), std::memory_order_relaxed);
+      } else {
+        event.channel->dropped_messages.fetch_add(1, std::memory_order_relaxed);
+        event.channel->dropped_bytes.fetch_add(payload.size(), std::memory_order_relaxed);
+      }
+    }
+  }
+  const size_t messages = events.size();
+  // Free the payloads before making room for more
+  events.clear();
+
+  {
+    std::lock_guard lock(queue_mutex);
+    in_flight_bytes -= bytes;
+    in_flight_messages -= messages;
+  }
+  space_available.notify_all();
+}
+
+void AsyncRecorder::WorkThread() {
+  std::vector<RecordEvent> events;
+  while (true) {
+    {
+      std::unique_lock lock(queue_mutex);
+      work_available.wait(lock, [this]() { return stop || queued_messages != 0; });
+      if (queued_messages == 0 || (stop && !async_options.drain_queue_on_stop)) {
+        return;
+      }
+      TakeQueued(events);
+    }
+    Write(events);
+  }
+}
+
+} // namespace basis::recorder
@@ -0,0 +1,242 @@
+#include <basis/recorder/snapshot_recorder.h>
+
+#include <vector>
+
+namespace basis::recorder {
+
+bool SnapshotRecorder::Start(std::string_view name) {
+  Stop();
+
+  // Anything that raced in after the last Stop()
+  while (events.Pop()) {
+  }
+  queued_bytes = 0;
+  output_name = name;
+  finalize_stopping = false;
+  running = true;
+  finalize_thread = std::thread([this]() { FinalizeThread(); });
+  snapshot_thread = std::thread([this]() { SnapshotThread(); });
+  return true;
+}
+
+void SnapshotRecorder::Stop() {
+  running = false;
+  if (snapshot_thread.joinable()) {
+    snapshot_thread.join();
+  }
+  {
+    std::lock_guard lock(finalize_mutex);
+    finalize_stopping = true;
+  }
+  finalize_cv.notify_all();
+  if (finalize_thread.joinable()) {
+    finalize_thread.join();
+  }
+}
+
+bool SnapshotRecorder::RegisterTopic(const std::string &topic,
+                                     const core::serialization::MessageTypeInfo &message_type_info,
+                                     const core::serialization::MessageSchema &basis_schema) {
+  bool record = false;
+  for (const auto &[_, pattern] : topic_patterns) {
+    if (std::regex_match(topic, pattern)) {
+      record = true;
+      break;
+    }
+  }
+  const bool trigger = !snapshot_options.trigger_topic.empty() && topic == snapshot_options.trigger_topic;
+  if (!record && !trigger) {
+    return false;
+  }
+
+  std::unique_lock lock(channel_mutex);
+  if (!topic_to_channel.contains(topic)) {
+    const Channel &channel = channels.emplace_back(Channel{topic, message_type_info, basis_schema, record, trigger});
+    topic_to_channel.emplace(topic, &channel);
+  }
+  return true;
+}
+
+bool SnapshotRecorder::WriteMessage(const std::string &topic, OwningSpan payload,
+                                    const basis::core::MonotonicTime &now) {
+  if (!running.load(std::memory_order_relaxed)) {
+    return false;
+  }
+
+  const Channel *channel = nullptr;
+  {
+    std::shared_lock lock(channel_mutex);
+    auto it = topic_to_channel.find(topic);
+    if (it == topic_to_channel.end()) {
+      return false;
+    }
+    channel = it->second;
+  }
+
+  // Triggers are never dropped, they are the whole point
+  const uint64_t size = payload.Span().size();
+  const uint64_t queued_before = queued_bytes.fetch_add(size, std::memory_order_relaxed);
+  if (!channel->trigger && snapshot_options.max_buffer_bytes != 0 && queued_before != 0 &&
+      queued_before + size > snapshot_options.max_buffer_bytes) {
+    queued_bytes.fetch_sub(size, std::memory_order_relaxed);
+    dropped_messages.fetch_add(1, std::memory_order_relaxed);
+    dropped_bytes.fetch_add(size, std::memory_order_relaxed);
+    return false;
+  }
+  events.Emplace(Event{channel, std::move(payload), now});
+  return true;
+}
+
+void SnapshotRecorder::Trigger(const core::MonotonicTime &stamp) {
+  if (!running.load(std::memory_order_relaxed)) {
+    BASIS_LOG_WARN("Ignoring snapshot trigger, recorder isn't started");
+    return;
+  }
+  events.Emplace(Event{nullptr, OwningSpan(std::shared_ptr<const std::byte>(), {}), stamp});
+}
+
+void SnapshotRecorder::SnapshotThread() {
+  std::vector<Event> batch;
+  while (true) {
+    // Checked before popping, so that everything pushed before Stop() is handled
+    const bool stopping = !running.load();
+    events.PopAll(batch, core::Duration::FromSeconds(0.1));
+    uint64_t batch_bytes = 0;
+    for (Event &event : batch) {
+      batch_bytes += event.payload.Span().size();
+      HandleEvent(event);
+    }
+    // Only now - until handled, the batch still holds on to the payloads
+    queued_bytes.fetch_sub(batch_bytes, std::memory_order_relaxed);
+    ReportDrops();
+    // Nothing came in to push the snapshot past its end - close it out once its time is up
+    if (batch.empty() && snapshot && core::MonotonicTime::Now() >= snapshot_deadline) {
+      FinishSnapshot();
+    }
+    batch.clear();
+    if (stopping) {
+      break;
+    }
+  }
+
+  FinishSnapshot();
+  ring.clear();
+  ring_bytes = 0;
+}
+
+void SnapshotRecorder::ReportDrops() {
+  const uint64_t dropped = dropped_messages.load(std::memory_order_relaxed);
+  if (dropped != reported_dropped_messages) {
+    BASIS_LOG_WARN("Snapshot recorder fell behind, dropped {} messages ({} bytes so far)",
+                   dropped - reported_dropped_messages, dropped_bytes.load(std::memory_order_relaxed));
+    reported_dropped_messages = dropped;
+  }
+}
+
+void SnapshotRecorder::HandleEvent(Event &event) {
+  const core::MonotonicTime stamp = event.stamp;
+  const bool trigger = event.channel == nullptr || event.channel->trigger;
+
+  if (event.channel && event.channel->record) {
+    if (snapshot && stamp > snapshot_end) {
+      FinishSnapshot();
+    }
+    if (snapshot) {
+      Write(event);
+    } else {
+      ring_bytes += event.payload.Span().size();
+      ring.push_back(std::move(event));
+      Evict(stamp);
+    }
+  }
+
+  if (trigger) {
+    if (snapshot) {
+      snapshot_end = std::max(snapshot_end, stamp + snapshot_options.post_trigger_duration);
+    } else {
+      StartSnapshot(stamp);
+    }
+  }
+
+  if (snapshot) {
+    UpdateSnapshotDeadline(stamp);
+  }
+}
+
+void SnapshotRecorder::UpdateSnapshotDeadline(const core::MonotonicTime &stamp) {
+  const core::MonotonicTime now = core::MonotonicTime::Now();
+  // Events may arrive out of order - never pull the deadline in
+  snapshot_deadline = std::max(snapshot_deadline, now + (snapshot_end - stamp));
+}
+
+void SnapshotRecorder::StartSnapshot(const core::MonotonicTime &trigger_stamp) {
+  const std::string name = fmt::format("{}_{:04}", output_name, snapshot_count.fetch_add(1));
+  // Filtering already happened in RegisterTopic()
+  snapshot = std::make_unique<Recorder>(recording_dir, Recorder::RECORD_ALL_TOPICS, options, true);
+  if (!snapshot->Start(name)) {
+    BASIS_LOG_ERROR("Unable to start snapshot {}", name);
+    snapshot.reset();
+    return;
+  }
+  BASIS_LOG_INFO("Writing snapshot {}", (recording_dir / name).string());
+
+  snapshot_end = trigger_stamp + snapshot_options.post_trigger_duration;
+  snapshot_deadline = {};
+  const core::MonotonicTime window_start =
+      core::MonotonicTime::FromNanoseconds(trigger_stamp.nsecs - snapshot_options.pre_trigger_duration.nsecs);
+  for (Event &buffered : ring) {
+    if (buffered.stamp >= window_start) {
+      Write(buffered);
+    }
+  }
+  ring.clear();
+  ring_bytes = 0;
+}
+
+void SnapshotRecorder::FinishSnapshot() {
+  if (!snapshot) {
+    return;
+  }
+  {
+    std::lock_guard lock(finalize_mutex);
+    to_finalize.push_back(std::move(snapshot));
+  }
+  finalize_cv.notify_all();
+}
+
+void SnapshotRecorder::FinalizeThread() {
+  std::unique_lock lock(finalize_mutex);
+  while (true) {
+    finalize_cv.wait(lock, [this]() { return !to_finalize.empty() || finalize_stopping; });
+    if (to_finalize.empty()) {
+      return;
+    }
+    std::unique_ptr<Recorder> finished = std::move(to_finalize.front());
+    to_finalize.pop_front();
+    lock.unlock();
+    finished->Stop();
+    finished.reset();
+    lock.lock();
+  }
+}
+
+void SnapshotRecorder::Write(Event &event) {
+  const Channel &channel = *event.channel;
+  // A no-op for all but the first message on each topic
+  snapshot->RegisterTopic(channel.topic, channel.message_type_info, channel.basis_schema);
+  snapshot->WriteMessage(channel.topic, event.payload.Span(), event.stamp);
+}
+
+void SnapshotRecorder::Evict(const core::MonotonicTime &newest) {
+  while (!ring.empty()) {
+    const Event &oldest = ring.front();
+    const bool over_budget = snapshot_options.max_buffer_bytes != 0 && ring_bytes > snapshot_options.max_buffer_bytes;
+    if (!over_budget && newest - oldest.stamp <= snapshot_options.pre_trigger_duration) {
+      return;
+    }
+    ring_bytes -= oldest.payload.Span().size();
+    ring.pop_front();
+  }
+}
+
+} // namespace basis::recorder
@@ -3,6 +3,7 @@
 #include <gtest/gtest.h>
 
 #include <basis/recorder.h>
+#include <basis/recorder/snapshot_recorder.h>
 
 #include <basis/plugins/serialization/protobuf.h>
 #ifdef BASIS_ENABLE_ROS
@@ -12,6 +13,32 @@
 
 #include <mcap/reader.hpp>
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <map>
+#include <random>
+#include <thread>
+
+/**
+ * Registers `topic` as carrying TestProtoStruct.
+ *
+ * @return RegisterTopic()'s result - recorders with topic patterns refuse anything else
+ */
+bool RegisterTestTopic(basis::RecorderInterface &recorder, const std::string &topic) {
+  auto basis_schema = basis::plugins::serialization::protobuf::ProtobufSerializer::DumpSchema<TestProtoStruct>();
+  auto mti = basis::plugins::serialization::protobuf::ProtobufSerializer::DeduceMessageTypeInfo<TestProtoStruct>();
+  return recorder.RegisterTopic(topic, mti, basis_schema);
+}
+
+/**
+ * A zeroed payload of `size` bytes - the recorders under test never look inside.
+ */
+basis::OwningSpan MakePayload(size_t size = 16) {
+  auto payload = std::make_shared<const std::vector<std::byte>>(size);
+  return {payload, std::span<const std::byte>(*payload)};
+}
+
 template <typename RecorderClass> class TestRecorderT : public testing::Test {
 public:
   TestRecorderT() { InitializeMCAP(); }
@@ -44,11 +71,7 @@ public:
     message_counts_by_file_by_topic[current_mcap_name][topic]++;
   }
 
-  void RegisterProtobuf(std::string topic_name = "/proto_topic") {
-    auto basis_schema = basis::plugins::serialization::protobuf::ProtobufSerializer::DumpSchema<TestProtoStruct>();
-    auto mti = basis::plugins::serialization::protobuf::ProtobufSerializer::DeduceMessageTypeInfo<TestProtoStruct>();
-    recorder->RegisterTopic(topic_name, mti, basis_schema);
-  }
+  void RegisterProtobuf(std::string topic_name = "/proto_topic") { RegisterTestTopic(*recorder, topic_name); }
 
   void WriteProtobuf(std::string topic_name = "/proto_topic") {
     TestProtoStruct msg;
@@ -155,6 +178,90 @@ TEST_F(TestRecorder, Split) {
   }
 }
 
+struct TestRecorderSegments : public testing::Test {
+  TestRecorderSegments() {
+    char temp_template[] = "/tmp/tmpdir.XXXXXX";
+    record_dir = mkdtemp(temp_template);
+  }
+  ~TestRecorderSegments() { std::filesystem::remove_all(record_dir); }
+
+  std::vector<std::string> ListRecordings() {
+    std::vector<std::string> out;
+    for (const auto &entry : std::filesystem::directory_iterator(record_dir)) {
+      out.push_back(entry.path().filename().string());
+    }
+    std::sort(out.begin(), out.end());
+    return out;
+  }
+
+  std::filesystem::path record_dir;
+};
+
+TEST_F(TestRecorderSegments, Duration) {
+  basis::RecorderOptions options;
+  options.segment_max_duration = basis::core::Duration::FromSeconds(1);
+  options.max_segments = 3;
+  basis::Recorder recorder(record_dir, basis::Recorder::RECORD_ALL_TOPICS, options);
+  ASSERT_TRUE(RegisterTestTopic(recorder, "/a"));
+  ASSERT_TRUE(recorder.Start("black_box"));
+
+  std::vector<std::byte> payload(64);
+  for (int i = 0; i < 10; i++) {
+    if (i == 3) {
+      // Registered mid segment - must still make it into every later segment
+      ASSERT_TRUE(RegisterTestTopic(recorder, "/b"));
+    }
+    const auto stamp = basis::core::MonotonicTime::FromSeconds(i * 0.5);
+    ASSERT_TRUE(recorder.WriteMessage("/a", payload, stamp));
+  }
+  recorder.Stop();
+
+  // Two messages per segment, five segments, the oldest two deleted
+  ASSERT_EQ(ListRecordings(),
+            (std::vector<std::string>{"black_box_0002.mcap", "black_box_0003.mcap", "black_box_0004.mcap"}));
+
+  for (const std::string &name : ListRecordings()) {
+    mcap::McapReader reader;
+    ASSERT_TRUE(reader.open((record_dir / name).string()).ok());
+    ASSERT_TRUE(reader.readSummary(mcap::ReadSummaryMethod::NoFallbackScan).ok());
+    ASSERT_EQ(reader.statistics()->messageCount, 2u);
+
+    std::map<std::string, mcap::ChannelId> channels;
+    for (const auto &[id, channel] : reader.channels()) {
+      channels.emplace(channel->topic, id);
+    }
+    ASSERT_EQ(channels, (std::map<std::string, mcap::ChannelId>{{"/a", 1}, {"/b", 2}}));
+  }
+}
+
+TEST_F(TestRecorderSegments, Size) {
+  basis::RecorderOptions options;
+  // Without chunking, the size is known after every message
+  options.chunk_size = 0;
+  options.segment_max_bytes = 16 * 1024;
+  basis::Recorder recorder(record_dir, basis::Recorder::RECORD_ALL_TOPICS, options);
+  ASSERT_TRUE(RegisterTestTopic(recorder, "/a"));
+  ASSERT_TRUE(recorder.Start("test"));
+
+  std::vector<std::byte> payload(1000);
+  constexpr int MESSAGE_COUNT = 100;
+  for (int i = 0; i < MESSAGE_COUNT; i++) {
+    ASSERT_TRUE(recorder.WriteMessage("/a", payload, basis::core::MonotonicTime::FromNanoseconds(i)));
+  }
+  recorder.Stop();
+
+  const std::vector<std::string> recordings = ListRecordings();
+  ASSERT_GE(recordings.size(), 6u);
+  uint64_t message_count = 0;
+  for (const std::string &name : recordings) {
+    mcap::McapReader reader;
+    ASSERT_TRUE(reader.open((record_dir / name).string()).ok());
+    ASSERT_TRUE(reader.readSummary(mcap::ReadSummaryMethod::NoFallbackScan).ok());
+    message_count += reader.statistics()->messageCount;
+  }
+  ASSERT_EQ(message_count, MESSAGE_COUNT);
+}
+
 #ifdef BASIS_ENABLE_ROS
 
 TEST_F(TestRecorder, Ros) {
@@ -180,6 +287,399 @@ TEST_F(TestAsyncRecorder, BasicTest) {
   RegisterAndWriteProtobuf();
 }
 
+struct AsyncRecorderQueueTest : public testing::Test {
+  AsyncRecorderQueueTest() {
+    char temp_template[] = "/tmp/tmpdir.XXXXXX";
+    record_dir = mkdtemp(temp_template);
+  }
+  ~AsyncRecorderQueueTest() { std::filesystem::remove_all(record_dir); }
+
+  std::unique_ptr<basis::AsyncRecorder> Create(basis::AsyncRecorderOptions options) {
+    auto recorder = std::make_unique<basis::AsyncRecorder>(record_dir, basis::Recorder::RECORD_ALL_TOPICS, options);
+    RegisterTestTopic(*recorder, "/low");
+    RegisterTestTopic(*recorder, "/high");
+    return recorder;
+  }
+
+  static bool Write(basis::AsyncRecorder &recorder, const std::string &topic, int64_t stamp) {
+    return recorder.WriteMessage(topic, MakePayload(), basis::core::MonotonicTime::FromNanoseconds(stamp));
+  }
+
+  static basis::AsyncRecorder::TopicStats Stats(const basis::AsyncRecorder &recorder, const std::string &topic) {
+    for (auto &[stats_topic, stats] : recorder.GetTopicStats()) {
+      if (stats_topic == topic) {
+        return stats;
+      }
+    }
+    return {};
+  }
+
+  /**
+   * <topic, log time> of every message in the recording, in file order
+   */
+  std::vector<std::pair<std::string, uint64_t>> ReadBack(const std::string &name) {
+    std::vector<std::pair<std::string, uint64_t>> out;
+    mcap::McapReader reader;
+    EXPECT_TRUE(reader.open((record_dir / (name + ".mcap")).string()).ok());
+    for (const auto &view : reader.readMessages()) {
+      out.emplace_back(view.channel->topic, view.message.logTime);
+    }
+    return out;
+  }
+
+  std::filesystem::path record_dir;
+};
+
+// Nothing is written until Start(), so messages written before then fill the queue deterministically
+
+TEST_F(AsyncRecorderQueueTest, LosslessByDefault) {
+  auto recorder = Create({});
+  constexpr int MESSAGE_COUNT = 1000;
+  for (int i = 0; i < MESSAGE_COUNT; i++) {
+    ASSERT_TRUE(Write(*recorder, "/low", i));
+  }
+  ASSERT_TRUE(recorder->Start("default"));
+  recorder->Stop();
+
+  auto stats = Stats(*recorder, "/low");
+  ASSERT_EQ(stats.written_messages, size_t(MESSAGE_COUNT));
+  ASSERT_EQ(stats.dropped_messages, 0u);
+  ASSERT_EQ(ReadBack("default").size(), size_t(MESSAGE_COUNT));
+}
+
+TEST_F(AsyncRecorderQueueTest, DropNewest) {
+  basis::AsyncRecorderOptions options;
+  options.max_queue_messages = 3;
+  options.overflow_policy = basis::recorder::OverflowPolicy::DropNewest;
+  auto recorder = Create(options);
+  for (int i = 0; i < 5; i++) {
+    ASSERT_EQ(Write(*recorder, "/low", i), i < 3);
+  }
+  ASSERT_TRUE(recorder->Start("drop_newest"));
+  recorder->Stop();
+
+  auto stats = Stats(*recorder, "/low");
+  ASSERT_EQ(stats.queued_messages, 5u);
+  ASSERT_EQ(stats.queued_bytes, 5u * 16);
+  ASSERT_EQ(stats.written_messages, 3u);
+  ASSERT_EQ(stats.dropped_messages, 2u);
+  ASSERT_EQ(stats.dropped_bytes, 2u * 16);
+  ASSERT_EQ(ReadBack("drop_newest"), (std::vector<std::pair<std::string, uint64_t>>{
+                                         {"/low", 0}, {"/low", 1}, {"/low", 2}}));
+}
+
+TEST_F(AsyncRecorderQueueTest, DropOldest) {
+  basis::AsyncRecorderOptions options;
+  options.max_queue_bytes = 3 * 16;
+  options.overflow_policy = basis::recorder::OverflowPolicy::DropOldest;
+  auto recorder = Create(options);
+  for (int i = 0; i < 5; i++) {
+    ASSERT_TRUE(Write(*recorder, "/low", i));
+  }
+  ASSERT_TRUE(recorder->Start("drop_oldest"));
+  recorder->Stop();
+
+  auto stats = Stats(*recorder, "/low");
+  ASSERT_EQ(stats.written_messages, 3u);
+  ASSERT_EQ(stats.dropped_messages, 2u);
+  ASSERT_EQ(ReadBack("drop_oldest"), (std::vector<std::pair<std::string, uint64_t>>{
+                                         {"/low", 2}, {"/low", 3}, {"/low", 4}}));
+}
+
+TEST_F(AsyncRecorderQueueTest, DropLowestPriority) {
+  basis::AsyncRecorderOptions options;
+  options.max_queue_messages = 3;
+  options.overflow_policy = basis::recorder::OverflowPolicy::DropLowestPriority;
+  options.topic_priorities = {{"/high", std::regex("/high"), 1}};
+  auto recorder = Create(options);
+  for (int i = 0; i < 3; i++) {
+    ASSERT_TRUE(Write(*recorder, "/low", i));
+  }
+  // Pushes out the oldest low priority messages
+  ASSERT_TRUE(Write(*recorder, "/high", 10));
+  ASSERT_TRUE(Write(*recorder, "/high", 11));
+  ASSERT_TRUE(Write(*recorder, "/high", 12));
+  // Nothing lower left to drop
+  ASSERT_FALSE(Write(*recorder, "/low", 3));
+  ASSERT_TRUE(recorder->Start("priority"));
+  recorder->Stop();
+
+  ASSERT_EQ(Stats(*recorder, "/low").dropped_messages, 4u);
+  ASSERT_EQ(Stats(*recorder, "/high").dropped_messages, 0u);
+  ASSERT_EQ(ReadBack("priority"), (std::vector<std::pair<std::string, uint64_t>>{
+                                      {"/high", 10}, {"/high", 11}, {"/high", 12}}));
+}
+
+TEST_F(AsyncRecorderQueueTest, Block) {
+  basis::AsyncRecorderOptions options;
+  options.max_queue_messages = 2;
+  options.overflow_policy = basis::recorder::OverflowPolicy::Block;
+  auto recorder = Create(options);
+  ASSERT_TRUE(recorder->Start("block"));
+  constexpr int MESSAGE_COUNT = 1000;
+  std::thread low([&]() {
+    for (int i = 0; i < MESSAGE_COUNT; i++) {
+      ASSERT_TRUE(Write(*recorder, "/low", i));
+    }
+  });
+  for (int i = 0; i < MESSAGE_COUNT; i++) {
+    ASSERT_TRUE(Write(*recorder, "/high", i));
+  }
+  low.join();
+  recorder->Stop();
+
+  for (const std::string topic : {"/low", "/high"}) {
+    auto stats = Stats(*recorder, topic);
+    ASSERT_EQ(stats.written_messages, size_t(MESSAGE_COUNT));
+    ASSERT_EQ(stats.dropped_messages, 0u);
+  }
+  ASSERT_EQ(ReadBack("block").size(), size_t(MESSAGE_COUNT * 2));
+}
+
+using TestSnapshotRecorder = TestRecorderSegments;
+
+TEST_F(TestSnapshotRecorder, Trigger) {
+  basis::SnapshotRecorderOptions options;
+  options.pre_trigger_duration = basis::core::Duration::FromSeconds(2);
+  options.post_trigger_duration = basis::core::Duration::FromSeconds(1);
+  options.trigger_topic = "/incident";
+  basis::SnapshotRecorder recorder(record_dir, {{"/a", std::regex("/a")}}, options);
+
+  ASSERT_TRUE(RegisterTestTopic(recorder, "/a"));
+  ASSERT_TRUE(RegisterTestTopic(recorder, "/incident"));
+  ASSERT_FALSE(RegisterTestTopic(recorder, "/b"));
+
+  auto write = [&](const std::string &topic, double stamp) {
+    return recorder.WriteMessage(topic, MakePayload(), basis::core::MonotonicTime::FromSeconds(stamp));
+  };
+
+  ASSERT_TRUE(recorder.Start("snapshot"));
+  for (int i = 0; i < 20; i++) {
+    ASSERT_TRUE(write("/a", i * 0.5));
+    if (i == 12) {
+      recorder.Trigger(basis::core::MonotonicTime::FromSeconds(6));
+    }
+    if (i == 18) {
+      ASSERT_TRUE(write("/incident", i * 0.5));
+    }
+  }
+  recorder.Stop();
+  ASSERT_EQ(recorder.GetSnapshotCount(), 2u);
+
+  auto read_stamps = [&](const std::string &name) {
+    std::vector<double> out;
+    mcap::McapReader reader;
+    EXPECT_TRUE(reader.open((record_dir / name).string()).ok());
+    for (const auto &view : reader.readMessages()) {
+      EXPECT_EQ(view.channel->topic, "/a");
+      out.push_back(view.message.logTime / 1e9);
+    }
+    return out;
+  };
+  // Two seconds before the trigger, one after
+  ASSERT_EQ(read_stamps("snapshot_0000.mcap"), (std::vector<double>{4, 4.5, 5, 5.5, 6, 6.5, 7}));
+  // Cut short by Stop()
+  ASSERT_EQ(read_stamps("snapshot_0001.mcap"), (std::vector<double>{7.5, 8, 8.5, 9, 9.5}));
+}
+
+/**
+ * A snapshot whose post-trigger window runs out with no more traffic is still finished, without waiting for Stop().
+ */
+TEST_F(TestSnapshotRecorder, FinishWithoutTraffic) {
+  basis::SnapshotRecorderOptions options;
+  options.pre_trigger_duration = basis::core::Duration::FromSeconds(1);
+  options.post_trigger_duration = basis::core::Duration::FromSeconds(0.2);
+  basis::SnapshotRecorder recorder(record_dir, {{"/a", std::regex("/a")}}, options);
+
+  ASSERT_TRUE(RegisterTestTopic(recorder, "/a"));
+
+  auto write = [&](double stamp) {
+    return recorder.WriteMessage("/a", MakePayload(), basis::core::MonotonicTime::FromSeconds(stamp));
+  };
+
+  ASSERT_TRUE(recorder.Start("idle"));
+  ASSERT_TRUE(write(1));
+  recorder.Trigger(basis::core::MonotonicTime::FromSeconds(1));
+  ASSERT_TRUE(write(1.1));
+
+  // Readable while the recorder is still running
+  std::vector<double> stamps;
+  for (int i = 0; i < 100 && stamps.size() != 2; i++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    mcap::McapReader reader;
+    if (!reader.open((record_dir / "idle_0000.mcap").string()).ok()) {
+      continue;
+    }
+    stamps.clear();
+    for (const auto &view : reader.readMessages([](const mcap::Status &) {})) {
+      stamps.push_back(view.message.logTime / 1e9);
+    }
+  }
+  ASSERT_EQ(stamps, (std::vector<double>{1, 1.1}));
+
+  // Inside the old window, but the snapshot is already closed - buffered for the next one instead
+  ASSERT_TRUE(write(1.15));
+  recorder.Stop();
+  ASSERT_EQ(recorder.GetSnapshotCount(), 1u);
+}
+
+/**
+ * Messages waiting for the snapshot thread count against max_buffer_bytes too - a burst is dropped rather than queued
+ * without limit. Triggers always get through.
+ */
+TEST_F(TestSnapshotRecorder, QueueBound) {
+  constexpr size_t PAYLOAD_SIZE = 64 * 1024;
+  constexpr int MESSAGE_COUNT = 2000;
+  basis::SnapshotRecorderOptions options;
+  options.max_buffer_bytes = 4 * PAYLOAD_SIZE;
+  options.trigger_topic = "/incident";
+  basis::SnapshotRecorder recorder(record_dir, {{"/a", std::regex("/a")}}, options);
+
+  ASSERT_TRUE(RegisterTestTopic(recorder, "/a"));
+  ASSERT_TRUE(RegisterTestTopic(recorder, "/incident"));
+
+  // Shared by every message, so the burst itself costs nothing
+  const basis::OwningSpan payload = MakePayload(PAYLOAD_SIZE);
+  auto write = [&](const std::string &topic, int i) {
+    return recorder.WriteMessage(topic, payload, basis::core::MonotonicTime::FromSeconds(1 + i * 0.001));
+  };
+
+  ASSERT_TRUE(recorder.Start("bound"));
+  int accepted = 0;
+  for (int i = 0; i < MESSAGE_COUNT; i++) {
+    accepted += write("/a", i);
+  }
+  ASSERT_TRUE(write("/incident", MESSAGE_COUNT));
+  recorder.Stop();
+
+  ASSERT_GT(recorder.GetDroppedMessageCount(), 0u);
+  ASSERT_EQ(accepted + recorder.GetDroppedMessageCount(), uint64_t(MESSAGE_COUNT));
+  ASSERT_EQ(recorder.GetDroppedByteCount(), recorder.GetDroppedMessageCount() * PAYLOAD_SIZE);
+  ASSERT_EQ(recorder.GetSnapshotCount(), 1u);
+}
+
+/**
+ * Payloads shaped like what robots actually record - mostly camera and lidar.
+ */
+std::vector<std::pair<std::string, std::vector<std::byte>>> MakeRepresentativePayloads() {
+  std::mt19937 rng(1234);
+  std::vector<std::pair<std::string, std::vector<std::byte>>> payloads;
+
+  // 640x480 rgb8 - smooth gradients plus sensor noise
+  std::vector<std::byte> image(640 * 480 * 3);
+  std::uniform_int_distribution<int> pixel_noise(-4, 4);
+  for (size_t y = 0; y < 480; y++) {
+    for (size_t x = 0; x < 640; x++) {
+      for (size_t c = 0; c < 3; c++) {
+        const int value = int((x + y * (c + 1)) / 4) + pixel_noise(rng);
+        image[(y * 640 + x) * 3 + c] = std::byte(std::clamp(value, 0, 255));
+      }
+    }
+  }
+  payloads.emplace_back("camera", std::move(image));
+
+  // 32 beam lidar, 2048 columns of xyz + intensity floats
+  std::vector<float> points;
+  points.reserve(32 * 2048 * 4);
+  std::normal_distribution<float> range_noise(0.0f, 0.02f);
+  for (int beam = 0; beam < 32; beam++) {
+    for (int column = 0; column < 2048; column++) {
+      const float azimuth = column * 2.0f * float(M_PI) / 2048;
+      const float elevation = (beam - 16) * 0.02f;
+      const float range = 10.0f + 5.0f * std::sin(azimuth * 3) + range_noise(rng);
+      points.push_back(range * std::cos(elevation) * std::cos(azimuth));
+      points.push_back(range * std::cos(elevation) * std::sin(azimuth));
+      points.push_back(range * std::sin(elevation));
+      points.push_back(float(beam % 8) * 16);
+    }
+  }
+  const auto *point_bytes = reinterpret_cast<const std::byte *>(points.data());
+  payloads.emplace_back("lidar", std::vector<std::byte>(point_bytes, point_bytes + points.size() * sizeof(float)));
+
+  return payloads;
+}
+
+TEST(RecorderBenchmark, Compression) {
+  using basis::recorder::Compression;
+  constexpr size_t MESSAGES_PER_PAYLOAD = 50;
+
+  char temp_template[] = "/tmp/tmpdir.XXXXXX";
+  const std::filesystem::path record_dir = mkdtemp(temp_template);
+
+  auto payloads = MakeRepresentativePayloads();
+  auto basis_schema = basis::plugins::serialization::protobuf::ProtobufSerializer::DumpSchema<TestProtoStruct>();
+  auto mti = basis::plugins::serialization::protobuf::ProtobufSerializer::DeduceMessageTypeInfo<TestProtoStruct>();
+
+  for (const auto &[payload_name, payload] : payloads) {
+    size_t uncompressed_file_size = 0;
+    for (auto [compression_name, compression] : std::initializer_list<std::pair<const char *, Compression>>{
+             {"none", Compression::None}, {"lz4", Compression::Lz4}, {"zstd", Compression::Zstd}}) {
+      basis::RecorderOptions options;
+      options.chunk_size = 4 * 1024 * 1024;
+      options.compression = compression;
+      options.compression_level = basis::recorder::CompressionLevel::Fast;
+
+      const std::string name = fmt::format("{}_{}", payload_name, compression_name);
+      const std::span<const std::byte> span(payload);
+      {
+        basis::Recorder recorder(record_dir, basis::Recorder::RECORD_ALL_TOPICS, options);
+        ASSERT_TRUE(recorder.Start(name));
+        recorder.RegisterTopic("/" + payload_name, mti, basis_schema);
+
+        // Synchronous recorder - this includes the time spent compressing
+        const auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < MESSAGES_PER_PAYLOAD; i++) {
+          ASSERT_TRUE(recorder.WriteMessage("/" + payload_name, span, basis::core::MonotonicTime::FromNanoseconds(i)));
+        }
+        recorder.Stop();
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        const size_t file_size = std::filesystem::file_size(record_dir / (name + ".mcap"));
+        if (compression == Compression::None) {
+          uncompressed_file_size = file_size;
+        }
+        const double megabytes = double(payload.size() * MESSAGES_PER_PAYLOAD) / (1024 * 1024);
+        spdlog::info("{:>6} {:>4}: {:8.1f} MB/s, compression ratio {:.2f}", payload_name, compression_name,
+                     megabytes / elapsed.count(), double(payload.size() * MESSAGES_PER_PAYLOAD) / file_size);
+        if (compression != Compression::None) {
+          ASSERT_LT(file_size, uncompressed_file_size);
+        }
+      }
+
+      // Everything written can be read back
+      mcap::McapReader reader;
+      ASSERT_TRUE(reader.open((record_dir / (name + ".mcap")).string()).ok());
+      size_t message_count = 0;
+      for (const auto &view : reader.readMessages()) {
+        ASSERT_EQ(view.message.dataSize, payload.size());
+        message_count++;
+      }
+      ASSERT_EQ(message_count, MESSAGES_PER_PAYLOAD);
+    }
+  }
+
+  // With the async recorder publishers only pay for queueing, no matter the compression
+  {
+    basis::RecorderOptions options;
+    options.compression = Compression::Zstd;
+    basis::AsyncRecorder recorder(record_dir, basis::Recorder::RECORD_ALL_TOPICS, {}, options);
+    ASSERT_TRUE(recorder.Start("async_zstd"));
+    recorder.RegisterTopic("/camera", mti, basis_schema);
+
+    auto owned = std::make_shared<const std::vector<std::byte>>(payloads[0].second);
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < MESSAGES_PER_PAYLOAD; i++) {
+      recorder.WriteMessage("/camera", basis::OwningSpan(owned, std::span<const std::byte>(*owned)),
+                            basis::core::MonotonicTime::FromNanoseconds(i));
+    }
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    recorder.Stop();
+    spdlog::info("async zstd camera: {:.1f}us per WriteMessage call", elapsed.count() * 1e6 / MESSAGES_PER_PAYLOAD);
+  }
+
+  std::filesystem::remove_all(record_dir);
+}
+
 // TestOutOfOrder
 
 // TestMixed
\ No newline at end of file
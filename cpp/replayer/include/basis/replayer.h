@@ -4,8 +4,16 @@
 #include "basis/core/transport/transport_manager.h"
 
 #include <basis/replayer/config.h>
+#include <basis/replayer/mapped_file.h>
 #include <mcap/reader.hpp>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
 #include <unordered_map>
 
 #include <time.pb.h>
@@ -20,11 +28,15 @@ using namespace replayer;
 
 class Replayer {
 public:
+  /**
+   * `coordinator_connector` may be nullptr, to replay without one (ie in tests).
+   */
   Replayer(Config config, 
     basis::core::transport::TransportManager &transport_manager,
-    basis::core::transport::CoordinatorConnector& coordinator_connector)
+    basis::core::transport::CoordinatorConnector *coordinator_connector)
       : config(std::move(config)), transport_manager(transport_manager), coordinator_connector(coordinator_connector) {
       }
+  virtual ~Replayer() { StopPrefetching(); }
 
   virtual bool Run();
 
@@ -34,18 +46,120 @@ public:
   basis::core::MonotonicTime EndTime() {
     return basis::core::MonotonicTime::FromNanoseconds(mcap_reader.statistics()->messageEndTime);
   }
+
+  /**
+   * Jump playback to `time` (clamped to the replay window) while Run() is in progress, ie to scrub from a tool. Chunks
+   * before it are never read. Anything read ahead is dropped, and /time restarts from `time` with a new run token.
+   */
+  void Seek(const basis::core::MonotonicTime &time);
+
 protected:
+  /**
+   * A message read ahead of playback, ready to publish.
+   */
+  struct PrefetchedMessage {
+    /// nullptr marks the start of a pass over the recording (or a seek), beginning at `publish_time`
+    basis::core::transport::PublisherRaw *publisher = nullptr;
+    std::shared_ptr<basis::core::transport::MessagePacket> packet;
+    int64_t publish_time = 0;
+    /// The Seek() this was read after - anything older is stale
+    uint64_t generation = 0;
+  };
+
   bool LoadRecording(std::filesystem::path recording_path);
 
   virtual bool OnRecordLoaded();
 
+  /**
+   * Reads (and decompresses) messages on a background thread, so that playback only ever publishes.
+   */
+  void StartPrefetching();
+  void StopPrefetching();
+
+  /**
+   * @return the next message, or nullopt once the recording has been read through
+   */
+  std::optional<PrefetchedMessage> PopPrefetched();
+
+  /**
+   * Whether reading in file order is as good as reading in log time order - no chunk overlaps another in time. Messages
+   * within a chunk are then played in the order they were recorded.
+   *
+   * File order is what lets uncompressed messages be published straight out of the mapping, log time order copies
+   * every chunk.
+   */
+  bool CanReadInFileOrder() const;
+
+  /**
+   * The part of the recording to replay, from Config::start/end.
+   */
+  int64_t WindowStart() const;
+  /// Exclusive
+  int64_t WindowEnd() const;
+
   const Config config;
 
   basis::core::transport::TransportManager &transport_manager;
-  basis::core::transport::CoordinatorConnector& coordinator_connector;
+  basis::core::transport::CoordinatorConnector *coordinator_connector;
+  /// Must outlive `mcap_reader`
+  std::shared_ptr<MappedFile> mapped_file;
   mcap::McapReader mcap_reader;
   std::unordered_map<std::string, std::shared_ptr<basis::core::transport::PublisherRaw>> publishers;
   std::shared_ptr<basis::core::transport::Publisher<basis::core::transport::proto::Time>> time_publisher;
+
+private:
+  /**
+   * What a pass over the recording managed, for the throughput report.
+   */
+  struct PassStats {
+    std::chrono::steady_clock::time_point wall_start;
+    int64_t recording_start = 0;
+    int64_t recording_end = 0;
+    uint64_t messages = 0;
+    uint64_t bytes = 0;
+  };
+
+  void ReportThroughput(const PassStats &stats);
+
+  /**
+   * Runs StandardUpdate() if it's been long enough since the last one - replaying as fast as possible shouldn't mean
+   * talking to the coordinator after every message.
+   */
+  void UpdateIfDue();
+
+  /**
+   * Blocks while any subscriber to `publisher` is `max_pending_messages` or more behind.
+   */
+  void WaitForSubscribers(basis::core::transport::PublisherRaw &publisher);
+
+  std::chrono::steady_clock::time_point next_update;
+
+  void PrefetchThread();
+
+  /**
+   * Reads from `start` to the end of the window.
+   *
+   * @return false if interrupted by a Seek() or StopPrefetching()
+   */
+  bool PrefetchPass(const mcap::ReadMessageOptions &options, int64_t start, uint64_t generation);
+
+  /**
+   * Blocks while the prefetch queue is full.
+   *
+   * @return false if prefetching was stopped, or a Seek() came in after `message` was read
+   */
+  bool PushPrefetched(PrefetchedMessage message);
+
+  std::mutex prefetch_mutex;
+  std::condition_variable prefetch_changed;
+  std::deque<PrefetchedMessage> prefetched;
+  uint64_t prefetched_bytes = 0;
+  bool prefetch_done = false;
+  bool prefetch_stop = false;
+  /// Bumped by every Seek(), written under prefetch_mutex
+  std::atomic<uint64_t> seek_generation = 0;
+  int64_t seek_target = 0;
+  std::thread prefetch_thread;
 };
 
 } // namespace basis
\ No newline at end of file
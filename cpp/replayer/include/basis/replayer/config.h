@@ -1,10 +1,39 @@
 #pragma once
 
+#include <cstdint>
 #include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <basis/core/time.h>
 
 namespace basis::replayer {
     struct Config {
         bool loop = false;
         std::filesystem::path input;
+        /// The window to replay, as offsets from the first message in the recording
+        std::optional<basis::core::Duration> start;
+        std::optional<basis::core::Duration> end;
+        /// Topics to replay, all of them if empty
+        std::vector<std::string> topics;
+        /// Map the recording into memory, publishing messages from uncompressed chunks without copying them
+        bool mmap = true;
+        /// Messages read ahead of playback, and their total payload size
+        size_t prefetch_max_messages = 4096;
+        uint64_t prefetch_max_bytes = 256 * 1024 * 1024;
+        /// Playback speed relative to the recording
+        double rate = 1.0;
+        /// Ignore `rate`, publishing as fast as the recording can be read (and subscribers keep up, see below)
+        bool as_fast_as_possible = false;
+        /// /time lands exactly on each message's timestamp - this is the largest step it takes through gaps between
+        /// messages. Zero steps straight from message to message.
+        basis::core::Duration max_time_step = basis::core::Duration::FromSeconds(0.01);
+        /// If nonzero, hold off publishing on a topic while any of its subscribers is this many messages behind,
+        /// rather than letting queues trim. Zero never waits.
+        size_t max_pending_messages = 0;
+        /// DeterministicReplayer only - threads to run handlers on, units with no data dependency between them running
+        /// at once. Zero runs everything on the calling thread.
+        size_t deterministic_threads = 0;
     };
-}
\ No newline at end of file
+}
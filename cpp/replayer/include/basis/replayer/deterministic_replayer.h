@@ -0,0 +1,303 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <span>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <mcap/reader.hpp>
+
+#include <basis/core/threading/thread_pool.h>
+#include <basis/replayer/config.h>
+#include <basis/replayer/mapped_file.h>
+#include <basis/unit.h>
+
+namespace basis {
+
+/**
+ * Runs units in lockstep with a recording, all in this process - no sockets, no coordinator, no wall clock.
+ *
+ * Recorded messages are deserialized and handed to each handler's type erased callbacks in log time order, with
+ * simulated time set to each message's timestamp exactly. Whatever a handler outputs is delivered to the handlers
+ * subscribed to it before time moves on, and recorded messages on topics a loaded unit publishes are skipped, so that
+ * the units' own outputs take their place. Rate handlers tick on simulated time.
+ *
+ * Nothing waits on anything, so replay runs as fast as the handlers do. Only autogenerated units (those with handlers)
+ * can be driven this way.
+ *
+ * Ordering, for a given timestamp: rate ticks scheduled before a message run before it, ticks at the same time as a
+ * message run after it, and outputs are delivered breadth first.
+ *
+ * With Config::deterministic_threads set, units are split into groups along the topic graph (a unit's handlers share
+ * its state, and units feeding each other in a cycle are merged) and groups with no data dependency between them run
+ * at once, even across messages. Each group still sees its inputs in exactly the order above, and outputs are handed
+ * to the output callback in that order too, on the calling thread - the results are identical to a sequential run.
+ */
+class DeterministicReplayer {
+public:
+  /**
+   * Called with every output from every handler, ie to compare against a known good run.
+   */
+  using OutputCallback = std::function<void(const core::MonotonicTime &time, const std::string &topic,
+                                            const std::shared_ptr<const void> &message, const std::string &type_name)>;
+
+  /**
+   * Config::input, start, end, topics, mmap and deterministic_threads apply - the rest is for realtime replay.
+   */
+  DeterministicReplayer(replayer::Config config) : config(std::move(config)) {}
+
+  /**
+   * Take over a unit that hasn't been initialized yet, ie straight from CreateUnitWithLoader(). The unit is given a
+   * transport manager with no network transports and initialized without subscribers - the replayer calls its
+   * handlers directly.
+   *
+   * @return false if there's nothing to drive (the unit has no handlers)
+   */
+  bool AddUnit(std::unique_ptr<Unit> unit);
+
+  void SetOutputCallback(OutputCallback callback) { output_callback = std::move(callback); }
+
+  /**
+   * Replays the whole window, then puts this process back on wall clock time.
+   */
+  bool Run();
+
+  struct Stats {
+    /// Recorded messages delivered
+    uint64_t messages = 0;
+    /// Handler invocations, from messages and from rate ticks
+    uint64_t handler_runs = 0;
+    /// Messages output by handlers
+    uint64_t outputs = 0;
+    int64_t recording_nsecs = 0;
+    double wall_seconds = 0.0;
+  };
+
+  /**
+   * Stats from the last Run().
+   */
+  const Stats &GetStats() const { return stats; }
+
+private:
+  struct Subscription {
+    Unit *unit;
+    HandlerPubSub *handler;
+  };
+
+  struct Message {
+    std::string topic;
+    std::shared_ptr<const void> message;
+    std::string type_name;
+  };
+
+  /**
+   * Where a message lands in the sequential order within a step - the output index of each message on the way from
+   * the step's root, interleaved with the index of the subscription that produced it. Ordered by length, then
+   * lexicographically, which is exactly breadth first order.
+   */
+  using Key = std::vector<uint32_t>;
+
+  struct KeyedMessage {
+    Key key;
+    Message message;
+
+    /// For std::priority_queue, earliest first
+    bool operator<(const KeyedMessage &other) const;
+  };
+
+  struct Step;
+
+  /**
+   * Units that have to run one after the other.
+   */
+  struct Group {
+    /// Groups subscribed to something this group outputs, always with a higher index
+    std::vector<size_t> downstream;
+
+    std::mutex mutex;
+    /// Steps this group has work in and hasn't started yet, oldest first
+    std::deque<Step *> pending;
+    bool running = false;
+  };
+
+  /**
+   * The groups a step might touch, given where it starts.
+   */
+  struct Plan {
+    /// In topological order
+    std::vector<size_t> groups;
+    /// For each group, how many groups in the plan feed it
+    std::vector<size_t> upstream_count;
+  };
+
+  struct GroupWork {
+    /// Upstream groups yet to finish this step
+    std::atomic<size_t> waiting = 0;
+    std::mutex inbox_mutex;
+    /// Outputs of upstream groups
+    std::vector<KeyedMessage> inbox;
+    /// Only touched by the group itself
+    std::vector<KeyedMessage> outputs;
+    uint64_t handler_runs = 0;
+  };
+
+  /**
+   * A recorded message, or a rate tick, and everything it sets off.
+   */
+  struct Step {
+    int64_t time = 0;
+    const Plan *plan = nullptr;
+    /// Rate ticks only
+    HandlerPubSub *timer_handler = nullptr;
+    /// Recorded messages only - the payload is borrowed from the mapped recording where possible
+    std::string topic;
+    std::string type;
+    std::string type_name;
+    std::shared_ptr<std::byte[]> payload_copy;
+    std::span<const std::byte> payload;
+
+    std::unique_ptr<GroupWork[]> work;
+    /// Groups in the plan yet to finish this step
+    std::atomic<size_t> remaining = 0;
+  };
+
+  struct Timer {
+    int64_t next;
+    /// Tie breaker, in the order handlers were added
+    size_t order;
+    HandlerPubSub *handler;
+
+    bool operator>(const Timer &other) const { return std::tie(next, order) > std::tie(other.next, other.order); }
+  };
+
+  /**
+   * Delivers a recorded message to every subscribed handler, and anything they output in turn.
+   */
+  void Deliver(const mcap::MessageView &message);
+
+  /**
+   * Deliver(), but handing the message off to the thread pool.
+   */
+  void DeliverInParallel(const mcap::MessageView &message);
+
+  /**
+   * @return the type as subscriptions name it (ie protobuf:foo.Bar) and the C++ type name of a recorded message
+   */
+  std::pair<std::string, std::string> RecordedType(const mcap::MessageView &message);
+
+  /**
+   * @return nullptr if the unit has no deserializer for `type`
+   */
+  std::shared_ptr<const void> Deserialize(Unit *unit, const std::string &type, const std::string &topic,
+                                          std::span<const std::byte> payload);
+
+  /**
+   * Runs a handler's callback, looking up the topic and type of everything it outputs.
+   */
+  std::vector<Message> CollectOutputs(HandlerPubSub *handler, HandlerPubSub::HandlerExecutingCallback &callback);
+
+  /**
+   * Hands `message` to every handler subscribed to its topic, queueing up their outputs.
+   */
+  void Dispatch(const Message &message, std::deque<Message> &outputs);
+
+  /**
+   * Runs a handler the synchronizer decided is ready, if any, queueing up its outputs.
+   */
+  void RunHandler(HandlerPubSub *handler, HandlerPubSub::HandlerExecutingCallback &callback,
+                  std::deque<Message> &outputs);
+
+  void DrainOutputs(std::deque<Message> &outputs);
+
+  /**
+   * Fires every rate tick scheduled before `time`.
+   */
+  void RunTimersBefore(int64_t time);
+
+  void SetTime(int64_t time);
+
+  /**
+   * Splits units into groups and orders them, see the class comment.
+   */
+  void BuildGroups();
+
+  const Plan &GetPlan(const std::vector<size_t> &root_groups);
+
+  /**
+   * Hands a step to the thread pool, committing the oldest steps first if too many are in flight.
+   */
+  void Submit(std::unique_ptr<Step> step);
+
+  /**
+   * Starts the group on its oldest pending step, if it's idle and that step's inputs are all in.
+   */
+  void TryRunGroup(size_t group_index);
+
+  /**
+   * Runs everything in the step that belongs to the group, in sequential order, on a worker thread.
+   */
+  void RunGroup(size_t group_index, Step &step);
+
+  /**
+   * Runs a handler the synchronizer decided is ready, if any, passing its outputs on to the groups subscribed to them.
+   */
+  void RunHandlerInGroup(size_t group_index, Step &step, HandlerPubSub *handler,
+                         HandlerPubSub::HandlerExecutingCallback &callback, Key key,
+                         std::priority_queue<KeyedMessage> &queue);
+
+  /**
+   * Waits for the oldest step to finish, then hands its outputs to the output callback in sequential order.
+   */
+  void CommitOldest();
+
+  const replayer::Config config;
+
+  std::vector<std::unique_ptr<Unit>> units;
+  std::unordered_map<std::string, std::vector<Subscription>> subscriptions;
+  /// Outputs of each handler, from the name it reports them by to {runtime topic, type name}
+  std::unordered_map<HandlerPubSub *, std::unordered_map<std::string, std::pair<std::string, std::string>>>
+      handler_outputs;
+  /// Published by some unit - recorded messages on these topics are replaced by the unit's output
+  std::unordered_set<std::string> produced_topics;
+  std::vector<HandlerPubSub *> rate_handlers;
+  std::unordered_map<HandlerPubSub *, Unit *> handler_units;
+  /// Recorded types with no deserializer in a unit subscribed to them, only warned about once
+  std::unordered_set<std::string> missing_deserializers;
+  std::mutex missing_deserializers_mutex;
+
+  OutputCallback output_callback;
+
+  std::shared_ptr<replayer::MappedFile> mapped_file;
+  mcap::McapReader mcap_reader;
+
+  std::vector<Timer> timers;
+  int64_t now = 0;
+  uint64_t run_token = 0;
+  Stats stats;
+
+  // Parallel replay only
+  std::vector<std::unique_ptr<Group>> groups;
+  std::unordered_map<Unit *, size_t> unit_groups;
+  /// Groups with a subscriber on each topic, in order
+  std::unordered_map<std::string, std::vector<size_t>> topic_groups;
+  /// Keyed by the root groups
+  std::map<std::vector<size_t>, Plan> plans;
+  std::unique_ptr<core::threading::ThreadPool> thread_pool;
+  /// Oldest first
+  std::deque<std::unique_ptr<Step>> in_flight;
+  std::mutex step_done_mutex;
+  std::condition_variable step_done;
+};
+
+} // namespace basis
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <filesystem>
+#include <memory>
+#include <span>
+
+#include <mcap/reader.hpp>
+
+namespace basis::replayer {
+
+/**
+ * A recording mapped into memory. Reads hand out pointers straight into the mapping, so that messages in uncompressed
+ * chunks can be published without ever being copied - packets hold a reference to the MappedFile to keep it mapped.
+ */
+class MappedFile : public mcap::IReadable {
+public:
+  /**
+   * @return nullptr if the file can't be mapped
+   */
+  static std::shared_ptr<MappedFile> Create(const std::filesystem::path &path);
+
+  ~MappedFile() override;
+
+  uint64_t size() const override { return mapping_size; }
+
+  uint64_t read(std::byte **output, uint64_t offset, uint64_t size) override;
+
+  /**
+   * @return true if `bytes` lie entirely within the mapping
+   */
+  bool Contains(std::span<const std::byte> bytes) const {
+    return bytes.data() >= mapping && bytes.data() + bytes.size() <= mapping + mapping_size;
+  }
+
+private:
+  MappedFile(std::byte *mapping, size_t mapping_size) : mapping(mapping), mapping_size(mapping_size) {}
+
+  std::byte *const mapping;
+  const size_t mapping_size;
+};
+
+} // namespace basis::replayer
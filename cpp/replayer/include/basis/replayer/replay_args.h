@@ -1,11 +1,28 @@
 #include <argparse/argparse.hpp>
 #include <memory>
 
+#include <basis/replayer/config.h>
+
 namespace basis::replayer {
 
 constexpr char LOOP_ARG[] = "--loop";
 constexpr char RECORDING_ARG[] = "recording";
+constexpr char RATE_ARG[] = "--rate";
+constexpr char AS_FAST_AS_POSSIBLE_ARG[] = "--as-fast-as-possible";
+constexpr char MAX_PENDING_ARG[] = "--max-pending";
+constexpr char START_ARG[] = "--start";
+constexpr char END_ARG[] = "--end";
+constexpr char TOPICS_ARG[] = "--topics";
 
 std::unique_ptr<argparse::ArgumentParser> CreateArgumentParser();
 
+/**
+ * The recording to replay, and which part of it - shared by every kind of replay.
+ */
+void AddRecordingArguments(argparse::ArgumentParser &parser);
+/**
+ * @return false (having said why) if the window makes no sense
+ */
+bool HandleRecordingArguments(const argparse::ArgumentParser &parser, Config &config);
+
 } // namespace basis::replayer
\ No newline at end of file
@@ -0,0 +1,85 @@
+/**
+ * @file deterministic_replay.cpp
+ *
+ * Runs units against a recording in lockstep, as fast as they'll go, all in this process. See DeterministicReplayer.
+ */
+#include <basis/launch.h>
+#include <basis/launch/unit_loader.h>
+#include <basis/replayer/deterministic_replayer.h>
+#include <basis/replayer/replay_args.h>
+
+#include <argparse/argparse.hpp>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+
+constexpr char LAUNCH_ARG[] = "--launch";
+constexpr char UNIT_ARG[] = "--unit";
+constexpr char THREADS_ARG[] = "--threads";
+
+int main(int argc, char *argv[]) {
+  using namespace basis::replayer;
+
+  basis::core::logging::InitializeLoggingSystem();
+
+  argparse::ArgumentParser parser("deterministic_replay");
+  parser.add_argument(LAUNCH_ARG).help("A launch file - every unit in it is run, regardless of process.");
+  parser.add_argument(UNIT_ARG).help("Path to a unit shared object to run, can be repeated.").append();
+  parser.add_argument(THREADS_ARG)
+      .help("Run units that don't depend on each other on this many threads. 0 runs everything on one thread.")
+      .default_value(size_t(0))
+      .scan<'u', size_t>();
+  AddRecordingArguments(parser);
+
+  try {
+    parser.parse_args(argc, argv);
+  } catch (const std::exception &err) {
+    std::cerr << err.what() << std::endl;
+    std::cerr << parser;
+    return 1;
+  }
+
+  Config config;
+  if (!HandleRecordingArguments(parser, config)) {
+    return 1;
+  }
+  config.deterministic_threads = parser.get<size_t>(THREADS_ARG);
+  basis::DeterministicReplayer replayer(std::move(config));
+
+  size_t unit_count = 0;
+  if (auto launch_path = parser.present(LAUNCH_ARG)) {
+    auto launch = basis::launch::ParseTemplatedLaunchDefinitionYAMLPath(*launch_path, std::vector<std::string>{});
+    if (!launch) {
+      return 1;
+    }
+    for (const auto &[process_name, process] : launch->processes) {
+      for (const auto &[unit_name, unit] : process.units) {
+        std::optional<std::filesystem::path> unit_so_path = basis::launch::FindUnit(unit.unit_type);
+        if (!unit_so_path) {
+          std::cerr << "Failed to find unit type " << unit.unit_type << std::endl;
+          return 1;
+        }
+        if (!replayer.AddUnit(CreateUnitWithLoader(*unit_so_path, unit_name, unit.args))) {
+          return 1;
+        }
+        unit_count++;
+      }
+    }
+  }
+  if (auto unit_paths = parser.present<std::vector<std::string>>(UNIT_ARG)) {
+    for (const std::filesystem::path unit_path : *unit_paths) {
+      const std::string unit_name = unit_path.filename().string().substr(0, unit_path.filename().string().find('.'));
+      if (!replayer.AddUnit(
+              CreateUnitWithLoader(unit_path, unit_name, std::vector<std::pair<std::string, std::string>>{}))) {
+        return 1;
+      }
+      unit_count++;
+    }
+  }
+  if (unit_count == 0) {
+    std::cerr << "Nothing to replay, pass " << LAUNCH_ARG << " or " << UNIT_ARG << std::endl;
+    return 1;
+  }
+
+  return replayer.Run() ? 0 : 1;
+}
@@ -0,0 +1,606 @@
+#include <basis/replayer/deterministic_replayer.h>
+#include <basis/replayer/logger.h>
+
+#include <algorithm>
+#include <chrono>
+#include <limits>
+
+#include <basis/core/serialization.h>
+
+namespace basis {
+using namespace replayer;
+
+namespace {
+/// Bounds memory when handlers fall behind reading - steps are only freed once committed, oldest first
+constexpr size_t MAX_STEPS_IN_FLIGHT = 4096;
+
+bool KeyBefore(const std::vector<uint32_t> &a, const std::vector<uint32_t> &b) {
+  return a.size() != b.size() ? a.size() < b.size() : a < b;
+}
+} // namespace
+
+bool DeterministicReplayer::KeyedMessage::operator<(const KeyedMessage &other) const {
+  // Reversed, std::priority_queue pops the largest first
+  return KeyBefore(other.key, key);
+}
+
+bool DeterministicReplayer::AddUnit(std::unique_ptr<Unit> unit) {
+  if (!unit) {
+    return false;
+  }
+
+  // Publishers still need somewhere to live, but nothing should leave the process
+  unit->transport_manager = std::make_unique<core::transport::TransportManager>(
+      std::make_unique<core::transport::InprocTransport>());
+  unit->Initialize({.create_subscribers = false});
+
+  if (unit->handlers.empty()) {
+    BASIS_LOG_ERROR("Unit {} has no handlers, it can't be replayed deterministically", unit->Name());
+    return false;
+  }
+
+  for (const auto &[handler_name, handler] : unit->handlers) {
+    for (const auto &[topic, _] : handler->type_erased_callbacks) {
+      subscriptions[topic].push_back({unit.get(), handler});
+    }
+
+    // ToTopicMap() names outputs as they're written in the unit's yaml, before templating
+    auto &outputs = handler_outputs[handler];
+    for (const auto &[templated_topic, runtime_topic] : unit->templated_topic_to_runtime_topic) {
+      auto it = std::find(handler->outputs.begin(), handler->outputs.end(), runtime_topic);
+      if (it == handler->outputs.end()) {
+        continue;
+      }
+      const size_t index = it - handler->outputs.begin();
+      outputs[templated_topic] = {runtime_topic,
+                                  index < handler->output_type_names.size() ? handler->output_type_names[index] : ""};
+    }
+    produced_topics.insert(handler->outputs.begin(), handler->outputs.end());
+
+    if (handler->rate_duration) {
+      rate_handlers.push_back(handler);
+    }
+    handler_units[handler] = unit.get();
+  }
+
+  units.emplace_back(std::move(unit));
+  return true;
+}
+
+void DeterministicReplayer::SetTime(int64_t time) {
+  now = time;
+  core::MonotonicTime::SetSimulatedTime(time, run_token);
+}
+
+std::vector<DeterministicReplayer::Message>
+DeterministicReplayer::CollectOutputs(HandlerPubSub *handler, HandlerPubSub::HandlerExecutingCallback &callback) {
+  std::vector<Message> messages;
+  const auto &output_topics = handler_outputs.at(handler);
+  for (auto &[name, message] : callback()) {
+    if (!message) {
+      continue;
+    }
+    auto it = output_topics.find(name);
+    if (it == output_topics.end()) {
+      BASIS_LOG_WARN("Dropping output {}, it isn't one of the handler's outputs", name);
+      continue;
+    }
+    const auto &[topic, type_name] = it->second;
+    messages.push_back({topic, std::move(message), type_name});
+  }
+  return messages;
+}
+
+void DeterministicReplayer::RunHandler(HandlerPubSub *handler, HandlerPubSub::HandlerExecutingCallback &callback,
+                                       std::deque<Message> &outputs) {
+  if (!callback) {
+    // The synchronizer is still waiting on something
+    return;
+  }
+  stats.handler_runs++;
+
+  for (Message &message : CollectOutputs(handler, callback)) {
+    stats.outputs++;
+    if (output_callback) {
+      output_callback(core::MonotonicTime::FromNanoseconds(now), message.topic, message.message, message.type_name);
+    }
+    outputs.push_back(std::move(message));
+  }
+}
+
+void DeterministicReplayer::Dispatch(const Message &message, std::deque<Message> &outputs) {
+  auto it = subscriptions.find(message.topic);
+  if (it == subscriptions.end()) {
+    return;
+  }
+  for (const Subscription &subscription : it->second) {
+    HandlerPubSub::HandlerExecutingCallback callback;
+    subscription.handler->type_erased_callbacks.at(message.topic)(message.message, &callback, message.type_name);
+    RunHandler(subscription.handler, callback, outputs);
+  }
+}
+
+void DeterministicReplayer::DrainOutputs(std::deque<Message> &outputs) {
+  while (!outputs.empty()) {
+    const Message message = std::move(outputs.front());
+    outputs.pop_front();
+    Dispatch(message, outputs);
+  }
+}
+
+std::pair<std::string, std::string> DeterministicReplayer::RecordedType(const mcap::MessageView &message) {
+  // Subscriptions name types the way the unit yaml does, ie protobuf:foo.Bar
+  std::shared_ptr<mcap::Schema> schema = mcap_reader.schema(message.channel->schemaId);
+  auto serializer = message.channel->metadata.find(core::serialization::MCAP_CHANNEL_METADATA_SERIALIZER);
+  std::string type =
+      (serializer != message.channel->metadata.end() ? serializer->second : "") + ":" + (schema ? schema->name : "");
+  // Same conversion to a C++ type name as generate_unit.py
+  std::string type_name = schema ? schema->name : "";
+  for (size_t pos = 0; (pos = type_name.find('.', pos)) != std::string::npos; pos += 2) {
+    type_name.replace(pos, 1, "::");
+  }
+  return {std::move(type), std::move(type_name)};
+}
+
+std::shared_ptr<const void> DeterministicReplayer::Deserialize(Unit *unit, const std::string &type,
+                                                               const std::string &topic,
+                                                               std::span<const std::byte> payload) {
+  auto helper = unit->deserialization_helpers.find(type);
+  if (helper == unit->deserialization_helpers.end()) {
+    std::lock_guard lock(missing_deserializers_mutex);
+    if (missing_deserializers.insert(unit->Name() + "/" + type).second) {
+      BASIS_LOG_WARN("Unit {} can't deserialize {} on {}, skipping it", unit->Name(), type, topic);
+    }
+    return nullptr;
+  }
+  return helper->second(payload);
+}
+
+void DeterministicReplayer::Deliver(const mcap::MessageView &message) {
+  const std::string &topic = message.channel->topic;
+  auto it = subscriptions.find(topic);
+  if (it == subscriptions.end()) {
+    return;
+  }
+
+  const auto [type, type_name] = RecordedType(message);
+  const std::span<const std::byte> payload(message.message.data, message.message.dataSize);
+  std::deque<Message> outputs;
+  // Deserialized once per unit, each unit brings its own deserializers
+  Unit *deserialized_for = nullptr;
+  std::shared_ptr<const void> deserialized;
+  for (const Subscription &subscription : it->second) {
+    if (subscription.unit != deserialized_for) {
+      deserialized_for = subscription.unit;
+      deserialized = Deserialize(subscription.unit, type, topic, payload);
+    }
+    if (!deserialized) {
+      continue;
+    }
+
+    HandlerPubSub::HandlerExecutingCallback callback;
+    subscription.handler->type_erased_callbacks.at(topic)(deserialized, &callback, type_name);
+    RunHandler(subscription.handler, callback, outputs);
+  }
+  DrainOutputs(outputs);
+}
+
+void DeterministicReplayer::RunTimersBefore(int64_t time) {
+  while (!timers.empty() && timers.front().next < time) {
+    std::pop_heap(timers.begin(), timers.end(), std::greater<>());
+    Timer &timer = timers.back();
+    if (thread_pool) {
+      now = timer.next;
+      auto step = std::make_unique<Step>();
+      step->time = now;
+      step->timer_handler = timer.handler;
+      step->plan = &GetPlan({unit_groups.at(handler_units.at(timer.handler))});
+      Submit(std::move(step));
+    } else {
+      SetTime(timer.next);
+
+      HandlerPubSub::HandlerExecutingCallback callback;
+      timer.handler->OnRateSubscriberTypeErased(core::MonotonicTime::FromNanoseconds(now), &callback);
+      std::deque<Message> outputs;
+      RunHandler(timer.handler, callback, outputs);
+      DrainOutputs(outputs);
+    }
+
+    timer.next += timer.handler->rate_duration->nsecs;
+    std::push_heap(timers.begin(), timers.end(), std::greater<>());
+  }
+}
+
+bool DeterministicReplayer::Run() {
+  stats = {};
+  if (config.mmap) {
+    mapped_file = MappedFile::Create(config.input);
+  }
+  auto status = mapped_file ? mcap_reader.open(*mapped_file) : mcap_reader.open(std::string(config.input));
+  if (status.ok()) {
+    status = mcap_reader.readSummary(mcap::ReadSummaryMethod::AllowFallbackScan);
+  }
+  if (!status.ok() || !mcap_reader.statistics()) {
+    BASIS_LOG_ERROR("Unable to read {}: {}", config.input.string(), status.message);
+    return false;
+  }
+
+  const int64_t recording_start = mcap_reader.statistics()->messageStartTime;
+  const int64_t window_start =
+      config.start ? std::max(recording_start, recording_start + config.start->nsecs) : recording_start;
+  const int64_t window_end =
+      config.end ? recording_start + config.end->nsecs : (int64_t)mcap_reader.statistics()->messageEndTime + 1;
+
+  for (const auto &[topic, _] : subscriptions) {
+    if (produced_topics.contains(topic)) {
+      BASIS_LOG_INFO("{} is published by a replayed unit, ignoring it in the recording", topic);
+    }
+  }
+
+  const std::unordered_set<std::string> selected_topics(config.topics.begin(), config.topics.end());
+  mcap::ReadMessageOptions options;
+  options.readOrder = mcap::ReadMessageOptions::ReadOrder::LogTimeOrder;
+  options.startTime = window_start;
+  options.endTime = window_end;
+  // Only chunks holding something a handler consumes are read
+  options.topicFilter = [&](std::string_view topic_view) {
+    const std::string topic(topic_view);
+    return subscriptions.contains(topic) && !produced_topics.contains(topic) &&
+           (selected_topics.empty() || selected_topics.contains(topic));
+  };
+
+  if (config.deterministic_threads > 0) {
+    BuildGroups();
+    thread_pool = std::make_unique<core::threading::ThreadPool>(config.deterministic_threads);
+    BASIS_LOG_INFO("Running {} units as {} independent groups on {} threads", units.size(), groups.size(),
+                   config.deterministic_threads);
+  }
+
+  run_token = core::MonotonicTime::Now(true).nsecs;
+  SetTime(window_start);
+  timers.clear();
+  for (HandlerPubSub *handler : rate_handlers) {
+    timers.push_back({window_start + handler->rate_duration->nsecs, timers.size(), handler});
+  }
+  std::make_heap(timers.begin(), timers.end(), std::greater<>());
+
+  const auto wall_start = std::chrono::steady_clock::now();
+  auto on_problem = [](const mcap::Status &problem) { BASIS_LOG_ERROR("Mcap failure: {}", problem.message); };
+  for (const mcap::MessageView &message : mcap_reader.readMessages(on_problem, options)) {
+    const int64_t time = message.message.logTime;
+    RunTimersBefore(time);
+    if (thread_pool) {
+      now = std::max(now, time);
+      DeliverInParallel(message);
+    } else {
+      SetTime(std::max(now, time));
+      Deliver(message);
+    }
+    stats.messages++;
+  }
+  RunTimersBefore(window_end);
+  while (!in_flight.empty()) {
+    CommitOldest();
+  }
+  thread_pool.reset();
+
+  stats.wall_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_start).count();
+  stats.recording_nsecs = now - window_start;
+  const double recording_seconds = stats.recording_nsecs / 1e9;
+  BASIS_LOG_INFO("Deterministically replayed {} messages through {} handler runs ({} outputs), covering {:.2f}s of "
+                 "recording in {:.2f}s: {:.2f}x realtime",
+                 stats.messages, stats.handler_runs, stats.outputs, recording_seconds, stats.wall_seconds,
+                 stats.wall_seconds > 0.0 ? recording_seconds / stats.wall_seconds : 0.0);
+
+  core::MonotonicTime::SetSimulatedTime(core::time::INVALID_NSECS, 0);
+  mcap_reader.close();
+  mapped_file.reset();
+  return true;
+}
+
+void DeterministicReplayer::BuildGroups() {
+  groups.clear();
+  unit_groups.clear();
+  topic_groups.clear();
+  plans.clear();
+
+  const size_t unit_count = units.size();
+  std::unordered_map<Unit *, size_t> unit_indices;
+  for (size_t i = 0; i < unit_count; i++) {
+    unit_indices[units[i].get()] = i;
+  }
+  // An edge from each unit to every unit subscribed to something it outputs
+  std::vector<std::vector<size_t>> edges(unit_count);
+  for (size_t i = 0; i < unit_count; i++) {
+    for (const auto &[_, handler] : units[i]->handlers) {
+      for (const std::string &topic : handler->outputs) {
+        auto it = subscriptions.find(topic);
+        if (it == subscriptions.end()) {
+          continue;
+        }
+        for (const Subscription &subscription : it->second) {
+          edges[i].push_back(unit_indices.at(subscription.unit));
+        }
+      }
+    }
+  }
+
+  // Tarjan's - units feeding each other in a cycle end up in the same component, components come out downstream first
+  constexpr size_t UNVISITED = std::numeric_limits<size_t>::max();
+  std::vector<size_t> index(unit_count, UNVISITED);
+  std::vector<size_t> lowlink(unit_count);
+  std::vector<size_t> component(unit_count);
+  std::vector<size_t> stack;
+  std::vector<bool> on_stack(unit_count);
+  size_t next_index = 0;
+  size_t component_count = 0;
+  std::function<void(size_t)> visit = [&](size_t v) {
+    index[v] = lowlink[v] = next_index++;
+    stack.push_back(v);
+    on_stack[v] = true;
+    for (size_t w : edges[v]) {
+      if (index[w] == UNVISITED) {
+        visit(w);
+        lowlink[v] = std::min(lowlink[v], lowlink[w]);
+      } else if (on_stack[w]) {
+        lowlink[v] = std::min(lowlink[v], index[w]);
+      }
+    }
+    if (lowlink[v] == index[v]) {
+      size_t w;
+      do {
+        w = stack.back();
+        stack.pop_back();
+        on_stack[w] = false;
+        component[w] = component_count;
+      } while (w != v);
+      component_count++;
+    }
+  };
+  for (size_t i = 0; i < unit_count; i++) {
+    if (index[i] == UNVISITED) {
+      visit(i);
+    }
+  }
+
+  // Flipped into topological order, so that downstream groups always have higher indices
+  for (size_t i = 0; i < component_count; i++) {
+    groups.push_back(std::make_unique<Group>());
+  }
+  for (size_t i = 0; i < unit_count; i++) {
+    const size_t group = component_count - 1 - component[i];
+    unit_groups[units[i].get()] = group;
+    for (size_t j : edges[i]) {
+      const size_t downstream = component_count - 1 - component[j];
+      if (downstream != group) {
+        groups[group]->downstream.push_back(downstream);
+      }
+    }
+  }
+  for (auto &group : groups) {
+    std::sort(group->downstream.begin(), group->downstream.end());
+    group->downstream.erase(std::unique(group->downstream.begin(), group->downstream.end()), group->downstream.end());
+  }
+
+  for (const auto &[topic, topic_subscriptions] : subscriptions) {
+    std::vector<size_t> &subscribed = topic_groups[topic];
+    for (const Subscription &subscription : topic_subscriptions) {
+      subscribed.push_back(unit_groups.at(subscription.unit));
+    }
+    std::sort(subscribed.begin(), subscribed.end());
+    subscribed.erase(std::unique(subscribed.begin(), subscribed.end()), subscribed.end());
+  }
+}
+
+const DeterministicReplayer::Plan &DeterministicReplayer::GetPlan(const std::vector<size_t> &root_groups) {
+  auto it = plans.find(root_groups);
+  if (it != plans.end()) {
+    return it->second;
+  }
+
+  std::vector<bool> reached(groups.size());
+  for (size_t group : root_groups) {
+    reached[group] = true;
+  }
+  // Downstream groups have higher indices, so one pass in order reaches everything
+  Plan plan;
+  plan.upstream_count.resize(groups.size());
+  for (size_t group = 0; group < groups.size(); group++) {
+    if (!reached[group]) {
+      continue;
+    }
+    plan.groups.push_back(group);
+    for (size_t downstream : groups[group]->downstream) {
+      reached[downstream] = true;
+      plan.upstream_count[downstream]++;
+    }
+  }
+  return plans.emplace(root_groups, std::move(plan)).first->second;
+}
+
+void DeterministicReplayer::DeliverInParallel(const mcap::MessageView &message) {
+  auto step = std::make_unique<Step>();
+  step->time = now;
+  step->topic = message.channel->topic;
+  std::tie(step->type, step->type_name) = RecordedType(message);
+  step->plan = &GetPlan(topic_groups.at(step->topic));
+
+  // The reader reuses its buffers, unless the message is straight out of the mapping
+  const std::span<const std::byte> payload(message.message.data, message.message.dataSize);
+  if (mapped_file && mapped_file->Contains(payload)) {
+    step->payload = payload;
+  } else {
+    step->payload_copy = std::make_shared_for_overwrite<std::byte[]>(payload.size());
+    std::copy(payload.begin(), payload.end(), step->payload_copy.get());
+    step->payload = {step->payload_copy.get(), payload.size()};
+  }
+  Submit(std::move(step));
+}
+
+void DeterministicReplayer::Submit(std::unique_ptr<Step> step) {
+  while (!in_flight.empty() && (in_flight.size() >= MAX_STEPS_IN_FLIGHT || in_flight.front()->remaining == 0)) {
+    CommitOldest();
+  }
+
+  Step *submitted = step.get();
+  const Plan &plan = *submitted->plan;
+  submitted->work = std::make_unique<GroupWork[]>(groups.size());
+  for (size_t group : plan.groups) {
+    submitted->work[group].waiting = plan.upstream_count[group];
+  }
+  submitted->remaining = plan.groups.size();
+  in_flight.push_back(std::move(step));
+
+  for (size_t group : plan.groups) {
+    std::lock_guard lock(groups[group]->mutex);
+    groups[group]->pending.push_back(submitted);
+  }
+  // Upstream groups may already be done with it, so every group gets a look
+  for (size_t group : plan.groups) {
+    TryRunGroup(group);
+  }
+}
+
+void DeterministicReplayer::TryRunGroup(size_t group_index) {
+  Group &group = *groups[group_index];
+  Step *step = nullptr;
+  {
+    std::lock_guard lock(group.mutex);
+    if (group.running || group.pending.empty() || group.pending.front()->work[group_index].waiting != 0) {
+      return;
+    }
+    group.running = true;
+    step = group.pending.front();
+    group.pending.pop_front();
+  }
+  thread_pool->post([this, group_index, step]() { RunGroup(group_index, *step); });
+}
+
+void DeterministicReplayer::RunGroup(size_t group_index, Step &step) {
+  core::MonotonicTime::SetThreadSimulatedTime(step.time);
+
+  // Everything upstream is done with this step, so the inbox is complete
+  std::priority_queue<KeyedMessage> queue({}, std::move(step.work[group_index].inbox));
+
+  // The step's root always comes first
+  if (step.timer_handler) {
+    if (unit_groups.at(handler_units.at(step.timer_handler)) == group_index) {
+      HandlerPubSub::HandlerExecutingCallback callback;
+      step.timer_handler->OnRateSubscriberTypeErased(core::MonotonicTime::FromNanoseconds(step.time), &callback);
+      RunHandlerInGroup(group_index, step, step.timer_handler, callback, {0}, queue);
+    }
+  } else {
+    const std::vector<Subscription> &recorded_subscriptions = subscriptions.at(step.topic);
+    Unit *deserialized_for = nullptr;
+    std::shared_ptr<const void> deserialized;
+    for (uint32_t j = 0; j < recorded_subscriptions.size(); j++) {
+      const Subscription &subscription = recorded_subscriptions[j];
+      if (unit_groups.at(subscription.unit) != group_index) {
+        continue;
+      }
+      if (subscription.unit != deserialized_for) {
+        deserialized_for = subscription.unit;
+        deserialized = Deserialize(subscription.unit, step.type, step.topic, step.payload);
+      }
+      if (!deserialized) {
+        continue;
+      }
+      HandlerPubSub::HandlerExecutingCallback callback;
+      subscription.handler->type_erased_callbacks.at(step.topic)(deserialized, &callback, step.type_name);
+      RunHandlerInGroup(group_index, step, subscription.handler, callback, {j}, queue);
+    }
+  }
+
+  while (!queue.empty()) {
+    const KeyedMessage next = queue.top();
+    queue.pop();
+    const std::vector<Subscription> &topic_subscriptions = subscriptions.at(next.message.topic);
+    for (uint32_t j = 0; j < topic_subscriptions.size(); j++) {
+      const Subscription &subscription = topic_subscriptions[j];
+      if (unit_groups.at(subscription.unit) != group_index) {
+        continue;
+      }
+      HandlerPubSub::HandlerExecutingCallback callback;
+      subscription.handler->type_erased_callbacks.at(next.message.topic)(next.message.message, &callback,
+                                                                         next.message.type_name);
+      Key key = next.key;
+      key.push_back(j);
+      RunHandlerInGroup(group_index, step, subscription.handler, callback, std::move(key), queue);
+    }
+  }
+  core::MonotonicTime::SetThreadSimulatedTime(core::time::INVALID_NSECS);
+
+  for (size_t downstream : groups[group_index]->downstream) {
+    if (step.work[downstream].waiting.fetch_sub(1) == 1) {
+      TryRunGroup(downstream);
+    }
+  }
+  {
+    std::lock_guard lock(groups[group_index]->mutex);
+    groups[group_index]->running = false;
+  }
+  TryRunGroup(group_index);
+
+  // Last, the step may be freed as soon as this hits zero
+  if (step.remaining.fetch_sub(1) == 1) {
+    std::lock_guard lock(step_done_mutex);
+    step_done.notify_all();
+  }
+}
+
+void DeterministicReplayer::RunHandlerInGroup(size_t group_index, Step &step, HandlerPubSub *handler,
+                                              HandlerPubSub::HandlerExecutingCallback &callback, Key key,
+                                              std::priority_queue<KeyedMessage> &queue) {
+  if (!callback) {
+    return;
+  }
+  GroupWork &work = step.work[group_index];
+  work.handler_runs++;
+
+  uint32_t output_index = 0;
+  for (Message &message : CollectOutputs(handler, callback)) {
+    Key output_key = key;
+    output_key.push_back(output_index++);
+    auto subscribed = topic_groups.find(message.topic);
+    if (subscribed != topic_groups.end()) {
+      for (size_t group : subscribed->second) {
+        if (group == group_index) {
+          queue.push({output_key, message});
+        } else {
+          std::lock_guard lock(step.work[group].inbox_mutex);
+          step.work[group].inbox.push_back({output_key, message});
+        }
+      }
+    }
+    work.outputs.push_back({std::move(output_key), std::move(message)});
+  }
+}
+
+void DeterministicReplayer::CommitOldest() {
+  Step &step = *in_flight.front();
+  {
+    std::unique_lock lock(step_done_mutex);
+    step_done.wait(lock, [&step]() { return step.remaining == 0; });
+  }
+
+  std::vector<KeyedMessage> outputs;
+  for (size_t group : step.plan->groups) {
+    GroupWork &work = step.work[group];
+    stats.handler_runs += work.handler_runs;
+    std::move(work.outputs.begin(), work.outputs.end(), std::back_inserter(outputs));
+  }
+  std::sort(outputs.begin(), outputs.end(),
+            [](const KeyedMessage &a, const KeyedMessage &b) { return KeyBefore(a.key, b.key); });
+  stats.outputs += outputs.size();
+
+  core::MonotonicTime::SetSimulatedTime(step.time, run_token);
+  if (output_callback) {
+    for (const KeyedMessage &output : outputs) {
+      output_callback(core::MonotonicTime::FromNanoseconds(step.time), output.message.topic, output.message.message,
+                      output.message.type_name);
+    }
+  }
+  in_flight.pop_front();
+}
+
+} // namespace basis
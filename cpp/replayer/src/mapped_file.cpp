@@ -0,0 +1,50 @@
+#include <basis/replayer/logger.h>
+#include <basis/replayer/mapped_file.h>
+
+#include <algorithm>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace basis::replayer {
+
+std::shared_ptr<MappedFile> MappedFile::Create(const std::filesystem::path &path) {
+  const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd == -1) {
+    BASIS_LOG_ERROR("Unable to open {}: {}", path.string(), strerror(errno));
+    return nullptr;
+  }
+
+  struct stat stat_buf;
+  if (fstat(fd, &stat_buf) == -1 || stat_buf.st_size == 0) {
+    close(fd);
+    return nullptr;
+  }
+
+  const size_t mapping_size = stat_buf.st_size;
+  void *mapping = mmap(nullptr, mapping_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    BASIS_LOG_WARN("Unable to map {}: {}", path.string(), strerror(errno));
+    return nullptr;
+  }
+  // Replay reads front to back - let the kernel read ahead aggressively
+  madvise(mapping, mapping_size, MADV_SEQUENTIAL);
+
+  return std::shared_ptr<MappedFile>(new MappedFile(static_cast<std::byte *>(mapping), mapping_size));
+}
+
+MappedFile::~MappedFile() { munmap(mapping, mapping_size); }
+
+uint64_t MappedFile::read(std::byte **output, uint64_t offset, uint64_t size) {
+  if (offset >= mapping_size) {
+    return 0;
+  }
+  *output = mapping + offset;
+  return std::min<uint64_t>(size, mapping_size - offset);
+}
+
+} // namespace basis::replayer
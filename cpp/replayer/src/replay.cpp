@@ -28,12 +28,19 @@ int main(int argc, char *argv[]) {
   transport_manager.RegisterTransport("net_tcp", std::make_unique<basis::plugins::transport::TcpTransport>());
 
   Config config;
+  if (!HandleRecordingArguments(*parser, config)) {
+    return 1;
+  }
   config.loop = parser->get<bool>(LOOP_ARG);
-  config.input = parser->get(RECORDING_ARG);
-
-  basis::Replayer replayer(std::move(config), transport_manager, *coordinator_connector);
+  config.rate = parser->get<double>(RATE_ARG);
+  config.as_fast_as_possible = parser->get<bool>(AS_FAST_AS_POSSIBLE_ARG);
+  config.max_pending_messages = parser->get<size_t>(MAX_PENDING_ARG);
+  if (!(config.rate > 0.0)) {
+    std::cerr << "--rate must be positive" << std::endl;
+    return 1;
+  }
 
-  replayer.Run();
+  basis::Replayer replayer(std::move(config), transport_manager, coordinator_connector.get());
 
-  return 0;
+  return replayer.Run() ? 0 : 1;
 }
\ No newline at end of file
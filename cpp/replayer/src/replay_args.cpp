@@ -1,5 +1,7 @@
 #include <basis/replayer/replay_args.h>
 
+#include <iostream>
+
 namespace basis::replayer {
 
 std::unique_ptr<argparse::ArgumentParser> CreateArgumentParser() {
@@ -7,10 +9,57 @@ std::unique_ptr<argparse::ArgumentParser> CreateArgumentParser() {
 
   
   parser->add_argument(LOOP_ARG).help("Whether or not to loop the playback.").default_value(false).implicit_value(true);
-  // TODO: allow multiple mcap files, directory support
-  parser->add_argument(RECORDING_ARG).help("The MCAP file to replay.");
+  parser->add_argument(RATE_ARG)
+      .help("Playback speed, relative to the recording.")
+      .default_value(1.0)
+      .scan<'g', double>();
+  parser->add_argument(AS_FAST_AS_POSSIBLE_ARG)
+      .help("Ignore --rate and publish as fast as possible.")
+      .default_value(false)
+      .implicit_value(true);
+  parser->add_argument(MAX_PENDING_ARG)
+      .help("Wait for subscribers that are this many messages behind, rather than dropping. 0 never waits.")
+      .default_value(size_t(0))
+      .scan<'u', size_t>();
+  AddRecordingArguments(*parser);
 
   return parser;
 }
 
+void AddRecordingArguments(argparse::ArgumentParser &parser) {
+  parser.add_argument(START_ARG)
+      .help("Seconds into the recording to start replaying from.")
+      .scan<'g', double>();
+  parser.add_argument(END_ARG)
+      .help("Seconds into the recording to stop replaying at.")
+      .scan<'g', double>();
+  // One topic per flag - taking any number would swallow the recording path that follows
+  parser.add_argument(TOPICS_ARG).help("Only replay this topic, can be repeated.").append();
+  // TODO: allow multiple mcap files, directory support
+  parser.add_argument(RECORDING_ARG).help("The MCAP file to replay.");
+}
+
+bool HandleRecordingArguments(const argparse::ArgumentParser &parser, Config &config) {
+  config.input = parser.get(RECORDING_ARG);
+  const std::optional<double> start = parser.present<double>(START_ARG);
+  if (start) {
+    if (!(*start >= 0.0)) {
+      std::cerr << START_ARG << " can't be negative" << std::endl;
+      return false;
+    }
+    config.start = basis::core::Duration::FromSeconds(*start);
+  }
+  if (auto end = parser.present<double>(END_ARG)) {
+    if (!(*end > start.value_or(0.0))) {
+      std::cerr << END_ARG << " must be after " << START_ARG << std::endl;
+      return false;
+    }
+    config.end = basis::core::Duration::FromSeconds(*end);
+  }
+  if (auto topics = parser.present<std::vector<std::string>>(TOPICS_ARG)) {
+    config.topics = std::move(*topics);
+  }
+  return true;
+}
+
 } // namespace basis::replayer
\ No newline at end of file
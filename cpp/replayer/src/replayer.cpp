@@ -3,13 +3,16 @@
 #include <basis/core/transport/publisher.h>
 #include <basis/replayer.h>
 #include <basis/unit.h>
+#include <algorithm>
 #include <chrono>
 #include <cstdint>
 #include <google/protobuf/wrappers.pb.h>
 #include <mcap/errors.hpp>
 #include <mcap/types.hpp>
+#include <cstring>
 #include <memory>
 #include <thread>
+#include <unordered_set>
 
 DECLARE_AUTO_LOGGER_NS(basis::replayer)
 
@@ -18,7 +21,14 @@ using namespace replayer;
 void LogMcapFailure(mcap::Status status) { BASIS_LOG_ERROR("Mcap failure: {}", status.message); }
 
 bool Replayer::LoadRecording(std::filesystem::path recording_path) {
-  auto status = mcap_reader.open(std::string(recording_path));
+  if (config.mmap) {
+    mapped_file = MappedFile::Create(recording_path);
+  }
+  auto status = mapped_file ? mcap_reader.open(*mapped_file) : mcap_reader.open(std::string(recording_path));
+  if (!status.ok()) {
+    LogMcapFailure(status);
+    return false;
+  }
   status = mcap_reader.readSummary(mcap::ReadSummaryMethod::AllowFallbackScan);
 
   if(!status.ok()) {
@@ -29,8 +39,12 @@ bool Replayer::LoadRecording(std::filesystem::path recording_path) {
 }
 
 bool Replayer::OnRecordLoaded() {
+  const std::unordered_set<std::string> selected_topics(config.topics.begin(), config.topics.end());
   for (const auto &[channel_id, channel] : mcap_reader.channels()) {
     [[maybe_unused]] const std::string &topic = channel->topic;
+    if (!selected_topics.empty() && !selected_topics.contains(topic)) {
+      continue;
+    }
     core::serialization::MessageTypeInfo message_type;
     std::shared_ptr<mcap::Schema> mcap_schema = mcap_reader.schema(channel->schemaId);
 
@@ -55,16 +69,224 @@ bool Replayer::OnRecordLoaded() {
       return false;
     }
 
-    publishers.emplace(topic, publisher);
+    if (config.max_pending_messages) {
+      // Waiting on subscribers replaces trimming their queues
+      publisher->SetMaxQueueSize(0);
+    }
 
-    time_publisher = transport_manager.Advertise<basis::core::transport::proto::Time>("/time");
+    publishers.emplace(topic, publisher);
 
     BASIS_LOG_INFO("replaying topic {}", topic);
   }
 
+  for (const std::string &topic : selected_topics) {
+    if (!publishers.contains(topic)) {
+      BASIS_LOG_WARN("Topic {} isn't in the recording", topic);
+    }
+  }
+
+  time_publisher = transport_manager.Advertise<basis::core::transport::proto::Time>("/time");
+
+  return true;
+}
+
+bool Replayer::CanReadInFileOrder() const {
+  uint64_t previous_end = 0;
+  for (const mcap::ChunkIndex &chunk_index : mcap_reader.chunkIndexes()) {
+    // Compressed chunks are decompressed into a buffer either way
+    if (!chunk_index.compression.empty() || chunk_index.messageStartTime < previous_end) {
+      return false;
+    }
+    previous_end = chunk_index.messageEndTime;
+  }
+  return true;
+}
+
+int64_t Replayer::WindowStart() const {
+  const int64_t recording_start = mcap_reader.statistics()->messageStartTime;
+  return config.start ? std::max(recording_start, recording_start + config.start->nsecs) : recording_start;
+}
+
+int64_t Replayer::WindowEnd() const {
+  const auto &statistics = mcap_reader.statistics();
+  return config.end ? (int64_t)statistics->messageStartTime + config.end->nsecs
+                    : (int64_t)statistics->messageEndTime + 1;
+}
+
+void Replayer::Seek(const basis::core::MonotonicTime &time) {
+  {
+    std::lock_guard lock(prefetch_mutex);
+    seek_target = time.nsecs;
+    seek_generation++;
+  }
+  prefetch_changed.notify_all();
+}
+
+void Replayer::StartPrefetching() {
+  StopPrefetching();
+  {
+    std::lock_guard lock(prefetch_mutex);
+    prefetched.clear();
+    prefetched_bytes = 0;
+    prefetch_done = false;
+    prefetch_stop = false;
+  }
+  prefetch_thread = std::thread([this]() { PrefetchThread(); });
+}
+
+void Replayer::StopPrefetching() {
+  {
+    std::lock_guard lock(prefetch_mutex);
+    prefetch_stop = true;
+  }
+  prefetch_changed.notify_all();
+  if (prefetch_thread.joinable()) {
+    prefetch_thread.join();
+  }
+}
+
+bool Replayer::PushPrefetched(PrefetchedMessage message) {
+  const size_t size = message.packet ? message.packet->GetPayload().size() : 0;
+  {
+    std::unique_lock lock(prefetch_mutex);
+    prefetch_changed.wait(lock, [&]() {
+      // Always let a single message through, no matter how large
+      return prefetch_stop || message.generation != seek_generation || prefetched.empty() ||
+             (prefetched.size() < config.prefetch_max_messages &&
+              prefetched_bytes + size <= config.prefetch_max_bytes);
+    });
+    if (prefetch_stop || message.generation != seek_generation) {
+      return false;
+    }
+    prefetched.push_back(std::move(message));
+    prefetched_bytes += size;
+  }
+  prefetch_changed.notify_all();
   return true;
 }
 
+std::optional<Replayer::PrefetchedMessage> Replayer::PopPrefetched() {
+  std::optional<PrefetchedMessage> out;
+  {
+    std::unique_lock lock(prefetch_mutex);
+    prefetch_changed.wait(lock, [this]() { return !prefetched.empty() || prefetch_done || prefetch_stop; });
+    if (prefetched.empty()) {
+      return std::nullopt;
+    }
+    out = std::move(prefetched.front());
+    prefetched.pop_front();
+    prefetched_bytes -= out->packet ? out->packet->GetPayload().size() : 0;
+  }
+  prefetch_changed.notify_all();
+  return out;
+}
+
+void Replayer::PrefetchThread() {
+  mcap::ReadMessageOptions options;
+  options.readOrder = mapped_file && CanReadInFileOrder() ? mcap::ReadMessageOptions::ReadOrder::FileOrder
+                                                          : mcap::ReadMessageOptions::ReadOrder::LogTimeOrder;
+  options.endTime = WindowEnd();
+  if (!config.topics.empty()) {
+    // The reader skips any chunk whose message indexes have none of these channels
+    options.topicFilter = [this](std::string_view topic) { return publishers.contains(std::string(topic)); };
+  }
+
+  int64_t start = WindowStart();
+  uint64_t generation = seek_generation;
+  while (true) {
+    const bool finished = PrefetchPass(options, start, generation);
+
+    std::unique_lock lock(prefetch_mutex);
+    if (finished && generation == seek_generation) {
+      if (config.loop) {
+        start = WindowStart();
+        continue;
+      }
+      prefetch_done = true;
+      prefetch_changed.notify_all();
+      // Stick around for a seek back into the recording, until Run() drains the queue and stops us
+      prefetch_changed.wait(lock, [&]() { return prefetch_stop || generation != seek_generation; });
+    }
+    if (prefetch_stop) {
+      return;
+    }
+
+    // Seeked - whatever was read ahead is from before the seek
+    generation = seek_generation;
+    start = std::clamp(seek_target, WindowStart(), WindowEnd());
+    prefetched.clear();
+    prefetched_bytes = 0;
+    prefetch_done = false;
+  }
+}
+
+bool Replayer::PrefetchPass(const mcap::ReadMessageOptions &pass_options, int64_t start, uint64_t generation) {
+  mcap::ReadMessageOptions options = pass_options;
+  // Chunks that end before this are never read
+  options.startTime = start;
+  uint64_t borrowed_count = 0;
+  uint64_t copied_count = 0;
+
+  if (!PushPrefetched({nullptr, nullptr, start, generation})) {
+    return false;
+  }
+  for (const mcap::MessageView &message : mcap_reader.readMessages(LogMcapFailure, options)) {
+    const std::span<const std::byte> payload(message.message.data, message.message.dataSize);
+    std::shared_ptr<core::transport::MessagePacket> packet;
+    if (mapped_file && mapped_file->Contains(payload)) {
+      packet = std::make_shared<core::transport::MessagePacket>(core::transport::MessageHeader::DataType::MESSAGE,
+                                                                payload, mapped_file);
+      borrowed_count++;
+    } else {
+      packet = std::make_shared<core::transport::MessagePacket>(core::transport::MessageHeader::DataType::MESSAGE,
+                                                                message.message.dataSize);
+      memcpy(packet->GetMutablePayload().data(), payload.data(), payload.size());
+      copied_count++;
+    }
+    if (!PushPrefetched({publishers.at(message.channel->topic).get(), std::move(packet),
+                         (int64_t)message.message.publishTime, generation})) {
+      return false;
+    }
+  }
+  BASIS_LOG_DEBUG("Read through recording, {} messages published from the mapping, {} copied", borrowed_count,
+                  copied_count);
+  return true;
+}
+
+void Replayer::UpdateIfDue() {
+  constexpr auto UPDATE_INTERVAL = std::chrono::milliseconds(10);
+  const auto wall_now = std::chrono::steady_clock::now();
+  if (wall_now < next_update) {
+    return;
+  }
+  basis::StandardUpdate(&transport_manager, coordinator_connector);
+  next_update = wall_now + UPDATE_INTERVAL;
+}
+
+void Replayer::WaitForSubscribers(basis::core::transport::PublisherRaw &publisher) {
+  if (config.max_pending_messages == 0) {
+    return;
+  }
+  while (publisher.GetPendingMessageCount() >= config.max_pending_messages) {
+    std::this_thread::sleep_for(std::chrono::microseconds(100));
+    // Keep accepting (and dropping dead) subscribers, a stuck one would otherwise stall playback forever
+    UpdateIfDue();
+  }
+}
+
+void Replayer::ReportThroughput(const PassStats &stats) {
+  const double wall_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - stats.wall_start).count();
+  const double recording_seconds = (stats.recording_end - stats.recording_start) / 1e9;
+  const double megabytes = stats.bytes / (1024.0 * 1024.0);
+  if (wall_seconds <= 0.0) {
+    return;
+  }
+  BASIS_LOG_INFO("Replayed {} messages ({:.1f} MiB) covering {:.2f}s of recording in {:.2f}s: {:.2f}x realtime, "
+                 "{:.0f} messages/s, {:.1f} MiB/s",
+                 stats.messages, megabytes, recording_seconds, wall_seconds, recording_seconds / wall_seconds,
+                 stats.messages / wall_seconds, megabytes / wall_seconds);
+}
+
 bool Replayer::Run() {
   bool ok = LoadRecording(config.input);
 
@@ -72,41 +294,73 @@ bool Replayer::Run() {
     return false;
   }
 
-  do {
-    const auto &statistics = mcap_reader.statistics();
-    basis::core::MonotonicTime now;
-    now.nsecs = (int64_t)statistics->messageStartTime;
-    BASIS_LOG_INFO("Beginning replay at {}", now.ToSeconds());
-    mcap::ReadMessageOptions options;
-    options.readOrder = mcap::ReadMessageOptions::ReadOrder::LogTimeOrder;
-
-    auto message_view = mcap_reader.readMessages(LogMcapFailure, options);
-
-    basis::StandardUpdate(&transport_manager, &coordinator_connector);
-
-    const int64_t token = basis::core::MonotonicTime::Now().nsecs;
-
-    auto wall_next = std::chrono::steady_clock::now();
-    for (const mcap::MessageView &message : message_view) {
-      while (now.nsecs < (int64_t)message.message.publishTime) {
-        constexpr int64_t NSECS_PER_TICK = 10000000; // 100hz
-        now.nsecs += NSECS_PER_TICK;
-        wall_next += std::chrono::nanoseconds(NSECS_PER_TICK);
-        std::this_thread::sleep_until(wall_next);
-        basis::StandardUpdate(&transport_manager, &coordinator_connector);
-        auto time_message = std::make_shared<basis::core::transport::proto::Time>();
-        time_message->set_nsecs(now.nsecs);
-        time_message->set_run_token(*reinterpret_cast<const uint64_t*>(&token));
-        time_publisher->Publish(time_message);
+  StartPrefetching();
+
+  basis::core::MonotonicTime now;
+  int64_t token = 0;
+  std::optional<PassStats> pass;
+  const int64_t max_time_step = config.max_time_step.nsecs > 0 ? config.max_time_step.nsecs : INT64_MAX;
+
+  while (std::optional<PrefetchedMessage> message = PopPrefetched()) {
+    if (message->generation != seek_generation) {
+      // Read before a Seek()
+      continue;
+    }
+    if (!message->publisher) {
+      if (pass) {
+        ReportThroughput(*pass);
       }
-      BASIS_LOG_DEBUG("Publishing on {}", message.channel->topic);
+      now.nsecs = message->publish_time;
+      BASIS_LOG_INFO("Beginning replay at {}", now.ToSeconds());
+
+      next_update = {};
+      UpdateIfDue();
 
-      auto packet = std::make_shared<core::transport::MessagePacket>(core::transport::MessageHeader::DataType::MESSAGE,
-                                                                     message.message.dataSize);
-      memcpy(packet->GetMutablePayload().data(), message.message.data, message.message.dataSize);
-      publishers.at(message.channel->topic)->PublishRaw(packet, now);
+      token = basis::core::MonotonicTime::Now().nsecs;
+      pass = PassStats{.wall_start = std::chrono::steady_clock::now(),
+                       .recording_start = now.nsecs,
+                       .recording_end = now.nsecs,
+                       .messages = 0,
+                       .bytes = 0};
+      continue;
     }
-  } while (config.loop);
+
+    // Step /time up to the message, landing on its timestamp exactly
+    while (now.nsecs < message->publish_time && message->generation == seek_generation) {
+      now.nsecs = message->publish_time - now.nsecs > max_time_step ? now.nsecs + max_time_step : message->publish_time;
+      if (!config.as_fast_as_possible) {
+        // Paced against the start of the pass, rather than the previous step, so that falling behind is caught up on
+        const auto offset = std::chrono::nanoseconds(int64_t((now.nsecs - pass->recording_start) / config.rate));
+        std::this_thread::sleep_until(pass->wall_start + offset);
+      }
+      UpdateIfDue();
+      auto time_message = std::make_shared<basis::core::transport::proto::Time>();
+      time_message->set_nsecs(now.nsecs);
+      time_message->set_run_token(*reinterpret_cast<const uint64_t*>(&token));
+      time_publisher->Publish(time_message);
+    }
+
+    if (message->generation != seek_generation) {
+      continue;
+    }
+
+    WaitForSubscribers(*message->publisher);
+
+    const size_t payload_size = message->packet->GetPayload().size();
+    BASIS_LOG_DEBUG("Publishing {} bytes", payload_size);
+
+    message->publisher->PublishRaw(std::move(message->packet), now);
+    pass->messages++;
+    pass->bytes += payload_size;
+    pass->recording_end = now.nsecs;
+    UpdateIfDue();
+  }
+
+  if (pass) {
+    ReportThroughput(*pass);
+  }
+
+  StopPrefetching();
 
   return ok;
 }
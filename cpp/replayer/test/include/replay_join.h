@@ -0,0 +1,17 @@
+/*
+
+  This is the starting point for your Unit. Edit this directly and implement the missing methods!
+
+*/
+#include <unit/replay_join/unit_base.h>
+
+class replay_join : public unit::replay_join::Base {
+public:
+  replay_join(const Args &args, const std::optional<std::string_view> &name_override = {})
+      : unit::replay_join::Base(args, name_override), args(args) {}
+
+  virtual unit::replay_join::Join::Output Join(const unit::replay_join::Join::Input &input) override;
+
+private:
+  const Args args;
+};
@@ -0,0 +1,17 @@
+/*
+
+  This is the starting point for your Unit. Edit this directly and implement the missing methods!
+
+*/
+#include <unit/replay_relay/unit_base.h>
+
+class replay_relay : public unit::replay_relay::Base {
+public:
+  replay_relay(const Args &args, const std::optional<std::string_view> &name_override = {})
+      : unit::replay_relay::Base(args, name_override), args(args) {}
+
+  virtual unit::replay_relay::Relay::Output Relay(const unit::replay_relay::Relay::Input &input) override;
+
+private:
+  const Args args;
+};
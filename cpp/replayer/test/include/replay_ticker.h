@@ -0,0 +1,18 @@
+/*
+
+  This is the starting point for your Unit. Edit this directly and implement the missing methods!
+
+*/
+#include <unit/replay_ticker/unit_base.h>
+
+class replay_ticker : public unit::replay_ticker::Base {
+public:
+  replay_ticker(const Args &args, const std::optional<std::string_view> &name_override = {})
+      : unit::replay_ticker::Base(args, name_override), args(args) {}
+
+  virtual unit::replay_ticker::Tick::Output Tick(const unit::replay_ticker::Tick::Input &input) override;
+
+private:
+  const Args args;
+  int ticks = 0;
+};
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <test.pb.h>
+
+#include <gtest/gtest.h>
+
+#include <basis/plugins/serialization/protobuf.h>
+#include <basis/recorder.h>
+#include <basis/replayer/config.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <set>
+#include <span>
+#include <string>
+#include <vector>
+
+constexpr int64_t MSECS = 1'000'000;
+
+/**
+ * Base fixture for the replayer tests - writes small recordings of TestExampleMessage into a temporary directory, with
+ * `config` pointing at them.
+ */
+class RecordingTest : public testing::Test {
+public:
+  RecordingTest() {
+    char temp_template[] = "/tmp/tmpdir.XXXXXX";
+    record_dir = mkdtemp(temp_template);
+    config.input = record_dir / "recording.mcap";
+  }
+
+  ~RecordingTest() { std::filesystem::remove_all(record_dir); }
+
+  struct RecordedMessage {
+    int64_t msecs;
+    std::string topic;
+    std::string name;
+  };
+
+  void Record(const std::vector<RecordedMessage> &messages) {
+    basis::Recorder recorder(record_dir);
+    std::set<std::string> registered;
+    for (const RecordedMessage &message : messages) {
+      if (registered.insert(message.topic).second) {
+        using basis::plugins::serialization::protobuf::ProtobufSerializer;
+        ASSERT_TRUE(recorder.RegisterTopic(message.topic,
+                                           ProtobufSerializer::DeduceMessageTypeInfo<TestExampleMessage>(),
+                                           ProtobufSerializer::DumpSchema<TestExampleMessage>()));
+      }
+    }
+    ASSERT_TRUE(recorder.Start("recording"));
+    for (const RecordedMessage &message : messages) {
+      TestExampleMessage msg;
+      msg.set_name(message.name);
+      auto [bytes, size] = basis::SerializeToBytes(msg);
+      ASSERT_TRUE(recorder.WriteMessage(message.topic, std::span<const std::byte>(bytes.get(), size),
+                                        basis::core::MonotonicTime::FromNanoseconds(message.msecs * MSECS)));
+    }
+    recorder.Stop();
+  }
+
+  std::filesystem::path record_dir;
+  basis::replayer::Config config;
+};
@@ -0,0 +1,18 @@
+/*
+
+  This is the starting point for your Unit. Edit this directly and implement the missing methods!
+
+*/
+
+#include <replay_join.h>
+
+#include <algorithm>
+
+using namespace unit::replay_join;
+
+Join::Output replay_join::Join(const Join::Input &input) {
+  auto message = std::make_shared<TestExampleMessage>();
+  message->set_name("(" + input.args_left_->name() + "+" + input.args_right_->name() + ")/" + args.name);
+  message->set_id(std::max(input.args_left_->id(), input.args_right_->id()) + 1);
+  return {message};
+}
@@ -0,0 +1,19 @@
+/*
+
+  This is the starting point for your Unit. Edit this directly and implement the missing methods!
+
+*/
+
+#include <replay_relay.h>
+
+using namespace unit::replay_relay;
+
+Relay::Output replay_relay::Relay(const Relay::Input &input) {
+  if (args.limit > 0 && input.args_input_->id() >= args.limit) {
+    return {};
+  }
+  auto message = std::make_shared<TestExampleMessage>(*input.args_input_);
+  message->set_name(message->name() + "/" + args.name);
+  message->set_id(message->id() + 1);
+  return {message};
+}
@@ -0,0 +1,16 @@
+/*
+
+  This is the starting point for your Unit. Edit this directly and implement the missing methods!
+
+*/
+
+#include <replay_ticker.h>
+
+using namespace unit::replay_ticker;
+
+Tick::Output replay_ticker::Tick(const Tick::Input &input) {
+  auto message = std::make_shared<TestExampleMessage>();
+  message->set_name(args.name + ":" + input.args_input_->name());
+  message->set_id(++ticks);
+  return {message};
+}
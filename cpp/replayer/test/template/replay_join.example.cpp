@@ -0,0 +1,16 @@
+/*
+
+  DO NOT EDIT THIS FILE
+
+  This is a template for use with your Unit, to use as a base, provided as an example.
+
+*/
+
+#include <replay_join.h>
+
+using namespace unit::replay_join;
+
+
+Join::Output replay_join::Join(const Join::Input& input) {
+    static_assert(false, "Implement me");
+}
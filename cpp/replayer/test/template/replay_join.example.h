@@ -0,0 +1,20 @@
+/*
+
+  DO NOT EDIT THIS FILE
+
+  This is a template for use with your Unit, to use as a base, provided as an example.
+
+*/
+#include <unit/replay_join/unit_base.h>
+
+class replay_join : public unit::replay_join::Base {
+public:
+  replay_join(const Args& args, const std::optional<std::string_view>& name_override = {}) 
+  : unit::replay_join::Base(args, name_override)
+  {}
+
+
+  virtual unit::replay_join::Join::Output
+  Join(const unit::replay_join::Join::Input &input) override;
+
+};
\ No newline at end of file
@@ -0,0 +1,16 @@
+/*
+
+  DO NOT EDIT THIS FILE
+
+  This is a template for use with your Unit, to use as a base, provided as an example.
+
+*/
+
+#include <replay_relay.h>
+
+using namespace unit::replay_relay;
+
+
+Relay::Output replay_relay::Relay(const Relay::Input& input) {
+    static_assert(false, "Implement me");
+}
@@ -0,0 +1,20 @@
+/*
+
+  DO NOT EDIT THIS FILE
+
+  This is a template for use with your Unit, to use as a base, provided as an example.
+
+*/
+#include <unit/replay_relay/unit_base.h>
+
+class replay_relay : public unit::replay_relay::Base {
+public:
+  replay_relay(const Args& args, const std::optional<std::string_view>& name_override = {}) 
+  : unit::replay_relay::Base(args, name_override)
+  {}
+
+
+  virtual unit::replay_relay::Relay::Output
+  Relay(const unit::replay_relay::Relay::Input &input) override;
+
+};
\ No newline at end of file
@@ -0,0 +1,16 @@
+/*
+
+  DO NOT EDIT THIS FILE
+
+  This is a template for use with your Unit, to use as a base, provided as an example.
+
+*/
+
+#include <replay_ticker.h>
+
+using namespace unit::replay_ticker;
+
+
+Tick::Output replay_ticker::Tick(const Tick::Input& input) {
+    static_assert(false, "Implement me");
+}
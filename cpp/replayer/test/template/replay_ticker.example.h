@@ -0,0 +1,20 @@
+/*
+
+  DO NOT EDIT THIS FILE
+
+  This is a template for use with your Unit, to use as a base, provided as an example.
+
+*/
+#include <unit/replay_ticker/unit_base.h>
+
+class replay_ticker : public unit::replay_ticker::Base {
+public:
+  replay_ticker(const Args& args, const std::optional<std::string_view>& name_override = {}) 
+  : unit::replay_ticker::Base(args, name_override)
+  {}
+
+
+  virtual unit::replay_ticker::Tick::Output
+  Tick(const unit::replay_ticker::Tick::Input &input) override;
+
+};
\ No newline at end of file
@@ -0,0 +1,176 @@
+#include <test.pb.h>
+
+#include <gtest/gtest.h>
+
+#include <basis/plugins/serialization/protobuf.h>
+#include <basis/recorder.h>
+#include <basis/replayer/deterministic_replayer.h>
+
+#include <replay_join.h>
+#include <replay_relay.h>
+#include <replay_ticker.h>
+
+#include "recording_test.h"
+
+#include <algorithm>
+#include <string_view>
+#include <string>
+#include <vector>
+
+using basis::core::Duration;
+using basis::core::MonotonicTime;
+
+/**
+ * Replays recordings through units, collecting their outputs.
+ */
+class TestDeterministicReplayer : public RecordingTest {
+public:
+  void AddRelay(const std::string &name, const std::string &input, const std::string &output, int limit = 0) {
+    units.push_back(std::make_unique<replay_relay>(replay_relay::Args(name, input, output, limit), name));
+  }
+
+  void AddJoin(const std::string &name, const std::string &left, const std::string &right, const std::string &output) {
+    units.push_back(std::make_unique<replay_join>(replay_join::Args(name, left, right, output), name));
+  }
+
+  void AddTicker(const std::string &name, const std::string &input, const std::string &output) {
+    units.push_back(std::make_unique<replay_ticker>(replay_ticker::Args(name, input, output), name));
+  }
+
+  /**
+   * Replays the recording through the units added so far, returning every output as "<msecs> <topic> <name>#<id>".
+   */
+  std::vector<std::string> Replay() {
+    basis::DeterministicReplayer replayer(config);
+    for (auto &unit : units) {
+      EXPECT_TRUE(replayer.AddUnit(std::move(unit)));
+    }
+    units.clear();
+
+    std::vector<std::string> outputs;
+    replayer.SetOutputCallback([&](const MonotonicTime &time, const std::string &topic,
+                                   const std::shared_ptr<const void> &message, const std::string &type_name) {
+      EXPECT_EQ(type_name, "TestExampleMessage");
+      // Handlers see the time of whatever set them off
+      EXPECT_EQ(MonotonicTime::Now().nsecs, time.nsecs);
+      auto msg = std::static_pointer_cast<const TestExampleMessage>(message);
+      outputs.push_back(fmt::format("{} {} {}#{}", time.nsecs / MSECS, topic, msg->name(), msg->id()));
+    });
+    EXPECT_TRUE(replayer.Run());
+    stats = replayer.GetStats();
+    return outputs;
+  }
+
+  std::vector<std::unique_ptr<basis::Unit>> units;
+  basis::DeterministicReplayer::Stats stats;
+};
+
+TEST_F(TestDeterministicReplayer, BreadthFirst) {
+  Record({{1000, "/in", "m"}});
+  AddRelay("a", "/in", "/a");
+  AddRelay("b", "/in", "/b");
+  AddRelay("a2", "/a", "/a2");
+  AddRelay("b2", "/b", "/b2");
+
+  // Everything the recorded message sets off directly comes before anything those outputs set off in turn
+  ASSERT_EQ(Replay(), (std::vector<std::string>{"1000 /a m/a#1", "1000 /b m/b#1", "1000 /a2 m/a/a2#2",
+                                                "1000 /b2 m/b/b2#2"}));
+  EXPECT_EQ(stats.messages, 1u);
+  EXPECT_EQ(stats.handler_runs, 4u);
+  EXPECT_EQ(stats.outputs, 4u);
+}
+
+TEST_F(TestDeterministicReplayer, RateTicks) {
+  Record({{1000, "/in", "first"}, {1100, "/in", "same"}, {1250, "/in", "after"}, {1300, "/in", "last"}});
+  AddTicker("t", "/in", "/ticks");
+
+  // Ticks start one period into the recording. A message at the same time as a tick is delivered first, one after
+  // it isn't seen until the next tick, and the tick at the very end of the recording still runs.
+  ASSERT_EQ(Replay(), (std::vector<std::string>{"1100 /ticks t:same#1", "1200 /ticks t:same#2",
+                                                "1300 /ticks t:last#3"}));
+  EXPECT_EQ(stats.messages, 4u);
+}
+
+TEST_F(TestDeterministicReplayer, SkipsProducedTopics) {
+  Record({{1000, "/in", "m"}, {1050, "/a", "recorded"}});
+  AddRelay("a", "/in", "/a");
+  AddRelay("a2", "/a", "/a2");
+
+  // The relay's output takes the place of the recorded /a
+  ASSERT_EQ(Replay(), (std::vector<std::string>{"1000 /a m/a#1", "1000 /a2 m/a/a2#2"}));
+  EXPECT_EQ(stats.messages, 1u);
+}
+
+TEST_F(TestDeterministicReplayer, Window) {
+  Record({{1000, "/in", "0"}, {1100, "/in", "1"}, {1200, "/in", "2"}, {1300, "/in", "3"}, {1400, "/in", "4"}});
+  AddRelay("r", "/in", "/out");
+  AddTicker("t", "/in", "/ticks");
+
+  config.start = Duration::FromNanoseconds(100 * MSECS);
+  config.end = Duration::FromNanoseconds(300 * MSECS);
+  // Ticks are relative to the start of the window, and stop at its end
+  ASSERT_EQ(Replay(), (std::vector<std::string>{"1100 /out 1/r#1", "1200 /out 2/r#1", "1200 /ticks t:2#1"}));
+  EXPECT_EQ(stats.messages, 2u);
+  EXPECT_EQ(stats.recording_nsecs, 100 * MSECS);
+}
+
+TEST_F(TestDeterministicReplayer, RestoresWallTime) {
+  Record({{1000, "/in", "m"}});
+  AddRelay("a", "/in", "/a");
+
+  bool simulated = false;
+  basis::DeterministicReplayer replayer(config);
+  ASSERT_TRUE(replayer.AddUnit(std::move(units.front())));
+  replayer.SetOutputCallback([&](auto &...) { simulated = MonotonicTime::UsingSimulatedTime(); });
+  ASSERT_TRUE(replayer.Run());
+
+  EXPECT_TRUE(simulated);
+  EXPECT_FALSE(MonotonicTime::UsingSimulatedTime());
+  EXPECT_NE(MonotonicTime::Now().nsecs, 1000 * MSECS);
+}
+
+TEST_F(TestDeterministicReplayer, ThreadsMatchSequential) {
+  std::vector<RecordedMessage> recording;
+  for (int i = 0; i < 200; i++) {
+    recording.push_back({1000 + i * 7, "/in", fmt::format("m{}", i)});
+    if (i % 2 == 0) {
+      recording.push_back({1000 + i * 7, "/cycle/in", fmt::format("c{}", i)});
+    }
+  }
+  Record(recording);
+
+  auto add_units = [&]() {
+    // A diamond, its left and right sides independent of each other
+    AddRelay("src", "/in", "/diamond/src");
+    AddRelay("left", "/diamond/src", "/diamond/left");
+    AddRelay("right", "/diamond/src", "/diamond/right");
+    AddJoin("join", "/diamond/left", "/diamond/right", "/diamond/out");
+    // Two relays feeding each other until the id reaches 6
+    AddRelay("entry", "/cycle/in", "/cycle/ping");
+    AddRelay("ping", "/cycle/ping", "/cycle/pong", 6);
+    AddRelay("pong", "/cycle/pong", "/cycle/ping", 6);
+    // Rate ticks on the diamond's output, and a relay downstream of them
+    AddTicker("ticker", "/diamond/out", "/ticks");
+    AddRelay("tick_relay", "/ticks", "/ticks/relayed");
+  };
+
+  add_units();
+  const std::vector<std::string> sequential = Replay();
+  const basis::DeterministicReplayer::Stats sequential_stats = stats;
+  auto count = [&](std::string_view part) {
+    return std::ranges::count_if(sequential, [&](const std::string &output) { return output.contains(part); });
+  };
+  EXPECT_EQ(count("1000 /diamond/out "), 1);
+  EXPECT_EQ(count("1000 /cycle/"), 6);
+  EXPECT_EQ(count(" /ticks/relayed "), 13);
+
+  for (size_t threads : {1u, 2u, 4u}) {
+    SCOPED_TRACE(fmt::format("{} threads", threads));
+    add_units();
+    config.deterministic_threads = threads;
+    EXPECT_EQ(Replay(), sequential);
+    EXPECT_EQ(stats.messages, sequential_stats.messages);
+    EXPECT_EQ(stats.handler_runs, sequential_stats.handler_runs);
+    EXPECT_EQ(stats.outputs, sequential_stats.outputs);
+  }
+}
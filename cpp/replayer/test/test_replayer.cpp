@@ -0,0 +1,361 @@
+#include <test.pb.h>
+#include <time.pb.h>
+
+#include <gtest/gtest.h>
+
+#include <basis/core/transport/transport.h>
+#include <basis/core/transport/transport_manager.h>
+#include <basis/plugins/serialization/protobuf.h>
+#include <basis/recorder.h>
+#include <basis/replayer.h>
+#include <basis/replayer/replay_args.h>
+
+#include "recording_test.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+using basis::core::Duration;
+using basis::core::MonotonicTime;
+using basis::core::transport::MessagePacket;
+
+/**
+ * Everything the replayer sends, in order - stands in for a network transport with a single subscriber per topic.
+ */
+struct Capture {
+  struct Sent {
+    std::string topic;
+    std::chrono::steady_clock::time_point wall_time;
+    std::shared_ptr<MessagePacket> packet;
+  };
+
+  /**
+   * Messages on `topic` sent but not handed to the subscriber yet. Must hold `mutex`.
+   */
+  size_t Pending(const std::string &topic) const {
+    return std::count_if(sent.begin() + delivered, sent.end(), [&](const Sent &s) { return s.topic == topic; });
+  }
+
+  std::mutex mutex;
+  std::condition_variable changed;
+  std::vector<Sent> sent;
+  std::set<std::string> advertised;
+  /// Everything before this has been handed to the subscriber - tests that don't consume hand over instantly
+  size_t delivered = 0;
+  bool consuming = false;
+  /// The most messages ever waiting on the subscriber, by topic
+  std::map<std::string, size_t> max_pending;
+};
+
+class CapturePublisher : public basis::core::transport::TransportPublisher {
+public:
+  CapturePublisher(Capture &capture, std::string_view topic) : capture(capture), topic(topic) {}
+
+  virtual void SendMessage(std::shared_ptr<MessagePacket> packet) override {
+    {
+      std::lock_guard lock(capture.mutex);
+      capture.sent.push_back({topic, std::chrono::steady_clock::now(), std::move(packet)});
+      if (!capture.consuming) {
+        capture.delivered = capture.sent.size();
+      }
+      capture.max_pending[topic] = std::max(capture.max_pending[topic], capture.Pending(topic));
+    }
+    capture.changed.notify_all();
+  }
+  virtual std::string GetTransportName() override { return "capture"; }
+  virtual std::string GetConnectionInformation() override { return ""; }
+  virtual size_t GetSubscriberCount() override { return 1; }
+  virtual size_t GetPendingMessageCount() override {
+    std::lock_guard lock(capture.mutex);
+    return capture.Pending(topic);
+  }
+  virtual void SetMaxQueueSize(size_t) override {}
+
+private:
+  Capture &capture;
+  const std::string topic;
+};
+
+class CaptureTransport : public basis::core::transport::Transport {
+public:
+  CaptureTransport(Capture &capture) : capture(capture) {}
+
+  virtual std::shared_ptr<basis::core::transport::TransportPublisher>
+  Advertise(std::string_view topic, basis::core::serialization::MessageTypeInfo) override {
+    capture.advertised.emplace(topic);
+    return std::make_shared<CapturePublisher>(capture, topic);
+  }
+  virtual std::shared_ptr<basis::core::transport::TransportSubscriber>
+  Subscribe(std::string_view, basis::core::transport::TypeErasedSubscriberCallback,
+            basis::core::threading::ThreadPool *, basis::core::serialization::MessageTypeInfo) override {
+    return nullptr;
+  }
+
+private:
+  Capture &capture;
+};
+
+/**
+ * Replays recordings in realtime, without a coordinator, capturing what's published.
+ */
+class TestReplayer : public RecordingTest {
+public:
+  TestReplayer() {
+    // Most tests only care about landing on each message
+    config.max_time_step = Duration::FromNanoseconds(0);
+    transport_manager.RegisterTransport("capture", std::make_unique<CaptureTransport>(capture));
+  }
+
+  /**
+   * Messages every `period_msecs` on /in named m0, m1, ..., starting at 1000ms.
+   */
+  void RecordPeriodic(int count, int64_t period_msecs) {
+    std::vector<RecordedMessage> messages;
+    for (int i = 0; i < count; i++) {
+      messages.push_back({1000 + i * period_msecs, "/in", fmt::format("m{}", i)});
+    }
+    Record(messages);
+  }
+
+  std::unique_ptr<basis::Replayer> CreateReplayer() {
+    return std::make_unique<basis::Replayer>(config, transport_manager, nullptr);
+  }
+
+  std::vector<std::string> Replay() {
+    EXPECT_TRUE(CreateReplayer()->Run());
+    return DescribeAll();
+  }
+
+  static basis::core::transport::proto::Time ParseTime(const Capture::Sent &sent) {
+    basis::core::transport::proto::Time time;
+    EXPECT_TRUE(time.ParseFromArray(sent.packet->GetPayload().data(), sent.packet->GetPayload().size()));
+    return time;
+  }
+
+  static std::string Describe(const Capture::Sent &sent) {
+    if (sent.topic == "/time") {
+      return fmt::format("/time {}", ParseTime(sent).nsecs() / MSECS);
+    }
+    TestExampleMessage msg;
+    EXPECT_TRUE(msg.ParseFromArray(sent.packet->GetPayload().data(), sent.packet->GetPayload().size()));
+    return fmt::format("{} {}", sent.topic, msg.name());
+  }
+
+  /**
+   * Everything sent so far, as "/time <msecs>" or "<topic> <name>".
+   */
+  std::vector<std::string> DescribeAll() {
+    std::lock_guard lock(capture.mutex);
+    std::vector<std::string> out;
+    for (const Capture::Sent &sent : capture.sent) {
+      out.push_back(Describe(sent));
+    }
+    return out;
+  }
+
+  /**
+   * Blocks until something matching `description` has been sent, returning how much had been sent by then.
+   */
+  size_t WaitFor(const std::string &description) {
+    std::unique_lock lock(capture.mutex);
+    size_t checked = 0;
+    capture.changed.wait(lock, [&]() {
+      for (; checked < capture.sent.size(); checked++) {
+        if (Describe(capture.sent[checked]) == description) {
+          return true;
+        }
+      }
+      return false;
+    });
+    return capture.sent.size();
+  }
+
+  Capture capture;
+  basis::core::transport::TransportManager transport_manager{nullptr};
+};
+
+TEST_F(TestReplayer, LandsOnMessages) {
+  Record({{1000, "/in", "a"}, {1025, "/in", "b"}, {1025, "/other", "c"}, {1060, "/in", "d"}});
+  config.as_fast_as_possible = true;
+  config.max_time_step = Duration::FromNanoseconds(10 * MSECS);
+
+  // /time steps through gaps, but never past a message. The first message is at the start time, so needs no step.
+  ASSERT_EQ(Replay(), (std::vector<std::string>{"/in a", "/time 1010", "/time 1020", "/time 1025", "/in b",
+                                                "/other c", "/time 1035", "/time 1045", "/time 1055", "/time 1060",
+                                                "/in d"}));
+}
+
+TEST_F(TestReplayer, NoTimeStep) {
+  Record({{1000, "/in", "a"}, {1025, "/in", "b"}, {1060, "/in", "c"}});
+  config.as_fast_as_possible = true;
+
+  ASSERT_EQ(Replay(), (std::vector<std::string>{"/in a", "/time 1025", "/in b", "/time 1060", "/in c"}));
+}
+
+TEST_F(TestReplayer, Rate) {
+  RecordPeriodic(11, 100);
+  config.rate = 4.0;
+
+  const auto wall_start = std::chrono::steady_clock::now();
+  ASSERT_EQ(Replay().size(), 21u);
+  const auto wall_elapsed = std::chrono::steady_clock::now() - wall_start;
+
+  // Each message goes out no earlier than its recorded offset scaled by the rate, counting from when replay began
+  std::lock_guard lock(capture.mutex);
+  int index = 0;
+  for (const Capture::Sent &sent : capture.sent) {
+    if (sent.topic == "/in") {
+      EXPECT_GE(sent.wall_time - wall_start, std::chrono::milliseconds(index * 25)) << "m" << index;
+      index++;
+    }
+  }
+  ASSERT_EQ(index, 11);
+  // A second of recording takes a quarter of that - with plenty of slack, but well short of realtime
+  ASSERT_GE(wall_elapsed, std::chrono::milliseconds(250));
+  ASSERT_LT(wall_elapsed, std::chrono::milliseconds(750));
+}
+
+TEST_F(TestReplayer, AsFastAsPossible) {
+  // 100s of recording, stepped through 10ms at a time
+  RecordPeriodic(11, 10'000);
+  config.as_fast_as_possible = true;
+  // Ignored
+  config.rate = 0.01;
+  config.max_time_step = Duration::FromNanoseconds(10 * MSECS);
+
+  const auto wall_start = std::chrono::steady_clock::now();
+  const std::vector<std::string> sent = Replay();
+  ASSERT_LT(std::chrono::steady_clock::now() - wall_start, std::chrono::seconds(10));
+
+  ASSERT_EQ(std::ranges::count_if(sent, [](const std::string &s) { return s.starts_with("/time "); }), 10'000);
+  ASSERT_EQ(std::ranges::count_if(sent, [](const std::string &s) { return s.starts_with("/in "); }), 11);
+  ASSERT_EQ(sent.front(), "/in m0");
+  ASSERT_EQ(sent[sent.size() - 2], "/time 101000");
+  ASSERT_EQ(sent.back(), "/in m10");
+}
+
+TEST_F(TestReplayer, MaxPending) {
+  constexpr int MESSAGE_COUNT = 50;
+  RecordPeriodic(MESSAGE_COUNT, 1);
+  config.as_fast_as_possible = true;
+  config.max_pending_messages = 2;
+
+  // A subscriber slower than replay
+  capture.consuming = true;
+  std::atomic<bool> done = false;
+  std::thread subscriber([&]() {
+    std::unique_lock lock(capture.mutex);
+    while (!done || capture.delivered < capture.sent.size()) {
+      if (capture.delivered < capture.sent.size()) {
+        capture.delivered++;
+        lock.unlock();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        lock.lock();
+      } else {
+        capture.changed.wait_for(lock, std::chrono::milliseconds(1));
+      }
+    }
+  });
+  const std::vector<std::string> sent = Replay();
+  done = true;
+  subscriber.join();
+
+  // Replay held off rather than letting the subscriber fall further behind, and nothing was lost
+  ASSERT_LE(capture.max_pending["/in"], 2u);
+  std::vector<std::string> messages;
+  std::ranges::copy_if(sent, std::back_inserter(messages), [](const std::string &s) { return s.starts_with("/in "); });
+  ASSERT_EQ(messages.size(), size_t(MESSAGE_COUNT));
+  for (int i = 0; i < MESSAGE_COUNT; i++) {
+    ASSERT_EQ(messages[i], fmt::format("/in m{}", i));
+  }
+}
+
+TEST_F(TestReplayer, Window) {
+  std::vector<RecordedMessage> messages;
+  for (int i = 0; i < 10; i++) {
+    messages.push_back({1000 + i * 100, "/a", fmt::format("a{}", i)});
+    messages.push_back({1000 + i * 100, "/b", fmt::format("b{}", i)});
+  }
+  Record(messages);
+  config.as_fast_as_possible = true;
+  config.start = Duration::FromNanoseconds(250 * MSECS);
+  config.end = Duration::FromNanoseconds(600 * MSECS);
+  config.topics = {"/b"};
+
+  // The end is exclusive, and /a isn't even advertised
+  ASSERT_EQ(Replay(), (std::vector<std::string>{"/time 1300", "/b b3", "/time 1400", "/b b4", "/time 1500", "/b b5"}));
+  ASSERT_EQ(capture.advertised, (std::set<std::string>{"/b", "/time"}));
+}
+
+TEST_F(TestReplayer, SeekWhileRunning) {
+  RecordPeriodic(20, 100);
+  config.rate = 4.0;
+  std::unique_ptr<basis::Replayer> replayer = CreateReplayer();
+
+  std::thread run([&]() { EXPECT_TRUE(replayer->Run()); });
+  const size_t sent_before_seek = WaitFor("/in m10");
+  // Back between two messages
+  replayer->Seek(MonotonicTime::FromNanoseconds(1250 * MSECS));
+  run.join();
+
+  std::lock_guard lock(capture.mutex);
+  const uint64_t first_token = ParseTime(capture.sent[1]).run_token();
+  size_t restart = sent_before_seek;
+  while (restart < capture.sent.size() &&
+         (capture.sent[restart].topic != "/time" || ParseTime(capture.sent[restart]).run_token() == first_token)) {
+    restart++;
+  }
+  // At most one message or /time step was already on its way out when the seek came in
+  ASSERT_LE(restart - sent_before_seek, 1u);
+
+  // /time picks up from the seek, under a new run token, and playback carries on from there
+  std::vector<std::string> after;
+  for (size_t i = restart; i < capture.sent.size(); i++) {
+    after.push_back(Describe(capture.sent[i]));
+  }
+  std::vector<std::string> expected;
+  for (int i = 3; i < 20; i++) {
+    expected.push_back(fmt::format("/time {}", 1000 + i * 100));
+    expected.push_back(fmt::format("/in m{}", i));
+  }
+  ASSERT_EQ(after, expected);
+}
+
+/**
+ * Parses a replay command line into a Config.
+ */
+static bool ParseRecordingArguments(std::vector<std::string> args, basis::replayer::Config &config) {
+  argparse::ArgumentParser parser("replay");
+  basis::replayer::AddRecordingArguments(parser);
+  args.insert(args.begin(), "replay");
+  parser.parse_args(args);
+  return basis::replayer::HandleRecordingArguments(parser, config);
+}
+
+TEST(TestReplayArguments, RecordingArguments) {
+  basis::replayer::Config config;
+  ASSERT_TRUE(
+      ParseRecordingArguments({"--topics", "/a", "--topics", "/b", "--start", "1.5", "--end", "3", "in.mcap"}, config));
+  ASSERT_EQ(config.input.string(), "in.mcap");
+  ASSERT_EQ(config.topics, (std::vector<std::string>{"/a", "/b"}));
+  ASSERT_EQ(config.start, Duration::FromSeconds(1.5));
+  ASSERT_EQ(config.end, Duration::FromSeconds(3));
+
+  config = {};
+  ASSERT_TRUE(ParseRecordingArguments({"in.mcap"}, config));
+  ASSERT_TRUE(config.topics.empty());
+  ASSERT_FALSE(config.start);
+  ASSERT_FALSE(config.end);
+
+  ASSERT_FALSE(ParseRecordingArguments({"--start", "-1", "in.mcap"}, config));
+  ASSERT_FALSE(ParseRecordingArguments({"--start", "2", "--end", "2", "in.mcap"}, config));
+  ASSERT_FALSE(ParseRecordingArguments({"--start", "2", "--end", "1", "in.mcap"}, config));
+  ASSERT_FALSE(ParseRecordingArguments({"--end", "-1", "in.mcap"}, config));
+}
@@ -12,10 +12,16 @@
 
 #include "unit/args_template.h"
 
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
 #include <memory>
+#include <mutex>
+#include <thread>
 #include <tuple>
 #include <type_traits>
 #include <unordered_map>
+#include <vector>
 
 namespace basis {
 class DeterministicReplayer;
@@ -44,7 +50,11 @@ struct HandlerPubSub {
   spdlog::logger *const AUTO_LOGGER;
   std::map<std::string, TypeErasedCallback> type_erased_callbacks;
   std::vector<std::string> outputs;
+  // The type name of each output, as type erased callbacks expect it - the inproc type, for outputs that have one
+  std::vector<std::string> output_type_names;
   std::optional<basis::core::Duration> rate_duration;
+  // Priority and deadline of everything this handler queues, along with its dispatch latency and deadline misses
+  basis::core::containers::CallbackSchedule schedule;
 };
 
 // Helper - if we're raw serialization, use it
@@ -373,6 +383,141 @@ protected:
   basis::core::threading::ThreadPool thread_pool{4};
 };
 
-// todo: interface for multithreaded units
+/**
+ * A unit where handlers run in parallel with each other on a pool of threads, but never in parallel with themselves.
+ * Each handler has its own queue (see CreateHandlerQueue()), handed to a worker whenever something lands in it, so a
+ * slow handler only delays itself. Anything shared between handlers is up to the unit to protect.
+ */
+class MultiThreadedUnit : public Unit {
+protected:
+  using Unit::Update;
+
+public:
+  using Unit::Advertise;
+  using Unit::Initialize;
+
+  /**
+   * @param handler_thread_count threads to run handlers on, one per core if zero
+   */
+  MultiThreadedUnit(std::string_view unit_name, size_t handler_thread_count = 0)
+      : Unit(unit_name),
+        handler_thread_pool(handler_thread_count ? handler_thread_count
+                                                 : std::max(1u, std::thread::hardware_concurrency())) {}
+
+  ~MultiThreadedUnit() { StopHandlers(); }
+
+  /**
+   * Handlers don't wait on Update() - this only services the transports and the coordinator connection.
+   */
+  virtual void Update(std::atomic<bool> *stop_token, const basis::core::Duration &max_execution_duration) override {
+    Unit::Update(stop_token, max_execution_duration);
+    std::this_thread::sleep_for(
+        std::min<std::chrono::nanoseconds>(std::chrono::nanoseconds(max_execution_duration.nsecs), UPDATE_INTERVAL));
+  }
+
+  /**
+   * Subscribes with a queue of its own - the callback runs on the handler pool, in order, one at a time.
+   */
+  template <typename T_MSG, typename T_Serializer = SerializationHandler<T_MSG>::type>
+  [[nodiscard]] std::shared_ptr<core::transport::Subscriber<T_MSG>>
+  Subscribe(std::string_view topic, core::transport::SubscriberCallback<T_MSG> callback, size_t queue_depth = 0,
+            core::serialization::MessageTypeInfo message_type = T_Serializer::template DeduceMessageTypeInfo<T_MSG>()) {
+    return Unit::Subscribe<T_MSG, T_Serializer>(
+        topic, callback, &thread_pool,
+        std::make_shared<basis::core::containers::SubscriberQueue>(CreateHandlerQueue(), queue_depth),
+        std::move(message_type));
+  }
+
+protected:
+  /**
+   * A queue for one handler. Callbacks added to it run on the handler pool, in order, never two at once.
+   */
+  std::shared_ptr<basis::core::containers::SubscriberOverallQueue> CreateHandlerQueue() {
+    auto handler_queue = std::make_shared<HandlerQueue>();
+    handler_queue->thread_pool = &handler_thread_pool;
+    handler_queue->queue = std::make_shared<basis::core::containers::SubscriberOverallQueue>(
+        [weak_handler_queue = std::weak_ptr<HandlerQueue>(handler_queue)]() {
+          if (auto locked = weak_handler_queue.lock()) {
+            Schedule(locked);
+          }
+        });
+    std::lock_guard lock(handler_queues_mutex);
+    handler_queues.push_back(handler_queue);
+    return handler_queue->queue;
+  }
+
+  /**
+   * Stops handing callbacks to the pool, then waits for any handler still running. Call before tearing down anything
+   * handlers use - the generated Base does so in its destructor.
+   */
+  void StopHandlers() {
+    std::lock_guard lock(handler_queues_mutex);
+    for (auto &handler_queue : handler_queues) {
+      std::lock_guard stop_lock(handler_queue->stop_mutex);
+      handler_queue->stopped = true;
+    }
+    for (auto &handler_queue : handler_queues) {
+      std::unique_lock stop_lock(handler_queue->stop_mutex);
+      handler_queue->idle.wait(stop_lock, [&]() { return !handler_queue->scheduled; });
+    }
+  }
+
+  /// For deserialization and async publishing, same as SingleThreadedUnit
+  basis::core::threading::ThreadPool thread_pool{4};
+
+private:
+  struct HandlerQueue {
+    std::shared_ptr<basis::core::containers::SubscriberOverallQueue> queue;
+    basis::core::threading::ThreadPool *thread_pool = nullptr;
+    /// Set while the queue is posted to or running on the pool - only one worker ever has it
+    std::atomic<bool> scheduled = false;
+    std::mutex stop_mutex;
+    /// Notified under `stop_mutex` whenever `scheduled` is cleared
+    std::condition_variable idle;
+    std::atomic<bool> stopped = false;
+  };
+
+  static void Schedule(const std::shared_ptr<HandlerQueue> &handler_queue) {
+    if (handler_queue->scheduled.exchange(true)) {
+      // Whoever has it will get to this
+      return;
+    }
+    std::lock_guard lock(handler_queue->stop_mutex);
+    if (handler_queue->stopped) {
+      handler_queue->scheduled = false;
+      handler_queue->idle.notify_all();
+      return;
+    }
+    handler_queue->thread_pool->post([handler_queue]() { Drain(handler_queue); });
+  }
+
+  static void Drain(const std::shared_ptr<HandlerQueue> &handler_queue) {
+    // Bounded, so that handlers share workers fairly when there are more of them than threads
+    for (size_t ran = 0; ran < HANDLER_BATCH_SIZE && !handler_queue->stopped; ran++) {
+      auto event = handler_queue->queue->Pop();
+      if (!event) {
+        break;
+      }
+      (*event)();
+    }
+    // An exchange rather than a store, to see everything pushed by whoever found the queue still scheduled
+    handler_queue->scheduled.exchange(false);
+    {
+      std::lock_guard lock(handler_queue->stop_mutex);
+      handler_queue->idle.notify_all();
+    }
+    // Those pushes weren't scheduled, and a full batch leaves work behind
+    if (handler_queue->queue->Size() != 0) {
+      Schedule(handler_queue);
+    }
+  }
+
+  static constexpr size_t HANDLER_BATCH_SIZE = 16;
+  static constexpr std::chrono::milliseconds UPDATE_INTERVAL{10};
+
+  basis::core::threading::ThreadPool handler_thread_pool;
+  std::mutex handler_queues_mutex;
+  std::vector<std::shared_ptr<HandlerQueue>> handler_queues;
+};
 
 } // namespace basis
\ No newline at end of file
@@ -1,5 +1,7 @@
 #include "basis/unit.h"
 
+#include <basis/plugins/transport/shm.h>
+
 namespace basis {
 std::unique_ptr<basis::core::transport::TransportManager>
 CreateStandardTransportManager(basis::RecorderInterface *recorder) {
@@ -12,6 +14,8 @@ CreateStandardTransportManager(basis::RecorderInterface *recorder) {
 
   transport_manager->RegisterTransport(basis::plugins::transport::TCP_TRANSPORT_NAME,
                                        std::make_unique<basis::plugins::transport::TcpTransport>());
+  transport_manager->RegisterTransport(basis::plugins::transport::SHM_TRANSPORT_NAME,
+                                       std::make_unique<basis::plugins::transport::ShmTransport>());
 
   return transport_manager;
 }
@@ -27,7 +31,7 @@ void StandardUpdate(basis::core::transport::TransportManager *transport_manager,
     if (new_schemas.size()) {
       coordinator_connector->SendSchemas(new_schemas);
     }
-    coordinator_connector->SendTransportManagerInfo(transport_manager->GetTransportManagerInfo());
+    coordinator_connector->SendPublishersIfChanged(transport_manager->GetTransportManagerInfo());
     coordinator_connector->Update();
 
     if (coordinator_connector->GetLastNetworkInfo()) {
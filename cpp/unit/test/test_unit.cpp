@@ -0,0 +1,111 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <basis/unit.h>
+
+using namespace std::chrono_literals;
+
+/**
+ * Exposes the handler queues that generated multi threaded units subscribe with.
+ */
+class TestMultiThreadedUnit : public basis::MultiThreadedUnit {
+public:
+  using MultiThreadedUnit::MultiThreadedUnit;
+  using MultiThreadedUnit::CreateHandlerQueue;
+  using MultiThreadedUnit::StopHandlers;
+
+  virtual void Initialize(const basis::UnitInitializeOptions &) override {}
+};
+
+class MultiThreadedUnitTest : public testing::Test {
+public:
+  MultiThreadedUnitTest() { basis::core::logging::InitializeLoggingSystem(); }
+};
+
+/**
+ * Callbacks for one handler run in order, one at a time, even with threads to spare
+ */
+TEST_F(MultiThreadedUnitTest, HandlerNeverRunsWithItself) {
+  TestMultiThreadedUnit unit("test_unit", 4);
+  auto queue = unit.CreateHandlerQueue();
+
+  constexpr int CALLBACK_COUNT = 200;
+  std::atomic<int> running = 0;
+  std::atomic<int> max_running = 0;
+  std::atomic<int> num_ran = 0;
+  std::vector<int> order;
+  for (int i = 0; i < CALLBACK_COUNT; i++) {
+    queue->AddCallback([&, i]() {
+      const int now_running = ++running;
+      int expected = max_running;
+      while (now_running > expected && !max_running.compare_exchange_weak(expected, now_running)) {
+      }
+      order.push_back(i);
+      std::this_thread::sleep_for(50us);
+      running--;
+      num_ran++;
+    });
+  }
+
+  for (int i = 0; i < 500 && num_ran != CALLBACK_COUNT; i++) {
+    std::this_thread::sleep_for(10ms);
+  }
+  ASSERT_EQ(num_ran, CALLBACK_COUNT);
+  ASSERT_EQ(max_running, 1);
+  for (int i = 0; i < CALLBACK_COUNT; i++) {
+    ASSERT_EQ(order[i], i);
+  }
+}
+
+/**
+ * Different handlers run in parallel - the first only finishes once the second has run
+ */
+TEST_F(MultiThreadedUnitTest, HandlersRunInParallel) {
+  TestMultiThreadedUnit unit("test_unit", 2);
+  auto first = unit.CreateHandlerQueue();
+  auto second = unit.CreateHandlerQueue();
+
+  std::promise<void> second_ran;
+  std::promise<bool> first_saw_second;
+  first->AddCallback([future = second_ran.get_future().share(), &first_saw_second]() {
+    first_saw_second.set_value(future.wait_for(5s) == std::future_status::ready);
+  });
+  second->AddCallback([&second_ran]() { second_ran.set_value(); });
+
+  auto result = first_saw_second.get_future();
+  ASSERT_EQ(result.wait_for(10s), std::future_status::ready);
+  ASSERT_TRUE(result.get());
+}
+
+/**
+ * StopHandlers() returns only once the running handler is done, and nothing runs after it
+ */
+TEST_F(MultiThreadedUnitTest, StopHandlersWaitsForRunningHandler) {
+  TestMultiThreadedUnit unit("test_unit", 2);
+  auto queue = unit.CreateHandlerQueue();
+
+  std::promise<void> started;
+  std::atomic<bool> finished = false;
+  std::atomic<int> num_ran = 0;
+  queue->AddCallback([&]() {
+    started.set_value();
+    std::this_thread::sleep_for(100ms);
+    finished = true;
+    num_ran++;
+  });
+  queue->AddCallback([&]() { num_ran++; });
+
+  started.get_future().wait();
+  unit.StopHandlers();
+  ASSERT_TRUE(finished);
+
+  queue->AddCallback([&]() { num_ran++; });
+  std::this_thread::sleep_for(50ms);
+  ASSERT_EQ(num_ran, 1);
+}
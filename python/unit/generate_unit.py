@@ -48,9 +48,12 @@ def generate_unit(unit_path, output_dir, source_dir):
     # todo: set default sync to 'all'
     
     unit.setdefault('args', {})
+    unit.setdefault('threading_model', 'single')
+    # 0 - one handler thread per core
+    unit.setdefault('threads', 0)
 
     
-    qos_defaults = {'depth': 10}
+    qos_defaults = {'depth': 10, 'async': False, 'async_depth': 10, 'async_drop_policy': 'drop_oldest'}
     def merge_qos_defaults(topic: dict, defaults: dict) -> None:
         if 'qos' in topic:
             topic['qos'] = {**defaults, **topic['qos']}
@@ -61,6 +64,10 @@ def generate_unit(unit_path, output_dir, source_dir):
     for handler_name, handler in unit['handlers'].items():
         handler.setdefault('inputs', {})
         handler.setdefault('outputs', {})
+        handler.setdefault('qos', {})
+        handler['qos'].setdefault('priority', 0)
+        # No deadline unless the unit asks for one - these keep their place in line with the unit's other callbacks
+        handler['qos'].setdefault('deadline', None)
         for output in handler['outputs'].values():
             output.setdefault('optional', False)
 